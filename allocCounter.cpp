@@ -0,0 +1,72 @@
+/*!
+ * Heap allocation counting
+ * \date 10/19/26
+ */
+
+#include "allocCounter.h"
+#include "numaPlacement.h"
+#include <new>
+#include <stdlib.h>
+
+// exception specifications of the replaced operators must match the standard library's
+#if __cplusplus >= 201103L
+#define NEW_THROWS
+#define NEVER_THROWS noexcept
+#else
+#define NEW_THROWS throw (std::bad_alloc)
+#define NEVER_THROWS throw ()
+#endif
+
+static long nAllocs = 0;    //!< Number of calls to operator new
+
+/*!
+ * Report the number of calls to operator new (any form) so far, plus the blocks obtained from placedAlloc (which bypasses operator new).
+ */
+long allocCount () {
+	long n;
+	#pragma omp atomic read
+	n = nAllocs;
+	return n + placedAllocCount();
+}
+
+/*!
+ * Counting replacement for the global operator new.
+ *
+ * \param [in] size Number of bytes requested
+ */
+void* operator new (size_t size) NEW_THROWS {
+	#pragma omp atomic
+	nAllocs++;
+	void *p = malloc(size ? size : 1);
+	if (p == NULL) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+/*!
+ * Counting replacement for the global operator new[].
+ *
+ * \param [in] size Number of bytes requested
+ */
+void* operator new[] (size_t size) NEW_THROWS {
+	return operator new (size);
+}
+
+/*!
+ * Replacement for the global operator delete matching the counting operator new.
+ *
+ * \param [in] p Memory to release
+ */
+void operator delete (void *p) NEVER_THROWS {
+	free(p);
+}
+
+/*!
+ * Replacement for the global operator delete[] matching the counting operator new[].
+ *
+ * \param [in] p Memory to release
+ */
+void operator delete[] (void *p) NEVER_THROWS {
+	free(p);
+}
@@ -0,0 +1,16 @@
+/*!
+ * Heap allocation counting
+ * \date 10/19/26
+ */
+
+#ifndef __ALLOC_COUNTER_H__
+#define __ALLOC_COUNTER_H__
+
+/*!
+ * Linking allocCounter.o replaces the global operator new/delete with versions that count every heap allocation made through them.
+ * Per-atom arrays using firstTouchAllocator are allocated with placedAlloc instead, which keeps its own count; allocCount() includes it.
+ * Intended for tests which check a loop performs no allocations.
+ */
+long allocCount ();     //!< Report the number of calls to operator new (any form) and placedAlloc so far
+
+#endif
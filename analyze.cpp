@@ -0,0 +1,116 @@
+/*!
+ * Offline trajectory analysis: radial distribution function, mean squared displacement, structure factor and density profiles
+ * \date 10/19/26
+ */
+
+#include "system.h"
+#include "trajectoryAnalysis.h"
+#include "structureFactor.h"
+#include "common.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <omp.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/*!
+ * Invoke the program as
+ * $ ./analyze numThreads trajectory L [rmax] [kmax] [maxLag]
+ * trajectory is either trajectory.xyz, whose (cubic) box length L must be given since XYZ frames do not record it, or a compressed
+ * trajectory (trajectory.ctz), whose frames carry their box and for which L is ignored.
+ * Frames are read in batches of one per thread; g(r) (up to rmax, default 2.5) and the density profiles are accumulated with each
+ * thread analyzing whole frames, while S(k) (up to kmax, default 10, with structureFactor) and the MSD (up to maxLag frames apart,
+ * default 100) are computed frame by frame in parallel over atoms.  Writes gr.dat, sk.dat, density.dat and msd.dat.
+ */
+int main (int argc, char* argv[]) {
+	if (argc < 4 || argc > 7) {
+		// catch incorrect number of arguments
+		printf("USAGE: %s <nthreads> <trajectory> <L> [rmax] [kmax] [maxLag] \n",argv[0]);
+		exit(1);
+	}
+
+	const int nthreads = atoi(argv[1]);
+	const float L = atof(argv[3]);
+	const float rmax = (argc >= 5) ? atof(argv[4]) : 2.5;
+	const float kmax = (argc >= 6) ? atof(argv[5]) : 10.0;
+	const int maxLag = (argc >= 7) ? atoi(argv[6]) : 100;
+	omp_set_num_threads(nthreads);
+
+	float3 box;
+	box.x = L; box.y = L; box.z = L;
+	mappedTrajectory traj (argv[2], box);
+	if (!traj.compressed() && L <= 0.0) {
+		throw customException ("The box length of an XYZ trajectory must be > 0");
+	}
+
+	const double t0 = omp_get_wtime();
+	std::vector <std::vector <float3> > frames (nthreads);
+	std::vector <float3> boxes (nthreads);
+	std::vector <frameStatistics> stats (nthreads);
+	for (int t = 0; t < nthreads; ++t) {
+		stats[t].clear();
+	}
+	structureFactor sf (kmax);
+	systemDefinition snapshot;
+	msdWindow msd (maxLag);
+	int nFrames = 0;
+	bool more = true;
+	while (more) {
+		int n = 0;
+		while (n < nthreads && (more = traj.next(frames[n], boxes[n]))) {
+			n++;
+		}
+		traj.release();
+		if (n == 0) break;
+
+		#pragma omp parallel for schedule(dynamic, 1)
+		for (int f = 0; f < n; ++f) {
+			frameStatistics &acc = stats[omp_get_thread_num()];
+			addRdf(frames[f], boxes[f], rmax, acc);
+			addProfile(frames[f], boxes[f], acc);
+			acc.frames++;
+		}
+		for (int f = 0; f < n; ++f) {
+			snapshot.atoms.resize(frames[f].size());
+			for (unsigned int i = 0; i < frames[f].size(); ++i) {
+				snapshot.atoms[i].pos = frames[f][i];
+			}
+			snapshot.setBox(boxes[f].x, boxes[f].y, boxes[f].z);
+			sf.sample(snapshot);
+			msd.add(frames[f], boxes[f]);
+		}
+		nFrames += n;
+	}
+	if (nFrames == 0) {
+		std::cerr << "No frames in " << argv[2] << std::endl;
+		return 1;
+	}
+
+	// combine the threads' accumulators
+	frameStatistics &total = stats[0];
+	for (int t = 1; t < nthreads; ++t) {
+		total.frames += stats[t].frames;
+		total.grFrames += stats[t].grFrames;
+		for (unsigned int b = 0; b < total.gr.size(); ++b) total.gr[b] += stats[t].gr[b];
+		for (unsigned int b = 0; b < total.profile.size(); ++b) total.profile[b] += stats[t].profile[b];
+	}
+
+	std::ofstream gr ("gr.dat");
+	for (int b = 0; b < GR_BINS && total.grFrames > 0; ++b) {
+		gr << (b+0.5)*rmax/GR_BINS << "\t" << total.gr[b]/total.grFrames << std::endl;
+	}
+	sf.write("sk.dat");
+	std::ofstream density ("density.dat");
+	for (int b = 0; b < PROFILE_BINS; ++b) {
+		density << (b+0.5)/PROFILE_BINS << "\t" << total.profile[b]/total.frames << "\t" << total.profile[PROFILE_BINS+b]/total.frames << "\t" << total.profile[2*PROFILE_BINS+b]/total.frames << std::endl;
+	}
+	std::ofstream msdFile ("msd.dat");
+	msd.write(msdFile);
+
+	std::cout << "Analyzed " << nFrames << " frames in " << omp_get_wtime()-t0 << " s" << std::endl;
+	if (total.grFrames < nFrames) {
+		std::cerr << nFrames-total.grFrames << " frames had a box smaller than 3.03 rmax and were left out of g(r)" << std::endl;
+	}
+	return 0;
+}
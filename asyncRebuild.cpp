@@ -0,0 +1,162 @@
+/*!
+ * Speculative cell list rebuilds on a helper thread
+ * \date 10/19/26
+ */
+
+#include "asyncRebuild.h"
+#include "common.h"
+#include <omp.h>
+
+asyncCellList::asyncCellList () {
+	running_ = false;
+	done_ = false;
+	nStarted_ = 0;
+	nTaken_ = 0;
+	nWaits_ = 0;
+	waitTime_ = 0.0;
+	pthread_mutex_init(&lock_, NULL);
+}
+
+/*!
+ * The copy is idle, whatever the original is doing.
+ *
+ * \param [in] other Builder to copy the statistics of
+ */
+asyncCellList::asyncCellList (const asyncCellList &other) {
+	running_ = false;
+	done_ = false;
+	nStarted_ = other.nStarted_;
+	nTaken_ = other.nTaken_;
+	nWaits_ = other.nWaits_;
+	waitTime_ = other.waitTime_;
+	pthread_mutex_init(&lock_, NULL);
+}
+
+/*!
+ * Any rebuild in progress is discarded and this builder becomes idle.
+ *
+ * \param [in] other Builder to copy the statistics of
+ */
+asyncCellList& asyncCellList::operator= (const asyncCellList &other) {
+	if (this != &other) {
+		cancel();
+		nStarted_ = other.nStarted_;
+		nTaken_ = other.nTaken_;
+		nWaits_ = other.nWaits_;
+		waitTime_ = other.waitTime_;
+	}
+	return *this;
+}
+
+asyncCellList::~asyncCellList () {
+	cancel();
+	pthread_mutex_destroy(&lock_);
+}
+
+/*!
+ * Copy the list and the system's positions and box, then rebuild the copy on the helper thread.  The copies are made here, on the
+ * calling thread, so the system may be advanced as soon as this returns.
+ *
+ * \param [in] cl Current cell list
+ * \param [in] sys System definition
+ */
+void asyncCellList::start (const cellList_cpu &cl, const systemDefinition &sys) {
+#ifdef NVCC
+	throw customException ("Asynchronous cell list rebuilds are only supported on the CPU");
+	return;
+#else
+	if (running_) {
+		throw customException ("A cell list rebuild is already in progress");
+		return;
+	}
+	next_ = cl;
+	snap_.atoms = sys.atoms;
+	const float3 box = sys.box();
+	snap_.setBox(box.x, box.y, box.z);
+	done_ = false;
+	error_.clear();
+	if (pthread_create(&thread_, NULL, worker_, this) != 0) {
+		throw customException ("Unable to start the cell list rebuild thread");
+		return;
+	}
+	running_ = true;
+	nStarted_++;
+#endif
+}
+
+/*!
+ * \return True if a rebuild was started and has finished, so take() will not wait
+ */
+bool asyncCellList::ready () {
+	if (!running_) {
+		return false;
+	}
+	pthread_mutex_lock(&lock_);
+	const bool done = done_;
+	pthread_mutex_unlock(&lock_);
+	return done;
+}
+
+/*!
+ * Wait for the rebuild started last to finish and replace the list with it.  An exception thrown by the rebuild is thrown again here.
+ *
+ * \param [out] cl Cell list to replace
+ */
+void asyncCellList::take (cellList_cpu &cl) {
+	if (!running_) {
+		throw customException ("No cell list rebuild was started");
+		return;
+	}
+	if (!ready()) {
+		const double t0 = omp_get_wtime();
+		join_();
+		waitTime_ += omp_get_wtime()-t0;
+		nWaits_++;
+	} else {
+		join_();
+	}
+	if (!error_.empty()) {
+		throw customException (error_);
+		return;
+	}
+	cl = next_;
+	nTaken_++;
+}
+
+/*!
+ * Wait for any rebuild in progress and discard it, e.g. when the list it would replace is recreated.
+ */
+void asyncCellList::cancel () {
+	if (running_) {
+		join_();
+	}
+}
+
+void* asyncCellList::worker_ (void *self) {
+	static_cast <asyncCellList*> (self)->run_();
+	return NULL;
+}
+
+/*!
+ * The rebuild runs on this thread alone, so it does not compete with the integrator's OpenMP threads for cores.
+ */
+void asyncCellList::run_ () {
+	std::string error;
+	omp_set_num_threads(1);
+#ifndef NVCC
+	try {
+		next_.rebuild(snap_);
+	} catch (std::exception &e) {
+		error = e.what();
+	}
+#endif
+	pthread_mutex_lock(&lock_);
+	error_ = error;
+	done_ = true;
+	pthread_mutex_unlock(&lock_);
+}
+
+void asyncCellList::join_ () {
+	pthread_join(thread_, NULL);
+	running_ = false;
+}
@@ -0,0 +1,57 @@
+/*!
+ * Speculative cell list rebuilds on a helper thread
+ * \date 10/19/26
+ */
+
+#ifndef __ASYNC_REBUILD_H__
+#define __ASYNC_REBUILD_H__
+
+#include <string>
+#include <pthread.h>
+#include "cellList.h"
+#include "system.h"
+
+/*!
+ * Builds the next cell list on a helper thread while the integrator carries on with the current one.  start() copies the list, the
+ * positions and the box as they are now and rebuilds the copy at those (by the time it is used, slightly stale) positions; take()
+ * hands it over once it is ready.  A list built from a snapshot remembers the snapshot's positions as its reference, so the usual
+ * displacement check against it stays exact: it is only valid while the atoms remain within its skin of where they were when the
+ * snapshot was taken.
+ * A copy of a builder starts idle, so integrators holding one may still be copied.
+ * Only the CPU cell list can be built this way.
+ */
+class asyncCellList {
+	public:
+		asyncCellList ();
+		asyncCellList (const asyncCellList &other);
+		asyncCellList& operator= (const asyncCellList &other);
+		~asyncCellList ();
+		void start (const cellList_cpu &cl, const systemDefinition &sys);   //!< Start rebuilding a copy of the list at the system's current positions
+		bool busy () const {return running_;}           //!< Report if a rebuild was started and not yet taken (or cancelled)
+		bool ready ();                                  //!< Report, without waiting, if a started rebuild has finished
+		void take (cellList_cpu &cl);                   //!< Wait for the rebuild to finish and replace the list with it
+		void cancel ();                                 //!< Wait for any rebuild to finish and discard it
+		int numStarted () const {return nStarted_;}     //!< Report how many rebuilds were started
+		int numTaken () const {return nTaken_;}         //!< Report how many rebuilt lists were swapped in
+		int numWaits () const {return nWaits_;}         //!< Report how many times a list was needed before its rebuild had finished
+		double waitTime () const {return waitTime_;}    //!< Report the total time take() spent waiting for unfinished rebuilds
+
+	private:
+		bool running_;              //!< Flag for whether the helper thread was started and not yet joined
+		bool done_;                 //!< Flag for whether the helper thread has finished its rebuild
+		std::string error_;         //!< Message of any exception thrown by the rebuild
+		cellList_cpu next_;         //!< List being rebuilt
+		systemDefinition snap_;     //!< Positions and box the list is rebuilt from
+		int nStarted_;              //!< Number of rebuilds started
+		int nTaken_;                //!< Number of rebuilt lists taken
+		int nWaits_;                //!< Number of times take() had to wait
+		double waitTime_;           //!< Time take() spent waiting
+		pthread_t thread_;          //!< Helper thread
+		pthread_mutex_t lock_;      //!< Protects done_ and error_
+
+		static void* worker_ (void *self);  //!< Thread entry point
+		void run_ ();                       //!< Rebuild the list, then flag it as done
+		void join_ ();                      //!< Wait for the helper thread to exit
+};
+
+#endif
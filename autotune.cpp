@@ -0,0 +1,310 @@
+/*!
+ * Runtime autotuning of performance parameters
+ * \date 10/19/26
+ */
+
+#include "autotune.h"
+#include "common.h"
+#include <math.h>
+#include <omp.h>
+
+/*!
+ * Initialize the tuner with default candidates.
+ * Thread counts are powers of 2 up to (and including) the current OMP maximum.
+ */
+autoTuner::autoTuner () {
+	stage_ = THREADS;
+	started_ = 0;
+	candidate_ = 0;
+	trialStep_ = 0;
+	trialSteps_ = 20;
+	retuneInterval_ = 1000;
+	retuneTol_ = 0.1;
+	stepsSinceCheck_ = 0;
+	nTunings_ = 0;
+	sumT_ = 0.0;
+
+	const int maxThreads = omp_get_max_threads();
+	for (int n = 1; n < maxThreads; n *= 2) {
+		threads_.push_back(n);
+	}
+	threads_.push_back(maxThreads);
+
+	const float rs[] = {0.0, 0.25, 0.5, 0.75, 1.0};
+	skins_.assign(rs, rs+5);
+	const float scale[] = {1.01, 1.1, 1.25};
+	cellScales_.assign(scale, scale+3);
+	const int subdiv[] = {1, 2, 3};
+	cellSubdivs_.assign(subdiv, subdiv+3);
+
+	const omp_sched_t fk[] = {omp_sched_dynamic, omp_sched_dynamic, omp_sched_dynamic, omp_sched_guided, omp_sched_static};
+	const int fc[] = {1, 4, 16, 1, 0};
+	forceKinds_.assign(fk, fk+5);
+	forceChunks_.assign(fc, fc+5);
+
+	const omp_sched_t sk[] = {omp_sched_dynamic, omp_sched_dynamic, omp_sched_guided, omp_sched_static};
+	const int sc[] = {OMP_CHUNK, 10*OMP_CHUNK, OMP_CHUNK, 0};
+	sweepKinds_.assign(sk, sk+4);
+	sweepChunks_.assign(sc, sc+4);
+}
+
+/*!
+ * Advance the system one step.  While tuning, every candidate is run for one untimed warmup step (which absorbs the forced rebuild of the cell list)
+ * followed by a number of timed steps.  Once tuned, the density and mean temperature are periodically compared to the values the system was tuned at.
+ *
+ * \param [in, out] sys System definition
+ * \param [in, out] integrate Integrator used to advance the system
+ */
+void autoTuner::step (systemDefinition &sys, integrator &integrate) {
+	if (!started_) {
+		current_.threads = omp_get_max_threads();
+		current_.rs = sys.rskin();
+		current_.cellScale = integrate.cellScale();
+		current_.cellSubdiv = integrate.cellSubdivisions();
+		current_.forceSteal = integrate.workStealing();
+		current_.forceKind = omp_sched_dynamic;
+		current_.forceChunk = 1;
+		current_.sweepKind = omp_sched_dynamic;
+		current_.sweepChunk = OMP_CHUNK;
+		apply_(current_, sys, integrate);
+		started_ = 1;
+		stage_ = THREADS;
+		candidate_ = 0;
+		trialStep_ = 0;
+		bestCost_ = -1.0;
+		if (!startTrial_(sys, integrate)) {
+			finishStage_(sys, integrate);
+		}
+	}
+
+	if (stage_ == DONE) {
+		integrate.step(sys);
+		sumT_ += sys.instantT();
+		stepsSinceCheck_++;
+		if (retuneInterval_ > 0 && stepsSinceCheck_ >= retuneInterval_) {
+			const float3 box = sys.box();
+			const double density = sys.numAtoms()/(box.x*box.y*box.z);
+			const double meanT = sumT_/stepsSinceCheck_;
+			if (fabs(density-refDensity_) > retuneTol_*refDensity_ || fabs(meanT-refT_) > retuneTol_*refT_) {
+				// thread count and schedules are not very sensitive to the state point, start from the skin radius
+				stage_ = SKIN;
+				candidate_ = 0;
+				trialStep_ = 0;
+				bestCost_ = -1.0;
+				if (!startTrial_(sys, integrate)) {
+					finishStage_(sys, integrate);
+				}
+			}
+			stepsSinceCheck_ = 0;
+			sumT_ = 0.0;
+		}
+		return;
+	}
+
+	const cellList_cpu &cl = integrate.cellList();
+	if (trialStep_ == 0) {
+		// warmup step absorbs the cost of recreating the cell list
+		const int b0 = cl.numBuilds();
+		const double t0 = cl.buildTime();
+		integrate.step(sys);
+		warmBuild_ = (cl.numBuilds() > b0) ? (cl.buildTime()-t0)/(cl.numBuilds()-b0) : 0.0;
+		buildsStart_ = cl.numBuilds();
+		buildTimeStart_ = cl.buildTime();
+		tStart_ = omp_get_wtime();
+		trialStep_++;
+		return;
+	}
+
+	integrate.step(sys);
+	trialStep_++;
+	if (trialStep_ <= trialSteps_) {
+		return;
+	}
+
+	// score this candidate
+	const double elapsed = omp_get_wtime() - tStart_;
+	const int builds = cl.numBuilds() - buildsStart_;
+	const double tBuild = cl.buildTime() - buildTimeStart_;
+	tuneTrial result;
+	result.stage = stageName_();
+	result.config = trial_;
+	if (builds > 0) {
+		result.secPerBuild = tBuild/builds;
+		result.stepsPerBuild = (1.0*trialSteps_)/builds;
+	} else {
+		// no rebuild occured, extrapolate (ballistically) when the displacements will exceed the skin
+		result.secPerBuild = warmBuild_;
+		const float disp = cl.maxDisplacement();
+		if (disp > 0.0) {
+			result.stepsPerBuild = cl.stepsSinceBuild()*trial_.rs/disp;
+		} else {
+			result.stepsPerBuild = trialSteps_;
+		}
+		if (result.stepsPerBuild < trialSteps_) result.stepsPerBuild = trialSteps_;
+	}
+	result.secPerStep = (elapsed-tBuild)/trialSteps_ + result.secPerBuild/result.stepsPerBuild;
+	trials_.push_back(result);
+
+	if (bestCost_ < 0 || result.secPerStep < bestCost_) {
+		bestCost_ = result.secPerStep;
+		bestInStage_ = trial_;
+	}
+
+	candidate_++;
+	trialStep_ = 0;
+	if (!startTrial_(sys, integrate)) {
+		finishStage_(sys, integrate);
+	}
+}
+
+/*!
+ * Lock in the best candidate from the current stage and move to the next one.  When the last stage is finished, record the state point tuned at.
+ *
+ * \param [in, out] sys System definition
+ * \param [in, out] integrate Integrator used to advance the system
+ */
+void autoTuner::finishStage_ (systemDefinition &sys, integrator &integrate) {
+	while (stage_ != DONE) {
+		if (bestCost_ >= 0) {
+			current_ = bestInStage_;
+		}
+		apply_(current_, sys, integrate);
+		stage_ = (stage_t) (stage_+1);
+		candidate_ = 0;
+		trialStep_ = 0;
+		bestCost_ = -1.0;
+		if (stage_ == DONE || startTrial_(sys, integrate)) {
+			break;
+		}
+	}
+
+	if (stage_ == DONE) {
+		const float3 box = sys.box();
+		refDensity_ = sys.numAtoms()/(box.x*box.y*box.z);
+		refT_ = sys.instantT();
+		stepsSinceCheck_ = 0;
+		sumT_ = 0.0;
+		nTunings_++;
+	}
+}
+
+/*!
+ * Impose the next candidate of the current stage that can be used.
+ *
+ * \param [in, out] sys System definition
+ * \param [in, out] integrate Integrator used to advance the system
+ * \return Whether a candidate was imposed
+ */
+bool autoTuner::startTrial_ (systemDefinition &sys, integrator &integrate) {
+	while (candidate_ < numCandidates_()) {
+		trial_ = candidateConfig_(candidate_);
+		if (apply_(trial_, sys, integrate)) {
+			return true;
+		}
+		candidate_++;
+	}
+	return false;
+}
+
+/*!
+ * Number of candidates to try in the current stage.
+ */
+int autoTuner::numCandidates_ () const {
+	switch (stage_) {
+		case THREADS: return threads_.size();
+		case SKIN: return skins_.size();
+		case CELL_SCALE: return cellScales_.size();
+		case CELL_SUBDIV: return cellSubdivs_.size();
+		case FORCE_SCHEDULE: return forceKinds_.size()+1;
+		case SWEEP_SCHEDULE: return sweepKinds_.size();
+		default: return 0;
+	}
+}
+
+/*!
+ * The configuration locked in so far, with the parameter of the current stage replaced by one of its candidates.
+ *
+ * \param [in] index Index of the candidate
+ */
+tuneConfig autoTuner::candidateConfig_ (const int index) const {
+	tuneConfig cfg = current_;
+	switch (stage_) {
+		case THREADS: cfg.threads = threads_[index]; break;
+		case SKIN: cfg.rs = skins_[index]; break;
+		case CELL_SCALE: cfg.cellScale = cellScales_[index]; break;
+		case CELL_SUBDIV: cfg.cellSubdiv = cellSubdivs_[index]; break;
+		case FORCE_SCHEDULE:
+			// the first candidate is work stealing, the rest are OMP schedules
+			cfg.forceSteal = (index == 0);
+			if (index > 0) {
+				cfg.forceKind = forceKinds_[index-1];
+				cfg.forceChunk = forceChunks_[index-1];
+			}
+			break;
+		case SWEEP_SCHEDULE: cfg.sweepKind = sweepKinds_[index]; cfg.sweepChunk = sweepChunks_[index]; break;
+		default: break;
+	}
+	return cfg;
+}
+
+/*!
+ * Impose a configuration on the system and integrator.  The cell list is recreated if the skin radius, cell width or subdivisions changed.
+ * If the cell list cannot be built with this configuration (e.g. too few cells) the previous configuration is restored.
+ *
+ * \param [in] cfg Configuration to impose
+ * \param [in, out] sys System definition
+ * \param [in, out] integrate Integrator used to advance the system
+ * \return Whether the configuration could be used
+ */
+bool autoTuner::apply_ (const tuneConfig &cfg, systemDefinition &sys, integrator &integrate) {
+	const float oldRs = sys.rskin(), oldScale = integrate.cellScale();
+	const int oldSubdiv = integrate.cellSubdivisions();
+	if (cfg.rs != oldRs || cfg.cellScale != oldScale || cfg.cellSubdiv != oldSubdiv) {
+		sys.setRskin(cfg.rs);
+		integrate.setCellScale(cfg.cellScale);
+		integrate.setCellSubdivisions(cfg.cellSubdiv);
+		try {
+			integrate.resetCellList(sys);
+		} catch (std::exception &e) {
+			sys.setRskin(oldRs);
+			integrate.setCellScale(oldScale);
+			integrate.setCellSubdivisions(oldSubdiv);
+			integrate.resetCellList(sys);
+			return false;
+		}
+	}
+	omp_set_num_threads(cfg.threads);
+	integrate.setWorkStealing(cfg.forceSteal);
+	integrate.setForceSchedule(cfg.forceKind, cfg.forceChunk);
+	integrate.setSweepSchedule(cfg.sweepKind, cfg.sweepChunk);
+	return true;
+}
+
+/*!
+ * Name of the parameter being tuned in the current stage.
+ */
+const char* autoTuner::stageName_ () const {
+	switch (stage_) {
+		case THREADS: return "threads";
+		case SKIN: return "rs";
+		case CELL_SCALE: return "cellScale";
+		case CELL_SUBDIV: return "cellSubdiv";
+		case FORCE_SCHEDULE: return "forceSchedule";
+		case SWEEP_SCHEDULE: return "sweepSchedule";
+		default: return "done";
+	}
+}
+
+/*!
+ * Print every trial and the configuration currently locked in.  Schedule kinds are reported with their omp_sched_t values (1 = static, 2 = dynamic, 3 = guided).
+ *
+ * \param [in] os Output stream
+ */
+void autoTuner::report (std::ostream &os) const {
+	os << "# stage\tthreads\trs\tcellScale\tcellSubdiv\tforceSteal\tforceKind\tforceChunk\tsweepKind\tsweepChunk\tsec/step\tsteps/build\tsec/build" << std::endl;
+	for (unsigned int i = 0; i < trials_.size(); ++i) {
+		const tuneConfig &c = trials_[i].config;
+		os << "# " << trials_[i].stage << "\t" << c.threads << "\t" << c.rs << "\t" << c.cellScale << "\t" << c.cellSubdiv << "\t" << c.forceSteal << "\t" << c.forceKind << "\t" << c.forceChunk << "\t" << c.sweepKind << "\t" << c.sweepChunk << "\t" << trials_[i].secPerStep << "\t" << trials_[i].stepsPerBuild << "\t" << trials_[i].secPerBuild << std::endl;
+	}
+	os << "# locked in\t" << current_.threads << "\t" << current_.rs << "\t" << current_.cellScale << "\t" << current_.cellSubdiv << "\t" << current_.forceSteal << "\t" << current_.forceKind << "\t" << current_.forceChunk << "\t" << current_.sweepKind << "\t" << current_.sweepChunk << std::endl;
+}
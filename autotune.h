@@ -0,0 +1,101 @@
+/*!
+ * Runtime autotuning of performance parameters
+ * \date 10/19/26
+ */
+
+#ifndef __AUTOTUNE_H__
+#define __AUTOTUNE_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "system.h"
+#include "integrator.h"
+
+//! A set of performance parameters which do not change the physics of a simulation
+struct tuneConfig {
+	int threads;            //!< Number of OMP threads
+	float rs;               //!< Skin radius for the cell/neighbor lists
+	float cellScale;        //!< Minimum cell width in units of (rc+rs)
+	int cellSubdiv;         //!< Number of cells spanning rc+rs in each direction
+	bool forceSteal;        //!< Whether the cell pair tasks are executed with work stealing (if so forceKind and forceChunk are unused)
+	omp_sched_t forceKind;  //!< OMP schedule kind for the loop over cell pairs
+	int forceChunk;         //!< OMP chunk size for the loop over cell pairs
+	omp_sched_t sweepKind;  //!< OMP schedule kind for the per-atom sweeps
+	int sweepChunk;         //!< OMP chunk size for the per-atom sweeps
+};
+
+//! Result of timing a single candidate configuration
+struct tuneTrial {
+	std::string stage;      //!< Parameter that was being varied
+	tuneConfig config;      //!< Configuration tried
+	double secPerStep;      //!< Estimated steady-state wall time per step
+	double stepsPerBuild;   //!< Measured or estimated number of steps between rebuilds
+	double secPerBuild;     //!< Measured wall time per rebuild
+};
+
+/*!
+ * Spends the first few hundred steps of a simulation timing candidate configurations, one parameter at a time, then locks in the fastest.
+ * Candidates are compared on their estimated steady-state cost per step, i.e. the non-rebuild time per step plus the cost per rebuild divided by the number of steps between rebuilds.
+ * If the density or mean temperature drifts from where the system was tuned, tuning is repeated.
+ */
+class autoTuner {
+public:
+	autoTuner ();
+	~autoTuner () {}
+	void step (systemDefinition &sys, integrator &integrate);  //!< Advance the system one step, trying candidate configurations until tuned
+	bool tuning () const {return stage_ != DONE;}               //!< Report if the tuner is still trying candidates
+	tuneConfig best () const {return current_;}                 //!< Report the configuration currently locked in
+	void setTrialSteps (const int n) {trialSteps_ = n;}         //!< Set the number of timed steps each candidate is run for
+	void setRetune (const int interval, const float tol) {retuneInterval_ = interval; retuneTol_ = tol;}   //!< Check for drift every interval steps, retuning if density or temperature changed by more than a relative tol
+	void setThreadCandidates (const std::vector <int> &threads) {threads_ = threads;}   //!< Assign the OMP thread counts to try
+	void setSkinCandidates (const std::vector <float> &rs) {skins_ = rs;}               //!< Assign the skin radii to try
+	void setCellScaleCandidates (const std::vector <float> &scale) {cellScales_ = scale;}   //!< Assign the cell width multipliers to try
+	void setCellSubdivCandidates (const std::vector <int> &subdiv) {cellSubdivs_ = subdiv;} //!< Assign the numbers of cells spanning rc+rs to try
+	void setForceScheduleCandidates (const std::vector <omp_sched_t> &kinds, const std::vector <int> &chunks) {forceKinds_ = kinds; forceChunks_ = chunks;}     //!< Assign the (kind, chunk) schedules to try for the loop over cell pairs, in addition to work stealing
+	void setSweepScheduleCandidates (const std::vector <omp_sched_t> &kinds, const std::vector <int> &chunks) {sweepKinds_ = kinds; sweepChunks_ = chunks;}     //!< Assign the (kind, chunk) schedules to try for the per-atom sweeps
+	void report (std::ostream &os) const;                      //!< Print every trial and the configuration locked in
+	int numTunings () const {return nTunings_;}                 //!< Report how many times tuning has completed
+
+private:
+	enum stage_t {THREADS, SKIN, CELL_SCALE, CELL_SUBDIV, FORCE_SCHEDULE, SWEEP_SCHEDULE, DONE};
+	stage_t stage_;             //!< Parameter currently being tuned
+	int started_;               //!< Flag for whether the initial configuration has been read from the integrator and system
+	int candidate_;             //!< Index of the candidate being tried within the current stage
+	int trialStep_;             //!< Steps taken with the current candidate (0 = untimed warmup step)
+	int trialSteps_;            //!< Number of timed steps per candidate
+	int retuneInterval_;        //!< Steps between drift checks once tuned
+	float retuneTol_;           //!< Relative change in density or temperature that triggers retuning
+	int stepsSinceCheck_;       //!< Steps since the last drift check
+	int nTunings_;              //!< Number of times tuning has completed
+	double tStart_;             //!< Wall time at the start of a trial
+	int buildsStart_;           //!< Cell list builds at the start of a trial
+	double buildTimeStart_;     //!< Cell list build time at the start of a trial
+	double warmBuild_;          //!< Cost of the forced rebuild during the warmup step
+	double bestCost_;           //!< Lowest cost found in the current stage
+	double refDensity_;         //!< Number density the current configuration was tuned at
+	double refT_;               //!< Mean temperature the current configuration was tuned at
+	double sumT_;               //!< Running sum of the instantaneous temperature since the last drift check
+	tuneConfig current_;        //!< Best configuration found so far
+	tuneConfig bestInStage_;    //!< Best configuration in the current stage
+	tuneConfig trial_;          //!< Configuration being tried
+	std::vector <int> threads_;             //!< Candidate OMP thread counts
+	std::vector <float> skins_;             //!< Candidate skin radii
+	std::vector <float> cellScales_;        //!< Candidate cell width multipliers
+	std::vector <int> cellSubdivs_;         //!< Candidate numbers of cells spanning rc+rs
+	std::vector <omp_sched_t> forceKinds_;  //!< Candidate schedule kinds for the loop over cell pairs
+	std::vector <int> forceChunks_;         //!< Candidate chunk sizes for the loop over cell pairs (paired with forceKinds_)
+	std::vector <omp_sched_t> sweepKinds_;  //!< Candidate schedule kinds for the per-atom sweeps
+	std::vector <int> sweepChunks_;         //!< Candidate chunk sizes for the per-atom sweeps (paired with sweepKinds_)
+	std::vector <tuneTrial> trials_;    //!< History of every candidate tried
+
+	int numCandidates_ () const;                                //!< Number of candidates in the current stage
+	tuneConfig candidateConfig_ (const int index) const;        //!< The current configuration with the current stage's parameter replaced by a candidate
+	bool apply_ (const tuneConfig &cfg, systemDefinition &sys, integrator &integrate);  //!< Impose a configuration, returns false if it cannot be used
+	bool startTrial_ (systemDefinition &sys, integrator &integrate);                    //!< Impose the next usable candidate, returns false if the stage is exhausted
+	void finishStage_ (systemDefinition &sys, integrator &integrate);                   //!< Lock in the best candidate of a stage and advance
+	const char* stageName_ () const;                            //!< Name of the parameter being tuned
+};
+
+#endif
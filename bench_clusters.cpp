@@ -0,0 +1,131 @@
+/*!
+ * Benchmark of the cluster-pair force kernel against the per-atom loop over pairs of cells, for the shifted Lennard-Jones potential
+ * \date 10/19/26
+ */
+
+#include "system.h"
+#include "potential.h"
+#include "integrator.h"
+#include "nvt.h"
+#include <iostream>
+#include "utils.h"
+#include <omp.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*!
+ * Invoke the program as
+ * $ ./cluster_bench numThreads nAtoms rs nsteps
+ * A liquid at density 0.8 is simulated with the force loop running over pairs of cells (one atom pair at a time), then over pairs of
+ * clusters of CLUSTER_SIZE atoms, and finally over a dual list of cluster pairs (an outer list with a skin of 3 rs, pruned to an inner
+ * list rs/3 beyond the cutoff).  Reported for each are the cell list builds, the number of pairs evaluated per pair within the cutoff (for
+ * the cluster kernel including the masked ones) and the wall time of a force calculation alone and of a whole step.
+ */
+int main (int argc, char* argv[]) {
+	if (argc != 5) {
+		// catch incorrect number of arguments
+		printf("USAGE: %s <nthreads> <natoms> <rs> <nsteps> \n",argv[0]);
+		exit(1);
+	}
+
+	const int nthreads = atoi(argv[1]);
+	const int nAtoms = atoi(argv[2]);
+	const float rs = atof(argv[3]);
+	const int nSteps = atoi(argv[4]);
+	omp_set_num_threads(nthreads);
+
+	const float density = 0.8, Temp = 1.0, timestep = 0.005, rCut = 2.5;
+	const int rngSeed = 3145;
+	const float dx = pow(1.0/density, 1.0/3.0);
+	const int nSide = (int) ceil(pow(1.0*nAtoms, 1.0/3.0));
+	const float L = nSide*dx;
+
+	std::cout << "# kernel\tbuilds\tpairs evaluated/accepted\ts/force\ts/step" << std::endl;
+	double tForce[3];
+	for (int c = 0; c < 3; ++c) {
+		systemDefinition a;
+		a.setBox(L, L, L);
+		a.setTemp(Temp);
+		a.setMass(1.0);
+		a.setRskin((c == 2) ? 3.0*rs : rs);
+		a.setRcut(rCut);
+		a.initThermal(nAtoms, Temp, rngSeed, 0.999*dx);	// slightly under dx so rounding cannot drop a lattice plane
+		// initThermal gives the last atom the whole momentum correction, spread it evenly instead so large systems start stable
+		float3 p;
+		p.x = 0.0; p.y = 0.0; p.z = 0.0;
+		a.atoms[nAtoms-1].vel = p;
+		for (int i = 0; i < nAtoms; ++i) {
+			p.x += a.atoms[i].vel.x/nAtoms;
+			p.y += a.atoms[i].vel.y/nAtoms;
+			p.z += a.atoms[i].vel.z/nAtoms;
+		}
+		for (int i = 0; i < nAtoms; ++i) {
+			a.atoms[i].vel.x -= p.x;
+			a.atoms[i].vel.y -= p.y;
+			a.atoms[i].vel.z -= p.z;
+		}
+		a.setPotential(slj);
+		std::vector <float> args(5);
+		args[0] = 1.0; // epsilon
+		args[1] = 1.0; // sigma
+		args[2] = 0.0; // delta
+		args[3] = -4.0*(pow(rCut, -12.0)-pow(rCut, -6.0)); // ushift
+		a.setPotentialArgs(args);
+
+		nvt_NH integrate (1.0);
+		integrate.setTimestep(timestep);
+		integrate.setClusterPairs(c > 0);
+		if (c == 2) {
+			integrate.setDualPairList(rs/3.0);
+		}
+		integrate.step(a);
+
+		// melt the lattice before timing anything
+		for (int step = 0; step < nSteps; ++step) {
+			integrate.step(a);
+		}
+		const int builds = integrate.cellList().numBuilds();
+		const double t0 = omp_get_wtime();
+		for (int step = 0; step < nSteps; ++step) {
+			integrate.calcForce(a);
+		}
+		const double t1 = omp_get_wtime();
+		for (int step = 0; step < nSteps; ++step) {
+			integrate.step(a);
+		}
+		const double t2 = omp_get_wtime();
+		tForce[c] = (t1-t0)/nSteps;
+
+		// pairs the cell loop checks, and those within the cutoff
+		const cellList_cpu &cl = integrate.cellList();
+		const float rc2 = rCut*rCut;
+		const float3 box = a.box();
+		double candidates = 0.0, accepted = 0.0;
+		#pragma omp parallel for reduction(+:candidates,accepted) schedule(dynamic)
+		for (int p = 0; p < cl.numCellPairs(); ++p) {
+			const int c1 = cl.pairCell1(p), c2 = cl.pairCell2(p);
+			for (int s1 = cl.cellBegin(c1); s1 < cl.cellEnd(c1); ++s1) {
+				for (int s2 = (c1 == c2) ? s1+1 : cl.cellBegin(c2); s2 < cl.cellEnd(c2); ++s2) {
+					float3 dr;
+					candidates += 1.0;
+					if (pbcDist2(a.atoms[cl.atom(s1)].pos, a.atoms[cl.atom(s2)].pos, dr, box) < rc2) {
+						accepted += 1.0;
+					}
+				}
+			}
+		}
+		const int timedBuilds = cl.numBuilds() - builds;
+		if (c == 0) {
+			std::cout << "cells\t" << timedBuilds << "\t" << candidates/accepted << "\t" << tForce[c] << "\t" << (t2-t1)/nSteps << std::endl;
+		} else if (c == 1) {
+			const double evaluated = integrate.clusters().numPairs()*(double) (CLUSTER_SIZE*CLUSTER_SIZE);
+			std::cout << "clusters of " << CLUSTER_SIZE << "\t" << timedBuilds << "\t" << evaluated/accepted << "\t" << tForce[c] << "\t" << (t2-t1)/nSteps << std::endl;
+		} else {
+			const double evaluated = integrate.clusters().numInnerPairs()*(double) (CLUSTER_SIZE*CLUSTER_SIZE);
+			std::cout << "dual list\t" << timedBuilds << "\t" << evaluated/accepted << "\t" << tForce[c] << "\t" << (t2-t1)/nSteps << "\t# " << integrate.clusters().numPrunes() << " prunes in all" << std::endl;
+		}
+	}
+	std::cout << "# force speedup of the cluster kernel: " << tForce[0]/tForce[1] << ", of the dual list: " << tForce[0]/tForce[2] << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*!
+ * Benchmark of cell subdivision: distance checks and wall time per step for cells spanning (rc+rs)/k
+ * \date 10/19/26
+ */
+
+#include "system.h"
+#include "potential.h"
+#include "integrator.h"
+#include "nvt.h"
+#include <iostream>
+#include "utils.h"
+#include <omp.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*!
+ * Count the candidate pairs a force evaluation checks (every pair of atoms in every pair of neighboring cells)
+ * and how many of them are actually within the cutoff.
+ *
+ * \param [in] sys System definition
+ * \param [in] cl Cell list, must be built
+ * \param [out] candidates Number of pairs whose distance is checked
+ * \param [out] accepted Number of pairs within the cutoff
+ */
+void countPairs (const systemDefinition &sys, const cellList_cpu &cl, double &candidates, double &accepted) {
+	const float rc2 = sys.rcut()*sys.rcut();
+	const float3 box = sys.box();
+	double nc = 0.0, na = 0.0;
+	#pragma omp parallel for reduction(+:nc,na) schedule(dynamic)
+	for (int p = 0; p < cl.numCellPairs(); ++p) {
+		const int c1 = cl.pairCell1(p), c2 = cl.pairCell2(p);
+		for (int s1 = cl.cellBegin(c1); s1 < cl.cellEnd(c1); ++s1) {
+			const int start2 = (c1 == c2) ? s1+1 : cl.cellBegin(c2);
+			for (int s2 = start2; s2 < cl.cellEnd(c2); ++s2) {
+				float3 dr;
+				nc += 1.0;
+				if (pbcDist2(sys.atoms[cl.atom(s1)].pos, sys.atoms[cl.atom(s2)].pos, dr, box) < rc2) {
+					na += 1.0;
+				}
+			}
+		}
+	}
+	candidates = nc;
+	accepted = na;
+}
+
+/*!
+ * Invoke the program as
+ * $ ./subcell_bench numThreads nAtoms rs nsteps
+ * A liquid at density 0.8 is simulated with k = 1, 2 and 3 cells spanning rc+rs, reporting for each the stencil size,
+ * the ratio of candidate to accepted pairs and the wall time per step.
+ */
+int main (int argc, char* argv[]) {
+	if (argc != 5) {
+		// catch incorrect number of arguments
+		printf("USAGE: %s <nthreads> <natoms> <rs> <nsteps> \n",argv[0]);
+		exit(1);
+	}
+
+	const int nthreads = atoi(argv[1]);
+	const int nAtoms = atoi(argv[2]);
+	const float rs = atof(argv[3]);
+	const int nSteps = atoi(argv[4]);
+	omp_set_num_threads(nthreads);
+
+	const float density = 0.8, Temp = 1.0, timestep = 0.005, rCut = 2.5;
+	const int rngSeed = 3145;
+	const float dx = pow(1.0/density, 1.0/3.0);
+	const int nSide = (int) ceil(pow(1.0*nAtoms, 1.0/3.0));
+	const float L = nSide*dx;
+
+	std::cout << "# k\tcells\tstencil\tcandidates/accepted\tbuilds\tbuild (s)\ts/step" << std::endl;
+	for (int k = 1; k <= 3; ++k) {
+		systemDefinition a;
+		a.setBox(L, L, L);
+		a.setTemp(Temp);
+		a.setMass(1.0);
+		a.setRskin(rs);
+		a.setRcut(rCut);
+		a.initThermal(nAtoms, Temp, rngSeed, 0.999*dx);	// slightly under dx so rounding cannot drop a lattice plane
+		// initThermal gives the last atom the whole momentum correction, spread it evenly instead so large systems start stable
+		float3 p;
+		p.x = 0.0; p.y = 0.0; p.z = 0.0;
+		a.atoms[nAtoms-1].vel = p;
+		for (int i = 0; i < nAtoms; ++i) {
+			p.x += a.atoms[i].vel.x/nAtoms;
+			p.y += a.atoms[i].vel.y/nAtoms;
+			p.z += a.atoms[i].vel.z/nAtoms;
+		}
+		for (int i = 0; i < nAtoms; ++i) {
+			a.atoms[i].vel.x -= p.x;
+			a.atoms[i].vel.y -= p.y;
+			a.atoms[i].vel.z -= p.z;
+		}
+
+		a.setPotential(slj);
+		std::vector <float> args(5);
+		args[0] = 1.0; // epsilon
+		args[1] = 1.0; // sigma
+		args[2] = 0.0; // delta
+		args[3] = 0.0; // ushift
+		a.setPotentialArgs(args);
+
+		nvt_NH integrate (1.0);
+		integrate.setTimestep(timestep);
+		integrate.setCellSubdivisions(k);
+		try {
+			integrate.step(a);
+		} catch (customException &e) {
+			std::cout << "# " << k << "\tskipped: " << e.what() << std::endl;
+			continue;
+		}
+
+		const double t1 = omp_get_wtime();
+		for (int step = 0; step < nSteps; ++step) {
+			integrate.step(a);
+		}
+		const double t2 = omp_get_wtime();
+
+		const cellList_cpu &cl = integrate.cellList();
+		double candidates, accepted;
+		countPairs(a, cl, candidates, accepted);
+		std::cout << k << "\t" << cl.numCells() << "\t" << cl.neighbors(0).size() << "\t" << candidates/accepted << "\t" << cl.numBuilds() << "\t" << cl.buildTime() << "\t" << (t2-t1)/nSteps << std::endl;
+	}
+
+	return 0;
+}
@@ -11,6 +11,8 @@
 #include "system.h"
 #include "utils.h"
 #include <stdlib.h>
+#include <algorithm>
+#include <omp.h>
 
 // if using cuda, "cell lists" are actually neighbor lists instead but are still maintained on the cpu
 #ifdef NVCC
@@ -20,8 +22,10 @@
  * \param [in] box Box size
  * \param [in] rc Cutoff radius
  * \param [in] rs Skin Radius
+ * \param [in] cellScale Unused by neighbor lists, accepted so both implementations share a constructor
+ * \param [in] subdiv Unused by neighbor lists, accepted so both implementations share a constructor
  */ 
-cellList_cpu::cellList_cpu (const float3 &box, const float rc, const float rs) {
+cellList_cpu::cellList_cpu (const float3 &box, const float rc, const float rs, const float cellScale, const int subdiv) {
 	if (rc < 0.0) {
         	throw customException("Cutoff radius must be > 0");
         	return;
@@ -34,6 +38,13 @@ cellList_cpu::cellList_cpu (const float3 &box, const float rc, const float rs) {
     	rs_ = rs;
 	start_ = 1;
     	box_ = box;
+	scaleSinceBuild_ = 1.0;
+	nBuilds_ = 0;
+	stepsSinceBuild_ = 0;
+	buildTime_ = 0.0;
+	drMax1_ = 0.0;
+	drMax2_ = 0.0;
+	haveDisp_ = false;
 }
 
 /*!
@@ -68,19 +79,14 @@ void cellList_cpu::checkUpdate (const systemDefinition &sys) {
 		// must build when initialized
 		build = 1;
 	} else {
-		float drMax1_ = 0.0;
-                float drMax2_ = 0.0;
-                float3 dummy, box = sys.box();
-                for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
-			const float dr2 = pbcDist2 (sys.atoms[i].pos, posAtLastBuild_[i], dummy, box);
-			if (dr2 > drMax1_*drMax1_) {
-				drMax2_ = drMax1_;
-				drMax1_ = sqrt(dr2);
-			} else if (dr2 > drMax2_*drMax2_) {
-				drMax2_ = sqrt(dr2);
-			}
+		// check max displacements, unless the integrator already found them during its position sweep
+		if (!haveDisp_) {
+			maxDisplacement2 (sys.atoms, posAtLastBuild_, sys.box(), dr1sq_, dr2sq_);
 		}
-                if (drMax1_+drMax2_ > rs_) {
+		drMax1_ = sqrt(dr1sq_);
+		drMax2_ = sqrt(dr2sq_);
+                const float shrink = (scaleSinceBuild_ < 1.0) ? (1.0-scaleSinceBuild_)*(rc_+rs_) : 0.0;
+                if (drMax1_+drMax2_+shrink > rs_) {
                         build = 1;
                 } else {
                         build = 0;
@@ -88,39 +94,32 @@ void cellList_cpu::checkUpdate (const systemDefinition &sys) {
 	}
 
 	// check to rebuild the neighbor list
+	haveDisp_ = false;
+	stepsSinceBuild_++;
 	if (build) {
-		std::vector < std::vector < int > > dummyNeighbors (sys.numAtoms());
-		std::vector < int > empty (1, -1);
-                for (unsigned int i = 0; i < dummyNeighbors.size(); ++i) {
-                        dummyNeighbors[i] = empty;
-                }
+		const double t0 = omp_get_wtime();
 		const int N = sys.numAtoms();
-		std::vector < int > nn(N, 0);
 		const float cut2 = (rs_+rc_)*(rs_+rc_);
 		float3 dummy, box = sys.box();
-		int totalNeighbors = 0;
+
+		// find every pair once, storing them in buffers which keep their capacity between builds
+		pairI_.clear();
+		pairJ_.clear();
+		nn_.assign(N, 0);
 		for (unsigned int i = 0; i < N; ++i) {
-			for (unsigned int j = i+i; j < N; ++j) {
+			for (unsigned int j = i+1; j < N; ++j) {
 				float dist2 = pbcDist2(sys.atoms[i].pos, sys.atoms[j].pos, dummy, box);
 				if (dist2 < cut2) {
-					nn[i]++;
-					nn[j]++;
-					totalNeighbors += 2;
-
-					// double the size to reduce the number of times this has to happen
-					if (dummyNeighbors[i].size() < nn[i]) {
-						dummyNeighbors[i].resize(2*dummyNeighbors[i].size());
-					}
-					if (dummyNeighbors[j].size() < nn[j]) {
-                                                dummyNeighbors[j].resize(2*dummyNeighbors[j].size());
-                                        }
-					dummyNeighbors[i][nn[i]-1] = j;
-					dummyNeighbors[j][nn[j]-1] = i;
+					pairI_.push_back(i);
+					pairJ_.push_back(j);
+					nn_[i]++;
+					nn_[j]++;
 				}
 			}
 		}
+		const int totalNeighbors = 2*pairI_.size();
 		
-		// make the list "linear"
+		// make the list "linear": each atom's count followed by its neighbors
 		try {
 			nlist.resize(totalNeighbors + N);
 		} catch (std::exception &e) {
@@ -130,20 +129,59 @@ void cellList_cpu::checkUpdate (const systemDefinition &sys) {
 		
 		int counter = 0;
 		for (unsigned int i = 0; i < N; ++i) {
-                        //dummyNeighbors[i].resize(nn[i]); // free as much memory as possible
-                        posAtLastBuild_[i] = sys.atoms[i].pos;
-			nlist[counter] = nn[i];
+			posAtLastBuild_[i] = sys.atoms[i].pos;
+			nlist[counter] = nn_[i];
 			nlist_index[i] = counter;
-			counter++;
-			for (unsigned int j = 0; j < nn[i]; ++j) {
-				nlist[counter] = dummyNeighbors[i][j];	
-				counter++;	
-			}
-			dummyNeighbors[i].resize(0); // free as much memory as possible
-                }
+			nn_[i] = counter+1;	// becomes the next free entry of atom i
+			counter += nlist[counter]+1;
+		}
+		for (unsigned int p = 0; p < pairI_.size(); ++p) {
+			nlist[nn_[pairI_[p]]++] = pairJ_[p];
+			nlist[nn_[pairJ_[p]]++] = pairI_[p];
+		}
+		start_ = 0;
+		drMax1_ = 0.0;
+		drMax2_ = 0.0;
+		scaleSinceBuild_ = 1.0;
+		stepsSinceBuild_ = 0;
+		nBuilds_++;
+		buildTime_ += omp_get_wtime() - t0;
 	}
 }	
 
+/*!
+ * Adapt the list to a new box after every coordinate was scaled affinely with it (as a barostat does).  Reference positions are rescaled
+ * in place; since shrinking brings unlisted pairs closer, the shrinkage of rc+rs since the last build is charged against the skin.
+ *
+ * \param [in] box New box size
+ * \return Always true, neighbor lists never need to be recreated for a new box
+ */
+bool cellList_cpu::rescale (const float3 &box) {
+	float3 s;
+	s.x = box.x/box_.x;
+	s.y = box.y/box_.y;
+	s.z = box.z/box_.z;
+	box_ = box;
+	const int natoms = posAtLastBuild_.size();
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < natoms; ++i) {
+		posAtLastBuild_[i].x *= s.x;
+		posAtLastBuild_[i].y *= s.y;
+		posAtLastBuild_[i].z *= s.z;
+	}
+	scaleSinceBuild_ *= std::min(s.x, std::min(s.y, s.z));
+	return true;
+}
+
+/*!
+ * Report the NUMA node(s) each per-atom array resides on.
+ *
+ * \param [in] os Output stream
+ */
+void cellList_cpu::reportPlacement (std::ostream &os) const {
+	::reportPlacement(os, "posAtLastBuild", posAtLastBuild_.empty() ? NULL : &posAtLastBuild_[0], posAtLastBuild_.size()*sizeof(float3));
+}
+
 // if not using GPUs (CUDA) maintain cell lists
 #else
 /*!
@@ -152,8 +190,10 @@ void cellList_cpu::checkUpdate (const systemDefinition &sys) {
  * \param [in] box Box size
  * \param [in] rc Cutoff radius
  * \param [in] rs Skin Radius
+ * \param [in] cellScale Minimum width of k cells in units of (rc+rs), must be > 1
+ * \param [in] subdiv Number of cells (k) spanning rc+rs in each direction, must be >= 1
  */
-cellList_cpu::cellList_cpu (const float3 &box, const float rc, const float rs) {
+cellList_cpu::cellList_cpu (const float3 &box, const float rc, const float rs, const float cellScale, const int subdiv) {
     if (rc < 0.0) {
 	throw customException("Cutoff radius must be > 0");
 	return;
@@ -164,82 +204,188 @@ cellList_cpu::cellList_cpu (const float3 &box, const float rc, const float rs) {
 	return;
     }
     rs_ = rs;
+    if (cellScale <= 1.0) {
+	throw customException("Cell scale must be > 1");
+	return;
+    }
+    if (subdiv < 1) {
+	throw customException("Cell subdivisions must be >= 1");
+	return;
+    }
+    subdiv_ = subdiv;
+    cellScale_ = cellScale;
 
     box_ = box;
 
 	start_ = 1;
-    lcell_.x = 1.01*(rc+rs);
+	nBuilds_ = 0;
+	stepsSinceBuild_ = 0;
+	buildTime_ = 0.0;
+	drMax1_ = 0.0;
+	drMax2_ = 0.0;
+	scaleSinceBuild_ = 1.0;
+	haveDisp_ = false;
+	incremental_ = false;
+	packPositions_ = false;
+	nMoved_ = 0;
+	nRelayouts_ = 0;
+	slack_ = 0;
+    lcell_.x = cellScale*(rc+rs)/subdiv;
     nCells.x = (int) floor (box.x/lcell_.x);
     lcell_.x = (box.x/nCells.x);
 
-    lcell_.y = 1.01*(rc+rs);
+    lcell_.y = cellScale*(rc+rs)/subdiv;
     nCells.y = (int) floor (box.y/lcell_.y);
     lcell_.y = (box.y/nCells.y);
 
-    lcell_.z = 1.01*(rc+rs);
+    lcell_.z = cellScale*(rc+rs)/subdiv;
     nCells.z = (int) floor (box.z/lcell_.z);
     lcell_.z = (box.z/nCells.z);
 
-    if (lcell_.x <= (rc+rs) || lcell_.y <= (rc+rs) || lcell_.z < (rc+rs)) {
+    if (subdiv*lcell_.x <= (rc+rs) || subdiv*lcell_.y <= (rc+rs) || subdiv*lcell_.z < (rc+rs)) {
 	throw customException("Cell width must exceed sum of cutoff and skin radius");
 	return;
     }
 
-    if (lcell_.x < 1) {
+    if (subdiv*lcell_.x < 1) {
 	throw customException ("Box dimension x too small relative to skin and cutoff radius to use cell lists");
 	return;
     }
-    if (lcell_.y < 1) {
+    if (subdiv*lcell_.y < 1) {
 	throw customException ("Box dimension y too small relative to skin and cutoff radius to use cell lists");
 	return;
     }
-    if (lcell_.z < 1) {
+    if (subdiv*lcell_.z < 1) {
 	throw customException ("Box dimension z too small relative to skin and cutoff radius to use cell lists");
 	return;
     }
 
-    if (nCells.x < 3 || nCells.y < 3 || nCells.z < 3) {
-	throw customException("Must be able to have at least 3 cells in each direction, change box size, skin, or cutoff radius");
+    // the stencil reaches subdiv cells in each direction, which must not wrap onto itself
+    if (nCells.x < 2*subdiv+1 || nCells.y < 2*subdiv+1 || nCells.z < 2*subdiv+1) {
+	throw customException("Must be able to have at least 2k+1 cells in each direction (k = subdivisions), change box size, skin, cutoff radius, or subdivisions");
 	return;
     }
 
     try {
-	head_.resize(nCells.x*nCells.y*nCells.z, -1);
+	cellStart_.resize(nCells.x*nCells.y*nCells.z+1, 0);
+	cellCount_.resize(nCells.x*nCells.y*nCells.z, 0);
     } catch (std::exception &e) {
 	std::cerr << e.what() << std::endl;
-	throw customException ("Unable to initialize head for cell list");
+	throw customException ("Unable to initialize cells for cell list");
 	return;
     }
+
+    buildStencil_();
+}
+
+/*!
+ * (Re)build the stencil of neighboring cells for the current cell widths, pruned to the cells which can hold atoms closer than rc+rs,
+ * and from it each cell's neighbors and the unique pairs of neighboring cells.  Does nothing if the pruned stencil did not change.
+ */
+void cellList_cpu::buildStencil_ () {
+    // stencil: keep only offsets whose cells can hold atoms closer than rc+rs (for subdiv = 1 this is all 27)
+    const float rcs2 = (rc_+rs_)*(rc_+rs_);
+    const int subdiv = subdiv_;
+    std::vector <int3> stencil;
+    for (int dx = -subdiv; dx <= subdiv; ++dx) {
+	const float gx = (abs(dx) > 1) ? (abs(dx)-1)*lcell_.x : 0.0;
+	for (int dy = -subdiv; dy <= subdiv; ++dy) {
+	    const float gy = (abs(dy) > 1) ? (abs(dy)-1)*lcell_.y : 0.0;
+	    for (int dz = -subdiv; dz <= subdiv; ++dz) {
+		const float gz = (abs(dz) > 1) ? (abs(dz)-1)*lcell_.z : 0.0;
+		if (gx*gx + gy*gy + gz*gz < rcs2) {
+		    int3 d;
+		    d.x = dx; d.y = dy; d.z = dz;
+		    stencil.push_back(d);
+		}
+	    }
+	}
+    }
+
+    if (stencil.size() == stencil_.size()) {
+	bool same = true;
+	for (unsigned int s = 0; s < stencil.size(); ++s) {
+	    same = same && stencil[s].x == stencil_[s].x && stencil[s].y == stencil_[s].y && stencil[s].z == stencil_[s].z;
+	}
+	if (same) {
+	    return;
+	}
+    }
+    stencil_ = stencil;
+
     // build neighbors for each cell
-	neighbor_.resize(nCells.x*nCells.y*nCells.z);
+	neighbor_.assign(nCells.x*nCells.y*nCells.z, std::vector <int> ());
 	for (unsigned int cellID = 0; cellID < nCells.x*nCells.y*nCells.z; ++cellID) {
 	    const int zref = floor(cellID/(nCells.x*nCells.y));
-	    const int yref = floor((cellID - zref*(nCells.x*nCells.y))/nCells.y);
+	    const int yref = floor((cellID - zref*(nCells.x*nCells.y))/nCells.x);
 	    const int xref = floor(cellID - zref*(nCells.x*nCells.y) - yref*nCells.x);
-	    for (int dx = -1; dx <= 1; ++dx) {
-		int xcell = xref + dx;
-		if (xcell >= nCells.x) xcell = 0;
-		if (xcell < 0) xcell = nCells.x-1;
-		for (int dy = -1; dy <= 1; ++dy) {
-		    int ycell = yref + dy;
-		    if (ycell >= nCells.y) ycell = 0;
-		    if (ycell < 0) ycell = nCells.y-1;
-		    for (int dz = -1; dz <= 1; ++dz) {
-			int zcell = zref + dz;
-			if (zcell >= nCells.z) zcell = 0;
-			if (zcell < 0) zcell = nCells.z-1;
-			const int cellID2 = xcell + ycell*nCells.x + zcell*(nCells.x*nCells.y);
-			neighbor_[cellID].push_back(cellID2);
-		    }
-		}
+	    for (unsigned int s = 0; s < stencil.size(); ++s) {
+		const int xcell = (xref + stencil[s].x + nCells.x) % nCells.x;
+		const int ycell = (yref + stencil[s].y + nCells.y) % nCells.y;
+		const int zcell = (zref + stencil[s].z + nCells.z) % nCells.z;
+		const int cellID2 = xcell + ycell*nCells.x + zcell*(nCells.x*nCells.y);
+		neighbor_[cellID].push_back(cellID2);
 	    }
 	}
     for (unsigned int cellID = 0; cellID < nCells.x*nCells.y*nCells.z; ++cellID) {
-	if (neighbor_[cellID].size() != 27) {
-	    throw customException ("Cell list initial build failed to find 27 neighbors (including self)");
+	if (neighbor_[cellID].size() != stencil.size()) {
+	    throw customException ("Cell list initial build failed to find every neighbor in the stencil (including self)");
 	    return;
 	}
     }
+
+    // each unique pair of neighboring cells (including a cell with itself) is listed once
+    pairCell1_.clear();
+    pairCell2_.clear();
+    for (unsigned int cellID = 0; cellID < neighbor_.size(); ++cellID) {
+	for (unsigned int index = 0; index < neighbor_[cellID].size(); ++index) {
+	    if ((unsigned int) neighbor_[cellID][index] >= cellID) {
+		pairCell1_.push_back(cellID);
+		pairCell2_.push_back(neighbor_[cellID][index]);
+	    }
+	}
+    }
+}
+
+/*!
+ * Adapt the list to a new box after every coordinate was scaled affinely with it (as a barostat does).  Atoms keep their fractional
+ * coordinates, so they stay in their cells: the cell widths and reference positions are rescaled in place (and the pruned stencil redone
+ * if it changed) without rebinning.  The grid itself is kept until the cells would become narrower than (rc+rs)/k, or the box has grown
+ * enough to fit another cell.  Shrinking brings pairs which were further apart than rc+rs at the last build closer, which lists of
+ * pairs found at the build (see clusterPairList) cannot see, so the shrinkage of rc+rs since the last build is charged against the skin.
+ *
+ * \param [in] box New box size
+ * \return False if the number of cells must change, in which case the list must be recreated for the new box
+ */
+bool cellList_cpu::rescale (const float3 &box) {
+    const float width = (rc_+rs_)/subdiv_;
+    if (box.x/nCells.x <= width || box.y/nCells.y <= width || box.z/nCells.z <= width) {
+	return false;
+    }
+    if ((int) floor(box.x/(cellScale_*width)) > nCells.x || (int) floor(box.y/(cellScale_*width)) > nCells.y || (int) floor(box.z/(cellScale_*width)) > nCells.z) {
+	return false;
+    }
+
+    float3 s;
+    s.x = box.x/box_.x;
+    s.y = box.y/box_.y;
+    s.z = box.z/box_.z;
+    box_ = box;
+    lcell_.x = box.x/nCells.x;
+    lcell_.y = box.y/nCells.y;
+    lcell_.z = box.z/nCells.z;
+    const int natoms = posAtLastBuild_.size();
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < natoms; ++i) {
+	posAtLastBuild_[i].x *= s.x;
+	posAtLastBuild_[i].y *= s.y;
+	posAtLastBuild_[i].z *= s.z;
+    }
+    scaleSinceBuild_ *= std::min(s.x, std::min(s.y, s.z));
+    if (subdiv_ > 1) {
+	buildStencil_();
+    }
+    return true;
 }
 
 /*!
@@ -249,7 +395,7 @@ cellList_cpu::cellList_cpu (const float3 &box, const float rc, const float rs) {
  * \param [in] pos Position of atom
  * \return cell
  */ 
-int cellList_cpu::cell (const float3 &pos) {
+int cellList_cpu::cell (const float3 &pos) const {
     float3 inBox = pbc(pos, box_);
     const int x = (int) floor(inBox.x/lcell_.x);
     const int y = (int) floor(inBox.y/lcell_.y);
@@ -259,67 +405,323 @@ int cellList_cpu::cell (const float3 &pos) {
 
 /*!
  * Checks to see if the cell list needs to be updated and if so, rebuilds
- * Uses linked list, so algorithm in O(N)
+ * Binning is a parallel counting sort, so algorithm in O(N).  The displacement check is skipped if the integrator supplied the displacements.
  *
  * \param [in] sys System definition
  */
 void cellList_cpu::checkUpdate (const systemDefinition &sys) {
-    int build = 0;
-    if (start_) {
-	const int natoms = sys.numAtoms();
-	try {
-			list_.resize(natoms, -1);
+	int build = 0;
+	if (start_) {
+		build = 1;
+	} else {
+		build = (measureDisplacement(sys) > rs_) ? 1 : 0;
+	}
+
+	haveDisp_ = false;
+	stepsSinceBuild_++;
+	if (build) {
+		rebuild(sys);
+	} else if (packPositions_) {
+		refreshPacked_(sys);
+	}
+
+	return;
+}
+
+/*!
+ * Find the two largest displacements since the last build, unless the integrator already found them during its position sweep, and keep
+ * them for the next check.  If the box has shrunk since the build, pairs further apart than rc+rs then are also closer by (1-s)(rc+rs),
+ * with s the product of the smallest scale factors, so that is added.
+ *
+ * \param [in] sys System definition
+ * \return Sum of the two largest displacements and the shrinkage of rc+rs, or 0 if the list has never been built
+ */
+float cellList_cpu::measureDisplacement (const systemDefinition &sys) {
+	if (start_) {
+		return 0.0;
+	}
+	if (!haveDisp_) {
+		maxDisplacement2 (sys.atoms, posAtLastBuild_, sys.box(), dr1sq_, dr2sq_);
+		haveDisp_ = true;
+	}
+	drMax1_ = sqrt(dr1sq_);
+	drMax2_ = sqrt(dr2sq_);
+	const float shrink = (scaleSinceBuild_ < 1.0) ? (1.0-scaleSinceBuild_)*(rc_+rs_) : 0.0;
+	return drMax1_+drMax2_+shrink;
+}
+
+/*!
+ * Build the list at the current positions, allocating it first if it has never been built.  Incremental lists only move the atoms
+ * which changed cells.
+ *
+ * \param [in] sys System definition
+ */
+void cellList_cpu::rebuild (const systemDefinition &sys) {
+	if (start_) {
+		const int natoms = sys.numAtoms();
+		try {
+			posAtLastBuild_.resize(natoms);
 		} catch (std::exception& e) {
 			std::cerr << e.what() << std::endl;
-			throw customException ("Unable to initialize list for cell list");
+			throw customException ("Unable to initialize position list for cell list");
 			return;
 		}
 		try {
-			posAtLastBuild_.resize(natoms);
+			atomCell_.resize(natoms, -1);
+			atomSlot_.resize(natoms, -1);
 		} catch (std::exception& e) {
 			std::cerr << e.what() << std::endl;
-			throw customException ("Unable to initialize position list for cell list");
+			throw customException ("Unable to initialize cell membership for cell list");
 			return;
 		}
 		start_ = 0;
-		build = 1;
+	}
+
+	const double t0 = omp_get_wtime();
+	if ((unsigned int) sys.numAtoms() != atomCell_.size()) {
+		throw customException ("Number of atoms in simulation has changed");
+		return;
+	}
+	if (incremental_ && nBuilds_ > 0) {
+		updateIncremental_(sys);
 	} else {
-		// check max displacements
-		float drMax1_ = 0.0;
-		float drMax2_ = 0.0;
-		float3 dummy;
-			for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
-				const float dr2 = pbcDist2 (sys.atoms[i].pos, posAtLastBuild_[i], dummy, sys.box());
-				if (dr2 > drMax1_*drMax1_) {
-					drMax2_ = drMax1_;
-					drMax1_ = sqrt(dr2);
-				} else if (dr2 > drMax2_*drMax2_) {
-					drMax2_ = sqrt(dr2);
+		buildFull_(sys);
+	}
+	drMax1_ = 0.0;
+	drMax2_ = 0.0;
+	scaleSinceBuild_ = 1.0;
+	haveDisp_ = false;
+	stepsSinceBuild_ = 0;
+	nBuilds_++;
+	buildTime_ += omp_get_wtime() - t0;
+
+	if (packPositions_) {
+		refreshPacked_(sys);
+	}
+}
+
+/*!
+ * Bin every atom: each thread counts the atoms per cell in its (static) share of the atoms, a prefix sum over cells gives each cell's
+ * (and each thread's) starting slot, then each thread scatters its share.  The result is identical to a serial build.
+ * If incremental updates are enabled every cell is given some slack capacity (a constant plus a quarter of its occupancy).
+ *
+ * \param [in] sys System definition
+ */
+void cellList_cpu::buildFull_ (const systemDefinition &sys) {
+	const int natoms = sys.numAtoms();
+	const int nc = cellCount_.size();
+	const int maxThreads = omp_get_max_threads();
+	if (threadCount_.size() < (unsigned int) (maxThreads*nc)) {
+		try {
+			threadCount_.resize(maxThreads*nc);
+		} catch (std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			throw customException ("Unable to allocate per-thread histograms for cell list");
+			return;
+		}
+	}
+	slack_ = incremental_ ? 2 : 0;
+
+	#pragma omp parallel shared(sys)
+	{
+		const int tid = omp_get_thread_num(), nt = omp_get_num_threads();
+		int *myCount = &threadCount_[tid*nc];
+		for (int c = 0; c < nc; ++c) {
+			myCount[c] = 0;
+		}
+
+		// (1) count
+		#pragma omp for schedule(static)
+		for (int i = 0; i < natoms; ++i) {
+			const int icell = cell(sys.atoms[i].pos);
+			atomCell_[i] = icell;
+			posAtLastBuild_[i] = sys.atoms[i].pos;
+			myCount[icell]++;
+		}
+
+		// (2) prefix sum over cells
+		#pragma omp single
+		{
+			int offset = 0;
+			for (int c = 0; c < nc; ++c) {
+				cellStart_[c] = offset;
+				int count = 0;
+				for (int t = 0; t < nt; ++t) {
+					count += threadCount_[t*nc+c];
 				}
+				cellCount_[c] = count;
+				offset += count + (slack_ > 0 ? slack_ + count/4 : 0);
+			}
+			cellStart_[nc] = offset;
+			if (cellAtoms_.size() < (unsigned int) offset) {
+				cellAtoms_.resize(offset);
 			}
-		if (drMax1_+drMax2_ > rs_) {
-			build = 1;
-		} else {
-			build = 0;
+		}
+
+		// each thread's histogram becomes its scatter offsets
+		#pragma omp for schedule(static)
+		for (int c = 0; c < nc; ++c) {
+			int offset = cellStart_[c];
+			for (int t = 0; t < nt; ++t) {
+				const int count = threadCount_[t*nc+c];
+				threadCount_[t*nc+c] = offset;
+				offset += count;
+			}
+		}
+
+		// (3) scatter, same static partition as the count so each thread fills exactly the slots it counted
+		#pragma omp for schedule(static)
+		for (int i = 0; i < natoms; ++i) {
+			const int slot = myCount[atomCell_[i]]++;
+			cellAtoms_[slot] = i;
+			atomSlot_[i] = slot;
 		}
 	}
+	nMoved_ = natoms;
+}
 
-	if (build) {
-		if (sys.numAtoms() != list_.size()) {
-			throw customException ("Number of atoms in simulation has changed");
-			return;
+/*!
+ * Update the cell list in place, moving only the atoms whose cell changed since the last update.
+ * Finding the moved atoms (and refreshing the reference positions) is an O(N) streaming pass done in parallel,
+ * the scattered writes to the cells are only O(moved atoms).
+ * If the net gain of some cell exceeds its slack, every cell is first laid out again with fresh slack for its new occupancy (see
+ * relayout_()), which copies the cells but does not rebin any atom.
+ *
+ * \param [in] sys System definition
+ */
+void cellList_cpu::updateIncremental_ (const systemDefinition &sys) {
+	const int natoms = sys.numAtoms();
+	if (moved_.size() < (unsigned int) omp_get_max_threads()) {
+		moved_.resize(omp_get_max_threads());
+	}
+
+	#pragma omp parallel shared(sys)
+	{
+		std::vector <int> &myMoved = moved_[omp_get_thread_num()];
+		myMoved.clear();
+		#pragma omp for schedule(static)
+		for (int i = 0; i < natoms; ++i) {
+			const int icell = cell(sys.atoms[i].pos);
+			if (icell != atomCell_[i]) {
+				myMoved.push_back(i);
+				myMoved.push_back(icell);
+			}
+			posAtLastBuild_[i] = sys.atoms[i].pos;
 		}
-		for (unsigned int i = 0; i < head_.size(); ++i) {
-			head_[i] = -1;
+	}
+
+	// remove every moved atom from its old cell first (by moving the cell's last atom into its slot) so cells only overflow on net gains
+	for (unsigned int t = 0; t < moved_.size(); ++t) {
+		for (unsigned int m = 0; m < moved_[t].size(); m += 2) {
+			const int i = moved_[t][m];
+			const int ocell = atomCell_[i];
+			const int last = cellStart_[ocell] + cellCount_[ocell] - 1;
+			const int slot = atomSlot_[i];
+			cellAtoms_[slot] = cellAtoms_[last];
+			atomSlot_[cellAtoms_[slot]] = slot;
+			cellCount_[ocell]--;
 		}
-			for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
-				const int icell = cell(sys.atoms[i].pos);
-				list_[i] = head_[icell];
-				head_[icell] = i;
-				posAtLastBuild_[i] = sys.atoms[i].pos;
+	}
+
+	// make room if any cell would gain more atoms than its slack holds
+	const int nc = cellCount_.size();
+	if (threadCount_.size() < (unsigned int) nc) {
+		threadCount_.resize(nc);
+	}
+	for (int c = 0; c < nc; ++c) {
+		threadCount_[c] = cellCount_[c];
+	}
+	bool overflow = false;
+	for (unsigned int t = 0; t < moved_.size(); ++t) {
+		for (unsigned int m = 0; m < moved_[t].size(); m += 2) {
+			const int icell = moved_[t][m+1];
+			threadCount_[icell]++;
+			if (threadCount_[icell] > cellStart_[icell+1]-cellStart_[icell]) {
+				overflow = true;
 			}
-	} 
+		}
+	}
+	if (overflow) {
+		relayout_();
+	}
 
-	return;
+	// then append each to its new cell
+	nMoved_ = 0;
+	for (unsigned int t = 0; t < moved_.size(); ++t) {
+		for (unsigned int m = 0; m < moved_[t].size(); m += 2) {
+			const int i = moved_[t][m], icell = moved_[t][m+1];
+			const int newSlot = cellStart_[icell] + cellCount_[icell];
+			cellAtoms_[newSlot] = i;
+			atomSlot_[i] = newSlot;
+			cellCount_[icell]++;
+			atomCell_[i] = icell;
+			nMoved_++;
+		}
+		moved_[t].clear();
+	}
 }
+
+/*!
+ * Give every cell a new capacity of its occupancy after the pending moves (the first numCells() entries of threadCount_) plus slack,
+ * and copy the atoms it holds now to the start of its new slots.
+ */
+void cellList_cpu::relayout_ () {
+	const int nc = cellCount_.size();
+	int offset = 0;
+	for (int c = 0; c < nc; ++c) {
+		const int count = threadCount_[c];
+		threadCount_[c] = offset;
+		offset += count + slack_ + count/4;
+	}
+	if (relayoutAtoms_.size() < (unsigned int) offset) {
+		relayoutAtoms_.resize(offset);
+	}
+	#pragma omp parallel for schedule(static)
+	for (int c = 0; c < nc; ++c) {
+		const int first = threadCount_[c];
+		for (int k = 0; k < cellCount_[c]; ++k) {
+			const int i = cellAtoms_[cellStart_[c]+k];
+			relayoutAtoms_[first+k] = i;
+			atomSlot_[i] = first+k;
+		}
+	}
+	for (int c = 0; c < nc; ++c) {
+		cellStart_[c] = threadCount_[c];
+	}
+	cellStart_[nc] = offset;
+	cellAtoms_.swap(relayoutAtoms_);
+	nRelayouts_++;
+}
+
+/*!
+ * Copy each atom's current position into the slot it occupies so a cell's positions can be streamed contiguously.
+ *
+ * \param [in] sys System definition
+ */
+void cellList_cpu::refreshPacked_ (const systemDefinition &sys) {
+	const int nslots = cellStart_.back();
+	if (cellPos_.size() < (unsigned int) nslots) {
+		cellPos_.resize(nslots);
+	}
+	const int nc = cellCount_.size();
+	#pragma omp parallel for schedule(static) shared(sys)
+	for (int c = 0; c < nc; ++c) {
+		for (int slot = cellStart_[c]; slot < cellStart_[c]+cellCount_[c]; ++slot) {
+			cellPos_[slot] = sys.atoms[cellAtoms_[slot]].pos;
+		}
+	}
+}
+/*!
+ * Report the NUMA node(s) each per-atom array resides on.
+ *
+ * \param [in] os Output stream
+ */
+void cellList_cpu::reportPlacement (std::ostream &os) const {
+	::reportPlacement(os, "posAtLastBuild", posAtLastBuild_.empty() ? NULL : &posAtLastBuild_[0], posAtLastBuild_.size()*sizeof(float3));
+	::reportPlacement(os, "cellAtoms", cellAtoms_.empty() ? NULL : &cellAtoms_[0], cellAtoms_.size()*sizeof(int));
+	::reportPlacement(os, "atomCell", atomCell_.empty() ? NULL : &atomCell_[0], atomCell_.size()*sizeof(int));
+	::reportPlacement(os, "atomSlot", atomSlot_.empty() ? NULL : &atomSlot_[0], atomSlot_.size()*sizeof(int));
+	::reportPlacement(os, "cellPos", cellPos_.empty() ? NULL : &cellPos_[0], cellPos_.size()*sizeof(float3));
+}
+
 #endif
@@ -17,10 +17,20 @@
  */ 
 class cellList_cpu {
     public:
-        cellList_cpu () {}
-        cellList_cpu (const float3 &box, const float rc, const float rs);
+        cellList_cpu () {nBuilds_ = 0; stepsSinceBuild_ = 0; buildTime_ = 0.0; drMax1_ = 0.0; drMax2_ = 0.0; haveDisp_ = false; scaleSinceBuild_ = 1.0;}
+        cellList_cpu (const float3 &box, const float rc, const float rs, const float cellScale=1.01, const int subdiv=1);
         ~cellList_cpu () {}
         void checkUpdate (const systemDefinition &sys); //!< Check if the neighbor list requires updating
+        int numBuilds () const {return nBuilds_;}                 //!< Report the number of times the list has been (re)built
+        double buildTime () const {return buildTime_;}            //!< Report the total wall time (s) spent (re)building the list
+        float maxDisplacement () const {return drMax1_+drMax2_;}  //!< Report the sum of the two largest displacements since the last build
+        int stepsSinceBuild () const {return stepsSinceBuild_;}   //!< Report the number of checks since the last build
+        const float3& refPos (const int i) const {return posAtLastBuild_[i];}  //!< Report an atom's position at the last build
+        void setDisplacements (const float dr1sq, const float dr2sq) {dr1sq_ = dr1sq; dr2sq_ = dr2sq; haveDisp_ = true;}    //!< Supply the two largest squared displacements since the last build so the next check does not recompute them
+        void setIncremental (const bool inc) {}                     //!< Neighbor lists are always rebuilt from scratch, accepted so both implementations share an interface
+        void setPackedPositions (const bool pack) {}                //!< Positions are copied to the GPU directly, accepted so both implementations share an interface
+        void reportPlacement (std::ostream &os) const;              //!< Report the NUMA node(s) each per-atom array resides on
+        bool rescale (const float3 &box);                           //!< Adapt to a new box after the coordinates were scaled with it, always succeeds
         std::vector < int > nlist_index;    //!< Position in the neighbor list indicating where each particle's neighbors start from
         std::vector < int > nlist;          //!< Neighbor list containing the indices of each particles neighbors
 	private:
@@ -30,35 +40,101 @@ class cellList_cpu {
         float3 box_;        //!< Simulation box size (x,y,z)
         float drMax1_;      //!< Largest displacement of a particle since the last build
         float drMax2_;      //!< Second largest displacement of a particle since the last build
-        std::vector <float3> posAtLastBuild_;   //!< Coordinates of each particle since the last time the list was built
+        float scaleSinceBuild_; //!< Product of the (smallest) box scale factors since the last build
+        float dr1sq_;       //!< Largest squared displacement supplied by the integrator
+        float dr2sq_;       //!< Second largest squared displacement supplied by the integrator
+        bool haveDisp_;     //!< Flag for whether the displacements were supplied for the next check
+        int nBuilds_;           //!< Number of times the list has been built
+        int stepsSinceBuild_;   //!< Number of checks since the last build
+        double buildTime_;      //!< Total wall time spent building the list
+        float3Vector posAtLastBuild_;           //!< Coordinates of each particle since the last time the list was built
+        std::vector <int> pairI_;   //!< First atom of each pair found during a build (kept to avoid reallocating)
+        std::vector <int> pairJ_;   //!< Second atom of each pair found during a build
+        std::vector <int> nn_;      //!< Number of neighbors of each atom, reused as fill positions
 };
 #else
 /*!
- * Maintains a linked list to track cells on the CPU
+ * Maintains cell lists on the CPU in compressed (CSR-like) form.
+ * The atoms in each cell are stored contiguously in cellAtoms_[cellStart_[c], cellStart_[c]+cellCount_[c]) and optionally a copy of their positions is kept alongside.
+ * Each cell may have some slack capacity beyond its count so atoms can be moved between cells incrementally.
+ * Cells may be narrower than rc+rs (k sub-cells spanning it), in which case the stencil of neighboring cells is wider but pruned to cells that can actually interact.
  */ 
 class cellList_cpu {
 	public:
-		cellList_cpu () {}
-		cellList_cpu (const float3 &box, const float rc, const float rs);
+		cellList_cpu () {nBuilds_ = 0; stepsSinceBuild_ = 0; buildTime_ = 0.0; drMax1_ = 0.0; drMax2_ = 0.0; scaleSinceBuild_ = 1.0; haveDisp_ = false; incremental_ = false; packPositions_ = false; nMoved_ = 0; nRelayouts_ = 0; slack_ = 0; subdiv_ = 1; cellScale_ = 1.01;}
+		cellList_cpu (const float3 &box, const float rc, const float rs, const float cellScale=1.01, const int subdiv=1);
 		~cellList_cpu () {}
 		void checkUpdate (const systemDefinition &sys); //!< Check if the neighbor list requires updating
-		int cell (const float3 &pos);   //!< Calculate the cell in which a given coordinate is located
-		int head (const int cell) const {return head_[cell];}   //!< Return the first atom (aka 'head') of each cell
-		int list (const int index) const {return list_[index];} //!< Iterates through a linked list of particles, returns the index of the next atom in line
+		int numBuilds () const {return nBuilds_;}                 //!< Report the number of times the list has been (re)built
+		double buildTime () const {return buildTime_;}            //!< Report the total wall time (s) spent (re)building the list
+		float maxDisplacement () const {return drMax1_+drMax2_;}  //!< Report the sum of the two largest displacements since the last build
+		int stepsSinceBuild () const {return stepsSinceBuild_;}   //!< Report the number of checks since the last build
+		const float3& refPos (const int i) const {return posAtLastBuild_[i];}  //!< Report an atom's position at the last build
+		void setDisplacements (const float dr1sq, const float dr2sq) {dr1sq_ = dr1sq; dr2sq_ = dr2sq; haveDisp_ = true;}    //!< Supply the two largest squared displacements since the last build so the next check does not recompute them
+		float measureDisplacement (const systemDefinition &sys);     //!< Find (unless supplied) the two largest displacements since the last build and report their sum plus any shrinkage of rc+rs, without rebuilding
+		void rebuild (const systemDefinition &sys);                   //!< Build the list at the current positions, whatever the displacements
+		float skin () const {return rs_;}                             //!< Report the skin radius
+		void setIncremental (const bool inc) {incremental_ = inc;}    //!< If true, rebuilds only move the atoms that changed cells instead of rebinning every atom
+		void setPackedPositions (const bool pack) {packPositions_ = pack;}  //!< If true, a copy of each atom's position is stored contiguously by cell and refreshed on every check
+		bool packedPositions () const {return packPositions_;}        //!< Report if packed copies of the positions are maintained
+		void reportPlacement (std::ostream &os) const;                //!< Report the NUMA node(s) each per-atom array resides on
+		bool rescale (const float3 &box);                             //!< Adapt to a new box after the coordinates were scaled with it, false if the number of cells must change
+		int movedLastBuild () const {return nMoved_;}                 //!< Report how many atoms were (re)inserted into a cell during the last build
+		int numRelayouts () const {return nRelayouts_;}               //!< Report how many incremental updates had to lay the cells out again because one ran out of slack
+		int cell (const float3 &pos) const;   //!< Calculate the cell in which a given coordinate is located
+		int cellBegin (const int cell) const {return cellStart_[cell];}                     //!< Return the first slot of a cell
+		int cellEnd (const int cell) const {return cellStart_[cell]+cellCount_[cell];}      //!< Return one past the last occupied slot of a cell
+		int atom (const int slot) const {return cellAtoms_[slot];}                          //!< Return the index of the atom stored in a slot
+		const float3& packedPos (const int slot) const {return cellPos_[slot];}             //!< Return the (packed) position of the atom stored in a slot
 		int3 nCells; //!< Number of cells in each direction
-		std::vector < int > neighbors (const int cellID) const {return neighbor_[cellID];}  //!< Returns the indices of a cell's neighboring cells
+		const std::vector < int >& neighbors (const int cellID) const {return neighbor_[cellID];}  //!< Returns the indices of a cell's neighboring cells
+		int subdivisions () const {return subdiv_;}                                 //!< Report the number of cells spanning rc+rs in each direction
+		int numCells () const {return cellCount_.size();}                           //!< Report the total number of cells
+		int occupancy (const int cell) const {return cellCount_[cell];}             //!< Report the number of atoms in a cell
+		int numCellPairs () const {return pairCell1_.size();}                       //!< Report the number of unique pairs of neighboring cells (including self pairs)
+		int pairCell1 (const int pair) const {return pairCell1_[pair];}             //!< Return the first (lower index) cell of a pair of neighboring cells
+		int pairCell2 (const int pair) const {return pairCell2_[pair];}             //!< Return the second cell of a pair of neighboring cells
 	private:
 		int start_; //!< Flag indicating whether this list has been build before or not
 		std::vector < std::vector < int > > neighbor_;  //!< Stores the indices of a cell's neighboring cells
+		std::vector <int> pairCell1_;   //!< First cell of each unique pair of neighboring cells
+		std::vector <int> pairCell2_;   //!< Second cell of each unique pair of neighboring cells (>= the first)
+		int subdiv_;    //!< Number of cells spanning rc+rs in each direction; cells are searched up to subdiv_ away, pruned by their minimum separation
+		float cellScale_;   //!< Minimum width of subdiv_ cells in units of (rc+rs) when the grid is laid out
+		std::vector <int3> stencil_;    //!< Offsets of the neighboring cells searched (including the cell itself)
         float rc_;      //!< Cutoff radius for pair potential
         float rs_;      //!< Skin radius for cell lists
         float3 lcell_;  //!< Length of a cell in each cartesian direction
         float3 box_;    //!< Simulation box size (x,y,z)
         float drMax1_;  //!< Largest displacement of a particle since the last build
         float drMax2_;  //!< Second largest displacement of a particle since the last build
-		std::vector <float3> posAtLastBuild_;   //!< Coordinates of each particle since the last time the list was built
-		std::vector <int> head_;    //!< Stores the first atom (aka 'head') of each cell
-		std::vector <int> list_;    //!< Stores the linked list of particles in each cell
+        float scaleSinceBuild_; //!< Product of the (smallest) box scale factors since the last build
+        float dr1sq_;   //!< Largest squared displacement supplied by the integrator
+        float dr2sq_;   //!< Second largest squared displacement supplied by the integrator
+        bool haveDisp_; //!< Flag for whether the displacements were supplied for the next check
+        int nBuilds_;           //!< Number of times the list has been built
+        int stepsSinceBuild_;   //!< Number of checks since the last build
+        double buildTime_;      //!< Total wall time spent building the list
+		float3Vector posAtLastBuild_;           //!< Coordinates of each particle since the last time the list was built
+		std::vector <int> cellStart_;   //!< First slot of each cell (size = number of cells + 1, so the capacity of cell c is cellStart_[c+1]-cellStart_[c])
+		std::vector <int> cellCount_;   //!< Number of atoms in each cell
+		intVector cellAtoms_;           //!< Atom indices stored contiguously by cell
+		float3Vector cellPos_;          //!< Copy of the positions in the same order as cellAtoms_ (if packPositions_)
+		intVector atomCell_;            //!< Cell each atom was placed in at the last build
+		intVector atomSlot_;            //!< Slot each atom occupies in cellAtoms_
+		std::vector <int> threadCount_; //!< Per-thread histogram of atoms per cell (thread major), reused as scatter offsets
+		std::vector < std::vector <int> > moved_;  //!< Per-thread (atom, new cell) pairs found during an incremental update
+		bool incremental_;  //!< Flag for whether rebuilds only move atoms which changed cells
+		bool packPositions_;    //!< Flag for whether a packed copy of the positions is maintained
+		int nMoved_;        //!< Number of atoms (re)inserted during the last build
+		int nRelayouts_;    //!< Number of incremental updates which laid the cells out again
+		intVector relayoutAtoms_;       //!< Scratch copy of cellAtoms_ used when the cells are laid out again
+		int slack_;         //!< Minimum extra capacity given to every cell during a full build
+		void buildFull_ (const systemDefinition &sys);          //!< Bin every atom with a parallel count, prefix sum and scatter
+		void updateIncremental_ (const systemDefinition &sys);  //!< Move only the atoms that changed cells
+		void relayout_ ();      //!< Lay the cells out again with room for the pending moves
+		void refreshPacked_ (const systemDefinition &sys);      //!< Refresh the packed copy of the positions
+		void buildStencil_ ();  //!< Build the pruned stencil, each cell's neighbors and the unique pairs of neighboring cells for the current cell widths
 };
 
 #endif
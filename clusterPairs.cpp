@@ -0,0 +1,393 @@
+/*!
+ * Cluster-pair (NxN) lists for the shifted Lennard-Jones force loop
+ * \date 10/19/26
+ */
+
+#include "clusterPairs.h"
+#include "utils.h"
+#include "common.h"
+#include <math.h>
+#include <algorithm>
+#include <utility>
+#include <omp.h>
+
+#ifndef NVCC
+/*!
+ * Rebuild the clusters if the cell list has been rebuilt since they were, otherwise copy the current position of every atom into its slot.
+ * With a dual list the inner list is pruned again after a rebuild, a change of box, or once an atom may have moved half the inner buffer.
+ * The inner buffer must be smaller than the skin, or the inner list would be the whole outer list and pruning it pure overhead.
+ *
+ * \param [in] cl Cell list, must be current
+ * \param [in] sys System definition
+ */
+void clusterPairList::update (const cellList_cpu &cl, const systemDefinition &sys) {
+	if (dualList() && innerBuffer_ >= cl.skin()) {
+		throw customException ("The inner buffer of a dual pair list must be smaller than the skin");
+		return;
+	}
+	const bool rebuild = (builtFor_ != cl.numBuilds());
+	if (rebuild) {
+		build(cl, sys);
+	} else {
+		pack_(sys);
+	}
+	if (dualList() && (rebuild || needsPrune_(sys.box()))) {
+		prune(sys);
+	}
+}
+
+/*!
+ * Copy the current position of every atom into its slot; padding repeats the last atom of its cluster.
+ *
+ * \param [in] sys System definition
+ */
+void clusterPairList::pack_ (const systemDefinition &sys) {
+	const int nSlots = atom_.size();
+	#pragma omp parallel for schedule(static)
+	for (int s = 0; s < nSlots; ++s) {
+		const int i = atom_[s];
+		if (i >= 0) {
+			x_[s] = sys.atoms[i].pos.x;
+			y_[s] = sys.atoms[i].pos.y;
+			z_[s] = sys.atoms[i].pos.z;
+		}
+	}
+	for (int s = 0; s < nSlots; ++s) {
+		if (atom_[s] < 0) {
+			x_[s] = x_[s-1];
+			y_[s] = y_[s-1];
+			z_[s] = z_[s-1];
+		}
+	}
+}
+
+/*!
+ * Find the bounding box of every cluster at the packed positions, with coordinates taken as the minimum image relative to its first
+ * atom so clusters at the edge of the box are not stretched across it.
+ *
+ * \param [in] box Box dimensions
+ */
+void clusterPairList::boundingBoxes_ (const float3 &box) {
+	center_.resize(nClusters_);
+	half_.resize(nClusters_);
+	#pragma omp parallel for schedule(static)
+	for (int ci = 0; ci < nClusters_; ++ci) {
+		const int I = ci*CLUSTER_SIZE;
+		float3 first, lo = {0.0, 0.0, 0.0}, hi = {0.0, 0.0, 0.0};
+		first.x = x_[I];
+		first.y = y_[I];
+		first.z = z_[I];
+		for (int k = 1; k < CLUSTER_SIZE; ++k) {
+			float3 p, dr;
+			p.x = x_[I+k];
+			p.y = y_[I+k];
+			p.z = z_[I+k];
+			pbcDist2(first, p, dr, box);
+			lo.x = std::min(lo.x, dr.x);
+			lo.y = std::min(lo.y, dr.y);
+			lo.z = std::min(lo.z, dr.z);
+			hi.x = std::max(hi.x, dr.x);
+			hi.y = std::max(hi.y, dr.y);
+			hi.z = std::max(hi.z, dr.z);
+		}
+		center_[ci].x = first.x + 0.5*(lo.x + hi.x);
+		center_[ci].y = first.y + 0.5*(lo.y + hi.y);
+		center_[ci].z = first.z + 0.5*(lo.z + hi.z);
+		half_[ci].x = 0.5*(hi.x - lo.x);
+		half_[ci].y = 0.5*(hi.y - lo.y);
+		half_[ci].z = 0.5*(hi.z - lo.z);
+	}
+}
+
+/*!
+ * \param [in] ci First cluster
+ * \param [in] cj Second cluster
+ * \param [in] box Box dimensions
+ * \return Squared distance between the bounding boxes of the two clusters, a lower bound on that of any of their atoms
+ */
+float clusterPairList::boxGap2_ (const int ci, const int cj, const float3 &box) const {
+	float3 d;
+	pbcDist2(center_[ci], center_[cj], d, box);
+	const float gx = std::max(0.0f, fabsf(d.x) - half_[ci].x - half_[cj].x);
+	const float gy = std::max(0.0f, fabsf(d.y) - half_[ci].y - half_[cj].y);
+	const float gz = std::max(0.0f, fabsf(d.z) - half_[ci].z - half_[cj].z);
+	return gx*gx + gy*gy + gz*gz;
+}
+
+/*!
+ * Pairs of atoms further apart than rc+innerBuffer at the last prune cannot come within rc until the sum of their displacements exceeds
+ * innerBuffer, which cannot happen while every atom has moved less than half of it.  Scaling the box could bring any pair closer, so a
+ * change of box always requires a prune.
+ *
+ * \param [in] box Current box dimensions
+ * \return True if the inner list may be missing a pair within rc
+ */
+bool clusterPairList::needsPrune_ (const float3 &box) const {
+	if (box.x != pruneBox_.x || box.y != pruneBox_.y || box.z != pruneBox_.z) {
+		return true;
+	}
+	const float Lx = box.x, Ly = box.y, Lz = box.z, invLx = 1.0/Lx, invLy = 1.0/Ly, invLz = 1.0/Lz;
+	const int nSlots = x_.size();
+	float dr2 = 0.0;
+	#pragma omp parallel
+	{
+		float myDr2 = 0.0;
+		#pragma omp for schedule(static)
+		for (int s = 0; s < nSlots; ++s) {
+			float dx = x_[s] - xp_[s], dy = y_[s] - yp_[s], dz = z_[s] - zp_[s];
+			dx -= Lx*floor(dx*invLx + 0.5f);
+			dy -= Ly*floor(dy*invLy + 0.5f);
+			dz -= Lz*floor(dz*invLz + 0.5f);
+			myDr2 = std::max(myDr2, dx*dx + dy*dy + dz*dz);
+		}
+		#pragma omp critical
+		{
+			dr2 = std::max(dr2, myDr2);
+		}
+	}
+	return 4.0*dr2 >= innerBuffer_*innerBuffer_;
+}
+
+/*!
+ * \param [in] ci First cluster
+ * \param [in] cj Second cluster
+ * \param [in] box Box dimensions
+ * \return Smallest squared distance between an atom of each cluster, computed CLUSTER_SIZE x CLUSTER_SIZE at a time as in the force kernel
+ */
+float clusterPairList::minDist2_ (const int ci, const int cj, const float3 &box) const {
+	const float Lx = box.x, Ly = box.y, Lz = box.z, invLx = 1.0/Lx, invLy = 1.0/Ly, invLz = 1.0/Lz;
+	const int I = ci*CLUSTER_SIZE, J = cj*CLUSTER_SIZE;
+	float d2min = Lx*Lx + Ly*Ly + Lz*Lz;
+	for (int a = 0; a < CLUSTER_SIZE; ++a) {
+		const float xi = x_[I+a], yi = y_[I+a], zi = z_[I+a];
+		for (int b = 0; b < CLUSTER_SIZE; ++b) {
+			float dx = x_[J+b] - xi, dy = y_[J+b] - yi, dz = z_[J+b] - zi;
+			dx -= Lx*floor(dx*invLx + 0.5f);
+			dy -= Ly*floor(dy*invLy + 0.5f);
+			dz -= Lz*floor(dz*invLz + 0.5f);
+			// padding repeats a real atom of its cluster, so it never brings a pair closer than its atoms are
+			d2min = std::min(d2min, dx*dx + dy*dy + dz*dz);
+		}
+	}
+	return d2min;
+}
+
+/*!
+ * Keep the pairs of the outer list with any two of their atoms closer than rc+innerBuffer (and every cluster with itself).  The bounding
+ * boxes of the clusters at the current positions reject most pairs at the cost of one distance, and only the rest have the distances of
+ * all their atoms checked.  Pairs are checked in parallel, then the kept pairs are counted per cluster and copied into the inner list.
+ * The positions are remembered to measure the displacements from.
+ *
+ * \param [in] sys System definition
+ */
+void clusterPairList::prune (const systemDefinition &sys) {
+	const float3 box = sys.box();
+	const float cut = sys.rcut() + innerBuffer_, cut2 = cut*cut;
+	const int n = nClusters_;
+	boundingBoxes_(box);
+	keep_.resize(pairJ_.size());
+	innerStart_.resize(n+1);
+	innerStart_[0] = 0;
+
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (int ci = 0; ci < n; ++ci) {
+		int count = 0;
+		for (int p = pairStart_[ci]; p < pairStart_[ci+1]; ++p) {
+			const int cj = pairJ_[p];
+			keep_[p] = (cj == ci || (boxGap2_(ci, cj, box) < cut2 && minDist2_(ci, cj, box) < cut2)) ? 1 : 0;
+			count += keep_[p];
+		}
+		innerStart_[ci+1] = count;
+	}
+	for (int ci = 0; ci < n; ++ci) {
+		innerStart_[ci+1] += innerStart_[ci];
+	}
+	innerJ_.resize(innerStart_[n]);
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (int ci = 0; ci < n; ++ci) {
+		int k = innerStart_[ci];
+		for (int p = pairStart_[ci]; p < pairStart_[ci+1]; ++p) {
+			if (keep_[p]) {
+				innerJ_[k++] = pairJ_[p];
+			}
+		}
+	}
+	xp_ = x_;
+	yp_ = y_;
+	zp_ = z_;
+	pruneBox_ = box;
+	nPrunes_++;
+}
+
+/*!
+ * Split the atoms of every cell, sorted by z, into clusters of CLUSTER_SIZE, pack their positions and find each cluster's bounding box.
+ * Then, for every pair of neighboring cells, list the pairs of their clusters whose boxes are closer than rc+rs; each cluster is paired
+ * with itself and with the clusters after it in its own cell.
+ *
+ * \param [in] cl Cell list, must be current
+ * \param [in] sys System definition
+ */
+void clusterPairList::build (const cellList_cpu &cl, const systemDefinition &sys) {
+	const int nCells = cl.numCells();
+	const float3 box = sys.box();
+	cellCluster_.resize(nCells+1);
+	cellCluster_[0] = 0;
+	for (int c = 0; c < nCells; ++c) {
+		cellCluster_[c+1] = cellCluster_[c] + (cl.occupancy(c) + CLUSTER_SIZE - 1)/CLUSTER_SIZE;
+	}
+	nClusters_ = cellCluster_[nCells];
+	nAtoms_ = 0;
+	const int nSlots = nClusters_*CLUSTER_SIZE;
+	atom_.assign(nSlots, -1);
+	valid_.assign(nSlots, 0.0);
+	x_.resize(nSlots);
+	y_.resize(nSlots);
+	z_.resize(nSlots);
+
+	std::vector < std::pair <float, int> > order;
+	for (int c = 0; c < nCells; ++c) {
+		if (cl.occupancy(c) == 0) {
+			continue;
+		}
+		const float3 &ref = sys.atoms[cl.atom(cl.cellBegin(c))].pos;
+		order.clear();
+		for (int slot = cl.cellBegin(c); slot < cl.cellEnd(c); ++slot) {
+			float3 dr;
+			pbcDist2(ref, sys.atoms[cl.atom(slot)].pos, dr, box);
+			order.push_back(std::make_pair(dr.z, cl.atom(slot)));
+		}
+		std::sort(order.begin(), order.end());
+		for (unsigned int k = 0; k < order.size(); ++k) {
+			const int s = cellCluster_[c]*CLUSTER_SIZE + k;
+			atom_[s] = order[k].second;
+			valid_[s] = 1.0;
+		}
+		nAtoms_ += order.size();
+	}
+	pack_(sys);
+	boundingBoxes_(box);
+
+	// cell pairs are grouped by their first cell, so the pairs of every cluster are found (and stored) together
+	const float cut = sys.rcut() + sys.rskin(), cut2 = cut*cut;
+	pairStart_.assign(nClusters_+1, 0);
+	pairJ_.clear();
+	int p0 = 0;
+	while (p0 < cl.numCellPairs()) {
+		const int c1 = cl.pairCell1(p0);
+		int p1 = p0;
+		while (p1 < cl.numCellPairs() && cl.pairCell1(p1) == c1) {
+			p1++;
+		}
+		for (int ci = cellCluster_[c1]; ci < cellCluster_[c1+1]; ++ci) {
+			for (int p = p0; p < p1; ++p) {
+				const int c2 = cl.pairCell2(p);
+				for (int cj = (c2 == c1) ? ci : cellCluster_[c2]; cj < cellCluster_[c2+1]; ++cj) {
+					if (boxGap2_(ci, cj, box) < cut2) {
+						pairJ_.push_back(cj);
+					}
+				}
+			}
+			pairStart_[ci+1] = pairJ_.size();
+		}
+		p0 = p1;
+	}
+	// clusters of cells without any pair of their own (none, unless the stencil is empty) still need a valid range
+	for (int ci = 0; ci < nClusters_; ++ci) {
+		pairStart_[ci+1] = std::max(pairStart_[ci+1], pairStart_[ci]);
+	}
+	builtFor_ = cl.numBuilds();
+}
+
+/*!
+ * Shifted Lennard-Jones interactions of cluster ci with every cluster on its list (the inner list, if there is one), CLUSTER_SIZE x
+ * CLUSTER_SIZE at a time.  The inner loop runs over the atoms of the second cluster with the minimum image, cutoff, overlap and padding
+ * tests all done as selects, so it vectorizes; the forces on the second cluster are gathered per pair and on the first over the whole
+ * list before being added to acc.
+ *
+ * \param [in] ci Cluster
+ * \param [in, out] acc Acceleration accumulator (with the opposite sign convention to atom::acc)
+ * \param [in] box Box dimensions
+ * \param [in] args Arguments of slj: epsilon, sigma, delta and ushift
+ * \param [in] rc Cutoff radius
+ * \param [in] invMass Inverse of the particle mass
+ * \param [in, out] W Virial accumulator, or NULL if the virial is not needed
+ * \param [in, out] overlaps Counter of the pairs found within delta
+ * \return Potential energy of the interactions
+ */
+float clusterPairList::clusterForce (const int ci, float3 *acc, const float3 &box, const float *args, const float rc, const float invMass, float *W, int &overlaps) const {
+	const float Lx = box.x, Ly = box.y, Lz = box.z, invLx = 1.0/Lx, invLy = 1.0/Ly, invLz = 1.0/Lz;
+	const float rc2 = rc*rc, eps = args[0], sigma = args[1], delta = args[2], ushift = args[3], d2 = delta*delta;
+	const int I = ci*CLUSTER_SIZE;
+	float fix[CLUSTER_SIZE], fiy[CLUSTER_SIZE], fiz[CLUSTER_SIZE];
+	for (int a = 0; a < CLUSTER_SIZE; ++a) {
+		fix[a] = 0.0;
+		fiy[a] = 0.0;
+		fiz[a] = 0.0;
+	}
+	float U = 0.0, vir = 0.0;
+	int ov = 0;
+
+	const std::vector <int> &start = dualList() ? innerStart_ : pairStart_, &partners = dualList() ? innerJ_ : pairJ_;
+	for (int p = start[ci]; p < start[ci+1]; ++p) {
+		const int J = partners[p]*CLUSTER_SIZE;
+		const bool self = (J == I);
+		const float *xj = &x_[J], *yj = &y_[J], *zj = &z_[J], *vj = &valid_[J];
+		float fjx[CLUSTER_SIZE], fjy[CLUSTER_SIZE], fjz[CLUSTER_SIZE];
+		for (int b = 0; b < CLUSTER_SIZE; ++b) {
+			fjx[b] = 0.0;
+			fjy[b] = 0.0;
+			fjz[b] = 0.0;
+		}
+		for (int a = 0; a < CLUSTER_SIZE; ++a) {
+			const float xi = x_[I+a], yi = y_[I+a], zi = z_[I+a], vi = valid_[I+a];
+			float sx = 0.0, sy = 0.0, sz = 0.0;
+			for (int b = 0; b < CLUSTER_SIZE; ++b) {
+				// minimum image of dr = r_j - r_i
+				float dx = xj[b] - xi, dy = yj[b] - yi, dz = zj[b] - zi;
+				dx -= Lx*floor(dx*invLx + 0.5f);
+				dy -= Ly*floor(dy*invLy + 0.5f);
+				dz -= Lz*floor(dz*invLz + 0.5f);
+				const float r2 = dx*dx + dy*dy + dz*dz;
+				const bool pair = (vi*vj[b] > 0.0f) && (b > a || !self);
+				const bool in = pair && r2 < rc2 && r2 > d2;
+				ov += (pair && r2 <= d2) ? 1 : 0;
+				const float r = in ? sqrt(r2) : 1.0f;
+				const float bb = in ? 1.0f/(r - delta) : 1.0f, s = sigma*bb, s2 = s*s, s6 = s2*s2*s2;
+				const float factor = in ? 24.0f*eps*s6*(2.0f*s6 - 1.0f)*bb/r : 0.0f;
+				U += in ? 4.0f*eps*(s6*s6 - s6) + ushift : 0.0f;
+				vir += factor*r2;
+				sx += factor*dx;
+				sy += factor*dy;
+				sz += factor*dz;
+				fjx[b] -= factor*dx;
+				fjy[b] -= factor*dy;
+				fjz[b] -= factor*dz;
+			}
+			fix[a] += sx;
+			fiy[a] += sy;
+			fiz[a] += sz;
+		}
+		for (int b = 0; b < CLUSTER_SIZE; ++b) {
+			const int j = atom_[J+b];
+			if (j >= 0) {
+				acc[j].x += fjx[b]*invMass;
+				acc[j].y += fjy[b]*invMass;
+				acc[j].z += fjz[b]*invMass;
+			}
+		}
+	}
+	for (int a = 0; a < CLUSTER_SIZE; ++a) {
+		const int i = atom_[I+a];
+		if (i >= 0) {
+			acc[i].x += fix[a]*invMass;
+			acc[i].y += fiy[a]*invMass;
+			acc[i].z += fiz[a]*invMass;
+		}
+	}
+	if (W != NULL) {
+		*W += vir;
+	}
+	overlaps += ov;
+	return U;
+}
+#endif
@@ -0,0 +1,81 @@
+/*!
+ * Cluster-pair (NxN) lists for the shifted Lennard-Jones force loop
+ * \date 10/19/26
+ */
+
+#ifndef __CLUSTER_PAIRS_H__
+#define __CLUSTER_PAIRS_H__
+
+#include <vector>
+#include "cellList.h"
+#include "system.h"
+
+#ifndef CLUSTER_SIZE
+//! Number of atoms in a cluster, and so the width of the innermost loop of the kernel (may be set to 8 at compile time for 256 bit SIMD)
+#define CLUSTER_SIZE 4
+#endif
+
+/*!
+ * Groups the atoms of every cell into clusters of CLUSTER_SIZE atoms (sorted along z within the cell, so each cluster is compact), and
+ * lists the pairs of clusters whose bounding boxes are within rc+rs of each other.  The positions of the atoms of each cluster are kept
+ * contiguously (x, y and z separately, padded with masked slots), so the kernel computes all CLUSTER_SIZE x CLUSTER_SIZE interactions
+ * between two clusters with unit stride loads and no branches; pairs outside the cutoff, padding slots and the lower triangle of a
+ * cluster with itself are masked out with selects.
+ * The list is rebuilt whenever the cell list is, since a pair of clusters further apart than rc+rs at a build cannot come within rc
+ * before the cell list's skin is exhausted (the cell list counts any shrinkage of the box since the build against it, see
+ * cellList_cpu::rescale()); in between only the packed positions are refreshed.
+ * With a dual list the pairs within rc+rs form an outer list, rebuilt with the cell list, and the kernel runs over an inner list of the
+ * pairs of clusters with any two atoms within rc plus a small inner buffer.  The inner list is pruned from the outer one by a parallel
+ * pass whenever an atom may have moved half the inner buffer since the last prune (or the outer list or the box changed), so a generous
+ * skin keeps rebuilds rare without the force loop paying for it.  The inner buffer must be smaller than the skin.
+ * Only the pair potential slj is supported, with overlaps (r <= delta) treated as OVERLAP_ABORT.
+ */
+class clusterPairList {
+	public:
+		clusterPairList () {builtFor_ = -1; nClusters_ = 0; nAtoms_ = 0; innerBuffer_ = 0.0; nPrunes_ = 0;}
+		~clusterPairList () {}
+		void update (const cellList_cpu &cl, const systemDefinition &sys);     //!< Rebuild if the cell list was rebuilt since the last call, then refresh the packed positions
+		void build (const cellList_cpu &cl, const systemDefinition &sys);      //!< Form the clusters from the cell list and find the pairs of clusters within rc+rs
+		void invalidate () {builtFor_ = -1;}                    //!< Force the clusters to be rebuilt, e.g. when the cell list is replaced
+		void setDualList (const float innerBuffer) {innerBuffer_ = innerBuffer; builtFor_ = -1;}   //!< Run the kernel over an inner list pruned to rc+innerBuffer, or over the whole list if innerBuffer <= 0
+		bool dualList () const {return innerBuffer_ > 0.0;}     //!< Report if the kernel runs over a pruned inner list
+		float innerBuffer () const {return innerBuffer_;}       //!< Report the buffer beyond rc the inner list is pruned to
+		void prune (const systemDefinition &sys);               //!< Prune the inner list from the outer one at the current positions
+		int numPrunes () const {return nPrunes_;}               //!< Report the number of times the inner list has been pruned
+		int numInnerPairs () const {return innerJ_.size();}     //!< Report the number of cluster pairs on the inner list
+		float clusterForce (const int ci, float3 *acc, const float3 &box, const float *args, const float rc, const float invMass, float *W, int &overlaps) const;   //!< Compute the interactions of one cluster with every cluster on its list
+		int numClusters () const {return nClusters_;}           //!< Report the number of clusters
+		int numPairs () const {return pairJ_.size();}           //!< Report the number of cluster pairs (including each cluster with itself)
+		int pairBegin (const int ci) const {return pairStart_[ci];}     //!< Return the first pair of cluster ci
+		int pairEnd (const int ci) const {return pairStart_[ci+1];}     //!< Return one past the last pair of cluster ci
+		int partner (const int pair) const {return pairJ_[pair];}       //!< Return the second (not lower) cluster of a pair
+		int atom (const int slot) const {return atom_[slot];}           //!< Return the atom in a slot (cluster*CLUSTER_SIZE + position in it), or -1 for padding
+		float fill () const {return nClusters_ > 0 ? nAtoms_/(float) (nClusters_*CLUSTER_SIZE) : 0.0;}     //!< Report the fraction of slots holding an atom
+
+	private:
+		int builtFor_;                  //!< Value of the cell list's build counter when the clusters were last built
+		int nClusters_;                 //!< Number of clusters
+		int nAtoms_;                    //!< Number of atoms in the clusters
+		std::vector <int> atom_;        //!< Atom in each slot, or -1 for padding
+		std::vector <float> valid_;     //!< 1 for slots holding an atom, 0 for padding
+		std::vector <float> x_, y_, z_; //!< Position of the atom in each slot (padding repeats the cluster's last atom)
+		std::vector <int> pairStart_;   //!< First pair of each cluster (size = number of clusters + 1)
+		std::vector <int> pairJ_;       //!< Second cluster of each pair, grouped by the first
+		std::vector <int> cellCluster_; //!< First cluster of each cell (size = number of cells + 1)
+		std::vector <float3> center_;   //!< Center of the bounding box of each cluster at the last build or prune
+		std::vector <float3> half_;     //!< Half the width of the bounding box of each cluster at the last build or prune
+		float innerBuffer_;             //!< Buffer beyond rc of the inner list, or not positive for a single list
+		int nPrunes_;                   //!< Number of times the inner list was pruned
+		std::vector <int> innerStart_;  //!< First inner pair of each cluster (size = number of clusters + 1)
+		std::vector <int> innerJ_;      //!< Second cluster of each inner pair, grouped by the first
+		std::vector <char> keep_;       //!< Whether each outer pair was kept by the last prune
+		std::vector <float> xp_, yp_, zp_;      //!< Position of the atom in each slot at the last prune
+		float3 pruneBox_;               //!< Box dimensions at the last prune
+		void pack_ (const systemDefinition &sys);       //!< Copy the current positions into the slots
+		void boundingBoxes_ (const float3 &box);        //!< Find the bounding box of every cluster at the packed positions
+		float boxGap2_ (const int ci, const int cj, const float3 &box) const;  //!< Squared distance between the bounding boxes of two clusters
+		float minDist2_ (const int ci, const int cj, const float3 &box) const;  //!< Smallest squared distance between an atom of each of two clusters
+		bool needsPrune_ (const float3 &box) const;     //!< Check if an atom may have moved half the inner buffer since the last prune
+};
+
+#endif
@@ -0,0 +1,285 @@
+/*!
+ * Streaming multi-tau correlators and Green-Kubo transport coefficients
+ * \date 10/19/26
+ */
+
+#include "correlator.h"
+#include "common.h"
+#include <fstream>
+#include <omp.h>
+
+/*!
+ * Instantiate an empty correlator.
+ *
+ * \param [in] channels Number of channels, the correlation is averaged over them
+ * \param [in] points Number of lags at each level, a multiple of average
+ * \param [in] average Number of samples averaged when passing to the next level
+ * \param [in] levels Number of levels, so the longest lag is (points-1) average^(levels-1) samples
+ */
+multiTauCorrelator::multiTauCorrelator (const int channels, const int points, const int average, const int levels) {
+	if (channels < 1 || average < 2 || points < average || points%average != 0 || levels < 1) {
+		throw customException ("Multi-tau correlators need channels >= 1, average >= 2, points a multiple of average, and levels >= 1");
+		return;
+	}
+	channels_ = channels;
+	p_ = points;
+	m_ = average;
+	levels_ = levels;
+	samples_ = 0;
+	allocated_ = 0;
+	head_.assign(levels_, -1);
+	filled_.assign(levels_, 0);
+	naccum_.assign(levels_, 0);
+	corr_.assign(levels_*p_, 0.0);
+	count_.assign(levels_*p_, 0.0);
+	lagSum_.assign(p_, 0.0);
+	allocate_(0);
+}
+
+/*!
+ * Allocate the values of every level up to this one.  The arrays are level major, so this appends to them, but they may move.
+ *
+ * \param [in] level Level
+ */
+void multiTauCorrelator::allocate_ (const int level) {
+	if (level < allocated_) {
+		return;
+	}
+	allocated_ = level+1;
+	shift_.resize(allocated_*p_*channels_, 0.0);
+	accum_.resize(allocated_*channels_, 0.0);
+	pass_.resize(allocated_*channels_, 0.0);
+}
+
+/*!
+ * Add one sample of every channel.
+ *
+ * \param [in] x Value of each channel
+ */
+void multiTauCorrelator::add (const float *x) {
+	if (channels_ == 0) {
+		throw customException ("Correlator has no channels");
+		return;
+	}
+	samples_++;
+	add_(x, 0);
+}
+
+/*!
+ * Add one value of every channel at a level: store it, correlate it with the values held, and pass on the average of every m values.
+ *
+ * \param [in] x Value of each channel
+ * \param [in] level Level
+ */
+void multiTauCorrelator::add_ (const float *x, const int level) {
+	if (level >= levels_) {
+		return;
+	}
+	const int nc = channels_;
+	head_[level] = (head_[level]+1)%p_;
+	float *newest = &shift_[(level*p_ + head_[level])*nc];
+	for (int c = 0; c < nc; ++c) {
+		newest[c] = x[c];
+	}
+	if (filled_[level] < p_) {
+		filled_[level]++;
+	}
+
+	// lags below p/m are covered more finely by the previous level
+	const int jmin = (level == 0) ? 0 : p_/m_, jmax = filled_[level];
+	#pragma omp parallel for schedule(static) if(nc >= 512)
+	for (int j = jmin; j < jmax; ++j) {
+		const float *old = &shift_[(level*p_ + (head_[level]-j+p_)%p_)*nc];
+		double sum = 0.0;
+		for (int c = 0; c < nc; ++c) {
+			sum += newest[c]*old[c];
+		}
+		lagSum_[j] = sum;
+	}
+	for (int j = jmin; j < jmax; ++j) {
+		corr_[level*p_+j] += lagSum_[j]/nc;
+		count_[level*p_+j] += 1.0;
+	}
+
+	double *acc = &accum_[level*nc];
+	for (int c = 0; c < nc; ++c) {
+		acc[c] += x[c];
+	}
+	naccum_[level]++;
+	if (naccum_[level] == m_) {
+		// x is not read again, so the arrays may move
+		if (level+1 < levels_) {
+			allocate_(level+1);
+			acc = &accum_[level*nc];
+		}
+		float *avg = &pass_[level*nc];
+		for (int c = 0; c < nc; ++c) {
+			avg[c] = acc[c]/m_;
+			acc[c] = 0.0;
+		}
+		naccum_[level] = 0;
+		add_(avg, level+1);
+	}
+}
+
+/*!
+ * Correlation at every lag products have been accumulated for, in increasing order of lag.
+ *
+ * \param [out] lag Lag in samples
+ * \param [out] C Correlation averaged over the channels
+ */
+void multiTauCorrelator::result (std::vector <double> &lag, std::vector <double> &C) const {
+	lag.clear();
+	C.clear();
+	long int scale = 1;
+	for (int level = 0; level < levels_; ++level) {
+		const int jmin = (level == 0) ? 0 : p_/m_;
+		for (int j = jmin; j < p_; ++j) {
+			if (count_[level*p_+j] > 0.0) {
+				lag.push_back((double) j*scale);
+				C.push_back(corr_[level*p_+j]/count_[level*p_+j]);
+			}
+		}
+		scale *= m_;
+	}
+}
+
+/*!
+ * Instantiate the correlators.
+ *
+ * \param [in] sampleTime Simulation time between calls to update(), e.g. the timestep times the number of steps between them
+ * \param [in] points Number of lags at each correlator level
+ * \param [in] levels Number of correlator levels
+ */
+greenKubo::greenKubo (const float sampleTime, const int points, const int levels) : sacf_ (3, points, 2, levels) {
+	if (sampleTime <= 0.0) {
+		throw customException ("Green-Kubo sample time must be > 0");
+		return;
+	}
+	sampleTime_ = sampleTime;
+	points_ = points;
+	levels_ = levels;
+	sumV_ = 0.0;
+	sumT_ = 0.0;
+}
+
+/*!
+ * Add the current velocities and off-diagonal pressure tensor, P_ab V = sum_i m v_a v_b + sum_pairs r_a F_b, to the correlators.
+ * The virial part is the one the integrator's last force calculation stored in the system.
+ *
+ * \param [in] sys System definition
+ */
+void greenKubo::update (const systemDefinition &sys) {
+	const int natoms = sys.numAtoms();
+	if (vacf_.channels() == 0) {
+		vacf_ = multiTauCorrelator (3*natoms, points_, 2, levels_);
+		v_.resize(3*natoms);
+	}
+	if (vacf_.channels() != 3*natoms) {
+		throw customException ("The number of atoms changed during a Green-Kubo calculation");
+		return;
+	}
+
+	float Kxy = 0.0, Kxz = 0.0, Kyz = 0.0;
+	#pragma omp parallel for schedule(static) reduction(+:Kxy,Kxz,Kyz)
+	for (int i = 0; i < natoms; ++i) {
+		const float3 v = sys.atoms[i].vel;
+		v_[3*i] = v.x;
+		v_[3*i+1] = v.y;
+		v_[3*i+2] = v.z;
+		Kxy += v.x*v.y;
+		Kxz += v.x*v.z;
+		Kyz += v.y*v.z;
+	}
+	vacf_.add(&v_[0]);
+
+	const float3 box = sys.box(), W = sys.virialOffDiagonal();
+	const float V = box.x*box.y*box.z, m = sys.mass();
+	float P[3];
+	P[0] = (m*Kxy + W.x)/V;
+	P[1] = (m*Kxz + W.y)/V;
+	P[2] = (m*Kyz + W.z)/V;
+	sacf_.add(P);
+	sumV_ += V;
+	sumT_ += sys.instantT();
+}
+
+/*!
+ * Trapezoidal integral of a correlation function over its lags, optionally returning the function and its running integral.
+ *
+ * \param [in] c Correlator
+ * \param [in] dt Time between samples
+ * \param [out] t Time of every lag, or NULL
+ * \param [out] C Correlation at every lag, or NULL
+ * \param [out] I Running integral at every lag, or NULL
+ * \return Integral over all lags
+ */
+double greenKubo::integral_ (const multiTauCorrelator &c, const double dt, std::vector <double> *t, std::vector <double> *C, std::vector <double> *I) {
+	std::vector <double> lag, corr;
+	c.result(lag, corr);
+	double sum = 0.0;
+	if (t != NULL) t->clear();
+	if (C != NULL) C->clear();
+	if (I != NULL) I->clear();
+	for (unsigned int i = 0; i < lag.size(); ++i) {
+		if (i > 0) {
+			sum += 0.5*(corr[i]+corr[i-1])*(lag[i]-lag[i-1])*dt;
+		}
+		if (t != NULL) t->push_back(lag[i]*dt);
+		if (C != NULL) C->push_back(corr[i]);
+		if (I != NULL) I->push_back(sum);
+	}
+	return sum;
+}
+
+/*!
+ * Self diffusion coefficient, D = int_0^inf <v_a(0) v_a(t)> dt averaged over atoms and components.
+ */
+double greenKubo::diffusion () const {
+	return integral_(vacf_, sampleTime_, NULL, NULL, NULL);
+}
+
+/*!
+ * Shear viscosity, eta = <V>/(k<T>) int_0^inf <P_ab(0) P_ab(t)> dt averaged over the off-diagonal components (k = 1).
+ */
+double greenKubo::viscosity () const {
+	if (sacf_.samples() == 0 || sumT_ <= 0.0) {
+		return 0.0;
+	}
+	return (sumV_/sumT_)*integral_(sacf_, sampleTime_, NULL, NULL, NULL);
+}
+
+/*!
+ * Write each correlation function with its running integral, as columns of time, correlation and integral.
+ *
+ * \param [in] vacfFile File for the velocity autocorrelation
+ * \param [in] sacfFile File for the stress autocorrelation
+ */
+void greenKubo::write (const std::string &vacfFile, const std::string &sacfFile) const {
+	const multiTauCorrelator *c[2] = {&vacf_, &sacf_};
+	const std::string names[2] = {vacfFile, sacfFile};
+	for (int f = 0; f < 2; ++f) {
+		std::ofstream out (names[f].c_str());
+		if (!out.is_open()) {
+			throw customException ("Unable to open "+names[f]);
+			return;
+		}
+		std::vector <double> t, C, I;
+		integral_(*c[f], sampleTime_, &t, &C, &I);
+		out << "# t\tC(t)\tintegral of C from 0 to t" << std::endl;
+		for (unsigned int i = 0; i < t.size(); ++i) {
+			out << t[i] << "\t" << C[i] << "\t" << I[i] << std::endl;
+		}
+	}
+}
+
+/*!
+ * Write the transport coefficients.
+ *
+ * \param [in, out] os Stream to write to
+ */
+void greenKubo::report (std::ostream &os) const {
+	os << "# Green-Kubo from " << sacf_.samples() << " samples " << sampleTime_ << " apart" << std::endl;
+	os << "# self diffusion coefficient\t" << diffusion() << std::endl;
+	os << "# shear viscosity\t" << viscosity() << std::endl;
+}
@@ -0,0 +1,82 @@
+/*!
+ * Streaming multi-tau correlators and Green-Kubo transport coefficients
+ * \date 10/19/26
+ */
+
+#ifndef __CORRELATOR_H__
+#define __CORRELATOR_H__
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include "system.h"
+
+/*!
+ * Multi-tau (logarithmic block) time correlation function of a set of channels, averaged over the channels, computed as samples
+ * arrive (Ramirez et al., J. Chem. Phys. 133, 154103 (2010)).  Level 0 correlates the last p samples; every level passes the average
+ * of each m of its samples on to the next, so level k covers lags p/m m^k ... (p-1) m^k.  A level's values are only allocated when the
+ * first value reaches it, after m^k samples, so memory is O(channels p) per level reached, O(channels p log(samples)) up to the levels
+ * given, and the work per sample is O(channels p) amortized.
+ */
+class multiTauCorrelator {
+	public:
+		multiTauCorrelator () {channels_ = 0; p_ = 0; m_ = 0; levels_ = 0; allocated_ = 0; samples_ = 0;}
+		multiTauCorrelator (const int channels, const int points=16, const int average=2, const int levels=24);
+		~multiTauCorrelator () {}
+		void add (const float *x);          //!< Add one sample of every channel
+		void result (std::vector <double> &lag, std::vector <double> &C) const;    //!< Report the correlation at every lag (in samples) with data
+		long int samples () const {return samples_;}    //!< Report the number of samples added
+		int channels () const {return channels_;}       //!< Report the number of channels
+		int levelsAllocated () const {return allocated_;}   //!< Report the number of levels values have reached, whose storage is allocated
+
+	private:
+		int channels_;      //!< Number of channels
+		int p_;             //!< Points per level
+		int m_;             //!< Samples averaged when passing to the next level
+		int levels_;        //!< Number of levels
+		int allocated_;     //!< Number of levels with storage for their values in shift_, accum_ and pass_
+		long int samples_;  //!< Number of samples added
+		std::vector <float> shift_;     //!< Last p values of every channel at every level, as a ring buffer (level major, then slot, then channel)
+		std::vector <int> head_;        //!< Slot of the newest value at every level
+		std::vector <int> filled_;      //!< Number of values held at every level
+		std::vector <double> accum_;    //!< Sum of the values not yet passed on from every level (level major, then channel)
+		std::vector <int> naccum_;      //!< Number of values in accum_ at every level
+		std::vector <double> corr_;     //!< Sum of the products at every level and lag
+		std::vector <double> count_;    //!< Number of products at every level and lag
+		std::vector <double> lagSum_;   //!< Scratch sums over the channels for every lag
+		std::vector <float> pass_;      //!< Averages being passed on to every level (level major, then channel)
+		void add_ (const float *x, const int level);    //!< Add one value of every channel at a level
+		void allocate_ (const int level);               //!< Allocate the values of every level up to this one
+};
+
+/*!
+ * Green-Kubo transport coefficients from streaming correlators: the self diffusion coefficient from the velocity autocorrelation
+ * function (each component of each atom is a channel) and the shear viscosity from the autocorrelation of the off-diagonal pressure
+ * tensor (xy, xz and yz are the channels), whose virial part the integrator computes with setComputeStress(true).
+ * Call update() at a fixed interval of simulation time; the integrals are trapezoidal over the correlators' lags.
+ */
+class greenKubo {
+	public:
+		greenKubo (const float sampleTime, const int points=16, const int levels=24);
+		~greenKubo () {}
+		void update (const systemDefinition &sys);  //!< Add the current velocities and stress to the correlators
+		double diffusion () const;                  //!< Report the self diffusion coefficient, the integral of the VACF of one component
+		double viscosity () const;                  //!< Report the shear viscosity, V/(kT) times the integral of the stress autocorrelation
+		const multiTauCorrelator& vacf () const {return vacf_;}     //!< Report the velocity autocorrelation
+		const multiTauCorrelator& sacf () const {return sacf_;}     //!< Report the off-diagonal stress autocorrelation
+		void write (const std::string &vacfFile, const std::string &sacfFile) const;   //!< Write each correlation function and its running integral against time
+		void report (std::ostream &os) const;       //!< Write the transport coefficients
+
+	private:
+		float sampleTime_;  //!< Simulation time between updates
+		int points_;        //!< Points per correlator level
+		int levels_;        //!< Number of correlator levels
+		multiTauCorrelator vacf_;   //!< Velocity autocorrelation
+		multiTauCorrelator sacf_;   //!< Off-diagonal stress autocorrelation
+		std::vector <float> v_;     //!< Scratch for the velocities of a sample
+		double sumV_;       //!< Sum of the volume over the samples
+		double sumT_;       //!< Sum of the instantaneous temperature over the samples
+		static double integral_ (const multiTauCorrelator &c, const double dt, std::vector <double> *t, std::vector <double> *C, std::vector <double> *I);  //!< Trapezoidal integral of a correlation function
+};
+
+#endif
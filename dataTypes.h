@@ -7,6 +7,9 @@
 #ifndef __DATA_TYPES_H__
 #define __DATA_TYPES_H__
 
+#include <vector>
+#include "numaPlacement.h"
+
 #ifdef NVCC
 // this should be included automatically, but just in case...
 #include "/usr/local/cuda/include/builtin_types.h"
@@ -33,4 +36,8 @@ struct atom {
 };
 typedef atom atom;
 
+typedef std::vector <atom, firstTouchAllocator <atom> > atomVector;     //!< Per-atom array of atoms, placed by first touch in NUMA mode
+typedef std::vector <float3, firstTouchAllocator <float3> > float3Vector; //!< Per-atom array of coordinates, placed by first touch in NUMA mode
+typedef std::vector <int, firstTouchAllocator <int> > intVector;          //!< Per-atom array of indices, placed by first touch in NUMA mode
+
 #endif
@@ -0,0 +1,134 @@
+/*!
+ * Embedded-atom method (EAM) many-body potential
+ * \date 10/19/26
+ */
+
+#include "eam.h"
+#include "common.h"
+#include <fstream>
+#include <sstream>
+
+/*!
+ * Tabulate a function.  Derivatives at the points are estimated from their neighbors, and each interval is a cubic matching the values
+ * and derivatives at its ends.
+ *
+ * \param [in] f Values at 0, delta, 2 delta, ...
+ * \param [in] delta Spacing of the points
+ */
+void eamTable::set (const std::vector <double> &f, const double delta) {
+	const int n = f.size();
+	if (n < 5 || delta <= 0.0) {
+		throw customException ("EAM tables need at least 5 points and a positive spacing");
+		return;
+	}
+	std::vector <double> d (n);
+	d[0] = f[1] - f[0];
+	d[1] = 0.5*(f[2] - f[0]);
+	d[n-2] = 0.5*(f[n-1] - f[n-3]);
+	d[n-1] = f[n-1] - f[n-2];
+	for (int m = 2; m < n-2; ++m) {
+		d[m] = ((f[m-2] - f[m+2]) + 8.0*(f[m+1] - f[m-1]))/12.0;
+	}
+
+	n_ = n;
+	delta_ = delta;
+	coeff_.resize(4*(n-1));
+	for (int m = 0; m < n-1; ++m) {
+		const double df = f[m+1] - f[m];
+		coeff_[4*m] = f[m];
+		coeff_[4*m+1] = d[m];
+		coeff_[4*m+2] = 3.0*df - 2.0*d[m] - d[m+1];
+		coeff_[4*m+3] = d[m] + d[m+1] - 2.0*df;
+	}
+}
+
+/*!
+ * Instantiate the potential from a setfl file.
+ *
+ * \param [in] filename setfl file
+ * \param [in] element Index of the element to use, in the order the file lists them
+ */
+eamPotential::eamPotential (const std::string &filename, const int element) {
+	cutoff_ = 0.0;
+	mass_ = 0.0;
+	read(filename, element);
+}
+
+/*!
+ * Read the tables of one element from a DYNAMO setfl file: three comment lines, the number of elements (and their names), then
+ * Nrho drho Nr dr cutoff, then for each element a line of atomic number, mass, lattice constant and lattice type followed by Nrho
+ * values of F(rho) and Nr values of f(r), and finally Nr values of r*phi(r) for every pair of elements i >= j.
+ * Only the element's own pair interaction is kept, since all atoms in a system are alike.
+ *
+ * \param [in] filename setfl file
+ * \param [in] element Index of the element to use, in the order the file lists them
+ */
+void eamPotential::read (const std::string &filename, const int element) {
+	std::ifstream in (filename.c_str());
+	if (!in.is_open()) {
+		throw customException ("Unable to open EAM file "+filename);
+		return;
+	}
+	std::string line;
+	for (int i = 0; i < 3; ++i) {
+		std::getline(in, line);
+	}
+	int nElements = 0;
+	std::getline(in, line);
+	std::istringstream header (line);
+	header >> nElements;
+	if (!header || nElements < 1) {
+		throw customException ("Cannot read the number of elements in EAM file "+filename);
+		return;
+	}
+	if (element < 0 || element >= nElements) {
+		throw customException ("EAM file "+filename+" does not contain the requested element");
+		return;
+	}
+
+	int nrho, nr;
+	double drho, dr, rc;
+	in >> nrho >> drho >> nr >> dr >> rc;
+	if (!in || nrho < 5 || nr < 5) {
+		throw customException ("Cannot read the table sizes in EAM file "+filename);
+		return;
+	}
+
+	std::vector <double> F (nrho), rho (nr), z2r (nr), skip;
+	for (int e = 0; e < nElements; ++e) {
+		int Z;
+		double mass, lattice;
+		std::string type;
+		in >> Z >> mass >> lattice >> type;
+		if (e == element) {
+			mass_ = mass;
+		}
+		std::vector <double> &Fe = (e == element) ? F : skip, &rhoe = (e == element) ? rho : skip;
+		Fe.resize(nrho);
+		for (int i = 0; i < nrho; ++i) {
+			in >> Fe[i];
+		}
+		rhoe.resize(nr);
+		for (int i = 0; i < nr; ++i) {
+			in >> rhoe[i];
+		}
+	}
+	for (int e1 = 0; e1 < nElements; ++e1) {
+		for (int e2 = 0; e2 <= e1; ++e2) {
+			std::vector <double> &z = (e1 == element && e2 == element) ? z2r : skip;
+			z.resize(nr);
+			for (int i = 0; i < nr; ++i) {
+				in >> z[i];
+			}
+		}
+	}
+	if (!in) {
+		throw customException ("EAM file "+filename+" ended before all tables were read");
+		return;
+	}
+
+	F_.set(F, drho);
+	rho_.set(rho, dr);
+	z2r_.set(z2r, dr);
+	cutoff_ = rc;
+}
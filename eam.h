@@ -0,0 +1,92 @@
+/*!
+ * Embedded-atom method (EAM) many-body potential
+ * \date 10/19/26
+ */
+
+#ifndef __EAM_H__
+#define __EAM_H__
+
+#include <vector>
+#include <string>
+#include <math.h>
+
+/*!
+ * Cubic interpolation of a function tabulated at n evenly spaced points starting from zero, with the derivatives at the points
+ * estimated by finite differences (the scheme LAMMPS uses for EAM tables).  Arguments beyond the table are clamped to its ends.
+ */
+class eamTable {
+	public:
+		eamTable () {n_ = 0; delta_ = 1.0;}
+		~eamTable () {}
+		void set (const std::vector <double> &f, const double delta);  //!< Tabulate f at spacing delta
+
+		/*!
+		 * Interpolate the function and its derivative.
+		 *
+		 * \param [in] x Argument
+		 * \param [out] df Derivative at x
+		 * \return Value at x
+		 */
+		inline float eval (const float x, float &df) const {
+			float p = x/delta_;
+			int m = (int) p;
+			m = (m < 0) ? 0 : ((m > n_-2) ? n_-2 : m);
+			p -= m;
+			p = (p < 0.0) ? 0.0 : ((p > 1.0) ? 1.0 : p);
+			const float *c = &coeff_[4*m];
+			df = (c[1] + p*(2.0*c[2] + 3.0*p*c[3]))/delta_;
+			return c[0] + p*(c[1] + p*(c[2] + p*c[3]));
+		}
+
+	private:
+		int n_;         //!< Number of tabulated points
+		float delta_;   //!< Spacing of the points
+		std::vector <float> coeff_;   //!< Cubic coefficients of each interval in powers of the fraction of the interval
+};
+
+/*!
+ * Embedded-atom potential, U = sum_i F(rho_i) + sum_{i<j} phi(r_ij) with the host density rho_i = sum_{j!=i} f(r_ij), for a
+ * single element read from a DYNAMO setfl file (as distributed with LAMMPS, e.g. *.eam.alloy).  The integrator evaluates it in two
+ * passes over its cell pairs (see integrator::setEmbeddedAtom()): the densities are accumulated first, then the forces, which need
+ * F'(rho) of both atoms of a pair.  Units are those of the file; set the system's mass (see mass()) and cutoff (at least cutoff())
+ * to match.
+ */
+class eamPotential {
+	public:
+		eamPotential () {cutoff_ = 0.0; mass_ = 0.0;}
+		eamPotential (const std::string &filename, const int element=0);
+		~eamPotential () {}
+		void read (const std::string &filename, const int element=0);   //!< Read the tables of one element from a setfl file
+		float cutoff () const {return cutoff_;}     //!< Report the cutoff of the density and pair functions
+		float mass () const {return mass_;}         //!< Report the mass of the element (in the file's units)
+
+		//! Electron density f(r) an atom contributes at distance r, and its derivative
+		inline float density (const float r, float &df) const {return rho_.eval(r, df);}
+
+		//! Embedding energy F(rho) of an atom in a host density rho, and its derivative
+		inline float embed (const float rho, float &dF) const {return F_.eval(rho, dF);}
+
+		/*!
+		 * Pair interaction phi(r), and its derivative, from the tabulated r*phi(r).
+		 *
+		 * \param [in] r Distance
+		 * \param [out] dphi Derivative at r
+		 * \return phi(r)
+		 */
+		inline float pair (const float r, float &dphi) const {
+			float dz;
+			const float z = z2r_.eval(r, dz), invR = 1.0/r;
+			const float phi = z*invR;
+			dphi = (dz - phi)*invR;
+			return phi;
+		}
+
+	private:
+		float cutoff_;      //!< Cutoff of the density and pair functions
+		float mass_;        //!< Mass of the element
+		eamTable F_;        //!< Embedding function F(rho)
+		eamTable rho_;      //!< Density function f(r)
+		eamTable z2r_;      //!< r*phi(r)
+};
+
+#endif
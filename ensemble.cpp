@@ -0,0 +1,93 @@
+#include "system.h"
+#include "potential.h"
+#include "integrator.h"
+#include "nvt.h"
+#include "ensembleRunner.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include "utils.h"
+#include <omp.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*!
+ * Invoke the program as
+ * $ ./ensemble numThreads nsteps replicas [atomsPerThread] > log
+ * Each non-empty line of the file replicas, other than comments starting with #, describes a replica as natoms T seed [rs]: shifted
+ * Lennard-Jones atoms at the density of the timing runs, thermostatted at T with the same Nose-Hoover setup as main.cpp.  Replica i writes
+ * step, kinetic energy, potential energy, temperature and total energy (the columns of main.cpp) to replica_i.dat, and the team size, time and throughput of every replica
+ * is written to stdout.  Replicas are given a thread per atomsPerThread atoms (default 2000), up to all numThreads, and run concurrently.
+ */
+int main (int argc, char* argv[]) {
+	if (argc < 4 || argc > 5) {
+		// catch incorrect number of arguments
+		printf("USAGE: %s <nthreads> <nsteps> <replicas> [atomsPerThread] \n",argv[0]);
+		exit(1);
+	}
+	const int nthreads = atoi(argv[1]);
+	const int nSteps = atoi(argv[2]);
+	const int atomsPerThread = (argc == 5) ? atoi(argv[4]) : 2000;
+	const float timestep = 0.005;
+
+	std::ifstream spec (argv[3]);
+	if (!spec.is_open()) {
+		std::cerr << "Unable to open " << argv[3] << std::endl;
+		return 1;
+	}
+	std::vector <systemDefinition*> systems;
+	std::vector <nvt_NH*> integrators;
+	std::string line;
+	while (std::getline(spec, line)) {
+		std::istringstream in (line);
+		int nAtoms, seed;
+		float Temp, rs = 0.3;
+		if (line.empty() || line[0] == '#' || !(in >> nAtoms >> Temp >> seed)) {
+			continue;
+		}
+		in >> rs;
+		const double L = pow(2.0*nAtoms, 1.0/3.0);
+		const float dx = 0.999*L/ceil(pow(nAtoms, 1.0/3.0));	// enough lattice sites for small replicas too
+
+		// initialization draws from the global random number generator, so it is done here, one replica at a time
+		systemDefinition *a = new systemDefinition;
+		a->setBox(L, L, L);
+		a->setTemp(Temp);
+		a->setMass(1.0);
+		a->setRskin(rs);
+		a->setRcut(2.5);
+		a->initThermal(nAtoms, Temp, seed, dx);
+		a->setPotential(slj);
+		std::vector <float> args(5);
+		args[0] = 1.0; // epsilon
+		args[1] = 1.0; // sigma
+		args[2] = 0.0; // delta
+		args[3] = 0.0; // ushift
+		a->setPotentialArgs(args);
+		nvt_NH *integrate = new nvt_NH (1.0);
+		integrate->setTimestep(timestep);
+		systems.push_back(a);
+		integrators.push_back(integrate);
+	}
+
+	ensembleRunner runner (atomsPerThread);
+	for (unsigned int i = 0; i < systems.size(); ++i) {
+		std::ostringstream name;
+		name << "replica_" << i << ".dat";
+		runner.addReplica(systems[i], integrators[i], nSteps, name.str());
+	}
+	int status = 0;
+	try {
+		runner.run(nthreads);
+	} catch (customException &ce) {
+		std::cerr << ce.what() << std::endl;
+		status = 1;
+	}
+	runner.report(std::cout);
+
+	for (unsigned int i = 0; i < systems.size(); ++i) {
+		delete integrators[i];
+		delete systems[i];
+	}
+	return status;
+}
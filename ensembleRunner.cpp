@@ -0,0 +1,193 @@
+/*!
+ * Runs many independent replicas in one process
+ * \date 10/19/26
+ */
+
+#include "ensembleRunner.h"
+#include "common.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <omp.h>
+
+/*!
+ * \param [in] atomsPerThread Number of atoms a thread is given before a replica gets another thread
+ */
+ensembleRunner::ensembleRunner (const int atomsPerThread) {
+	if (atomsPerThread < 1) {
+		throw customException ("Each thread of a replica must be given at least one atom");
+		return;
+	}
+	atomsPerThread_ = atomsPerThread;
+	wall_ = 0.0;
+}
+
+/*!
+ * Add a replica.  The system must be initialized (atoms, box, potential) and the integrator set up; both must outlive run().
+ *
+ * \param [in] sys System
+ * \param [in] integrate Integrator
+ * \param [in] nSteps Number of steps to run
+ * \param [in] output File to write step, kinetic energy, potential energy, temperature and total energy to (in that order), or empty for none
+ * \param [in] report Steps between lines of output (default nSteps/1000, at least 1)
+ * \return Index of the replica
+ */
+int ensembleRunner::addReplica (systemDefinition *sys, integrator *integrate, const int nSteps, const std::string &output, const int report) {
+	if (sys == NULL || integrate == NULL || nSteps < 0) {
+		throw customException ("A replica needs a system, an integrator and a non-negative number of steps");
+		return -1;
+	}
+	replica r;
+	r.sys = sys;
+	r.integrate = integrate;
+	r.nSteps = nSteps;
+	r.done = 0;
+	r.output = output;
+	r.report = (report > 0) ? report : std::max(1, nSteps/1000);
+	r.threads = 0;
+	r.time = 0.0;
+	replicas_.push_back(r);
+	return replicas_.size()-1;
+}
+
+/*!
+ * Give a replica more steps to run, e.g. to continue a run which has completed.  Its output is appended to.
+ *
+ * \param [in] i Index of the replica
+ * \param [in] nSteps Number of steps to add
+ */
+void ensembleRunner::addSteps (const int i, const int nSteps) {
+	if (i < 0 || i >= (int) replicas_.size() || nSteps < 0) {
+		throw customException ("Steps can only be added to an existing replica, and not removed");
+		return;
+	}
+	replicas_[i].nSteps += nSteps;
+}
+
+/*!
+ * One thread per atomsPerThread atoms, at least one and at most the pool, rounded down to a divisor of the pool.
+ *
+ * \param [in] natoms Number of atoms in the replica
+ * \param [in] nThreads Number of threads in the pool
+ */
+int ensembleRunner::teamSize (const int natoms, const int nThreads) const {
+	int w = std::min(std::max(1, natoms/atomsPerThread_), nThreads);
+	while (nThreads%w != 0) {
+		w--;
+	}
+	return w;
+}
+
+//! Orders replicas by decreasing work, the number of atoms times the steps to run
+class longerReplica {
+	public:
+		longerReplica (const std::vector <double> &work) : work_(work) {}
+		bool operator() (const int a, const int b) const {return work_[a] > work_[b];}
+	private:
+		const std::vector <double> &work_;
+};
+
+/*!
+ * Advance every replica to completion, or by at most maxSteps.  If any replica throws, the others still run and the first failure is
+ * rethrown at the end.
+ *
+ * \param [in] nThreads Number of threads to share between the replicas, or 0 for omp_get_max_threads()
+ * \param [in] maxSteps Most steps any replica is advanced by, or 0 to run every replica to completion
+ */
+void ensembleRunner::run (const int nThreads, const int maxSteps) {
+	const int pool = (nThreads > 0) ? nThreads : omp_get_max_threads();
+	const int nrep = replicas_.size();
+	std::vector <double> work (nrep);
+	std::vector <int> steps (nrep), sizes;
+	for (int i = 0; i < nrep; ++i) {
+		replicas_[i].threads = teamSize(replicas_[i].sys->numAtoms(), pool);
+		replicas_[i].error.clear();
+		steps[i] = replicas_[i].nSteps - replicas_[i].done;
+		if (maxSteps > 0) {
+			steps[i] = std::min(steps[i], maxSteps);
+		}
+		work[i] = replicas_[i].sys->numAtoms()*(double) steps[i];
+		sizes.push_back(replicas_[i].threads);
+	}
+	std::sort(sizes.begin(), sizes.end());
+	sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+	// two active levels let the teams nest inside the loop over replicas
+	const int levels = omp_get_max_active_levels();
+	omp_set_max_active_levels(2);
+	const double t0 = omp_get_wtime();
+	for (int s = sizes.size()-1; s >= 0; --s) {
+		std::vector <int> batch;
+		for (int i = 0; i < nrep; ++i) {
+			if (replicas_[i].threads == sizes[s]) {
+				batch.push_back(i);
+			}
+		}
+		std::stable_sort(batch.begin(), batch.end(), longerReplica (work));
+		const int nbatch = batch.size();
+		#pragma omp parallel for schedule(dynamic, 1) num_threads(pool/sizes[s])
+		for (int b = 0; b < nbatch; ++b) {
+			run_(replicas_[batch[b]], steps[batch[b]]);
+		}
+	}
+	wall_ += omp_get_wtime()-t0;
+	omp_set_max_active_levels(levels);
+
+	for (int i = 0; i < nrep; ++i) {
+		if (!replicas_[i].error.empty()) {
+			std::ostringstream msg;
+			msg << "Replica " << i << " failed: " << replicas_[i].error;
+			throw customException (msg.str());
+			return;
+		}
+	}
+}
+
+/*!
+ * Advance one replica with its team size as the number of threads of its parallel regions, writing its thermodynamics as main.cpp does
+ * (appending after the first segment).  Exceptions are recorded rather than thrown, since they may not leave the parallel region.
+ *
+ * \param [in, out] r Replica
+ * \param [in] steps Number of steps to advance
+ */
+void ensembleRunner::run_ (replica &r, const int steps) {
+	omp_set_num_threads(r.threads);
+	const double t0 = omp_get_wtime();
+	try {
+		std::ofstream out;
+		if (!r.output.empty()) {
+			out.open(r.output.c_str(), (r.done > 0) ? std::ios::app : std::ios::out);
+			if (!out.is_open()) {
+				throw customException ("Unable to open "+r.output);
+			}
+		}
+		systemDefinition &sys = *r.sys;
+		for (int s = 0; s < steps; ++s) {
+			const int step = r.done;
+			r.integrate->step(sys);
+			r.done++;
+			if (out.is_open() && step%r.report == 0) {
+				out << step << "\t" << sys.KinE() << "\t" << sys.PotE() << "\t" << sys.instantT() << "\t" << sys.KinE() + sys.PotE() << std::endl;
+			}
+		}
+	} catch (std::exception &e) {
+		r.error = e.what();
+	}
+	r.time += omp_get_wtime()-t0;
+}
+
+/*!
+ * Write the team size, time and steps per second of every replica, and the throughput of the whole run in atom steps per second.
+ *
+ * \param [in, out] os Stream to write to
+ */
+void ensembleRunner::report (std::ostream &os) const {
+	os << "# replica\tatoms\tthreads\tsteps\ttime (s)\tsteps/s" << std::endl;
+	double atomSteps = 0.0;
+	for (unsigned int i = 0; i < replicas_.size(); ++i) {
+		const replica &r = replicas_[i];
+		os << i << "\t" << r.sys->numAtoms() << "\t" << r.threads << "\t" << r.done << "\t" << r.time << "\t" << (r.time > 0.0 ? r.done/r.time : 0.0) << std::endl;
+		atomSteps += r.sys->numAtoms()*(double) r.done;
+	}
+	os << "# wall time (s): " << wall_ << ", atom steps/s: " << (wall_ > 0.0 ? atomSteps/wall_ : 0.0) << std::endl;
+}
@@ -0,0 +1,60 @@
+/*!
+ * Runs many independent replicas in one process
+ * \date 10/19/26
+ */
+
+#ifndef __ENSEMBLE_RUNNER_H__
+#define __ENSEMBLE_RUNNER_H__
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include "system.h"
+#include "integrator.h"
+
+/*!
+ * Runs independent replicas (a system and its integrator) side by side, so a sweep over state points or seeds fills a node from one
+ * process.  Each replica is given a team of threads sized to its number of atoms, atomsPerThread atoms per thread up to the whole pool,
+ * rounded down to a divisor of the pool so teams tile it: small replicas get one core each and run concurrently, while a large replica
+ * gets every thread to itself.  Replicas of each team size are run, largest team first, as a dynamically scheduled loop over the teams
+ * (longest replicas first), and each team runs its replica's OpenMP regions as a nested parallel region.
+ * run() can be given a number of steps, in which case each replica advances at most that far and the next run() carries on, so
+ * replicas can be coupled between segments (see replicaExchange).
+ * Replicas must be fully initialized before run(), since initialization draws from the global random number generator.
+ */
+class ensembleRunner {
+	public:
+		ensembleRunner (const int atomsPerThread=2000);
+		~ensembleRunner () {}
+		int addReplica (systemDefinition *sys, integrator *integrate, const int nSteps, const std::string &output="", const int report=0);   //!< Add a replica (not owned) writing step, KinE, PotE, T and total energy to output, returns its index
+		void addSteps (const int i, const int nSteps);              //!< Give replica i more steps to run
+		void run (const int nThreads=0, const int maxSteps=0);     //!< Advance every replica on a pool of threads (default, all of OpenMP's), to completion or by at most maxSteps
+		int teamSize (const int natoms, const int nThreads) const;  //!< Report the number of threads a replica of this many atoms is given
+		int numReplicas () const {return replicas_.size();}         //!< Report the number of replicas
+		int threads (const int i) const {return replicas_[i].threads;}  //!< Report the number of threads replica i ran with
+		int stepsDone (const int i) const {return replicas_[i].done;}   //!< Report the number of steps replica i has run
+		double time (const int i) const {return replicas_[i].time;}     //!< Report the time replica i has taken
+		double wallTime () const {return wall_;}    //!< Report the time every run() so far has taken
+		void report (std::ostream &os) const;       //!< Write the team size, time and throughput of every replica
+
+	private:
+		//! A replica and its schedule
+		struct replica {
+			systemDefinition *sys;  //!< System
+			integrator *integrate;  //!< Integrator
+			int nSteps;             //!< Steps to run
+			int done;               //!< Steps run so far
+			std::string output;     //!< File the thermodynamics are written to, if any
+			int report;             //!< Steps between lines of output
+			int threads;            //!< Team size
+			double time;            //!< Time taken so far
+			std::string error;      //!< Message of an exception the replica failed with
+		};
+
+		int atomsPerThread_;    //!< Atoms a thread is given before a replica gets another thread
+		double wall_;           //!< Time every run() so far took
+		std::vector <replica> replicas_;    //!< Replicas
+		static void run_ (replica &r, const int steps);     //!< Advance one replica on the calling thread's team
+};
+
+#endif
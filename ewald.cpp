@@ -0,0 +1,469 @@
+/*!
+ * Long-range electrostatics (Ewald summation and smooth particle-mesh Ewald)
+ * \date 10/19/26
+ */
+
+#include "ewald.h"
+#include "common.h"
+#include <math.h>
+#include <algorithm>
+#include <omp.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*!
+ * Instantiate a solver.
+ *
+ * \param [in] method Reciprocal space method
+ * \param [in] tolerance Relative accuracy of the real and reciprocal space sums
+ */
+ewaldSolver::ewaldSolver (const ewaldMethod method, const float tolerance) {
+	method_ = method;
+	order_ = 4;
+	alpha_ = 0.0;
+	rc_ = 0.0;
+	Uself_ = 0.0;
+	box_.x = -1.0; box_.y = -1.0; box_.z = -1.0;
+	mesh_.x = 0; mesh_.y = 0; mesh_.z = 0;
+	setTolerance(tolerance);
+}
+
+/*!
+ * Set the relative accuracy of the real and reciprocal space sums.
+ *
+ * \param [in] tol Tolerance, 0 < tol < 1
+ */
+void ewaldSolver::setTolerance (const float tol) {
+	if (tol <= 0.0 || tol >= 1.0) {
+		throw customException ("Ewald tolerance must be between 0 and 1");
+	}
+	tol_ = tol;
+	box_.x = -1.0;
+}
+
+/*!
+ * Set the order of the B-splines used to spread charges onto the PME mesh.
+ *
+ * \param [in] p Order, at least 3
+ */
+void ewaldSolver::setOrder (const int p) {
+	if (p < 3) {
+		throw customException ("PME B-spline order must be at least 3");
+	}
+	order_ = p;
+	box_.x = -1.0;
+}
+
+/*!
+ * Cardinal B-spline weights M_p(w+p-1-j) of a charge a fraction w past a mesh point onto the p points around it, and their derivatives.
+ *
+ * \param [in] w Fractional offset, 0 <= w < 1
+ * \param [in] p Order
+ * \param [out] theta Weights (p values)
+ * \param [out] dtheta Derivatives of the weights with respect to w (p values)
+ */
+static void bspline (const double w, const int p, double *theta, double *dtheta) {
+	theta[p-1] = 0.0;
+	theta[1] = w;
+	theta[0] = 1.0-w;
+	for (int j = 3; j < p; ++j) {
+		const double div = 1.0/(j-1);
+		theta[j-1] = div*w*theta[j-2];
+		for (int k = 1; k < j-1; ++k) {
+			theta[j-k-1] = div*((w+k)*theta[j-k-2] + (j-k-w)*theta[j-k-1]);
+		}
+		theta[0] = div*(1.0-w)*theta[0];
+	}
+	// derivatives follow from the order p-1 splines
+	dtheta[0] = -theta[0];
+	for (int j = 1; j < p; ++j) {
+		dtheta[j] = theta[j-1]-theta[j];
+	}
+	const double div = 1.0/(p-1);
+	theta[p-1] = div*w*theta[p-2];
+	for (int k = 1; k < p-1; ++k) {
+		theta[p-k-1] = div*((w+k)*theta[p-k-2] + (p-k-w)*theta[p-k-1]);
+	}
+	theta[0] = div*(1.0-w)*theta[0];
+}
+
+/*!
+ * Squared moduli |b(m)|^2 of the B-spline interpolation of exp(2 pi i m u/K), for every frequency on a mesh of K points.
+ *
+ * \param [in] K Number of mesh points
+ * \param [in] p B-spline order
+ * \param [out] b2 |b(m)|^2 for m = 0..K-1
+ */
+static void bsplineModuli (const int K, const int p, std::vector <double> &b2) {
+	std::vector <double> theta (p), dtheta (p);
+	bspline (0.0, p, &theta[0], &dtheta[0]);	// theta[j] = M_p(p-1-j)
+	std::vector <double> denom (K);
+	for (int m = 0; m < K; ++m) {
+		double re = 0.0, im = 0.0;
+		for (int k = 0; k < p-1; ++k) {
+			const double arg = 2.0*M_PI*m*k/K;
+			re += theta[p-2-k]*cos(arg);
+			im += theta[p-2-k]*sin(arg);
+		}
+		denom[m] = re*re + im*im;
+	}
+	// odd orders vanish at the Nyquist frequency, interpolate over it
+	for (int m = 0; m < K; ++m) {
+		if (denom[m] < 1.0e-7) {
+			denom[m] = 0.5*(denom[(m-1+K)%K] + denom[(m+1)%K]);
+		}
+	}
+	b2.resize(K);
+	for (int m = 0; m < K; ++m) {
+		b2[m] = 1.0/denom[m];
+	}
+}
+
+/*!
+ * Smallest power of two not less than n.
+ */
+static int nextPow2 (const int n) {
+	int k = 1;
+	while (k < n) {
+		k *= 2;
+	}
+	return k;
+}
+
+/*!
+ * In place radix-2 FFT of n (a power of 2) complex numbers.
+ *
+ * \param [in, out] a Data
+ * \param [in] n Number of points
+ * \param [in] sign Sign of the exponent, -1 forward and +1 (unnormalized) inverse
+ */
+static void fft1d (std::complex <double> *a, const int n, const int sign) {
+	for (int i = 1, j = 0; i < n; ++i) {
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j) {
+			std::swap(a[i], a[j]);
+		}
+	}
+	for (int len = 2; len <= n; len <<= 1) {
+		const double ang = sign*2.0*M_PI/len;
+		const std::complex <double> wlen (cos(ang), sin(ang));
+		for (int i = 0; i < n; i += len) {
+			std::complex <double> w (1.0, 0.0);
+			for (int j = 0; j < len/2; ++j) {
+				const std::complex <double> u = a[i+j], v = a[i+j+len/2]*w;
+				a[i+j] = u+v;
+				a[i+j+len/2] = u-v;
+				w *= wlen;
+			}
+		}
+	}
+}
+
+/*!
+ * Choose alpha and the reciprocal space resolution, and precompute what only depends on them and the box.  Does nothing if neither changed.
+ *
+ * \param [in] sys System definition
+ */
+void ewaldSolver::setup (const systemDefinition &sys) {
+	const float3 box = sys.box();
+	if (box.x == box_.x && box.y == box_.y && box.z == box_.z && sys.rcut() == rc_) {
+		return;
+	}
+	box_ = box;
+	rc_ = sys.rcut();
+	if (rc_ <= 0.0) {
+		throw customException ("Ewald summation requires a positive cutoff");
+	}
+	if (2.0*rc_ > box.x || 2.0*rc_ > box.y || 2.0*rc_ > box.z) {
+		throw customException ("Ewald real space cutoff must be less than half the box");
+	}
+
+	// erfc(alpha rc) = tol
+	double lo = 0.0, hi = 10.0;
+	for (int it = 0; it < 100; ++it) {
+		const double mid = 0.5*(lo+hi);
+		if (erfc(mid) > tol_) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	alpha_ = hi/rc_;
+
+	// exp(-pi^2 m^2/alpha^2) = tol
+	const double mmax = alpha_*sqrt(-log(tol_))/M_PI;
+	int3 n;
+	n.x = (int) ceil(mmax*box.x);
+	n.y = (int) ceil(mmax*box.y);
+	n.z = (int) ceil(mmax*box.z);
+	const double V = box.x*box.y*box.z, a2 = alpha_*alpha_;
+
+	if (method_ == CLASSIC_EWALD) {
+		mesh_ = n;
+		kvec_.clear();
+		kfac_.clear();
+		for (int ix = 0; ix <= n.x; ++ix) {
+			for (int iy = -n.y; iy <= n.y; ++iy) {
+				for (int iz = -n.z; iz <= n.z; ++iz) {
+					// half of reciprocal space, the other half is its mirror image
+					if (ix == 0 && (iy < 0 || (iy == 0 && iz <= 0))) {
+						continue;
+					}
+					float3 k;
+					k.x = 2.0*M_PI*ix/box.x;
+					k.y = 2.0*M_PI*iy/box.y;
+					k.z = 2.0*M_PI*iz/box.z;
+					const double k2 = k.x*k.x + k.y*k.y + k.z*k.z;
+					if (k2 > 4.0*M_PI*M_PI*mmax*mmax) {
+						continue;
+					}
+					kvec_.push_back(k);
+					kfac_.push_back(4.0*M_PI/V*exp(-k2/(4.0*a2))/k2);
+				}
+			}
+		}
+		kcos_.resize(kvec_.size());
+		ksin_.resize(kvec_.size());
+	} else {
+		// the mesh must resolve every frequency kept, and hold a full B-spline
+		mesh_.x = nextPow2(std::max(2*n.x+1, 2*order_));
+		mesh_.y = nextPow2(std::max(2*n.y+1, 2*order_));
+		mesh_.z = nextPow2(std::max(2*n.z+1, 2*order_));
+		std::vector <double> bx, by, bz;
+		bsplineModuli (mesh_.x, order_, bx);
+		bsplineModuli (mesh_.y, order_, by);
+		bsplineModuli (mesh_.z, order_, bz);
+		influence_.resize(mesh_.x*mesh_.y*mesh_.z);
+		grid_.resize(influence_.size());
+		#pragma omp parallel for schedule(static)
+		for (int ix = 0; ix < mesh_.x; ++ix) {
+			const double mx = ((ix <= mesh_.x/2) ? ix : ix-mesh_.x)/box.x;
+			for (int iy = 0; iy < mesh_.y; ++iy) {
+				const double my = ((iy <= mesh_.y/2) ? iy : iy-mesh_.y)/box.y;
+				for (int iz = 0; iz < mesh_.z; ++iz) {
+					const double mz = ((iz <= mesh_.z/2) ? iz : iz-mesh_.z)/box.z;
+					const double m2 = mx*mx + my*my + mz*mz;
+					const int idx = (ix*mesh_.y + iy)*mesh_.z + iz;
+					influence_[idx] = (m2 > 0.0) ? bx[ix]*by[iy]*bz[iz]*exp(-M_PI*M_PI*m2/a2)/(M_PI*V*m2) : 0.0;
+				}
+			}
+		}
+	}
+}
+
+/*!
+ * Add the reciprocal space forces to each atom's acceleration, and compute the reciprocal space energy plus the self energy of the charges
+ * and the energy of the uniform background that neutralizes a net charge.
+ *
+ * \param [in, out] sys System definition, must have one charge per atom
+ * \return Reciprocal, self and net charge energy
+ */
+float ewaldSolver::reciprocal (systemDefinition &sys) {
+	const int natoms = sys.numAtoms();
+	if ((int) sys.charges().size() != natoms) {
+		throw customException ("Ewald summation requires one charge per atom");
+	}
+	setup(sys);
+
+	const std::vector <float> &q = sys.charges();
+	double q2 = 0.0, qtot = 0.0;
+	for (int i = 0; i < natoms; ++i) {
+		q2 += q[i]*q[i];
+		qtot += q[i];
+	}
+	const double V = box_.x*box_.y*box_.z;
+	Uself_ = -alpha_/sqrt(M_PI)*q2 - M_PI*qtot*qtot/(2.0*V*alpha_*alpha_);
+
+	const float Urec = (method_ == CLASSIC_EWALD) ? classic_(sys) : pme_(sys);
+	return Urec + Uself_;
+}
+
+/*!
+ * Reciprocal space sum over explicit reciprocal vectors.
+ *
+ * \param [in, out] sys System definition
+ * \return Reciprocal space energy
+ */
+float ewaldSolver::classic_ (systemDefinition &sys) {
+	const int natoms = sys.numAtoms(), nk = kvec_.size();
+	const float *q = &sys.charges()[0];
+	const float invMass = 1.0/sys.mass();
+	double U = 0.0;
+
+	#pragma omp parallel for schedule(static) reduction(+:U)
+	for (int k = 0; k < nk; ++k) {
+		double c = 0.0, s = 0.0;
+		for (int i = 0; i < natoms; ++i) {
+			const double kr = kvec_[k].x*sys.atoms[i].pos.x + kvec_[k].y*sys.atoms[i].pos.y + kvec_[k].z*sys.atoms[i].pos.z;
+			c += q[i]*cos(kr);
+			s += q[i]*sin(kr);
+		}
+		kcos_[k] = c;
+		ksin_[k] = s;
+		U += kfac_[k]*(c*c + s*s);
+	}
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < natoms; ++i) {
+		double fx = 0.0, fy = 0.0, fz = 0.0;
+		for (int k = 0; k < nk; ++k) {
+			const double kr = kvec_[k].x*sys.atoms[i].pos.x + kvec_[k].y*sys.atoms[i].pos.y + kvec_[k].z*sys.atoms[i].pos.z;
+			const double t = kfac_[k]*(kcos_[k]*sin(kr) - ksin_[k]*cos(kr));
+			fx += t*kvec_[k].x;
+			fy += t*kvec_[k].y;
+			fz += t*kvec_[k].z;
+		}
+		const double f = 2.0*q[i]*invMass;
+		sys.atoms[i].acc.x += f*fx;
+		sys.atoms[i].acc.y += f*fy;
+		sys.atoms[i].acc.z += f*fz;
+	}
+
+	return U;
+}
+
+/*!
+ * Reciprocal space sum on the mesh.  Charges are spread with B-splines onto per-thread meshes which are then summed, the mesh is
+ * transformed, multiplied by the influence function and transformed back into the potential, which is interpolated back onto the atoms.
+ *
+ * \param [in, out] sys System definition
+ * \return Reciprocal space energy
+ */
+float ewaldSolver::pme_ (systemDefinition &sys) {
+	const int natoms = sys.numAtoms(), p = order_;
+	const int Kx = mesh_.x, Ky = mesh_.y, Kz = mesh_.z, nmesh = Kx*Ky*Kz;
+	const float *q = &sys.charges()[0];
+	const float invMass = 1.0/sys.mass();
+	const float3 box = box_;
+	const int nThreads = omp_get_max_threads();
+	if ((int) theta_.size() < 3*p*natoms) {
+		theta_.resize(3*p*natoms);
+		dtheta_.resize(3*p*natoms);
+		base_.resize(3*natoms);
+	}
+	if ((int) threadGrid_.size() < nThreads) {
+		threadGrid_.resize(nThreads);
+		line_.resize(nThreads);
+	}
+
+	#pragma omp parallel
+	{
+		const int tid = omp_get_thread_num(), nt = omp_get_num_threads();
+		std::vector <double> &myGrid = threadGrid_[tid];
+		myGrid.assign(nmesh, 0.0);
+
+		#pragma omp for schedule(static)
+		for (int i = 0; i < natoms; ++i) {
+			const float pos[3] = {sys.atoms[i].pos.x, sys.atoms[i].pos.y, sys.atoms[i].pos.z};
+			const float L[3] = {box.x, box.y, box.z};
+			const int K[3] = {Kx, Ky, Kz};
+			for (int d = 0; d < 3; ++d) {
+				double s = pos[d]/L[d];
+				s -= floor(s);
+				const double u = s*K[d];
+				const int b = (int) floor(u);
+				bspline (u-b, p, &theta_[(3*i+d)*p], &dtheta_[(3*i+d)*p]);
+				base_[3*i+d] = (b-p+1+K[d])%K[d];
+			}
+			const double *tx = &theta_[3*i*p], *ty = tx+p, *tz = ty+p;
+			for (int a = 0; a < p; ++a) {
+				const int ix = (base_[3*i]+a)%Kx;
+				const double wx = q[i]*tx[a];
+				for (int b = 0; b < p; ++b) {
+					const int iy = (base_[3*i+1]+b)%Ky;
+					const double wxy = wx*ty[b];
+					double *row = &myGrid[(ix*Ky + iy)*Kz];
+					for (int c = 0; c < p; ++c) {
+						row[(base_[3*i+2]+c)%Kz] += wxy*tz[c];
+					}
+				}
+			}
+		}
+
+		#pragma omp for schedule(static)
+		for (int n = 0; n < nmesh; ++n) {
+			double sum = 0.0;
+			for (int t = 0; t < nt; ++t) {
+				sum += threadGrid_[t][n];
+			}
+			grid_[n] = std::complex <double> (sum, 0.0);
+		}
+	}
+
+	fft3d_(-1);
+
+	double U = 0.0;
+	#pragma omp parallel for schedule(static) reduction(+:U)
+	for (int n = 0; n < nmesh; ++n) {
+		U += influence_[n]*std::norm(grid_[n]);
+		grid_[n] *= influence_[n];
+	}
+	U *= 0.5;
+
+	fft3d_(1);
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < natoms; ++i) {
+		const double *tx = &theta_[3*i*p], *ty = tx+p, *tz = ty+p;
+		const double *dx = &dtheta_[3*i*p], *dy = dx+p, *dz = dy+p;
+		double fx = 0.0, fy = 0.0, fz = 0.0;
+		for (int a = 0; a < p; ++a) {
+			const int ix = (base_[3*i]+a)%Kx;
+			for (int b = 0; b < p; ++b) {
+				const int iy = (base_[3*i+1]+b)%Ky;
+				const std::complex <double> *row = &grid_[(ix*Ky + iy)*Kz];
+				for (int c = 0; c < p; ++c) {
+					const double phi = row[(base_[3*i+2]+c)%Kz].real();
+					fx += dx[a]*ty[b]*tz[c]*phi;
+					fy += tx[a]*dy[b]*tz[c]*phi;
+					fz += tx[a]*ty[b]*dz[c]*phi;
+				}
+			}
+		}
+		const double f = -q[i]*invMass;
+		sys.atoms[i].acc.x += f*fx*Kx/box.x;
+		sys.atoms[i].acc.y += f*fy*Ky/box.y;
+		sys.atoms[i].acc.z += f*fz*Kz/box.z;
+	}
+
+	return U;
+}
+
+/*!
+ * In place 3D FFT of the mesh, one direction at a time with the lines of each direction transformed in parallel.
+ *
+ * \param [in] sign Sign of the exponent, -1 forward and +1 (unnormalized) inverse
+ */
+void ewaldSolver::fft3d_ (const int sign) {
+	const int K[3] = {mesh_.x, mesh_.y, mesh_.z};
+	const int stride[3] = {mesh_.y*mesh_.z, mesh_.z, 1};
+	for (int d = 0; d < 3; ++d) {
+		// lines along d are indexed by the other two directions
+		const int d1 = (d+1)%3, d2 = (d+2)%3;
+		const int nlines = K[d1]*K[d2];
+		#pragma omp parallel
+		{
+			std::vector < std::complex <double> > &line = line_[omp_get_thread_num()];
+			if ((int) line.size() < K[d]) {
+				line.resize(K[d]);
+			}
+			#pragma omp for schedule(static)
+			for (int l = 0; l < nlines; ++l) {
+				const int start = (l/K[d2])*stride[d1] + (l%K[d2])*stride[d2];
+				for (int j = 0; j < K[d]; ++j) {
+					line[j] = grid_[start + j*stride[d]];
+				}
+				fft1d (&line[0], K[d], sign);
+				for (int j = 0; j < K[d]; ++j) {
+					grid_[start + j*stride[d]] = line[j];
+				}
+			}
+		}
+	}
+}
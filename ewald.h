@@ -0,0 +1,88 @@
+/*!
+ * Long-range electrostatics (Ewald summation and smooth particle-mesh Ewald)
+ * \date 10/19/26
+ */
+
+#ifndef __EWALD_H__
+#define __EWALD_H__
+
+#include <vector>
+#include <complex>
+#include <math.h>
+#include "dataTypes.h"
+#include "system.h"
+
+//! Method used for the reciprocal space sum
+enum ewaldMethod {
+	CLASSIC_EWALD,  //!< Explicit sum over reciprocal vectors, O(N^(3/2)) at best but exact to the tolerance; use for validation
+	SMOOTH_PME      //!< Smooth particle-mesh Ewald (Essmann et al. 1995), B-spline charge spreading and a 3D FFT, O(N log N)
+};
+
+/*!
+ * Long-range part of the Coulomb interaction between the system's charges, U = sum_{i<j} q_i q_j/r_ij over all periodic images.
+ * The interaction is split with the Ewald parameter alpha into a short-ranged real space part, erfc(alpha r)/r, which the integrator
+ * evaluates over the cell list with the pair potential's cutoff, and a smooth reciprocal space part plus self and net charge corrections computed here.
+ * The tolerance sets both: alpha is chosen so erfc(alpha rc) = tolerance and reciprocal vectors (or mesh frequencies) are kept until
+ * exp(-pi^2 m^2/alpha^2) drops below it.  Only orthorhombic boxes are supported.
+ */
+class ewaldSolver {
+	public:
+		ewaldSolver (const ewaldMethod method=SMOOTH_PME, const float tolerance=1.0e-5);
+		~ewaldSolver () {}
+		void setMethod (const ewaldMethod method) {method_ = method; box_.x = -1.0;}   //!< Select the reciprocal space method
+		void setTolerance (const float tol);    //!< Set the relative accuracy of the real and reciprocal space sums (smaller is more accurate and slower)
+		void setOrder (const int p);            //!< Set the order of the B-splines used to spread charges onto the mesh (default 4)
+		ewaldMethod method () const {return method_;}   //!< Report the reciprocal space method
+		float tolerance () const {return tol_;}         //!< Report the accuracy tolerance
+		int order () const {return order_;}             //!< Report the B-spline order
+		float alpha () const {return alpha_;}           //!< Report the Ewald splitting parameter, valid after setup()
+		int3 mesh () const {return mesh_;}              //!< Report the PME mesh (or for classic Ewald, the largest reciprocal vector index) in each direction
+		void setup (const systemDefinition &sys);       //!< Choose alpha and the reciprocal space resolution for the system's box and cutoff, if they changed
+		float reciprocal (systemDefinition &sys);       //!< Add the reciprocal space forces to each atom's acceleration and return the reciprocal, self and net charge energy
+		float selfEnergy () const {return Uself_;}      //!< Report the self and net charge energy from the last reciprocal()
+
+		/*!
+		 * Real space part of the interaction of a pair of charges, to be evaluated for every pair within the cutoff.
+		 *
+		 * \param [in] qq Product of the charges
+		 * \param [in] r2 Squared distance between the charges
+		 * \param [in] alpha Ewald splitting parameter
+		 * \param [out] fOverR Magnitude of the (repulsive) force divided by the distance
+		 * \return Energy of the pair
+		 */
+		static inline float realSpace (const float qq, const float r2, const float alpha, float &fOverR) {
+			const float r = sqrt(r2), ar = alpha*r;
+			const float u = qq*erfc(ar)/r;
+			fOverR = (u + qq*1.1283791671*alpha*exp(-ar*ar))/r2;	// 2/sqrt(pi)
+			return u;
+		}
+
+	private:
+		ewaldMethod method_;    //!< Reciprocal space method
+		float tol_;             //!< Accuracy tolerance
+		int order_;             //!< B-spline order
+		float alpha_;           //!< Ewald splitting parameter
+		float rc_;              //!< Real space cutoff alpha was chosen for
+		float3 box_;            //!< Box the mesh and influence function were set up for
+		int3 mesh_;             //!< Mesh size (PME) or largest reciprocal vector index (classic) in each direction
+		float Uself_;           //!< Self and net charge energy
+
+		std::vector <float3> kvec_;         //!< Classic Ewald: reciprocal vectors in half of reciprocal space
+		std::vector <double> kfac_;         //!< Classic Ewald: 4 pi/V exp(-k^2/(4 alpha^2))/k^2 for each reciprocal vector (doubled for the omitted half)
+		std::vector <double> kcos_;         //!< Classic Ewald: real part of the structure factor of each reciprocal vector
+		std::vector <double> ksin_;         //!< Classic Ewald: imaginary part of the structure factor of each reciprocal vector
+
+		std::vector <double> influence_;    //!< PME: B(m) C(m), the product of the B-spline moduli and the reciprocal space kernel on the mesh
+		std::vector < std::complex <double> > grid_;        //!< PME: charge mesh, transformed in place
+		std::vector < std::vector <double> > threadGrid_;   //!< PME: per-thread charge meshes so atoms can be spread in parallel
+		std::vector < std::vector < std::complex <double> > > line_;  //!< PME: per-thread buffers for one line of the FFT
+		std::vector <double> theta_;        //!< PME: B-spline weights of each atom in each direction (atom major, then direction, then order)
+		std::vector <double> dtheta_;       //!< PME: derivatives of the B-spline weights
+		std::vector <int> base_;            //!< PME: first mesh point each atom is spread onto in each direction
+
+		float classic_ (systemDefinition &sys);             //!< Reciprocal space sum over reciprocal vectors
+		float pme_ (systemDefinition &sys);                 //!< Reciprocal space sum on the mesh
+		void fft3d_ (const int sign);                       //!< In place 3D FFT of grid_
+};
+
+#endif
@@ -0,0 +1,265 @@
+/*!
+ * In-situ analysis run concurrently with the integration
+ * \date 10/19/26
+ */
+
+#include "inSitu.h"
+#include "common.h"
+#include <omp.h>
+
+/*!
+ * Start the analysis threads.
+ *
+ * \param [in] nThreads Number of analysis threads
+ * \param [in] policy What to do when analysis falls behind
+ */
+inSituAnalysis::inSituAnalysis (const int nThreads, const laggingPolicy policy) {
+	if (nThreads < 1) {
+		throw customException ("In-situ analysis needs at least one thread");
+		return;
+	}
+	policy_ = policy;
+	pending_[0] = 0;
+	pending_[1] = 0;
+	running_ = 0;
+	stop_ = false;
+	blocked_ = 0.0;
+	pthread_mutex_init(&lock_, NULL);
+	pthread_cond_init(&work_, NULL);
+	pthread_cond_init(&done_, NULL);
+	threads_.resize(nThreads);
+	for (int t = 0; t < nThreads; ++t) {
+		if (pthread_create(&threads_[t], NULL, worker_, this) != 0) {
+			throw customException ("Unable to start an in-situ analysis thread");
+			return;
+		}
+	}
+}
+
+/*!
+ * Let the queued analyses finish, then stop the threads.
+ */
+inSituAnalysis::~inSituAnalysis () {
+	finish();
+	pthread_mutex_lock(&lock_);
+	stop_ = true;
+	pthread_cond_broadcast(&work_);
+	pthread_mutex_unlock(&lock_);
+	for (unsigned int t = 0; t < threads_.size(); ++t) {
+		pthread_join(threads_[t], NULL);
+	}
+	pthread_cond_destroy(&done_);
+	pthread_cond_destroy(&work_);
+	pthread_mutex_destroy(&lock_);
+}
+
+/*!
+ * Register a hook.  Hooks should be registered before the first update().
+ *
+ * \param [in] hook Analysis, not owned, which must outlive this object or the next finish()
+ * \param [in] every Number of steps between calls; the hook is due at steps which are multiples of this
+ * \param [in] name Name to report the hook's statistics under
+ * \return Index of the hook
+ */
+int inSituAnalysis::addHook (analysisHook *hook, const int every, const std::string &name) {
+	if (hook == NULL || every < 1) {
+		throw customException ("An analysis hook must be given and run at least every 1 step");
+		return -1;
+	}
+	hookEntry h;
+	h.hook = hook;
+	h.running = false;
+	h.stats.name = name;
+	h.stats.every = every;
+	h.stats.calls = 0;
+	h.stats.skipped = 0;
+	h.stats.time = 0.0;
+	h.stats.maxTime = 0.0;
+	pthread_mutex_lock(&lock_);
+	hooks_.push_back(h);
+	pthread_mutex_unlock(&lock_);
+	return hooks_.size()-1;
+}
+
+/*!
+ * Copy the system into a snapshot buffer.  The copy is parallel over the integrator's threads since it is the only part of the
+ * analysis which holds up the next step.
+ *
+ * \param [out] snap Buffer
+ * \param [in] sys System
+ * \param [in] step Current step
+ */
+void inSituAnalysis::take_ (snapshot &snap, const systemDefinition &sys, const int step) {
+	const int natoms = sys.numAtoms();
+	snap.step = step;
+	snap.box = sys.box();
+	snap.KinE = sys.KinE();
+	snap.PotE = sys.PotE();
+	snap.instantT = sys.instantT();
+	snap.pos.resize(natoms);
+	snap.vel.resize(natoms);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < natoms; ++i) {
+		snap.pos[i] = sys.atoms[i].pos;
+		snap.vel[i] = sys.atoms[i].vel;
+	}
+}
+
+/*!
+ * Queue the hooks due at this step on a free snapshot buffer.  If neither buffer is free the step's analyses are skipped
+ * (ANALYSIS_SKIP) or this waits for a buffer to be released (ANALYSIS_BLOCK).
+ *
+ * \param [in] sys System
+ * \param [in] step Current step
+ */
+void inSituAnalysis::update (const systemDefinition &sys, const int step) {
+	due_.clear();
+	for (unsigned int h = 0; h < hooks_.size(); ++h) {
+		if (step%hooks_[h].stats.every == 0) {
+			due_.push_back(h);
+		}
+	}
+	if (due_.empty()) {
+		return;
+	}
+
+	pthread_mutex_lock(&lock_);
+	int buffer = (pending_[0] == 0) ? 0 : ((pending_[1] == 0) ? 1 : -1);
+	if (buffer < 0 && policy_ == ANALYSIS_SKIP) {
+		for (unsigned int d = 0; d < due_.size(); ++d) {
+			hooks_[due_[d]].stats.skipped++;
+		}
+		pthread_mutex_unlock(&lock_);
+		return;
+	}
+	if (buffer < 0) {
+		const double t0 = omp_get_wtime();
+		while (pending_[0] > 0 && pending_[1] > 0) {
+			pthread_cond_wait(&done_, &lock_);
+		}
+		blocked_ += omp_get_wtime()-t0;
+		buffer = (pending_[0] == 0) ? 0 : 1;
+	}
+	pthread_mutex_unlock(&lock_);
+
+	// no job refers to a free buffer, so it can be filled without holding the lock
+	take_(buffers_[buffer], sys, step);
+
+	pthread_mutex_lock(&lock_);
+	for (unsigned int d = 0; d < due_.size(); ++d) {
+		job j;
+		j.hook = due_[d];
+		j.buffer = buffer;
+		queue_.push_back(j);
+	}
+	pending_[buffer] = due_.size();
+	pthread_cond_broadcast(&work_);
+	pthread_mutex_unlock(&lock_);
+}
+
+/*!
+ * Wait until every queued analysis has run, e.g. before reading a hook's results or at the end of a simulation.
+ */
+void inSituAnalysis::finish () {
+	pthread_mutex_lock(&lock_);
+	while (!queue_.empty() || running_ > 0) {
+		pthread_cond_wait(&done_, &lock_);
+	}
+	pthread_mutex_unlock(&lock_);
+}
+
+/*!
+ * Statistics of one hook, which may still be changing if analyses are queued.
+ *
+ * \param [in] i Index of the hook
+ */
+hookStats inSituAnalysis::stats (const int i) {
+	pthread_mutex_lock(&lock_);
+	const hookStats s = hooks_[i].stats;
+	pthread_mutex_unlock(&lock_);
+	return s;
+}
+
+/*!
+ * Write the number of calls, skipped snapshots and time of every hook.
+ *
+ * \param [in, out] os Stream to write to
+ */
+void inSituAnalysis::report (std::ostream &os) {
+	pthread_mutex_lock(&lock_);
+	os << "# hook\tevery\tcalls\tskipped\ttotal time (s)\tmean time (s)\tmax time (s)" << std::endl;
+	for (unsigned int h = 0; h < hooks_.size(); ++h) {
+		const hookStats &s = hooks_[h].stats;
+		os << (s.name.empty() ? "-" : s.name) << "\t" << s.every << "\t" << s.calls << "\t" << s.skipped << "\t" << s.time << "\t" << (s.calls > 0 ? s.time/s.calls : 0.0) << "\t" << s.maxTime << std::endl;
+	}
+	os << "# time spent waiting for a free snapshot buffer (s): " << blocked_ << std::endl;
+	pthread_mutex_unlock(&lock_);
+}
+
+/*!
+ * Position in the queue of the oldest job whose hook is not already running, so a hook never runs concurrently with itself and sees its
+ * snapshots in order.  Must be called holding the lock.
+ */
+int inSituAnalysis::nextJob_ () {
+	for (unsigned int q = 0; q < queue_.size(); ++q) {
+		if (!hooks_[queue_[q].hook].running) {
+			return q;
+		}
+	}
+	return -1;
+}
+
+/*!
+ * Thread entry point.
+ *
+ * \param [in] self The inSituAnalysis object
+ */
+void* inSituAnalysis::worker_ (void *self) {
+	((inSituAnalysis*) self)->run_();
+	return NULL;
+}
+
+/*!
+ * Run queued jobs until told to stop.
+ */
+void inSituAnalysis::run_ () {
+	pthread_mutex_lock(&lock_);
+	while (true) {
+		int q = -1;
+		while (!stop_ && (q = nextJob_()) < 0) {
+			pthread_cond_wait(&work_, &lock_);
+		}
+		if (stop_) {
+			break;
+		}
+		const job j = queue_[q];
+		queue_.erase(queue_.begin()+q);
+		analysisHook *hook = hooks_[j.hook].hook;
+		const std::string name = hooks_[j.hook].stats.name;
+		hooks_[j.hook].running = true;
+		running_++;
+		pthread_mutex_unlock(&lock_);
+
+		const double t0 = omp_get_wtime();
+		try {
+			hook->analyze(buffers_[j.buffer]);
+		} catch (std::exception &e) {
+			std::cerr << "In-situ analysis " << name << " failed at step " << buffers_[j.buffer].step << ": " << e.what() << std::endl;
+		}
+		const double t = omp_get_wtime()-t0;
+
+		pthread_mutex_lock(&lock_);
+		hookEntry &h = hooks_[j.hook];
+		h.running = false;
+		h.stats.calls++;
+		h.stats.time += t;
+		if (t > h.stats.maxTime) {
+			h.stats.maxTime = t;
+		}
+		pending_[j.buffer]--;
+		running_--;
+		pthread_cond_broadcast(&done_);
+		pthread_cond_broadcast(&work_);		// the hook may have further snapshots queued
+	}
+	pthread_mutex_unlock(&lock_);
+}
@@ -0,0 +1,109 @@
+/*!
+ * In-situ analysis run concurrently with the integration
+ * \date 10/19/26
+ */
+
+#ifndef __IN_SITU_H__
+#define __IN_SITU_H__
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <iostream>
+#include <pthread.h>
+#include "dataTypes.h"
+#include "system.h"
+
+//! What inSituAnalysis::update() does when every snapshot buffer is still being analyzed
+enum laggingPolicy {
+	ANALYSIS_SKIP,  //!< Skip the analyses due at this step and carry on integrating
+	ANALYSIS_BLOCK  //!< Wait for a buffer to be released, so no analysis is ever skipped
+};
+
+//! Read-only copy of the state of a system at one step, handed to analysis hooks
+struct snapshot {
+	int step;           //!< Step the snapshot was taken at
+	float3 box;         //!< Box dimensions
+	float KinE;         //!< Kinetic energy
+	float PotE;         //!< Potential energy
+	float instantT;     //!< Instantaneous temperature
+	std::vector <float3> pos;   //!< Position of each atom
+	std::vector <float3> vel;   //!< Velocity of each atom
+};
+
+/*!
+ * An analysis run every so many steps on a snapshot of the system.  analyze() is called on one of the analysis threads, never
+ * concurrently with itself, and for a given hook in the order of the steps; it must not touch the live system.
+ */
+class analysisHook {
+	public:
+		virtual ~analysisHook () {}
+		virtual void analyze (const snapshot &snap) = 0;   //!< Analyze one snapshot
+};
+
+//! Timing statistics of one registered hook
+struct hookStats {
+	std::string name;   //!< Name given at registration
+	int every;          //!< Steps between calls
+	int calls;          //!< Number of snapshots analyzed
+	int skipped;        //!< Number of snapshots skipped because analysis fell behind (ANALYSIS_SKIP)
+	double time;        //!< Total time spent in analyze()
+	double maxTime;     //!< Longest single call to analyze()
+};
+
+/*!
+ * Runs registered analysis hooks on a pool of threads while the integrator carries on.  Call update() after every step; when any hook
+ * is due the system is copied into one of two snapshot buffers (double buffering, so one snapshot can be analyzed while the next is
+ * taken) and the due hooks are queued on that buffer.  A buffer is released when all of its hooks have run.  If both buffers are still
+ * in use the lagging policy decides whether to skip that step's analyses or wait.
+ * The integrator keeps all of its OpenMP threads, so leave cores free for the analysis threads.
+ */
+class inSituAnalysis {
+	public:
+		inSituAnalysis (const int nThreads=1, const laggingPolicy policy=ANALYSIS_SKIP);
+		~inSituAnalysis ();
+		int addHook (analysisHook *hook, const int every, const std::string &name="");   //!< Register a hook (not owned) to be run every so many steps, returns its index
+		void update (const systemDefinition &sys, const int step);  //!< Queue the hooks due at this step
+		void finish ();                                 //!< Wait until every queued analysis has run
+		void setPolicy (const laggingPolicy policy) {policy_ = policy;}    //!< Choose what happens when analysis falls behind
+		laggingPolicy policy () const {return policy_;}                     //!< Report what happens when analysis falls behind
+		int numHooks () const {return hooks_.size();}                       //!< Report the number of registered hooks
+		hookStats stats (const int i);                  //!< Report the timing statistics of a hook
+		double blockedTime () const {return blocked_;}  //!< Report the time update() spent waiting for a free buffer (ANALYSIS_BLOCK)
+		void report (std::ostream &os);                 //!< Write the statistics of every hook
+
+	private:
+		//! A registered hook
+		struct hookEntry {
+			analysisHook *hook;     //!< Hook
+			bool running;           //!< Flag for whether a thread is running the hook
+			hookStats stats;        //!< Timing statistics
+		};
+		//! A hook queued on a snapshot buffer
+		struct job {
+			int hook;               //!< Index of the hook
+			int buffer;             //!< Index of the snapshot buffer
+		};
+
+		laggingPolicy policy_;      //!< What happens when analysis falls behind
+		std::vector <hookEntry> hooks_;     //!< Registered hooks
+		snapshot buffers_[2];       //!< Snapshot buffers
+		int pending_[2];            //!< Number of queued or running jobs on each buffer
+		std::deque <job> queue_;    //!< Jobs not yet started, oldest first
+		int running_;               //!< Number of jobs being run
+		bool stop_;                 //!< Flag telling the threads to exit
+		double blocked_;            //!< Time update() spent waiting for a free buffer
+		std::vector <int> due_;     //!< Hooks due at the current step
+
+		std::vector <pthread_t> threads_;   //!< Analysis threads
+		pthread_mutex_t lock_;      //!< Protects everything shared with the analysis threads
+		pthread_cond_t work_;       //!< Signalled when a job is queued, a hook becomes free, or the threads must stop
+		pthread_cond_t done_;       //!< Signalled when a job completes
+
+		static void* worker_ (void *self);  //!< Thread entry point
+		void run_ ();                       //!< Run jobs until told to stop
+		int nextJob_ ();                    //!< Position in the queue of the oldest job whose hook is not running, or -1
+		void take_ (snapshot &snap, const systemDefinition &sys, const int step);  //!< Copy the system into a buffer
+};
+
+#endif
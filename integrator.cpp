@@ -10,68 +10,525 @@
 #include <math.h>
 #include "common.h"
 #include "integrator.h"
+#include "utils.h"
 #include <omp.h>
 #include <vector>
+#include <algorithm>
 
 #ifndef NVCC
+/*!
+ * Compute the interactions between all atoms in a pair of neighboring cells (or all pairs of atoms within one cell).
+ *
+ * \param [in] c1 First cell
+ * \param [in] c2 Second cell, may equal c1
+ * \param [in] cl Cell list
+ * \param [in] sys System definition
+ * \param [in, out] acc Acceleration accumulator (with the opposite sign convention to atom::acc)
+ * \param [in] box Box dimensions
+ * \param [in] args Additional arguments to the pair potential
+ * \param [in] rc Cutoff radius
+ * \param [in] invMass Inverse of the particle mass
+ * \param [in] q Charge of each atom, or NULL if there are no electrostatic interactions
+ * \param [in] alpha Ewald splitting parameter for the real space part of the electrostatic interactions
+ * \param [in, out] W Virial accumulator, or NULL if the virial is not needed; the electrostatic contribution is the real space energy
+ * \param [in, out] ov Overlap policy and this thread's overlap counter
+ * \param [in, out] Woff Off-diagonal virial accumulator (xy, xz, yz), or NULL if the stress is not needed
+ * \return Potential energy of the interactions
+ */
+static inline float cellPairForce (const int c1, const int c2, const cellList_cpu &cl, const systemDefinition &sys, float3 *acc, const float3 &box, const float *args, const float &rc, const float invMass, const float *q, const float alpha, float *W, overlapState *ov, float3 *Woff) {
+	float Up = 0.0;
+	const bool packed = cl.packedPositions();
+	for (int slot1 = cl.cellBegin(c1); slot1 < cl.cellEnd(c1); ++slot1) {
+		const int atom1 = cl.atom(slot1);
+		const float3 *p1 = packed ? &cl.packedPos(slot1) : &sys.atoms[atom1].pos;
+		const int start2 = (c1 == c2) ? slot1+1 : cl.cellBegin(c2);
+		for (int slot2 = start2; slot2 < cl.cellEnd(c2); ++slot2) {
+			const int atom2 = cl.atom(slot2);
+			const float3 *p2 = packed ? &cl.packedPos(slot2) : &sys.atoms[atom2].pos;
+			float3 pf;
+			Up += sys.potential (p1, p2, &pf, &box, args, &rc, ov);
+			if (q != NULL || W != NULL || Woff != NULL) {
+				float3 dr;
+				const float r2 = pbcDist2 (*p1, *p2, dr, box);
+				if (W != NULL) {
+					*W -= dr.x*pf.x + dr.y*pf.y + dr.z*pf.z;
+				}
+				if (Woff != NULL) {
+					Woff->x -= dr.x*pf.y;
+					Woff->y -= dr.x*pf.z;
+					Woff->z -= dr.y*pf.z;
+				}
+				if (q != NULL && r2 < rc*rc) {
+					// real space part of the Ewald sum, with the same sign convention as the pair potentials
+					float fOverR;
+					const float u = ewaldSolver::realSpace (q[atom1]*q[atom2], r2, alpha, fOverR);
+					Up += u;
+					pf.x -= fOverR*dr.x;
+					pf.y -= fOverR*dr.y;
+					pf.z -= fOverR*dr.z;
+					if (W != NULL) {
+						*W += u;	// the Coulomb energy is homogeneous of degree -1, so its virial is the energy itself
+					}
+				}
+			}
+			acc[atom1].x -= pf.x*invMass; 
+			acc[atom1].y -= pf.y*invMass;
+			acc[atom1].z -= pf.z*invMass;
+			acc[atom2].x += pf.x*invMass;
+			acc[atom2].y += pf.y*invMass;
+			acc[atom2].z += pf.z*invMass;
+		}
+	}
+	return Up;
+}
+
+/*!
+ * First pass of an embedded-atom force calculation: accumulate the host density each atom in a pair of neighboring cells (or all pairs
+ * of atoms within one cell) receives from the other.
+ *
+ * \param [in] c1 First cell
+ * \param [in] c2 Second cell, may equal c1
+ * \param [in] cl Cell list
+ * \param [in] sys System definition
+ * \param [in, out] rho Host density accumulator
+ * \param [in] box Box dimensions
+ * \param [in] eam Embedded-atom potential
+ */
+static inline void cellPairDensity (const int c1, const int c2, const cellList_cpu &cl, const systemDefinition &sys, float *rho, const float3 &box, const eamPotential &eam) {
+	const float rc2 = eam.cutoff()*eam.cutoff();
+	const bool packed = cl.packedPositions();
+	for (int slot1 = cl.cellBegin(c1); slot1 < cl.cellEnd(c1); ++slot1) {
+		const int atom1 = cl.atom(slot1);
+		const float3 *p1 = packed ? &cl.packedPos(slot1) : &sys.atoms[atom1].pos;
+		const int start2 = (c1 == c2) ? slot1+1 : cl.cellBegin(c2);
+		for (int slot2 = start2; slot2 < cl.cellEnd(c2); ++slot2) {
+			const int atom2 = cl.atom(slot2);
+			const float3 *p2 = packed ? &cl.packedPos(slot2) : &sys.atoms[atom2].pos;
+			float3 dr;
+			const float r2 = pbcDist2 (*p1, *p2, dr, box);
+			if (r2 < rc2) {
+				float df;
+				const float f = eam.density(sqrt(r2), df);
+				rho[atom1] += f;
+				rho[atom2] += f;
+			}
+		}
+	}
+}
+
+/*!
+ * Second pass of an embedded-atom force calculation: the pair and embedding forces between all atoms in a pair of neighboring cells (or
+ * all pairs of atoms within one cell), once F'(rho) of every atom is known.
+ *
+ * \param [in] c1 First cell
+ * \param [in] c2 Second cell, may equal c1
+ * \param [in] cl Cell list
+ * \param [in] sys System definition
+ * \param [in, out] acc Acceleration accumulator (with the opposite sign convention to atom::acc)
+ * \param [in] box Box dimensions
+ * \param [in] eam Embedded-atom potential
+ * \param [in] fp Derivative of each atom's embedding energy with respect to its host density
+ * \param [in] invMass Inverse of the particle mass
+ * \param [in, out] W Virial accumulator, or NULL if the virial is not needed
+ * \param [in, out] Woff Off-diagonal virial accumulator (xy, xz, yz), or NULL if the stress is not needed
+ * \return Pair energy of the interactions
+ */
+static inline float cellPairEmbeddedForce (const int c1, const int c2, const cellList_cpu &cl, const systemDefinition &sys, float3 *acc, const float3 &box, const eamPotential &eam, const float *fp, const float invMass, float *W, float3 *Woff) {
+	float Up = 0.0;
+	const float rc2 = eam.cutoff()*eam.cutoff();
+	const bool packed = cl.packedPositions();
+	for (int slot1 = cl.cellBegin(c1); slot1 < cl.cellEnd(c1); ++slot1) {
+		const int atom1 = cl.atom(slot1);
+		const float3 *p1 = packed ? &cl.packedPos(slot1) : &sys.atoms[atom1].pos;
+		const int start2 = (c1 == c2) ? slot1+1 : cl.cellBegin(c2);
+		for (int slot2 = start2; slot2 < cl.cellEnd(c2); ++slot2) {
+			const int atom2 = cl.atom(slot2);
+			const float3 *p2 = packed ? &cl.packedPos(slot2) : &sys.atoms[atom2].pos;
+			float3 dr;
+			const float r2 = pbcDist2 (*p1, *p2, dr, box);
+			if (r2 >= rc2) continue;
+			const float r = sqrt(r2);
+			float df, dphi;
+			eam.density(r, df);
+			Up += eam.pair(r, dphi);
+			const float factor = (dphi + (fp[atom1] + fp[atom2])*df)/r;
+			float3 pf;
+			pf.x = factor*dr.x;
+			pf.y = factor*dr.y;
+			pf.z = factor*dr.z;
+			if (W != NULL) {
+				*W -= dr.x*pf.x + dr.y*pf.y + dr.z*pf.z;
+			}
+			if (Woff != NULL) {
+				Woff->x -= dr.x*pf.y;
+				Woff->y -= dr.x*pf.z;
+				Woff->z -= dr.y*pf.z;
+			}
+			acc[atom1].x -= pf.x*invMass;
+			acc[atom1].y -= pf.y*invMass;
+			acc[atom1].z -= pf.z*invMass;
+			acc[atom2].x += pf.x*invMass;
+			acc[atom2].y += pf.y*invMass;
+			acc[atom2].z += pf.z*invMass;
+		}
+	}
+	return Up;
+}
+
 /*!
  * Calculate the pairwise forces in a system.  This also calculates the potential energy of a system.
  * The kinetic energy is calculated during the verlet integration.
+ * Runs of unique pairs of neighboring cells are tasks; by default tasks are executed largest first with work stealing (see cellPairScheduler).
+ * Every thread accumulates into its own buffer, so any thread may execute any task, and the buffers are summed at the end.
+ * If an Ewald solver was given the real space electrostatics are added to each pair and the reciprocal space part is computed afterwards.
+ * If an embedded-atom potential was given it replaces the pair potential, and is evaluated in two passes over the same tasks: the host
+ * densities are accumulated in per-thread buffers and summed, then the forces are computed from F'(rho) of both atoms of each pair.
+ * If the integrator needs the pressure the virial is accumulated as well, and if asked for the stress so are its off-diagonal components.
+ * If the timestep is adaptive, the largest speed and acceleration of any atom are found while the accelerations are stored.
+ * If cluster pairs are on, the loop runs over clusters of atoms instead, each interacting with the clusters on its list (see
+ * clusterPairList); this is only available for slj without electrostatics, the embedded-atom potential or the stress.  With a dual pair
+ * list the clusters only visit the pairs of an inner list, pruned beyond rc+innerBuffer as the atoms move.
+ * Overlapping pairs are counted per thread by the pair potential and acted on once the loop is complete (see checkOverlaps_()).
+ * With asynchronous rebuilds the cell list may be replaced by one built on the helper thread (see updateCellList_()).
  *
  * \param [in, out] sys System definition
  */
 void integrator::calcForce (systemDefinition &sys) {
-	// For cache coeherency allocate new space for calculations
-	float3 empty;
-	empty.x = 0; empty.y = 0; empty.z = 0;
-	std::vector <float3> acc (sys.numAtoms(), empty);
+	const int natoms = sys.numAtoms();
 	const float rc = sys.rcut();
 
 	// every time, check if the cell list needs to be updated first
-	cl_.checkUpdate(sys);
+	updateCellList_(sys);
 
-	float Up = 0.0;
+	// cell pair tasks only change when the occupancy (or number of threads) does
+	const int nThreads = omp_get_max_threads();
+	if (!forceTasks_.current(cl_, nThreads)) {
+		forceTasks_.build(cl_, nThreads);
+	}
+	forceTasks_.rewind();
+	ws_.reserve(nThreads, natoms);
+
+	float Up = 0.0, Wvir = 0.0, vmax2 = 0.0, amax2 = 0.0, Wxy = 0.0, Wxz = 0.0, Wyz = 0.0;
+	int overlaps = 0;
 	const float3 box = sys.box();
 	const float invMass = 1.0/sys.mass();
 	
-	// traverse cell list and calculate total system potential energy 
-	std::vector <float> args = sys.potentialArgs();
-#pragma omp parallel for reduction(+:Up) schedule(dynamic, 1)
-	for (unsigned int cellID = 0; cellID < cl_.nCells.x*cl_.nCells.y*cl_.nCells.z; ++cellID) {
-		int atom1 = cl_.head(cellID);
-		while (atom1 >= 0) {
-			std::vector < int > neighbors = cl_.neighbors(cellID);
-			for (int index = 0; index < neighbors.size(); ++index) {
-				const int cellID2 = neighbors[index];
-				int atom2 = cl_.head(cellID2);
-				while (atom2 >= 0) {
-					if (atom1 > atom2) {
-						float3 pf;
-						Up += sys.potential (&sys.atoms[atom1].pos, &sys.atoms[atom2].pos, &pf, &box, &args[0], &rc);
-						acc[atom1].x -= pf.x*invMass; 
-						acc[atom1].y -= pf.y*invMass;
-						acc[atom1].z -= pf.z*invMass;
-						acc[atom2].x += pf.x*invMass;
-						acc[atom2].y += pf.y*invMass;
-						acc[atom2].z += pf.z*invMass;
+	// traverse cell pairs and calculate total system potential energy 
+	const float *args = sys.potentialArgs().empty() ? NULL : &sys.potentialArgs()[0];
+	const float *q = NULL;
+	float alpha = 0.0;
+	if (ewald_ != NULL) {
+		ewald_->setup(sys);
+		if (sys.charges().size() > 0) {
+			q = &sys.charges()[0];
+		}
+		alpha = ewald_->alpha();
+	}
+	if (computeStress_ && ewald_ != NULL) {
+		throw customException ("The stress is not computed with electrostatics");
+	}
+	if (eam_ != NULL) {
+		if (ewald_ != NULL) {
+			throw customException ("Electrostatics cannot be combined with the embedded-atom potential");
+		}
+		if (rc < eam_->cutoff()) {
+			throw customException ("The cutoff must be at least that of the embedded-atom potential");
+		}
+		ws_.reserveDensity(nThreads, natoms);
+	}
+	if (clusterPairs_) {
+		if (sys.potential != slj || sys.potentialArgs().size() < 4) {
+			throw customException ("Cluster pairs are only supported for the slj pair potential");
+		}
+		if (ewald_ != NULL || eam_ != NULL || computeStress_) {
+			throw customException ("Cluster pairs cannot be combined with electrostatics, the embedded-atom potential or the stress");
+		}
+		if (sys.overlapMode() != OVERLAP_ABORT) {
+			throw customException ("Cluster pairs only support the OVERLAP_ABORT policy");
+		}
+		clusters_.update(cl_, sys);
+	} else if (clusters_.dualList()) {
+		throw customException ("The dual pair list needs cluster pairs");
+	}
+	const int nClusters = clusters_.numClusters();
+	const int nTasks = forceTasks_.numTasks();
+	useForceSchedule_();
+	#pragma omp parallel reduction(+:Up,Wvir,overlaps,Wxy,Wxz,Wyz) shared(sys)
+	{
+		const int tid = omp_get_thread_num(), nt = omp_get_num_threads();
+		float *myW = computeVirial_ ? &Wvir : NULL;
+		float3 Woff = {0.0, 0.0, 0.0};
+		float3 *myWoff = computeStress_ ? &Woff : NULL;
+		overlapState ov;
+		ov.policy = sys.overlapMode();
+		ov.softCore = sys.softCore();
+		ov.count = 0;
+		float3 *myAcc = ws_.threadAcc(tid);
+		for (int i = 0; i < natoms; ++i) {
+			myAcc[i].x = 0.0;
+			myAcc[i].y = 0.0;
+			myAcc[i].z = 0.0;
+		}
+		if (eam_ != NULL) {
+			// first pass, any thread may execute any cell pair so each accumulates densities into its own buffer
+			float *myRho = ws_.threadDensity(tid);
+			for (int i = 0; i < natoms; ++i) {
+				myRho[i] = 0.0;
+			}
+			#pragma omp for schedule(runtime)
+			for (int rank = 0; rank < nTasks; ++rank) {
+				const int task = forceTasks_.sortedTask(rank);
+				for (int p = forceTasks_.taskBegin(task); p < forceTasks_.taskEnd(task); ++p) {
+					cellPairDensity (forceTasks_.cell1(p), forceTasks_.cell2(p), cl_, sys, myRho, box, *eam_);
+				}
+			}
+			float *rho = ws_.density(), *fp = ws_.embeddingForce();
+			#pragma omp for schedule(static)
+			for (int i = 0; i < natoms; ++i) {
+				float r = 0.0;
+				for (int t = 0; t < nt; ++t) {
+					r += ws_.threadDensity(t)[i];
+				}
+				rho[i] = r;
+				Up += eam_->embed(r, fp[i]);
+			}
+		}
+
+		const double t0 = omp_get_wtime();
+		double myCost = 0.0;
+		int myTasks = 0, mySteals = 0;
+		if (clusterPairs_) {
+			#pragma omp for schedule(dynamic, 4) nowait
+			for (int ci = 0; ci < nClusters; ++ci) {
+				Up += clusters_.clusterForce(ci, myAcc, box, args, rc, invMass, myW, ov.count);
+			}
+		} else if (workStealing_) {
+			int task;
+			while ((task = forceTasks_.next(tid, mySteals)) >= 0) {
+				for (int p = forceTasks_.taskBegin(task); p < forceTasks_.taskEnd(task); ++p) {
+					if (eam_ != NULL) {
+						Up += cellPairEmbeddedForce (forceTasks_.cell1(p), forceTasks_.cell2(p), cl_, sys, myAcc, box, *eam_, ws_.embeddingForce(), invMass, myW, myWoff);
+					} else {
+						Up += cellPairForce (forceTasks_.cell1(p), forceTasks_.cell2(p), cl_, sys, myAcc, box, args, rc, invMass, q, alpha, myW, &ov, myWoff);
+					}
+				}
+				myCost += forceTasks_.cost(task);
+				myTasks++;
+			}
+		} else {
+			#pragma omp for schedule(runtime) nowait
+			for (int rank = 0; rank < nTasks; ++rank) {
+				const int task = forceTasks_.sortedTask(rank);
+				for (int p = forceTasks_.taskBegin(task); p < forceTasks_.taskEnd(task); ++p) {
+					if (eam_ != NULL) {
+						Up += cellPairEmbeddedForce (forceTasks_.cell1(p), forceTasks_.cell2(p), cl_, sys, myAcc, box, *eam_, ws_.embeddingForce(), invMass, myW, myWoff);
+					} else {
+						Up += cellPairForce (forceTasks_.cell1(p), forceTasks_.cell2(p), cl_, sys, myAcc, box, args, rc, invMass, q, alpha, myW, &ov, myWoff);
 					}
-					atom2 = cl_.list(atom2);
 				}
+				myCost += forceTasks_.cost(task);
+				myTasks++;
+			}
+		}
+		forceTasks_.record(tid, omp_get_wtime()-t0, myCost, myTasks, mySteals);
+		overlaps += ov.count;
+		Wxy += Woff.x;
+		Wxz += Woff.y;
+		Wyz += Woff.z;
+		#pragma omp barrier
+
+		// sum the per-thread accumulators and save acceleration in array of atoms in system
+		float myV2 = 0.0, myA2 = 0.0;
+		#pragma omp for schedule(static)
+		for (int i = 0; i < natoms; ++i) {
+			float3 a = ws_.threadAcc(0)[i];
+			for (int t = 1; t < nt; ++t) {
+				const float3 *acc = ws_.threadAcc(t);
+				a.x += acc[i].x;
+				a.y += acc[i].y;
+				a.z += acc[i].z;
+			}
+			sys.atoms[i].acc.x = -a.x;
+			sys.atoms[i].acc.y = -a.y;
+			sys.atoms[i].acc.z = -a.z;
+			if (adaptive_) {
+				const float3 v = sys.atoms[i].vel;
+				myV2 = std::max(myV2, v.x*v.x + v.y*v.y + v.z*v.z);
+				myA2 = std::max(myA2, a.x*a.x + a.y*a.y + a.z*a.z);
+			}
+		}
+		if (adaptive_) {
+			#pragma omp critical
+			{
+				vmax2 = std::max(vmax2, myV2);
+				amax2 = std::max(amax2, myA2);
 			}
-			atom1 = cl_.list(atom1);
 		}
 	}
+	vmax2_ = vmax2;
+	amax2_ = amax2;
 	
-	// save acceleration in array of atoms in system
-	#pragma omp parallel for
-	for (int i = 0; i < sys.numAtoms(); ++i) {
-		sys.atoms[i].acc.x = -acc[i].x;
-		sys.atoms[i].acc.y = -acc[i].y;
-		sys.atoms[i].acc.z = -acc[i].z;
+	if (ewald_ != NULL) {
+		const float Ulong = ewald_->reciprocal(sys);
+		Up += Ulong;
+		Wvir += Ulong;
 	}
-	
+
 	// set Up
 	sys.setPotE(Up);
+	if (computeVirial_) {
+		sys.setVirial(Wvir);
+	}
+	if (computeStress_) {
+		float3 Woff;
+		Woff.x = Wxy;
+		Woff.y = Wxz;
+		Woff.z = Wyz;
+		sys.setVirialOffDiagonal(Woff);
+	}
+	checkOverlaps_(sys, overlaps);
+}
+
+/*!
+ * Record the number of overlapping pairs a force calculation found, and throw if the system's policy is to abort on them.  This is the
+ * only place overlaps raise an exception, outside of any parallel region.
+ *
+ * \param [in] sys System definition
+ * \param [in] overlaps Number of overlapping pairs found
+ */
+void integrator::checkOverlaps_ (const systemDefinition &sys, const int overlaps) {
+	overlaps_ = overlaps;
+	totalOverlaps_ += overlaps;
+	if (overlaps > 0 && sys.overlapMode() == OVERLAP_ABORT) {
+		throw customException ("dr < delta");
+	}
+}
+
+/*!
+ * Keep the cell list valid for the current positions.  Without asynchronous rebuilds this is the cell list's own check.  With them, a
+ * rebuild is started on the helper thread, from a copy of the current positions, once the two largest displacements since the last
+ * build add up to more than the trigger fraction of the skin, and the force steps carry on with the current list meanwhile.  The new
+ * list is swapped in at the first step it is ready, or as soon as the current list's skin is used up (waiting for it only then).  A
+ * swapped in list is checked like any other against the positions it was built from, so if the atoms moved further than the skin
+ * while it was being built it is rebuilt at once on the calling threads: the speculation can only cost time, never correctness.
+ * The cell pair tasks and cluster pairs follow a new list on the calling threads as usual.
+ *
+ * \param [in] sys System definition
+ */
+void integrator::updateCellList_ (const systemDefinition &sys) {
+	if (asyncRebuild_ && cl_.numBuilds() > 0) {
+		if (async_.ready()) {
+			async_.take(cl_);
+			forceTasks_.invalidate();
+			clusters_.invalidate();
+		}
+		const float disp = cl_.measureDisplacement(sys);
+		if (disp > cl_.skin()) {
+			// the current list is exhausted, only the one being built can save a synchronous rebuild
+			if (async_.busy()) {
+				async_.take(cl_);
+				forceTasks_.invalidate();
+				clusters_.invalidate();
+			}
+		} else if (disp > asyncTrigger_*cl_.skin() && !async_.busy()) {
+			async_.start(cl_, sys);
+		}
+	}
+	cl_.checkUpdate(sys);
+}
+
+/*!
+ * Change the box after every coordinate was scaled with it.  The cell list is rescaled in place, and only recreated if the number of
+ * cells must change.
+ *
+ * \param [in, out] sys System definition
+ * \param [in] box New box size
+ */
+void integrator::rescaleBox_ (systemDefinition &sys, const float3 &box) {
+	if (asyncRebuild_) {
+		throw customException ("Asynchronous cell list rebuilds cannot be combined with a changing box");
+		return;
+	}
+	sys.setBox(box.x, box.y, box.z);
+	if (!cl_.rescale(box)) {
+		resetCellList(sys);
+		gridResets_++;
+	}
+}
+
+/*!
+ * Let the timestep vary between dtMin and dtMax.  At the end of every step the largest displacement any atom would make in the next
+ * step is predicted from the largest speed and acceleration, and the conserved energy is compared with its value at the last cell
+ * list rebuild.  The timestep only changes when the cell list was rebuilt (so it is constant over every stretch of steps sharing a
+ * list), except that it is halved at once if an atom would move further than maxDisp, e.g. in a close contact.
+ *
+ * \param [in] dtMin Smallest timestep
+ * \param [in] dtMax Largest timestep
+ * \param [in] maxDisp Largest distance any atom may move in one step
+ * \param [in] energyTol Largest excursion of the conserved energy per atom allowed between rebuilds
+ */
+void integrator::setAdaptiveTimestep (const float dtMin, const float dtMax, const float maxDisp, const float energyTol) {
+	if (dtMin <= 0.0 || dtMax < dtMin) {
+		throw customException ("Adaptive timestep bounds must satisfy 0 < dtMin <= dtMax");
+		return;
+	}
+	if (maxDisp <= 0.0 || energyTol <= 0.0) {
+		throw customException ("Adaptive timestep displacement and energy tolerances must be > 0");
+		return;
+	}
+	adaptive_ = true;
+	dtMin_ = dtMin;
+	dtMax_ = dtMax;
+	maxDisp_ = maxDisp;
+	energyTol_ = energyTol;
+	dt_ = std::min(std::max(dt_, dtMin_), dtMax_);
+	haveRef_ = false;
+}
+
+/*!
+ * Reconsider the timestep at the end of a step (see setAdaptiveTimestep()).  Integration error in the conserved energy grows as dt^2,
+ * so at a rebuild the timestep is scaled by sqrt(tolerance/error), limited to between 0.5 and 1.25 and to not predict a displacement
+ * beyond maxDisp.
+ *
+ * \param [in] sys System definition
+ */
+void integrator::adaptTimestep_ (const systemDefinition &sys) {
+	if (!adaptive_) return;
+	const float H = conservedEnergy(sys);
+	const float disp = sqrt(vmax2_)*dt_ + 0.5*sqrt(amax2_)*dt_*dt_;
+	if (!haveRef_) {
+		Href_ = H;
+		errMax_ = 0.0;
+		lastBuild_ = cl_.numBuilds();
+		haveRef_ = true;
+	}
+	errMax_ = std::max(errMax_, (float) fabs(H-Href_)/sys.numAtoms());
+
+	float newDt = dt_;
+	if (disp > maxDisp_) {
+		newDt = 0.5*dt_;
+	} else if (cl_.numBuilds() != lastBuild_) {
+		float factor = (errMax_ > 0.0) ? 0.9*sqrt(energyTol_/errMax_) : 1.25;
+		factor = std::min(std::max(factor, (float) 0.5), (float) 1.25);
+		if (fabs(factor-1.0) < 0.05) {
+			factor = 1.0;
+		}
+		if (factor > 1.0 && disp*factor > maxDisp_) {
+			factor = std::max((float) 1.0, maxDisp_/disp);
+		}
+		newDt = dt_*factor;
+	} else {
+		return;
+	}
+
+	newDt = std::min(std::max(newDt, dtMin_), dtMax_);
+	if (newDt != dt_) {
+		dt_ = newDt;
+		dtChanges_++;
+	}
+	Href_ = H;
+	errMax_ = 0.0;
+	lastBuild_ = cl_.numBuilds();
 }
 
 #endif
@@ -61,12 +61,12 @@ __device__ float dev_pbcDist2 (const float3 *p1, const float3 *p2, float3 *dr, c
 /*!
  * An arbitrary potential that could be changed to meet the user's needs in the future.
  */
-__device__ float dev_pairUF (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut) {
+__device__ float dev_pairUF (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut, overlapState *ov) {
         return 0.0;
 }
 
 /*!
- * Pairwise interaction between 2 atoms (shifted lennard-jones)
+ * Pairwise interaction between 2 atoms (shifted lennard-jones), treating overlaps exactly as slj does
  *
  * \param [in] p1 Pointer to atom 1's position
  * \param [in] p2 Pointer to atom 2's position
@@ -74,20 +74,40 @@ __device__ float dev_pairUF (const float3 *p1, const float3 *p2, float3 *pairFor
  * \param [in] box Pointer to box dimensions
  * \param [in] args Additional arguments, in this case {epsilon, sigma, delta, ushift}
  * \param [in] rcut Cutoff distance; NOTE: this MUST already incorporate the delta shift, ie. if r < ((rc' + delta) = rc), then force is computed
+ * \param [in, out] ov Overlap policy and this thread's overlap counter
 */
-__device__ float dev_slj (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut) {
+__device__ float dev_slj (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut, overlapState *ov) {
     float3 dr;
 	float r2 = dev_pbcDist2(p1, p2, &dr, box);
 
-	// check that r > delta and throw/catch
+	// check that r > delta
 	if (r2 <= args[2]*args[2]) {
-		// shift to just past the singularity and allow to run
-		r2 = 1.0001*args[2]*args[2];
+		ov->count++;
+		if (ov->policy == OVERLAP_ABORT) {
+			pairForce->x = 0.0;
+			pairForce->y = 0.0;
+			pairForce->z = 0.0;
+			return 0.0;
+		} else if (ov->policy == OVERLAP_CLAMP) {
+			// shift to just past the singularity (but not so close the energy overflows) and allow to run
+			r2 = (args[2]+0.01*args[1])*(args[2]+0.01*args[1]);
+		}
 	}
 	
 	if (r2 < (*rcut)*(*rcut)) {
 		float r = sqrt(r2);
         float x = r - args[2];
+		if (ov->policy == OVERLAP_SOFTCORE && x < ov->softCore*args[1]) {
+			// inside the soft core the force keeps the magnitude it has at x = xs
+			const float xs = ov->softCore*args[1];
+			const float b = 1.0/xs, a = args[1]*b, a2 = a*a, a6 = a2*a2*a2;
+			const float fs = 24.0*args[0]*a6*(2.0*a6-1.0)*b;
+			const float factor = (r > 0.0) ? fs/r : 0.0;
+			pairForce->x = -factor*dr.x;
+			pairForce->y = -factor*dr.y;
+			pairForce->z = -factor*dr.z;
+			return 4.0*args[0]*(a6*a6-a6)+args[3] + fs*(xs-x);
+		}
 		float b = 1.0/x, a = args[1]*b, a2 = a*a, a6 = a2*a2*a2, factor;
 		factor = 24.0*args[0]*a6*(2.0*a6-1.0)*b/r;
 		pairForce->x = -factor*dr.x;
@@ -115,8 +135,10 @@ __device__ float dev_slj (const float3 *p1, const float3 *p2, float3 *pairForce,
  * \param [in] args Pair potential arguments
  * \param [in] rcut Cutoff distance for potential
  * \param [in] pFlag Flags which potential function to use
+ * \param [in] overlap Overlap policy (its count is ignored)
+ * \param [out] overlaps_each Number of overlapping neighbors of each atom, the total is this summed divided by 2
  */
-__global__ void loopOverNeighbors (atom* dev_atoms, int* nlist, int* nlist_index, float3* force, float3* box, float* Up_each, int* natoms, float* args, float* rcut, int* pFlag) {
+__global__ void loopOverNeighbors (atom* dev_atoms, int* nlist, int* nlist_index, float3* force, float3* box, float* Up_each, int* natoms, float* args, float* rcut, int* pFlag, overlapState* overlap, int* overlaps_each) {
 	const int tid = threadIdx.x + blockIdx.x*blockDim.x;
 	
 	if (tid < *natoms) {
@@ -131,6 +153,9 @@ __global__ void loopOverNeighbors (atom* dev_atoms, int* nlist, int* nlist_index
 			pFunc = dev_pairUF;
 		}
 
+		overlapState ov = *overlap;
+		ov.count = 0;
+
 		float3 myforce;
 		myforce.x = 0;
 		myforce.y = 0;
@@ -140,7 +165,7 @@ __global__ void loopOverNeighbors (atom* dev_atoms, int* nlist, int* nlist_index
 		for (unsigned int i = start+1; i < start+1+nlist[start]; ++i) {
 			// compute potential between dev_atoms[nlist[i]] and dev_atoms[tid]
 			float3 dummyForce;
-			Up += pFunc (&dev_atoms[nlist[i]].pos, &dev_atoms[tid].pos, &dummyForce, box, args, rcut);
+			Up += pFunc (&dev_atoms[nlist[i]].pos, &dev_atoms[tid].pos, &dummyForce, box, args, rcut, &ov);
 
 			myforce.x += dummyForce.x;
 			myforce.y += dummyForce.y;
@@ -152,6 +177,7 @@ __global__ void loopOverNeighbors (atom* dev_atoms, int* nlist, int* nlist_index
 		force[tid].y = -myforce.y;
 		force[tid].z = -myforce.z;
 		Up_each[tid] = Up;
+		overlaps_each[tid] = ov.count;
 	}	
 }
 
@@ -162,6 +188,24 @@ __global__ void loopOverNeighbors (atom* dev_atoms, int* nlist, int* nlist_index
  * \param [in, out] sys System definition
  */
 void integrator::calcForce (systemDefinition &sys) {
+	if (ewald_ != NULL) {
+		throw customException ("Electrostatics are only supported on the CPU");
+	}
+	if (eam_ != NULL) {
+		throw customException ("The embedded-atom potential is only supported on the CPU");
+	}
+	if (computeVirial_) {
+		throw customException ("The virial (and so NPT integration) is only supported on the CPU");
+	}
+	if (computeStress_) {
+		throw customException ("The stress is only supported on the CPU");
+	}
+	if (clusterPairs_ || clusters_.dualList()) {
+		throw customException ("Cluster pairs are only supported on the CPU");
+	}
+	if (asyncRebuild_) {
+		throw customException ("Asynchronous cell list rebuilds are only supported on the CPU");
+	}
 	float Up = 0.0;
 	const float invMass = 1.0/sys.mass();
 
@@ -209,23 +253,35 @@ void integrator::calcForce (systemDefinition &sys) {
 	float* dev_Up_each_atom_ptr = thrust::raw_pointer_cast(&dev_Up_each_atom[0]);
 	
 	// potential arguments
-	std::vector < float > potArgs = sys.potentialArgs();
+	const std::vector < float > &potArgs = sys.potentialArgs();
 	std::vector < float > rcut (1, sys.rcut());
 	thrust::device_vector < float > dev_args (potArgs.begin(), potArgs.end());
 	float* dev_args_ptr = thrust::raw_pointer_cast(&dev_args[0]);
 	thrust::device_vector < float > dev_rcut (rcut.begin(), rcut.end());
 	float* dev_rcut_ptr = thrust::raw_pointer_cast(&dev_rcut[0]);
 
+	// overlap policy, and a count of overlapping neighbors to store results in
+	std::vector < overlapState > overlap (1);
+	overlap[0].policy = sys.overlapMode();
+	overlap[0].softCore = sys.softCore();
+	overlap[0].count = 0;
+	thrust::device_vector < overlapState > dev_overlap (overlap.begin(), overlap.end());
+	overlapState* dev_overlap_ptr = thrust::raw_pointer_cast(&dev_overlap[0]);
+	thrust::device_vector < int > dev_overlaps_each_atom (sys.numAtoms());
+	int* dev_overlaps_each_atom_ptr = thrust::raw_pointer_cast(&dev_overlaps_each_atom[0]);
+
 	// invoke kernel to compute
-	loopOverNeighbors <<< sys.cudaBlocks, sys.cudaThreads >>> (dev_atoms_ptr, dev_neighbor_list_ptr, dev_neighbor_index_ptr, dev_force_ptr, dev_sysbox_ptr, dev_Up_each_atom_ptr, dev_natoms_ptr, dev_args_ptr, dev_rcut_ptr, dev_pFlag_ptr);
+	loopOverNeighbors <<< sys.cudaBlocks, sys.cudaThreads >>> (dev_atoms_ptr, dev_neighbor_list_ptr, dev_neighbor_index_ptr, dev_force_ptr, dev_sysbox_ptr, dev_Up_each_atom_ptr, dev_natoms_ptr, dev_args_ptr, dev_rcut_ptr, dev_pFlag_ptr, dev_overlap_ptr, dev_overlaps_each_atom_ptr);
 	
 	// call a reduction to collect Up then divide by 2 since double counted
 	Up = thrust::reduce(dev_Up_each_atom.begin(), dev_Up_each_atom.end(), (float) 0.0, thrust::plus<float>());
 	Up /= 2.0;	// pairs are double counted
+	const int overlaps = thrust::reduce(dev_overlaps_each_atom.begin(), dev_overlaps_each_atom.end(), 0, thrust::plus<int>())/2;
 	
 	// store accelerations on atoms	
-	std::vector < float3 > netForces (sys.numAtoms());
-	thrust::copy(dev_force.begin(), dev_force.end(), netForces.begin());
+	ws_.reserve(1, sys.numAtoms());
+	float3 *netForces = ws_.hostForce();
+	thrust::copy(dev_force.begin(), dev_force.end(), netForces);
 
 	#pragma omp parallel for schedule(dynamic,OMP_CHUNK)
 	for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
@@ -236,4 +292,48 @@ void integrator::calcForce (systemDefinition &sys) {
 
 	// set Up
 	sys.setPotE(Up);
+	checkOverlaps_(sys, overlaps);
+}
+
+/*!
+ * Change the box after every coordinate was scaled with it.  Neighbor lists are rescaled in place.
+ *
+ * \param [in, out] sys System definition
+ * \param [in] box New box size
+ */
+void integrator::rescaleBox_ (systemDefinition &sys, const float3 &box) {
+	sys.setBox(box.x, box.y, box.z);
+	if (!cl_.rescale(box)) {
+		resetCellList(sys);
+		gridResets_++;
+	}
+}
+
+/*!
+ * Record the number of overlapping pairs a force calculation found, and throw if the system's policy is to abort on them.
+ *
+ * \param [in] sys System definition
+ * \param [in] overlaps Number of overlapping pairs found
+ */
+void integrator::checkOverlaps_ (const systemDefinition &sys, const int overlaps) {
+	overlaps_ = overlaps;
+	totalOverlaps_ += overlaps;
+	if (overlaps > 0 && sys.overlapMode() == OVERLAP_ABORT) {
+		throw customException ("dr < delta");
+	}
+}
+
+/*!
+ * Adaptive timesteps need the largest speed and acceleration from the force calculation, which the GPU does not report.
+ */
+void integrator::setAdaptiveTimestep (const float dtMin, const float dtMax, const float maxDisp, const float energyTol) {
+	throw customException ("Adaptive timesteps are only supported on the CPU");
+}
+
+/*!
+ * Never enabled on the GPU.
+ *
+ * \param [in] sys System definition
+ */
+void integrator::adaptTimestep_ (const systemDefinition &sys) {
 }
@@ -9,20 +9,106 @@
 
 #include "system.h"
 #include "cellList.h"
+#include "pairScheduler.h"
+#include "clusterPairs.h"
+#include "asyncRebuild.h"
+#include "workspace.h"
+#include "ewald.h"
+#include "eam.h"
+#include "common.h"
 #include <vector>
+#include <omp.h>
 
 //! Base class for integrators such as NVT (Nose-Hoover) or NVE ensembles
 class integrator {
 	public:
+		integrator () {start_ = 1; dt_ = 0.005; cellScale_ = 1.01; cellSubdiv_ = 1; sweepKind_ = omp_sched_dynamic; sweepChunk_ = OMP_CHUNK; forceKind_ = omp_sched_dynamic; forceChunk_ = 1; incrementalCells_ = false; packedPositions_ = false; workStealing_ = true; clusterPairs_ = false; asyncRebuild_ = false; asyncTrigger_ = 0.5; ewald_ = NULL; eam_ = NULL; computeVirial_ = false; computeStress_ = false; gridResets_ = 0; adaptive_ = false; dtMin_ = 0.0; dtMax_ = 0.0; maxDisp_ = 0.0; energyTol_ = 0.0; vmax2_ = 0.0; amax2_ = 0.0; haveRef_ = false; Href_ = 0.0; errMax_ = 0.0; lastBuild_ = 0; dtChanges_ = 0; overlaps_ = 0; totalOverlaps_ = 0;}
+		virtual ~integrator () {}
 		void setTimestep (const float dt) {dt_ = dt;}   //!< Set the integrator timestep
+		float timestep () const {return dt_;}           //!< Report the integrator timestep
+		void setAdaptiveTimestep (const float dtMin, const float dtMax, const float maxDisp=0.03, const float energyTol=1.0e-4);  //!< Let the timestep vary within [dtMin, dtMax], see adaptTimestep_()
+		void setFixedTimestep () {adaptive_ = false;}   //!< Stop adapting the timestep
+		int timestepChanges () const {return dtChanges_;}   //!< Report how many times the adaptive timestep was changed
+		virtual float conservedEnergy (const systemDefinition &sys) const {return sys.KinE() + sys.PotE();}   //!< Report the quantity the integrator conserves (the total energy unless a thermostat or barostat adds to it)
         void calcForce (systemDefinition &sys); //!< Calculate the forces on each atom
 		virtual void step (systemDefinition &sys) = 0; //!< Move the system forward a step in time
+		void resetCellList (const systemDefinition &sys) {cellList_cpu tmpCL (sys.box(), sys.rcut(), sys.rskin(), cellScale_, cellSubdiv_); tmpCL.setIncremental(incrementalCells_); tmpCL.setPackedPositions(packedPositions_); async_.cancel(); cl_ = tmpCL; forceTasks_.invalidate(); clusters_.invalidate();}  //!< (Re)create the cell list from the system's current box, cutoff and skin radius
+		void setCellScale (const float scale) {cellScale_ = scale;} //!< Set the minimum cell width in units of (rc+rs), takes effect at the next resetCellList()
+		float cellScale () const {return cellScale_;}               //!< Report the minimum cell width in units of (rc+rs)
+		void setCellSubdivisions (const int k) {cellSubdiv_ = k;}   //!< Use cells of width cellScale*(rc+rs)/k with a pruned stencil, takes effect at the next resetCellList()
+		int cellSubdivisions () const {return cellSubdiv_;}         //!< Report the number of cells spanning rc+rs in each direction
+		void setIncrementalCells (const bool inc) {incrementalCells_ = inc; async_.cancel(); cl_.setIncremental(inc);}  //!< If true, cell list rebuilds only move atoms which changed cells
+		void setPackedPositions (const bool pack) {packedPositions_ = pack; async_.cancel(); cl_.setPackedPositions(pack);}    //!< If true, the force loop reads positions from a copy stored contiguously by cell
+		void setSweepSchedule (const omp_sched_t kind, const int chunk) {sweepKind_ = kind; sweepChunk_ = chunk;}  //!< Set the OMP schedule used by the per-atom integration sweeps
+		void setForceSchedule (const omp_sched_t kind, const int chunk) {forceKind_ = kind; forceChunk_ = chunk;}  //!< Set the OMP schedule used by the loop over cell pairs in calcForce when work stealing is off
+		void sweepSchedule (omp_sched_t &kind, int &chunk) const {kind = sweepKind_; chunk = sweepChunk_;}      //!< Report the OMP schedule used by the per-atom integration sweeps
+		void forceSchedule (omp_sched_t &kind, int &chunk) const {kind = forceKind_; chunk = forceChunk_;}      //!< Report the OMP schedule used by the loop over cell pairs when work stealing is off
+		void setWorkStealing (const bool steal) {workStealing_ = steal;}   //!< If true (default), cell pair tasks are executed by the work stealing scheduler rather than an OMP loop
+		bool workStealing () const {return workStealing_;}                  //!< Report if cell pair tasks are executed by the work stealing scheduler
+		void setClusterPairs (const bool clusters) {clusterPairs_ = clusters;}  //!< If true, calcForce evaluates slj over pairs of clusters of atoms instead of pairs of cells (see clusterPairList)
+		bool clusterPairs () const {return clusterPairs_;}                  //!< Report if the force loop runs over pairs of clusters
+		void setDualPairList (const float innerBuffer) {clusters_.setDualList(innerBuffer);}   //!< With cluster pairs, run the force loop over an inner list pruned to rc+innerBuffer from the rc+rs list, or over the whole list if innerBuffer <= 0
+		const clusterPairList& clusters () const {return clusters_;}        //!< Report the clusters and cluster pairs of the last force calculation
+		void setAsyncRebuild (const bool async, const float trigger=0.5) {asyncRebuild_ = async; asyncTrigger_ = trigger; if (!async) async_.cancel();}   //!< If true, start rebuilding the cell list on a helper thread once the atoms have used up this fraction of the skin (see updateCellList_())
+		bool asyncRebuild () const {return asyncRebuild_;}                  //!< Report if the cell list is rebuilt on a helper thread
+		const asyncCellList& asyncRebuilds () const {return async_;}        //!< Report the statistics of the helper thread's rebuilds
+		const cellPairScheduler& forceTasks () const {return forceTasks_;}  //!< Report the cell pair tasks and the per-thread load statistics of the force loop
+		void resetLoadStats () {forceTasks_.resetStats();}                  //!< Clear the per-thread load statistics of the force loop
+		const cellList_cpu& cellList () const {return cl_;}        //!< Report the cell or neighbor list (e.g. to read its build statistics)
+		const workspace& scratch () const {return ws_;}            //!< Report the scratch buffers reused across steps
+		void setComputeStress (const bool stress) {computeStress_ = stress;}   //!< If true, calcForce also computes the off-diagonal virial (see systemDefinition::virialOffDiagonal())
+		int cellGridResets () const {return gridResets_;}          //!< Report how many times a change of box forced the cell list to be recreated
+		void setElectrostatics (ewaldSolver *ewald) {ewald_ = ewald;}  //!< Add Coulomb interactions between the system's charges using this solver (not owned), or NULL to remove them
+		void setEmbeddedAtom (eamPotential *eam) {eam_ = eam;}         //!< Use this embedded-atom potential (not owned) instead of the system's pair potential, or NULL to go back to the pair potential
+		int overlaps () const {return overlaps_;}              //!< Report how many overlapping pairs the last force calculation found
+		long int totalOverlaps () const {return totalOverlaps_;} //!< Report how many overlapping pairs all force calculations have found
     
     protected:
 		cellList_cpu cl_;   //!< Cell or neighbor list
 		std::vector <float3> lastAccelerations_;    //!< Acceleration of particles on previous timestep (useful for NVE integrator)
 		float dt_;      //!< Timestep size
 		int start_;     //!< Flag for whether this object has been initialized or not
+		float cellScale_;       //!< Minimum cell width in units of (rc+rs)
+		int cellSubdiv_;        //!< Number of cells spanning rc+rs in each direction
+		bool incrementalCells_; //!< Flag for whether cell list rebuilds are incremental
+		bool packedPositions_;  //!< Flag for whether the cell list keeps a packed copy of the positions
+		bool workStealing_;     //!< Flag for whether the force loop uses the work stealing scheduler
+		cellPairScheduler forceTasks_;  //!< Cell pair tasks for the force loop
+		bool clusterPairs_;     //!< Flag for whether the force loop runs over pairs of clusters
+		clusterPairList clusters_;      //!< Clusters of atoms and the pairs of them within rc+rs, if the force loop uses them
+		bool asyncRebuild_;     //!< Flag for whether the cell list is rebuilt on a helper thread
+		float asyncTrigger_;    //!< Fraction of the skin the atoms may use up before a rebuild is started on the helper thread
+		asyncCellList async_;   //!< Helper thread rebuilding the cell list
+		void updateCellList_ (const systemDefinition &sys);  //!< Swap in or start a rebuild on the helper thread as needed, then check the cell list
+		ewaldSolver *ewald_;    //!< Long-range electrostatics solver, if any
+		eamPotential *eam_;     //!< Embedded-atom potential replacing the pair potential, if any
+		bool computeVirial_;    //!< Flag for whether calcForce also computes the virial
+		bool computeStress_;    //!< Flag for whether calcForce also computes the off-diagonal virial
+		int gridResets_;        //!< Number of times the cell list was recreated for a new box
+		void rescaleBox_ (systemDefinition &sys, const float3 &box);  //!< Change the box after the coordinates were scaled with it, rescaling the cell list in place when possible
+		bool adaptive_;         //!< Flag for whether the timestep is adapted
+		float dtMin_;           //!< Smallest adaptive timestep
+		float dtMax_;           //!< Largest adaptive timestep
+		float maxDisp_;         //!< Largest displacement of any atom allowed in one step
+		float energyTol_;       //!< Largest excursion of the conserved energy per atom allowed between cell list rebuilds
+		float vmax2_;           //!< Largest squared speed of any atom, found by calcForce when adapting the timestep
+		float amax2_;           //!< Largest squared acceleration of any atom, found by calcForce when adapting the timestep
+		bool haveRef_;          //!< Flag for whether Href_ has been recorded
+		float Href_;            //!< Conserved energy when the timestep last changed or the cell list was last rebuilt
+		float errMax_;          //!< Largest excursion of the conserved energy per atom from Href_
+		int lastBuild_;         //!< Value of the cell list's build counter when the timestep was last reconsidered
+		int dtChanges_;         //!< Number of times the timestep was changed
+		int overlaps_;          //!< Number of overlapping pairs found by the last force calculation
+		long int totalOverlaps_;    //!< Number of overlapping pairs found by all force calculations
+		void checkOverlaps_ (const systemDefinition &sys, const int overlaps);   //!< Record the overlaps found by a force calculation and act on them
+		void adaptTimestep_ (const systemDefinition &sys);    //!< Grow or shrink the timestep at the end of a step
+		workspace ws_;          //!< Scratch buffers reused across steps (e.g. per-thread acceleration accumulators so any thread may execute any cell pair)
+		omp_sched_t sweepKind_; //!< OMP schedule kind for per-atom sweeps
+		int sweepChunk_;        //!< OMP chunk size for per-atom sweeps
+		omp_sched_t forceKind_; //!< OMP schedule kind for the loop over cell pairs
+		int forceChunk_;        //!< OMP chunk size for the loop over cell pairs
+		void useSweepSchedule_ () const {omp_set_schedule(sweepKind_, sweepChunk_);}   //!< Make the sweep schedule the one used by schedule(runtime) loops
+		void useForceSchedule_ () const {omp_set_schedule(forceKind_, forceChunk_);}   //!< Make the force schedule the one used by schedule(runtime) loops
 };
 
 
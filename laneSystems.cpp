@@ -0,0 +1,300 @@
+/*!
+ * Many small systems advanced together, one per SIMD lane
+ * \date 10/19/26
+ */
+
+#include "laneSystems.h"
+#include "potential.h"
+#include "common.h"
+#include <algorithm>
+#include <math.h>
+#include <omp.h>
+
+/*!
+ * Pack the systems into lanes.  Every system must have the same number of atoms, box, mass, cutoff and slj parameters; each keeps its own
+ * target temperature.
+ *
+ * \param [in] systems Systems to advance, which are copied and not modified (see unpack())
+ * \param [in] Q Thermostat mass as for nvt_NH, or not positive to conserve energy as nve does
+ */
+laneSystems::laneSystems (const std::vector <systemDefinition*> &systems, const float Q) {
+	if (systems.empty()) {
+		throw customException ("At least one system is needed");
+		return;
+	}
+	const systemDefinition &s0 = *systems[0];
+	N_ = s0.numAtoms();
+	W_ = systems.size();
+	P_ = ((W_ + LANE_BLOCK - 1)/LANE_BLOCK)*LANE_BLOCK;
+	box_ = s0.box();
+	mass_ = s0.mass();
+	rc_ = s0.rcut();
+	Q_ = Q;
+	dt_ = 0.005;
+	start_ = true;
+	if (N_ < 2 || s0.potentialArgs().size() < 4) {
+		throw customException ("Systems packed into lanes need at least 2 atoms and the slj parameters");
+		return;
+	}
+	if (2.0*rc_ > std::min(box_.x, std::min(box_.y, box_.z))) {
+		throw customException ("Systems packed into lanes need a box at least twice the cutoff, since forces use the minimum image");
+		return;
+	}
+	for (int k = 0; k < 4; ++k) {
+		args_[k] = s0.potentialArgs()[k];
+	}
+	for (int w = 0; w < W_; ++w) {
+		const systemDefinition &s = *systems[w];
+		const float3 b = s.box();
+		bool same = (s.numAtoms() == N_ && b.x == box_.x && b.y == box_.y && b.z == box_.z && s.mass() == mass_ && s.rcut() == rc_ && s.potentialArgs().size() >= 4);
+		for (int k = 0; same && k < 4; ++k) {
+			same = (s.potentialArgs()[k] == args_[k]);
+		}
+		if (!same) {
+			throw customException ("Systems packed into lanes must have the same number of atoms, box, mass, cutoff and potential parameters");
+			return;
+		}
+		#ifndef NVCC
+		if (s.potential != slj) {
+			throw customException ("Systems packed into lanes must use the slj pair potential");
+			return;
+		}
+		#endif
+		if (s.overlapMode() != OVERLAP_ABORT) {
+			throw customException ("Systems packed into lanes only support the OVERLAP_ABORT policy");
+			return;
+		}
+		if (Q_ > 0.0 && s.targetT() <= 0.0) {
+			throw customException ("Thermostatted systems need a positive target temperature");
+			return;
+		}
+	}
+
+	std::vector <float> *arrays[9] = {&x_, &y_, &z_, &vx_, &vy_, &vz_, &ax_, &ay_, &az_};
+	for (int k = 0; k < 9; ++k) {
+		arrays[k]->assign(N_*P_, 0.0);
+	}
+	targetT_.resize(P_);
+	instantT_.assign(P_, 0.0);
+	KinE_.assign(P_, 0.0);
+	PotE_.assign(P_, 0.0);
+	gammadot_.assign(P_, 0.0);
+	scale_.assign(P_, 1.0);
+	overlaps_.assign(P_, 0);
+	for (int l = 0; l < P_; ++l) {
+		// padding lanes repeat the first system, so they do the same (discarded) work without any special cases
+		const systemDefinition &s = *systems[(l < W_) ? l : 0];
+		targetT_[l] = s.targetT();
+		for (int i = 0; i < N_; ++i) {
+			const int idx = i*P_ + l;
+			x_[idx] = s.atoms[i].pos.x;
+			y_[idx] = s.atoms[i].pos.y;
+			z_[idx] = s.atoms[i].pos.z;
+			vx_[idx] = s.atoms[i].vel.x;
+			vy_[idx] = s.atoms[i].vel.y;
+			vz_[idx] = s.atoms[i].vel.z;
+		}
+	}
+}
+
+/*!
+ * Compute the acceleration of every atom and the potential energy of every lane, summing the shifted Lennard-Jones interaction over all
+ * pairs within the cutoff.  The innermost loop runs over a block of lanes, with the cutoff and overlap tests as selects rather than branches.
+ */
+void laneSystems::calcForce () {
+	const int nBlocks = P_/LANE_BLOCK, N = N_, P = P_;
+	const float Lx = box_.x, Ly = box_.y, Lz = box_.z, invLx = 1.0/Lx, invLy = 1.0/Ly, invLz = 1.0/Lz;
+	const float rc2 = rc_*rc_, eps = args_[0], sigma = args_[1], delta = args_[2], ushift = args_[3], d2 = delta*delta;
+	const float invMass = 1.0/mass_;
+
+	#pragma omp parallel for schedule(static)
+	for (int blk = 0; blk < nBlocks; ++blk) {
+		const int o = blk*LANE_BLOCK;
+		float U[LANE_BLOCK];
+		int ov[LANE_BLOCK];
+		for (int l = 0; l < LANE_BLOCK; ++l) {
+			U[l] = 0.0;
+			ov[l] = 0;
+		}
+		for (int i = 0; i < N; ++i) {
+			float *ax = &ax_[i*P+o], *ay = &ay_[i*P+o], *az = &az_[i*P+o];
+			for (int l = 0; l < LANE_BLOCK; ++l) {
+				ax[l] = 0.0;
+				ay[l] = 0.0;
+				az[l] = 0.0;
+			}
+		}
+
+		for (int i = 0; i < N; ++i) {
+			const float *xi = &x_[i*P+o], *yi = &y_[i*P+o], *zi = &z_[i*P+o];
+			float fx[LANE_BLOCK], fy[LANE_BLOCK], fz[LANE_BLOCK];
+			for (int l = 0; l < LANE_BLOCK; ++l) {
+				fx[l] = 0.0;
+				fy[l] = 0.0;
+				fz[l] = 0.0;
+			}
+			for (int j = i+1; j < N; ++j) {
+				const float *xj = &x_[j*P+o], *yj = &y_[j*P+o], *zj = &z_[j*P+o];
+				float *axj = &ax_[j*P+o], *ayj = &ay_[j*P+o], *azj = &az_[j*P+o];
+				for (int l = 0; l < LANE_BLOCK; ++l) {
+					// minimum image of dr = r_j - r_i
+					float dx = xj[l] - xi[l], dy = yj[l] - yi[l], dz = zj[l] - zi[l];
+					dx -= Lx*floor(dx*invLx + 0.5f);
+					dy -= Ly*floor(dy*invLy + 0.5f);
+					dz -= Lz*floor(dz*invLz + 0.5f);
+					const float r2 = dx*dx + dy*dy + dz*dz;
+					const bool in = (r2 < rc2 && r2 > d2);
+					ov[l] += (r2 <= d2) ? 1 : 0;
+					const float r = in ? sqrt(r2) : 1.0f;
+					const float b = in ? 1.0f/(r - delta) : 1.0f, a = sigma*b, a2 = a*a, a6 = a2*a2*a2;
+					const float factor = in ? 24.0f*eps*a6*(2.0f*a6 - 1.0f)*b/r : 0.0f;
+					U[l] += in ? 4.0f*eps*(a6*a6 - a6) + ushift : 0.0f;
+					fx[l] -= factor*dx;
+					fy[l] -= factor*dy;
+					fz[l] -= factor*dz;
+					axj[l] += factor*dx;
+					ayj[l] += factor*dy;
+					azj[l] += factor*dz;
+				}
+			}
+			float *ax = &ax_[i*P+o], *ay = &ay_[i*P+o], *az = &az_[i*P+o];
+			for (int l = 0; l < LANE_BLOCK; ++l) {
+				ax[l] = (ax[l] + fx[l])*invMass;
+				ay[l] = (ay[l] + fy[l])*invMass;
+				az[l] = (az[l] + fz[l])*invMass;
+			}
+		}
+		for (int l = 0; l < LANE_BLOCK; ++l) {
+			PotE_[o+l] = U[l];
+			overlaps_[o+l] = ov[l];
+		}
+	}
+
+	for (int l = 0; l < W_; ++l) {
+		if (overlaps_[l] > 0) {
+			throw customException ("dr < delta");
+			return;
+		}
+	}
+}
+
+/*!
+ * Kinetic energy m sum v^2/2 and temperature of every lane, with 3(N-1) degrees of freedom as the integrators use.
+ */
+void laneSystems::kinetic_ () {
+	const int nBlocks = P_/LANE_BLOCK;
+	#pragma omp parallel for schedule(static)
+	for (int blk = 0; blk < nBlocks; ++blk) {
+		const int o = blk*LANE_BLOCK;
+		float Uk[LANE_BLOCK];
+		for (int l = 0; l < LANE_BLOCK; ++l) {
+			Uk[l] = 0.0;
+		}
+		for (int i = 0; i < N_; ++i) {
+			const float *vx = &vx_[i*P_+o], *vy = &vy_[i*P_+o], *vz = &vz_[i*P_+o];
+			for (int l = 0; l < LANE_BLOCK; ++l) {
+				Uk[l] += vx[l]*vx[l] + vy[l]*vy[l] + vz[l]*vz[l];
+			}
+		}
+		for (int l = 0; l < LANE_BLOCK; ++l) {
+			Uk[l] *= mass_;
+			instantT_[o+l] = Uk[l]/(3.0*(N_-1.0));
+			KinE_[o+l] = 0.5*Uk[l];
+		}
+	}
+}
+
+/*!
+ * Half step of every lane's thermostat velocity, as nvt_NH does before and after each step.
+ */
+void laneSystems::thermostat_ () {
+	if (Q_ <= 0.0) {
+		return;
+	}
+	for (int l = 0; l < P_; ++l) {
+		const float tau2 = Q_/((3.0*(N_-1.0))*targetT_[l]);
+		const float gammadd = 1/tau2*(instantT_[l]/targetT_[l]-1);
+		gammadot_[l] += dt_*0.5*gammadd;
+	}
+}
+
+/*!
+ * Advance every system a step with velocity Verlet, scaling velocities by each lane's Nose-Hoover thermostat when there is one.
+ * The first call computes the initial forces and temperatures.
+ */
+void laneSystems::step () {
+	if (start_) {
+		calcForce();
+		kinetic_();
+		for (int l = 0; l < P_; ++l) {
+			gammadot_[l] = 0.0;
+		}
+		start_ = false;
+	}
+	thermostat_();
+
+	for (int l = 0; l < P_; ++l) {
+		scale_[l] = exp(-gammadot_[l]*dt_*0.5);
+	}
+	const float *s = &scale_[0];
+	const float hdt = 0.5*dt_, dt = dt_;
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < N_; ++i) {
+		const int base = i*P_;
+		for (int l = 0; l < P_; ++l) {
+			const int idx = base + l;
+			vx_[idx] = vx_[idx]*s[l] + hdt*ax_[idx];
+			vy_[idx] = vy_[idx]*s[l] + hdt*ay_[idx];
+			vz_[idx] = vz_[idx]*s[l] + hdt*az_[idx];
+			x_[idx] += vx_[idx]*dt;
+			y_[idx] += vy_[idx]*dt;
+			z_[idx] += vz_[idx]*dt;
+		}
+	}
+
+	calcForce();
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < N_; ++i) {
+		const int base = i*P_;
+		for (int l = 0; l < P_; ++l) {
+			const int idx = base + l;
+			vx_[idx] = (vx_[idx] + ax_[idx]*hdt)*s[l];
+			vy_[idx] = (vy_[idx] + ay_[idx]*hdt)*s[l];
+			vz_[idx] = (vz_[idx] + az_[idx]*hdt)*s[l];
+		}
+	}
+	kinetic_();
+	thermostat_();
+}
+
+/*!
+ * Copy one system's positions, velocities, accelerations, energies and temperature into a system definition.
+ *
+ * \param [in] lane Index of the system, in the order it was packed
+ * \param [in, out] sys System definition, e.g. the one the lane was packed from
+ */
+void laneSystems::unpack (const int lane, systemDefinition &sys) const {
+	if (lane < 0 || lane >= W_) {
+		throw customException ("No such lane");
+		return;
+	}
+	sys.atoms.resize(N_);
+	for (int i = 0; i < N_; ++i) {
+		const int idx = i*P_ + lane;
+		sys.atoms[i].pos.x = x_[idx];
+		sys.atoms[i].pos.y = y_[idx];
+		sys.atoms[i].pos.z = z_[idx];
+		sys.atoms[i].vel.x = vx_[idx];
+		sys.atoms[i].vel.y = vy_[idx];
+		sys.atoms[i].vel.z = vz_[idx];
+		sys.atoms[i].acc.x = ax_[idx];
+		sys.atoms[i].acc.y = ay_[idx];
+		sys.atoms[i].acc.z = az_[idx];
+	}
+	sys.setKinE(KinE_[lane]);
+	sys.setPotE(PotE_[lane]);
+	sys.updateInstantTemp(instantT_[lane]);
+	sys.setTemp(targetT_[lane]);
+}
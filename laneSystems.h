@@ -0,0 +1,67 @@
+/*!
+ * Many small systems advanced together, one per SIMD lane
+ * \date 10/19/26
+ */
+
+#ifndef __LANE_SYSTEMS_H__
+#define __LANE_SYSTEMS_H__
+
+#include <vector>
+#include "dataTypes.h"
+#include "system.h"
+
+//! Number of systems processed together by the innermost loops; lanes are padded to a multiple of this
+#define LANE_BLOCK 8
+
+/*!
+ * Advances many identically shaped small systems (same number of atoms, box, mass, cutoff and shifted Lennard-Jones parameters) in
+ * lockstep, so the work of one step is spread across SIMD lanes rather than over a few hundred atoms.  Coordinates are stored atom
+ * major with the systems innermost, so every loop runs over LANE_BLOCK consecutive systems with unit stride and no branches.
+ * Forces are summed over all pairs of atoms, which for systems only a few cutoffs across is no more work than a cell list (every cell
+ * neighbors every other) and needs no per-system lists.  Blocks of systems are independent and shared among the OpenMP threads.
+ * Each system follows the velocity Verlet and Nose-Hoover updates of nve and nvt_NH exactly, at its own target temperature, so a system
+ * matches what those integrators produce on it alone up to the order of the force sums.
+ * Only the pair potential slj is supported, with overlaps (r <= delta) treated as OVERLAP_ABORT, and the box must be at least twice the
+ * cutoff so the minimum image finds every neighbor.
+ */
+class laneSystems {
+	public:
+		laneSystems (const std::vector <systemDefinition*> &systems, const float Q=-1.0);
+		~laneSystems () {}
+		void setTimestep (const float dt) {dt_ = dt;}   //!< Set the timestep
+		float timestep () const {return dt_;}           //!< Report the timestep
+		void step ();                                   //!< Advance every system a step
+		void calcForce ();                              //!< Compute the accelerations and potential energy of every system
+		void unpack (const int lane, systemDefinition &sys) const;   //!< Copy a system's atoms and energies back out
+		int numSystems () const {return W_;}            //!< Report the number of systems
+		int numAtoms () const {return N_;}              //!< Report the number of atoms in each system
+		float KinE (const int lane) const {return KinE_[lane];}     //!< Report the kinetic energy of a system
+		float PotE (const int lane) const {return PotE_[lane];}     //!< Report the potential energy of a system
+		float instantT (const int lane) const {return instantT_[lane];}     //!< Report the instantaneous temperature of a system
+
+	private:
+		int N_;                 //!< Atoms per system
+		int W_;                 //!< Number of systems
+		int P_;                 //!< Number of lanes, W rounded up to a multiple of LANE_BLOCK
+		float3 box_;            //!< Box dimensions
+		float mass_;            //!< Mass of each atom
+		float rc_;              //!< Cutoff radius
+		float args_[4];         //!< epsilon, sigma, delta and ushift of the shifted Lennard-Jones potential
+		float Q_;               //!< Thermostat mass, or not positive for constant energy
+		float dt_;              //!< Timestep
+		bool start_;            //!< Flag for whether the first step has yet to compute the initial forces
+		std::vector <float> x_, y_, z_;         //!< Position of every atom of every lane (atom major, then lane)
+		std::vector <float> vx_, vy_, vz_;      //!< Velocity of every atom of every lane
+		std::vector <float> ax_, ay_, az_;      //!< Acceleration of every atom of every lane
+		std::vector <float> targetT_;   //!< Target temperature of each lane
+		std::vector <float> instantT_;  //!< Instantaneous temperature of each lane
+		std::vector <float> KinE_;      //!< Kinetic energy of each lane
+		std::vector <float> PotE_;      //!< Potential energy of each lane
+		std::vector <float> gammadot_;  //!< Thermostat velocity of each lane
+		std::vector <float> scale_;     //!< Velocity scaling of each lane's thermostat over half a step
+		std::vector <int> overlaps_;    //!< Pairs closer than delta in each lane at the last force calculation
+		void kinetic_ ();               //!< Compute the kinetic energy and temperature of every lane
+		void thermostat_ ();            //!< Half step of the thermostat velocity of every lane
+};
+
+#endif
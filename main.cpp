@@ -2,6 +2,8 @@
 #include "potential.h"
 #include "integrator.h"
 #include "nvt.h"
+#include "autotune.h"
+#include "trajectory.h"
 #include <iostream>
 #include "utils.h"
 #include <omp.h>
@@ -15,13 +17,19 @@
 
 /*!
  * Invoke the program as 
- * $ ./md numThreads > log 2> err
+ * $ ./md numThreads natoms rs nsteps [autotune] [subcells] [numa] [precision] > log 2> err
+ * If autotune is nonzero, numThreads and rs are only the starting point and are tuned at runtime along with the cell size and OMP schedules.
+ * subcells (default 1) is the number of cells spanning rc+rs in each direction; 2 or 3 reduces the number of distance checks in dense systems.
+ * If numa is nonzero, threads are pinned and the per-atom arrays are placed by parallel first touch (see numaPlacement.h); the binding and the
+ * node each array ended up on are written to stderr.
+ * If precision is positive, snapshots are written to a compressed trajectory, trajectory.ctz, with coordinates quantized to that precision
+ * (see trajectory.h) instead of to trajectory.xyz.
  */ 
 int main (int argc, char* argv[]) {
     
-	if (argc !=5) {
+	if (argc < 5 || argc > 9) {
 		// catch incorrect number of arguments
-		printf("USAGE: %s <nthreads> <natoms> <rs> <nsteps> \n",argv[0]);
+		printf("USAGE: %s <nthreads> <natoms> <rs> <nsteps> [autotune] [subcells] [numa] [precision] \n",argv[0]);
 		exit(1);
     	}
 
@@ -29,9 +37,18 @@ int main (int argc, char* argv[]) {
     	const int nAtoms = atoi(argv[2]);
 	const float rs = atof(argv[3]);
     	const int nSteps = atoi(argv[4]);	
+	const int tune = (argc >= 6) ? atoi(argv[5]) : 0;
+	const int subcells = (argc >= 7) ? atoi(argv[6]) : 1;
+	const int numa = (argc >= 8) ? atoi(argv[7]) : 0;
+	const float precision = (argc == 9) ? atof(argv[8]) : 0.0;
 	const float L = 12; 
 
 	omp_set_num_threads(nthreads);
+	if (numa) {
+		// must precede initialization so the atoms are first touched by pinned threads
+		setNumaMode(true);
+		pinThreads(std::cerr);
+	}
     	const int rngSeed = 3145;
     
     	float Temp = 0.5;
@@ -41,7 +58,7 @@ int main (int argc, char* argv[]) {
 	a.setBox(L, L, L);
 	a.setTemp(Temp);
     	a.setMass(1.0);
-	a.setRskin(1.0);
+	a.setRskin(rs);
     	a.setRcut(2.5);	// if slj needs to incorporate "delta" shift already so cell list is properly created
 	a.initThermal(nAtoms, 1.01*Temp, rngSeed, 1.2);
 	
@@ -78,17 +95,43 @@ int main (int argc, char* argv[]) {
 
  	nvt_NH integrate (1.0);     // damping constant for thermostat = 1.0
 	integrate.setTimestep(timestep);
+	integrate.setCellSubdivisions(subcells);
+	if (numa) {
+		// sweeps must follow the same static partitioning the per-atom arrays were first touched with
+		integrate.setSweepSchedule(omp_sched_static, 0);
+	}
+	autoTuner tuner;
+	compressedTrajectoryWriter *traj = NULL;
+	if (precision > 0.0) {
+		traj = new compressedTrajectoryWriter ("trajectory.ctz", precision);
+	}
 
     int report = nSteps/1000;
     if (nSteps < 1000) report = 1;
                                                          
 	for (unsigned int long step = 0; step < nSteps; ++step) {
-		integrate.step(a);
+		if (tune) {
+			tuner.step(a, integrate);
+		} else {
+			integrate.step(a);
+		}
 		if (step%report == 0) {
 			std::cout << step << "\t" << a.KinE() << "\t" << a.PotE() << "\t" << a.instantT() << "\t" << a.KinE() + a.PotE() << std::endl;
-			a.writeSnapshot();
+			if (traj != NULL) {
+				traj->write(a, step);
+			} else {
+				a.writeSnapshot();
+			}
 		}
 	}
+	delete traj;
+	if (tune) {
+		tuner.report(std::cerr);
+	}
+	if (numa) {
+		reportPlacement(std::cerr, "atoms", &a.atoms[0], a.atoms.size()*sizeof(atom));
+		integrate.cellList().reportPlacement(std::cerr);
+	}
 
     return 0;
 }
@@ -0,0 +1,191 @@
+/*!
+ * Do NPT integration with the Martyna-Tobias-Klein barostat.
+ * \date 10/19/26
+ */
+
+#include "system.h"
+#include "npt.h"
+#include "cellList.h"
+#include <exception>
+#include "common.h"
+#include "utils.h"
+#include <math.h>
+#include <vector>
+#include <omp.h>
+
+/*!
+ * sinh(x)/x, with its series near 0.
+ */
+static inline float sinhc (const float x) {
+    if (fabs(x) < 1.0e-3) {
+        const float x2 = x*x;
+        return 1.0 + x2/6.0 + x2*x2/120.0;
+    }
+    return sinh(x)/x;
+}
+
+/*!
+ * Initialize integrator
+ *
+ * \param [in] tauT Relaxation time of the thermostats
+ * \param [in] tauP Relaxation time of the barostat
+ */
+npt_MTK::npt_MTK (const float tauT, const float tauP) {
+    if (tauT <= 0.0 || tauP <= 0.0) {
+        throw customException ("Thermostat and barostat relaxation times must be > 0");
+    }
+    tauT_ = tauT;
+    tauP_ = tauP;
+    computeVirial_ = true;
+    start_ = 1;
+}
+
+/*!
+ * Advance the barostat and particle thermostats half a step (each split symmetrically around the velocity scaling it causes).
+ * The barostat velocity is scaled immediately; the particle velocities are not, but K2_ is updated as if they were.
+ *
+ * \param [in] Nf Number of degrees of freedom of the particles
+ * \param [in] kT Target temperature
+ * \return Factor every particle velocity must be scaled by
+ */
+float npt_MTK::thermostatHalf_ (const float Nf, const float kT) {
+    const float h = 0.5*dt_;
+    vxib_ += 0.5*h*(W_*veps_*veps_ - kT)/Qb_;
+    veps_ *= exp(-h*vxib_);
+    vxib_ += 0.5*h*(W_*veps_*veps_ - kT)/Qb_;
+    xib_ += h*vxib_;
+
+    vxi_ += 0.5*h*(K2_ - Nf*kT)/Q_;
+    const float s = exp(-h*vxi_);
+    K2_ *= s*s;
+    vxi_ += 0.5*h*(K2_ - Nf*kT)/Q_;
+    xi_ += h*vxi_;
+    return s;
+}
+
+/*!
+ * Integrate a single timestep forward with the symmetric (Trotter) factorization of the MTK equations of motion:
+ * thermostats, barostat and particle velocities are advanced half a step, then positions and box a full step, then the reverse.
+ * Creates a cell list the first time it is called.
+ *
+ * \param [in, out] sys System definition
+ */
+void npt_MTK::step (systemDefinition &sys) {
+    const int N = sys.numAtoms();
+    const float Nf = 3.0*(N-1.0), kT = sys.targetT(), m = sys.mass();
+    if (start_) {
+        try {
+            resetCellList(sys);
+        } catch (std::exception &e) {
+            std::cerr << e.what() << std:: endl;
+            throw customException("Failed to integrate on first step");
+        }
+        Q_ = Nf*kT*tauT_*tauT_;
+        Qb_ = kT*tauT_*tauT_;
+        W_ = (Nf+3.0)*kT*tauP_*tauP_;
+        xi_ = 0.0; vxi_ = 0.0;
+        xib_ = 0.0; vxib_ = 0.0;
+        veps_ = 0.0;
+
+        calcForce(sys);
+
+        float K2 = 0.0;
+        #pragma omp parallel for reduction(+:K2)
+        for (int i = 0; i < N; ++i) {
+            K2 += (sys.atoms[i].vel.x*sys.atoms[i].vel.x)+(sys.atoms[i].vel.y*sys.atoms[i].vel.y)+(sys.atoms[i].vel.z*sys.atoms[i].vel.z);
+        }
+        K2_ = K2*m;
+        sys.updateInstantTemp(K2_/Nf);
+        sys.setKinE(0.5*K2_);
+        start_ = 0;
+    }
+
+    const float h = 0.5*dt_, alpha = 1.0+3.0/Nf;
+
+    // (1) thermostats and barostat, half step
+    const float s = thermostatHalf_(Nf, kT);
+    float3 box = sys.box();
+    veps_ += h*(alpha*K2_ + sys.virial() - 3.0*box.x*box.y*box.z*sys.targetP())/W_;
+
+    // (2) box, full step; the cell list (and its reference positions) follow before the position sweep measures displacements
+    const float f = exp(veps_*dt_);
+    box.x *= f;
+    box.y *= f;
+    box.z *= f;
+    rescaleBox_(sys, box);
+
+    // (3) evolve particle velocities half a step and positions a full step
+    // the position sweep also finds the two largest displacements since the cell list was built
+    const float va = s*exp(-alpha*veps_*h), vb = h*exp(-0.5*alpha*veps_*h)*sinhc(0.5*alpha*veps_*h);
+    const float rb = dt_*exp(veps_*h)*sinhc(veps_*h);
+    const bool track = (cl_.numBuilds() > 0);
+    float dr1sq = 0.0, dr2sq = 0.0;
+    useSweepSchedule_();
+    #pragma omp parallel shared(sys, dr1sq, dr2sq)
+    {
+        float my1 = 0.0, my2 = 0.0;
+        float3 dummy;
+        #pragma omp for schedule(runtime)
+        for (int i = 0; i < N; ++i) {
+            sys.atoms[i].vel.x = sys.atoms[i].vel.x*va + vb*sys.atoms[i].acc.x;
+            sys.atoms[i].vel.y = sys.atoms[i].vel.y*va + vb*sys.atoms[i].acc.y;
+            sys.atoms[i].vel.z = sys.atoms[i].vel.z*va + vb*sys.atoms[i].acc.z;
+            sys.atoms[i].pos.x = sys.atoms[i].pos.x*f + rb*sys.atoms[i].vel.x;
+            sys.atoms[i].pos.y = sys.atoms[i].pos.y*f + rb*sys.atoms[i].vel.y;
+            sys.atoms[i].pos.z = sys.atoms[i].pos.z*f + rb*sys.atoms[i].vel.z;
+            if (track) {
+                keepTop2 (pbcDist2 (sys.atoms[i].pos, cl_.refPos(i), dummy, box), my1, my2);
+            }
+        }
+        #pragma omp critical
+        {
+            keepTop2 (my1, dr1sq, dr2sq);
+            keepTop2 (my2, dr1sq, dr2sq);
+        }
+    }
+    if (track) {
+        cl_.setDisplacements(dr1sq, dr2sq);
+    }
+
+    // (4) calc force and virial
+    calcForce(sys);
+
+    // (5) evolve particle velocities half a step
+    const float va2 = exp(-alpha*veps_*h);
+    float K2 = 0.0;
+    useSweepSchedule_();
+    #pragma omp parallel for schedule(runtime) reduction(+:K2) shared(sys)
+    for (int i = 0; i < N; ++i) {
+        sys.atoms[i].vel.x = sys.atoms[i].vel.x*va2 + vb*sys.atoms[i].acc.x;
+        sys.atoms[i].vel.y = sys.atoms[i].vel.y*va2 + vb*sys.atoms[i].acc.y;
+        sys.atoms[i].vel.z = sys.atoms[i].vel.z*va2 + vb*sys.atoms[i].acc.z;
+        K2 += (sys.atoms[i].vel.x*sys.atoms[i].vel.x)+(sys.atoms[i].vel.y*sys.atoms[i].vel.y)+(sys.atoms[i].vel.z*sys.atoms[i].vel.z);
+    }
+    K2_ = K2*m;
+
+    // (6) barostat and thermostats, half step
+    veps_ += h*(alpha*K2_ + sys.virial() - 3.0*box.x*box.y*box.z*sys.targetP())/W_;
+    const float s2 = thermostatHalf_(Nf, kT);
+    #pragma omp parallel for schedule(runtime) shared(sys)
+    for (int i = 0; i < N; ++i) {
+        sys.atoms[i].vel.x *= s2;
+        sys.atoms[i].vel.y *= s2;
+        sys.atoms[i].vel.z *= s2;
+    }
+    sys.updateInstantTemp(K2_/Nf);
+    sys.setKinE(0.5*K2_);
+
+    adaptTimestep_(sys);
+}
+
+/*!
+ * The quantity conserved by MTK dynamics: kinetic and potential energy, PV, and the kinetic and potential energies of the barostat and thermostats.
+ *
+ * \param [in] sys System definition
+ * \return Conserved energy
+ */
+float npt_MTK::conservedEnergy (const systemDefinition &sys) const {
+    const float Nf = 3.0*(sys.numAtoms()-1.0), kT = sys.targetT();
+    const float3 box = sys.box();
+    return sys.KinE() + sys.PotE() + sys.targetP()*box.x*box.y*box.z + 0.5*W_*veps_*veps_ + 0.5*Q_*vxi_*vxi_ + Nf*kT*xi_ + 0.5*Qb_*vxib_*vxib_ + kT*xib_;
+}
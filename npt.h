@@ -0,0 +1,38 @@
+/*!
+ * NPT integration with the Martyna-Tobias-Klein barostat.
+ * \date 10/19/26
+ */
+
+#ifndef __NPT_MTK_H__
+#define __NPT_MTK_H__
+
+#include "system.h"
+#include "integrator.h"
+
+/*!
+ * Isotropic Martyna-Tobias-Klein (MTK) integration at constant pressure and temperature.  The particles and the barostat each have a
+ * Nose-Hoover thermostat; the box is scaled by the barostat every step and the cell list follows it in place (see cellList_cpu::rescale),
+ * so only a change in the number of cells costs a rebuild.  The target pressure is systemDefinition::targetP().
+ */
+class npt_MTK : public integrator {
+public:
+    npt_MTK (const float tauT, const float tauP);
+    ~npt_MTK () {}
+    void step (systemDefinition &sys);
+    float conservedEnergy (const systemDefinition &sys) const;  //!< Report the quantity MTK dynamics conserve (enthalpy plus thermostat and barostat energies)
+private:
+    float tauT_;        //!< Thermostat relaxation time
+    float tauP_;        //!< Barostat relaxation time
+    float Q_;           //!< Particle thermostat mass
+    float Qb_;          //!< Barostat thermostat mass
+    float W_;           //!< Barostat mass
+    float xi_;          //!< Particle thermostat position
+    float vxi_;         //!< Particle thermostat velocity
+    float xib_;         //!< Barostat thermostat position
+    float vxib_;        //!< Barostat thermostat velocity
+    float veps_;        //!< Barostat velocity, d ln(V)/dt / 3
+    float K2_;          //!< Twice the kinetic energy of the particles
+    float thermostatHalf_ (const float Nf, const float kT);    //!< Advance both thermostats half a step, returns the factor the particle velocities must be scaled by
+};
+
+#endif
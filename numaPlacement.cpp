@@ -0,0 +1,264 @@
+/*!
+ * NUMA-aware memory placement and thread pinning
+ * \date 10/19/26
+ */
+
+#include "numaPlacement.h"
+#include <map>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <omp.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+static bool numaMode_ = false;              //!< Whether NUMA-aware placement is enabled
+static const size_t hugePage_ = 2097152;    //!< Transparent huge page size assumed for alignment
+static long nPlaced_ = 0;                   //!< Number of blocks obtained from placedAlloc
+
+/*!
+ * Enable (or disable) first-touch placement and huge page hints for arrays allocated afterwards with firstTouchAllocator.
+ * Should be set, and threads pinned, before the system is initialized.
+ *
+ * \param [in] numa Whether to enable NUMA-aware placement
+ */
+void setNumaMode (const bool numa) {
+	numaMode_ = numa;
+}
+
+/*!
+ * Report if NUMA-aware placement is enabled.
+ */
+bool numaMode () {
+	return numaMode_;
+}
+
+/*!
+ * Report the number of blocks obtained from placedAlloc so far.  They bypass operator new, so allocCount() adds them to its own count.
+ */
+long placedAllocCount () {
+	long n;
+	#pragma omp atomic read
+	n = nPlaced_;
+	return n;
+}
+
+/*!
+ * Allocate memory.  When NUMA-aware placement is enabled, large blocks are huge page aligned and hinted to use transparent huge pages,
+ * then every page is first touched by the thread which owns the first element on it under a static OMP schedule.
+ * Called from inside a parallel region the touch loop runs on the calling thread alone, placing everything on its node.
+ *
+ * \param [in] bytes Number of bytes requested
+ * \param [in] elemSize Size of one element, so pages are touched following the element partitioning
+ * \return Pointer to the memory
+ */
+void* placedAlloc (const size_t bytes, const size_t elemSize) {
+	#pragma omp atomic
+	nPlaced_++;
+	void *p = NULL;
+	if (!numaMode_) {
+		p = malloc(bytes ? bytes : 1);
+		if (p == NULL) {
+			throw std::bad_alloc();
+		}
+		return p;
+	}
+
+	#ifdef __linux__
+	const size_t page = sysconf(_SC_PAGESIZE);
+	const size_t align = (bytes >= hugePage_) ? hugePage_ : page;
+	if (posix_memalign(&p, align, bytes ? bytes : 1) != 0) {
+		throw std::bad_alloc();
+	}
+	#ifdef MADV_HUGEPAGE
+	if (bytes >= hugePage_) {
+		madvise(p, bytes - bytes%hugePage_, MADV_HUGEPAGE);
+	}
+	#endif
+
+	char *c = static_cast<char*>(p);
+	const long n = bytes/elemSize;
+	#pragma omp parallel for schedule(static)
+	for (long i = 0; i < n; ++i) {
+		const size_t off = i*elemSize;
+		if (i == 0 || off/page != (off-elemSize)/page) {
+			c[off - off%page] = 0;
+		}
+	}
+	#else
+	p = malloc(bytes ? bytes : 1);
+	if (p == NULL) {
+		throw std::bad_alloc();
+	}
+	#endif
+	return p;
+}
+
+/*!
+ * Release memory obtained from placedAlloc.
+ *
+ * \param [in] p Memory to release
+ */
+void placedFree (void *p) {
+	free(p);
+}
+
+/*!
+ * Bind each OMP thread to one CPU of the process' affinity mask, in order, so consecutive threads (which own consecutive atoms under a static schedule)
+ * share a socket.  If the OMP runtime already binds threads (OMP_PLACES or OMP_PROC_BIND were set) that binding is kept.
+ * Each thread's CPU and NUMA node are then reported.
+ *
+ * \param [in] os Output stream for the report
+ */
+void pinThreads (std::ostream &os) {
+	#ifdef __linux__
+	bool bound = false;
+	#if _OPENMP >= 201307
+	bound = (omp_get_proc_bind() != omp_proc_bind_false);
+	#endif
+	if (bound) {
+		os << "# threads already bound by the OMP runtime (OMP_PLACES/OMP_PROC_BIND)" << std::endl;
+	} else {
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		sched_getaffinity(0, sizeof(allowed), &allowed);
+		std::vector <int> cpus;
+		for (int c = 0; c < CPU_SETSIZE; ++c) {
+			if (CPU_ISSET(c, &allowed)) {
+				cpus.push_back(c);
+			}
+		}
+		if (cpus.empty()) {
+			os << "# unable to read the affinity mask, threads not pinned" << std::endl;
+			return;
+		}
+		#pragma omp parallel
+		{
+			cpu_set_t one;
+			CPU_ZERO(&one);
+			CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &one);
+			sched_setaffinity(0, sizeof(one), &one);
+		}
+	}
+
+	std::vector <int> cpu (omp_get_max_threads(), -1), node (omp_get_max_threads(), -1);
+	#pragma omp parallel
+	{
+		unsigned int c = 0, n = 0;
+		if (syscall(SYS_getcpu, &c, &n, NULL) == 0) {
+			cpu[omp_get_thread_num()] = c;
+			node[omp_get_thread_num()] = n;
+		}
+	}
+	os << "# thread\tcpu\tnode" << std::endl;
+	for (unsigned int t = 0; t < cpu.size(); ++t) {
+		os << "# " << t << "\t" << cpu[t] << "\t" << node[t] << std::endl;
+	}
+	#else
+	os << "# thread pinning is only supported on linux" << std::endl;
+	#endif
+}
+
+/*!
+ * Report how many pages of an array reside on each NUMA node (queried with move_pages, which does not move anything when no target nodes are given).
+ *
+ * \param [in] os Output stream
+ * \param [in] name Name of the array
+ * \param [in] p Start of the array
+ * \param [in] bytes Size of the array
+ */
+void reportPlacement (std::ostream &os, const char *name, const void *p, const size_t bytes) {
+	#ifdef __linux__
+	if (p == NULL || bytes == 0) {
+		os << "# " << name << ": empty" << std::endl;
+		return;
+	}
+	const size_t page = sysconf(_SC_PAGESIZE);
+	const size_t first = ((size_t) p)/page, last = ((size_t) p + bytes - 1)/page;
+	const unsigned long npages = last - first + 1;
+	std::vector <void*> pages (npages);
+	std::vector <int> status (npages, -1);
+	for (unsigned long i = 0; i < npages; ++i) {
+		pages[i] = (void*) ((first + i)*page);
+	}
+	if (syscall(SYS_move_pages, 0, npages, &pages[0], NULL, &status[0], 0) != 0) {
+		os << "# " << name << ": unable to query page placement" << std::endl;
+		return;
+	}
+	std::map <int, unsigned long> count;
+	for (unsigned long i = 0; i < npages; ++i) {
+		count[status[i] >= 0 ? status[i] : -1]++;
+	}
+	os << "# " << name << " (" << npages << " pages):";
+	for (std::map <int, unsigned long>::const_iterator it = count.begin(); it != count.end(); ++it) {
+		if (it->first < 0) {
+			os << " not resident " << it->second;
+		} else {
+			os << " node " << it->first << " " << it->second;
+		}
+	}
+	os << std::endl;
+	#else
+	os << "# " << name << ": page placement can only be queried on linux" << std::endl;
+	#endif
+}
+
+/*!
+ * Count the NUMA nodes listed by sysfs.
+ *
+ * \return Number of nodes, at least 1
+ */
+int numaNodes () {
+	int n = 0;
+	#ifdef __linux__
+	char path[64];
+	for (int node = 0; node < 1024; ++node) {
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", node);
+		if (access(path, F_OK) == 0) {
+			n++;
+		}
+	}
+	#endif
+	return (n > 0) ? n : 1;
+}
+
+/*!
+ * Find which NUMA node a page resides on (queried with move_pages, like reportPlacement).
+ *
+ * \param [in] p Any address in the page
+ * \return Node of the page, or -1 if it is not resident or the query failed
+ */
+int pageNode (const void *p) {
+	#ifdef __linux__
+	const size_t page = sysconf(_SC_PAGESIZE);
+	void *pages[1];
+	int status[1] = {-1};
+	pages[0] = (void*) (((size_t) p) - ((size_t) p)%page);
+	if (syscall(SYS_move_pages, 0, 1, pages, NULL, status, 0) != 0) {
+		return -1;
+	}
+	return (status[0] >= 0) ? status[0] : -1;
+	#else
+	return -1;
+	#endif
+}
+
+/*!
+ * Find which NUMA node the calling thread is running on.  Only meaningful if the thread is pinned (see pinThreads()).
+ *
+ * \return Node of the thread's current CPU, or -1 if the query failed
+ */
+int threadNode () {
+	#ifdef __linux__
+	unsigned int c = 0, n = 0;
+	if (syscall(SYS_getcpu, &c, &n, NULL) == 0) {
+		return n;
+	}
+	#endif
+	return -1;
+}
@@ -0,0 +1,56 @@
+/*!
+ * NUMA-aware memory placement and thread pinning
+ * \date 10/19/26
+ */
+
+#ifndef __NUMA_PLACEMENT_H__
+#define __NUMA_PLACEMENT_H__
+
+#include <iostream>
+#include <new>
+#include <stddef.h>
+
+void setNumaMode (const bool numa);     //!< Enable (or disable) first-touch placement and huge page hints for arrays using firstTouchAllocator
+bool numaMode ();                       //!< Report if NUMA-aware placement is enabled
+void* placedAlloc (const size_t bytes, const size_t elemSize);  //!< Allocate memory, placing its pages by parallel first touch when NUMA-aware placement is enabled
+void placedFree (void *p);              //!< Release memory obtained from placedAlloc
+long placedAllocCount ();               //!< Report the number of blocks obtained from placedAlloc so far
+void pinThreads (std::ostream &os);     //!< Bind each OMP thread to a single CPU unless OMP_PLACES/OMP_PROC_BIND already bind them, and report the binding
+void reportPlacement (std::ostream &os, const char *name, const void *p, const size_t bytes);   //!< Report how many pages of an array reside on each NUMA node
+int numaNodes ();                       //!< Report the number of NUMA nodes with a directory in sysfs (1 if it cannot be read)
+int pageNode (const void *p);           //!< Report the NUMA node of the page holding an address, or -1 if it is not resident or cannot be queried
+int threadNode ();                      //!< Report the NUMA node of the CPU the calling thread is running on, or -1 if it cannot be queried
+
+/*!
+ * Allocator for large per-atom arrays.  With NUMA-aware placement enabled the memory is huge page aligned, hinted to use transparent huge pages,
+ * and each page is first touched by the thread which owns the elements on it under a static OMP schedule (the partitioning used by the
+ * cell list binning and, in NUMA mode, by the integrator sweeps), so the pages end up on that thread's node.
+ * Otherwise it behaves like std::allocator.
+ */
+template <class T>
+class firstTouchAllocator {
+	public:
+		typedef T value_type;
+		typedef T* pointer;
+		typedef const T* const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+		template <class U> struct rebind {typedef firstTouchAllocator<U> other;};
+
+		firstTouchAllocator () {}
+		template <class U> firstTouchAllocator (const firstTouchAllocator<U> &other) {}
+		pointer address (reference x) const {return &x;}
+		const_pointer address (const_reference x) const {return &x;}
+		pointer allocate (size_type n, const void *hint = 0) {return static_cast<pointer>(placedAlloc(n*sizeof(T), sizeof(T)));}   //!< Allocate (and place) room for n elements
+		void deallocate (pointer p, size_type n) {placedFree(p);}      //!< Release room for n elements
+		size_type max_size () const {return ((size_t) -1)/sizeof(T);}
+		void construct (pointer p, const T &val) {new ((void*) p) T(val);}
+		void destroy (pointer p) {p->~T();}
+};
+
+template <class T, class U> bool operator== (const firstTouchAllocator<T> &a, const firstTouchAllocator<U> &b) {return true;}
+template <class T, class U> bool operator!= (const firstTouchAllocator<T> &a, const firstTouchAllocator<U> &b) {return false;}
+
+#endif
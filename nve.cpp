@@ -9,6 +9,7 @@
 #include "cellList.h"
 #include <exception>
 #include "common.h"
+#include "utils.h"
 #include <math.h>
 #include <vector>
 #include <omp.h>
@@ -21,11 +22,9 @@
  * \param [in, out] sys System definition
  */  
 void nve::step (systemDefinition &sys) {
-    int chunk = OMP_CHUNK;
     if (start_) {
         try {
-            cellList_cpu tmpCL (sys.box(), sys.rcut(), sys.rskin());
-            cl_ = tmpCL;
+            resetCellList(sys);
         } catch (std::exception &e) {
             std::cerr << e.what() << std:: endl;
             throw customException("Failed to integrate on first step");
@@ -48,9 +47,14 @@ void nve::step (systemDefinition &sys) {
     }
     
     // (1) evolve particle velocities
-    #pragma omp parallel shared(sys)
+    // the position sweep also finds the two largest displacements since the cell list was built
+    const bool track = (cl_.numBuilds() > 0);
+    const float3 box = sys.box();
+    float dr1sq = 0.0, dr2sq = 0.0;
+    useSweepSchedule_();
+    #pragma omp parallel shared(sys, dr1sq, dr2sq)
     {
-        #pragma omp for schedule(dynamic,OMP_CHUNK)
+        #pragma omp for schedule(runtime)
         for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
             sys.atoms[i].vel.x += 0.5*dt_*(sys.atoms[i].acc.x);
             sys.atoms[i].vel.y += 0.5*dt_*(sys.atoms[i].acc.y);
@@ -58,21 +62,35 @@ void nve::step (systemDefinition &sys) {
         }
 
         // (2) evolve particle positions
-        #pragma omp for schedule(dynamic,OMP_CHUNK)
+        float my1 = 0.0, my2 = 0.0;
+        float3 dummy;
+        #pragma omp for schedule(runtime)
         for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
             sys.atoms[i].pos.x += sys.atoms[i].vel.x*dt_;
             sys.atoms[i].pos.y += sys.atoms[i].vel.y*dt_;
             sys.atoms[i].pos.z += sys.atoms[i].vel.z*dt_;
+            if (track) {
+                keepTop2 (pbcDist2 (sys.atoms[i].pos, cl_.refPos(i), dummy, box), my1, my2);
+            }
+        }
+        #pragma omp critical
+        {
+            keepTop2 (my1, dr1sq, dr2sq);
+            keepTop2 (my2, dr1sq, dr2sq);
         }
     }
+    if (track) {
+        cl_.setDisplacements(dr1sq, dr2sq);
+    }
     
     // (3) calc force
     calcForce(sys);
     
     // (4) evolve particle velocities
+    useSweepSchedule_();
     #pragma omp parallel shared(sys)
     {
-    #pragma omp for schedule(dynamic,OMP_CHUNK)
+    #pragma omp for schedule(runtime)
     for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
             sys.atoms[i].vel.x += 0.5*dt_*(sys.atoms[i].acc.x);
             sys.atoms[i].vel.y += 0.5*dt_*(sys.atoms[i].acc.y);
@@ -95,5 +113,6 @@ void nve::step (systemDefinition &sys) {
     sys.updateInstantTemp(tmp);
     sys.setKinE(Uk);
 
+    adaptTimestep_(sys);
 }
 
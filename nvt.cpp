@@ -8,6 +8,7 @@
 #include "cellList.h"
 #include <exception>
 #include "common.h"
+#include "utils.h"
 #include <math.h>
 #include <vector>
 #include <omp.h>
@@ -20,6 +21,7 @@
 nvt_NH::nvt_NH (const float Q) {
     Q_ = Q; 
     gamma_ = 0.0;
+    lnS_ = 0.0;
 	start_ = 1; 
 }
 
@@ -30,11 +32,9 @@ nvt_NH::nvt_NH (const float Q) {
  * \param [in, out] sys System definition
  */
 void nvt_NH::step (systemDefinition &sys) {
-    int chunk = OMP_CHUNK;
     if (start_) {
         try {
-            cellList_cpu tmpCL (sys.box(), sys.rcut(), sys.rskin());
-            cl_ = tmpCL;
+            resetCellList(sys);
         } catch (std::exception &e) {
             std::cerr << e.what() << std:: endl;
             throw customException("Failed to integrate on first step");
@@ -64,6 +64,7 @@ void nvt_NH::step (systemDefinition &sys) {
         start_ = 0;
         gammadot_ = 0.0;
         gammadd_ = 0.0;
+        lnS_ = 0.0;
     }
     
     tau2_ = Q_/ ((3.0*(sys.numAtoms()-1.0))*sys.targetT());
@@ -75,11 +76,17 @@ void nvt_NH::step (systemDefinition &sys) {
     
     // position step
     gamma_ += gammadot_*dt_;
+    lnS_ += gammadot_*dt_;
     
     // (2) evolve particle velocities
-    #pragma omp parallel shared(sys)
+    // the position sweep also finds the two largest displacements since the cell list was built
+    const bool track = (cl_.numBuilds() > 0);
+    const float3 box = sys.box();
+    float dr1sq = 0.0, dr2sq = 0.0;
+    useSweepSchedule_();
+    #pragma omp parallel shared(sys, dr1sq, dr2sq)
     {
-        #pragma omp for schedule(dynamic,OMP_CHUNK)
+        #pragma omp for schedule(runtime)
         for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
             sys.atoms[i].vel.x = sys.atoms[i].vel.x*exp(-gammadot_*dt_*0.5) + 0.5*dt_*(sys.atoms[i].acc.x);
             sys.atoms[i].vel.y = sys.atoms[i].vel.y*exp(-gammadot_*dt_*0.5) + 0.5*dt_*(sys.atoms[i].acc.y);
@@ -87,21 +94,35 @@ void nvt_NH::step (systemDefinition &sys) {
         }
 
         // (3) evolve particle positions
-        #pragma omp for schedule(dynamic,OMP_CHUNK)
+        float my1 = 0.0, my2 = 0.0;
+        float3 dummy;
+        #pragma omp for schedule(runtime)
         for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
             sys.atoms[i].pos.x += sys.atoms[i].vel.x*dt_;
             sys.atoms[i].pos.y += sys.atoms[i].vel.y*dt_;
             sys.atoms[i].pos.z += sys.atoms[i].vel.z*dt_;
+            if (track) {
+                keepTop2 (pbcDist2 (sys.atoms[i].pos, cl_.refPos(i), dummy, box), my1, my2);
+            }
+        }
+        #pragma omp critical
+        {
+            keepTop2 (my1, dr1sq, dr2sq);
+            keepTop2 (my2, dr1sq, dr2sq);
         }
     }
+    if (track) {
+        cl_.setDisplacements(dr1sq, dr2sq);
+    }
     
     // (4) calc force
     calcForce(sys);
     
     // (5) evolve particle velocities
+    useSweepSchedule_();
     #pragma omp parallel shared(sys)
     {
-    #pragma omp for schedule(dynamic,OMP_CHUNK)
+    #pragma omp for schedule(runtime)
     for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
         sys.atoms[i].vel.x = (sys.atoms[i].vel.x+sys.atoms[i].acc.x*dt_*0.5)*exp(-gammadot_*dt_*0.5);
         sys.atoms[i].vel.y = (sys.atoms[i].vel.y+sys.atoms[i].acc.y*dt_*0.5)*exp(-gammadot_*dt_*0.5);
@@ -127,5 +148,42 @@ void nvt_NH::step (systemDefinition &sys) {
     // (6) update thermostat velocity
     gammadd_ = 1/tau2_*(sys.instantT()/sys.targetT()-1);
     gammadot_ += dt_*0.5*gammadd_;
+
+    adaptTimestep_(sys);
+}
+
+/*!
+ * The quantity conserved by Nose-Hoover dynamics: kinetic and potential energy plus the thermostat's kinetic and potential energy.
+ *
+ * \param [in] sys System definition
+ * \return Conserved energy
+ */
+float nvt_NH::conservedEnergy (const systemDefinition &sys) const {
+    return sys.KinE() + sys.PotE() + 0.5*Q_*gammadot_*gammadot_ + 3.0*(sys.numAtoms()-1.0)*sys.targetT()*lnS_;
 }
 
+/*!
+ * Move the system to a new target temperature as a replica exchange does: velocities are scaled by sqrt(T/T0) so the kinetic energy
+ * matches the new temperature, and the thermostat velocity by the same factor, which maps the Nose-Hoover trajectory at T0 onto one at T
+ * (Mori and Okamoto, J. Phys. Soc. Jpn. 79, 074003 (2010)).  The thermostat's integral lnS is kept, so the conserved energy jumps.
+ *
+ * \param [in, out] sys System definition
+ * \param [in] T New target temperature
+ */
+void nvt_NH::rescaleTemperature (systemDefinition &sys, const float T) {
+    if (T <= 0.0 || sys.targetT() <= 0.0) {
+        throw customException ("Temperatures must be positive to rescale velocities");
+        return;
+    }
+    const float s = sqrt(T/sys.targetT());
+    #pragma omp parallel for
+    for (unsigned int i = 0; i < sys.numAtoms(); ++i) {
+        sys.atoms[i].vel.x *= s;
+        sys.atoms[i].vel.y *= s;
+        sys.atoms[i].vel.z *= s;
+    }
+    sys.setKinE(sys.KinE()*s*s);
+    sys.updateInstantTemp(sys.instantT()*s*s);
+    sys.setTemp(T);
+    gammadot_ *= s;
+}
@@ -16,12 +16,16 @@ public:
     nvt_NH (const float Q);
     ~nvt_NH () {}
     void step (systemDefinition &sys);
+    float conservedEnergy (const systemDefinition &sys) const;  //!< Report the quantity Nose-Hoover dynamics conserve
+    void rescaleTemperature (systemDefinition &sys, const float T);    //!< Move the system and thermostat to a new target temperature, e.g. after a replica exchange
+    float thermostatVelocity () const {return gammadot_;}   //!< Report the thermostat 'velocity'
 private:
     float Q_;           //!< Thermostat's 'mass'
     float gamma_;       //!< Thermostat 'position' (it is essentially a spring)
     float tau2_;        //!< Square of damping constant, tau
     float gammadot_;    //!< First derivative of gamma (thermostat 'velocity')
     float gammadd_; //!< Second derivative of gamma (thermostat 'acceleration')
+    float lnS_;         //!< Integral of gammadot since the first step, the thermostat's contribution to the conserved energy
 };
 
 #endif
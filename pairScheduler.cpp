@@ -0,0 +1,230 @@
+/*!
+ * Cell-pair task scheduling
+ * \date 10/19/26
+ */
+
+#include "pairScheduler.h"
+#include "common.h"
+#include <algorithm>
+#include <omp.h>
+
+#ifndef NVCC
+//! Orders task indices by decreasing cost
+struct byDecreasingCost {
+	const std::vector <double> *cost;   //!< Cost of each task
+	bool operator() (const int a, const int b) const {return (*cost)[a] > (*cost)[b];}
+};
+
+/*!
+ * Check the tasks were built for the cell list's current occupancy and stencil (which changes if the box is rescaled), and for nThreads queues.
+ *
+ * \param [in] cl Cell list
+ * \param [in] nThreads Number of threads which will execute the tasks
+ * \return True if the tasks can be reused
+ */
+bool cellPairScheduler::current (const cellList_cpu &cl, const int nThreads) const {
+	return builtFor_ == cl.numBuilds() && cellPairs_ == cl.numCellPairs() && nThreads_ == nThreads;
+}
+
+/*!
+ * Estimate the cost of every pair of neighboring cells from the current occupancy and discard empty pairs.  Consecutive pairs (which share
+ * their first cell or are near it) are grouped into tasks of at least a minimum cost, then tasks are sorted largest first and dealt
+ * round-robin (reversing direction each round) to one queue per thread so every queue starts with a similar load.
+ *
+ * \param [in] cl Cell list, must have been built
+ * \param [in] nThreads Number of threads which will execute the tasks
+ */
+void cellPairScheduler::build (const cellList_cpu &cl, const int nThreads) {
+	if (nThreads < 1) {
+		throw customException ("Number of threads must be > 0");
+		return;
+	}
+
+	// every buffer is reserved for the largest possible number of pairs, so rebuilds never reallocate
+	const int maxPairs = cl.numCellPairs();
+	cellPairs_ = maxPairs;
+	cell1_.reserve(maxPairs);
+	cell2_.reserve(maxPairs);
+	pairCost_.reserve(maxPairs);
+	taskStart_.reserve(maxPairs+1);
+	cost_.reserve(maxPairs);
+	sorted_.reserve(maxPairs);
+	queue_.reserve(maxPairs);
+	owner_.reserve(maxPairs);
+
+	cell1_.clear();
+	cell2_.clear();
+	pairCost_.clear();
+	double total = 0.0;
+	for (int p = 0; p < cl.numCellPairs(); ++p) {
+		const int c1 = cl.pairCell1(p), c2 = cl.pairCell2(p);
+		const double n1 = cl.occupancy(c1), n2 = cl.occupancy(c2);
+		const double c = (c1 == c2) ? 0.5*n1*(n1-1.0) : n1*n2;
+		if (c > 0) {
+			cell1_.push_back(c1);
+			cell2_.push_back(c2);
+			pairCost_.push_back(c);
+			total += c;
+		}
+	}
+
+	// group consecutive pairs until each task reaches the minimum grain
+	const double grain = (tasksPerThread_ > 0) ? total/(1.0*tasksPerThread_*nThreads) : 0.0;
+	taskStart_.clear();
+	cost_.clear();
+	double c = 0.0;
+	for (unsigned int p = 0; p < pairCost_.size(); ++p) {
+		if (c == 0.0) {
+			taskStart_.push_back(p);
+		}
+		c += pairCost_[p];
+		if (c >= grain) {
+			cost_.push_back(c);
+			c = 0.0;
+		}
+	}
+	if (c > 0.0) {
+		cost_.push_back(c);
+	}
+	taskStart_.push_back(pairCost_.size());
+
+	sorted_.resize(cost_.size());
+	for (unsigned int t = 0; t < sorted_.size(); ++t) {
+		sorted_[t] = t;
+	}
+	byDecreasingCost cmp;
+	cmp.cost = &cost_;
+	std::sort(sorted_.begin(), sorted_.end(), cmp);
+
+	if (nThreads != nThreads_) {
+		nThreads_ = nThreads;
+		next_.resize(nThreads_);
+		resetStats();
+	}
+	queueBegin_.assign(nThreads_, 0);
+	queueEnd_.assign(nThreads_, 0);
+	owner_.resize(sorted_.size());
+	for (unsigned int rank = 0; rank < sorted_.size(); ++rank) {
+		const int round = rank/nThreads_, pos = rank%nThreads_;
+		owner_[rank] = (round%2 == 0) ? pos : nThreads_-1-pos;
+		queueEnd_[owner_[rank]]++;
+	}
+	int offset = 0;
+	for (int q = 0; q < nThreads_; ++q) {
+		const int count = queueEnd_[q];
+		queueBegin_[q] = offset;
+		queueEnd_[q] = offset;
+		offset += count;
+	}
+	queue_.resize(sorted_.size());
+	for (unsigned int rank = 0; rank < sorted_.size(); ++rank) {
+		queue_[queueEnd_[owner_[rank]]++] = sorted_[rank];
+	}
+
+	builtFor_ = cl.numBuilds();
+	rewind();
+}
+
+/*!
+ * Reset every queue to its first (largest) task.  Must be called outside of the parallel region executing the tasks.
+ */
+void cellPairScheduler::rewind () {
+	for (int q = 0; q < nThreads_; ++q) {
+		next_[q].value = queueBegin_[q];
+	}
+}
+
+/*!
+ * Take the next task from this thread's own queue, or if it is empty, steal from the front of another thread's queue.
+ *
+ * \param [in] tid Thread number
+ * \param [in, out] steals Incremented if the task returned was stolen
+ * \return Task index, or -1 if there is no work left
+ */
+int cellPairScheduler::next (const int tid, int &steals) {
+	int idx;
+	if (tid < nThreads_) {
+		#pragma omp atomic capture
+		idx = next_[tid].value++;
+		if (idx < queueEnd_[tid]) {
+			return queue_[idx];
+		}
+	}
+	for (int k = 1; k <= nThreads_; ++k) {
+		const int q = (tid + k) % nThreads_;
+		int peek;
+		#pragma omp atomic read
+		peek = next_[q].value;
+		if (peek >= queueEnd_[q]) {
+			continue;   // only used to skip empty queues, the capture below decides
+		}
+		#pragma omp atomic capture
+		idx = next_[q].value++;
+		if (idx < queueEnd_[q]) {
+			steals++;
+			return queue_[idx];
+		}
+	}
+	return -1;
+}
+
+/*!
+ * Accumulate the work done by a thread during one pass over the tasks.
+ *
+ * \param [in] tid Thread number
+ * \param [in] busy Wall time spent executing tasks
+ * \param [in] cost Sum of the estimated costs of the tasks executed
+ * \param [in] tasks Number of tasks executed
+ * \param [in] steals Number of tasks stolen
+ */
+void cellPairScheduler::record (const int tid, const double busy, const double cost, const int tasks, const int steals) {
+	if (tid < 0 || (unsigned int) tid >= stats_.size()) {
+		return;
+	}
+	stats_[tid].busy += busy;
+	stats_[tid].cost += cost;
+	stats_[tid].tasks += tasks;
+	stats_[tid].steals += steals;
+}
+
+/*!
+ * Clear the per-thread load statistics.
+ */
+void cellPairScheduler::resetStats () {
+	threadLoad empty;
+	empty.busy = 0.0;
+	empty.cost = 0.0;
+	empty.tasks = 0;
+	empty.steals = 0;
+	stats_.assign(nThreads_, empty);
+}
+
+/*!
+ * Ratio of the largest to the mean per-thread busy time; 1 is perfectly balanced.
+ */
+double cellPairScheduler::imbalance () const {
+	double mx = 0.0, mean = 0.0;
+	for (unsigned int t = 0; t < stats_.size(); ++t) {
+		mean += stats_[t].busy;
+		if (stats_[t].busy > mx) mx = stats_[t].busy;
+	}
+	if (mean <= 0.0) {
+		return 1.0;
+	}
+	mean /= stats_.size();
+	return mx/mean;
+}
+
+/*!
+ * Print the per-thread load statistics.
+ *
+ * \param [in] os Output stream
+ */
+void cellPairScheduler::report (std::ostream &os) const {
+	os << "# thread\ttasks\tsteals\tcost\tbusy (s)" << std::endl;
+	for (unsigned int t = 0; t < stats_.size(); ++t) {
+		os << "# " << t << "\t" << stats_[t].tasks << "\t" << stats_[t].steals << "\t" << stats_[t].cost << "\t" << stats_[t].busy << std::endl;
+	}
+	os << "# imbalance (max/mean busy) = " << imbalance() << std::endl;
+}
+#endif
@@ -0,0 +1,79 @@
+/*!
+ * Cell-pair task scheduling
+ * \date 10/19/26
+ */
+
+#ifndef __PAIR_SCHEDULER_H__
+#define __PAIR_SCHEDULER_H__
+
+#include <iostream>
+#include <vector>
+#include "cellList.h"
+
+//! Per-thread counter padded to its own cache line
+struct paddedCounter {
+	int value;      //!< Counter
+	char pad[60];   //!< Padding to avoid false sharing
+};
+
+//! Work done by a single thread, padded to its own cache line(s)
+struct threadLoad {
+	double busy;    //!< Wall time spent executing tasks
+	double cost;    //!< Sum of the estimated cost of the tasks executed
+	int tasks;      //!< Number of tasks executed
+	int steals;     //!< Number of tasks taken from another thread's queue
+	char pad[40];   //!< Padding to avoid false sharing
+};
+
+/*!
+ * Flat list of tasks for the force loop, ordered largest first by estimated cost.  A task is a run of consecutive (cell, cell) pairs whose
+ * estimated cost (product of the occupancies, or n(n-1)/2 for a cell with itself) is at least a minimum grain, so small cells are grouped
+ * rather than scheduled one pair at a time.
+ * Tasks are dealt to per-thread queues; a thread which exhausts its own queue steals the next (largest remaining) task of the first
+ * non-empty queue after its own, in thread order.
+ * Both owners and thieves take tasks from the front of a queue with an atomic increment, so a queue never needs locking.
+ */
+class cellPairScheduler {
+public:
+	cellPairScheduler () {nThreads_ = 0; builtFor_ = -1; cellPairs_ = 0; tasksPerThread_ = 64;}
+	~cellPairScheduler () {}
+	void build (const cellList_cpu &cl, const int nThreads);   //!< Estimate the cost of every pair of neighboring cells, group them into tasks and deal them to nThreads queues
+	bool current (const cellList_cpu &cl, const int nThreads) const;   //!< Report if the tasks reflect the cell list's current occupancy, stencil and thread count
+	void invalidate () {builtFor_ = -1;}                     //!< Force the tasks to be rebuilt, e.g. when the cell list is replaced
+	void rewind ();                                         //!< Reset the queues before a pass over the tasks
+	int next (const int tid, int &steals);                  //!< Return the next task for thread tid, or -1 if every queue is empty
+	void setTasksPerThread (const int n) {tasksPerThread_ = n; builtFor_ = -1;}  //!< Set the minimum grain of a task to 1/n of the work per thread (pairs are never split)
+	int numTasks () const {return sorted_.size();}          //!< Report the number of tasks
+	int sortedTask (const int rank) const {return sorted_[rank];}   //!< Return the task with the given rank by cost (0 = largest)
+	int taskBegin (const int task) const {return taskStart_[task];}     //!< Return the first (non-empty) cell pair of a task
+	int taskEnd (const int task) const {return taskStart_[task+1];}     //!< Return one past the last cell pair of a task
+	int numPairs () const {return cell1_.size();}                       //!< Report the number of non-empty cell pairs
+	int cell1 (const int pair) const {return cell1_[pair];}             //!< Return the first cell of a non-empty cell pair
+	int cell2 (const int pair) const {return cell2_[pair];}             //!< Return the second cell of a non-empty cell pair
+	double cost (const int task) const {return cost_[task];}            //!< Return the estimated cost of a task
+	void record (const int tid, const double busy, const double cost, const int tasks, const int steals);  //!< Accumulate the work done by a thread during a pass
+	void resetStats ();                                     //!< Clear the per-thread load statistics
+	const threadLoad& load (const int tid) const {return stats_[tid];}  //!< Report the accumulated work done by a thread
+	int numThreads () const {return nThreads_;}             //!< Report the number of threads the tasks were dealt to
+	double imbalance () const;                              //!< Report the ratio of the largest to the mean per-thread busy time
+	void report (std::ostream &os) const;                   //!< Print the per-thread load statistics
+private:
+	int nThreads_;                      //!< Number of per-thread queues
+	int builtFor_;                      //!< Value of the cell list's build counter when the tasks were last built
+	int cellPairs_;                     //!< Number of pairs of neighboring cells (which changes with the stencil) when the tasks were last built
+	int tasksPerThread_;                //!< Minimum grain of a task, as a fraction of the work per thread
+	std::vector <int> cell1_;           //!< First cell of each non-empty cell pair
+	std::vector <int> cell2_;           //!< Second cell of each non-empty cell pair
+	std::vector <int> taskStart_;       //!< First cell pair of each task (size = number of tasks + 1)
+	std::vector <double> pairCost_;     //!< Estimated cost of each non-empty cell pair
+	std::vector <int> owner_;           //!< Queue each task (by rank) is dealt to
+	std::vector <double> cost_;         //!< Estimated cost of each task
+	std::vector <int> sorted_;          //!< Task indices, largest first
+	std::vector <int> queue_;           //!< Task indices grouped by the queue they were dealt to, largest first within a queue
+	std::vector <int> queueEnd_;        //!< One past the last entry of each queue in queue_
+	std::vector <int> queueBegin_;      //!< First entry of each queue in queue_
+	std::vector <paddedCounter> next_;  //!< Next entry to be taken from each queue
+	std::vector <threadLoad> stats_;    //!< Accumulated per-thread load statistics
+};
+
+#endif
@@ -22,8 +22,9 @@
  * \param [in] box Pointer to box dimensions
  * \param [in] args Additional arguments, in this case epsilon
  * \param [in] rcut Cutoff distance
+ * \param [in, out] ov Overlap policy and counter (unused, this potential has no core)
  */
-float pairUF (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut) {
+float pairUF (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut, overlapState *ov) {
 	// for now use the same potential as in the HW
 	const float eps = args[0], rc = *rcut;
 	float3 dr;
@@ -45,7 +46,9 @@ float pairUF (const float3 *p1, const float3 *p2, float3 *pairForce, const float
 
 
 /*!
- * Pairwise interaction between 2 atoms (shifted lennard-jones)
+ * Pairwise interaction between 2 atoms (shifted lennard-jones).
+ * Pairs with r <= delta are counted in ov and treated according to its policy instead of throwing, since this is called from inside the
+ * parallel force loop; the integrator acts on the count once the loop is complete.
  *
  * \param [in] p1 Pointer to atom 1's position
  * \param [in] p2 Pointer to atom 2's position
@@ -53,22 +56,39 @@ float pairUF (const float3 *p1, const float3 *p2, float3 *pairForce, const float
  * \param [in] box Pointer to box dimensions
  * \param [in] args Additional arguments, in this case {epsilon, sigma, delta, ushift}
  * \param [in] rcut Cutoff distance; NOTE: this MUST already incorporate the delta shift, ie. if r < ((rc' + delta) = rc), then force is computed
+ * \param [in, out] ov Overlap policy and this thread's overlap counter
  */
-float slj (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut) {
+float slj (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut, overlapState *ov) {
 	float3 dr;
 	float r2 = pbcDist2(*p1, *p2, dr, *box);
-	// check that r > delta and throw/catch
-	if (r2 < args[2]*args[2]) {
-		throw customException("dr < delta");
-		pairForce->x = 0.0;
-		pairForce->y = 0.0;
-		pairForce->z = 0.0;
-		return 0.0;
+	// check that r > delta
+	if (r2 <= args[2]*args[2]) {
+		ov->count++;
+		if (ov->policy == OVERLAP_ABORT) {
+			pairForce->x = 0.0;
+			pairForce->y = 0.0;
+			pairForce->z = 0.0;
+			return 0.0;
+		} else if (ov->policy == OVERLAP_CLAMP) {
+			// shift to just past the singularity (but not so close the energy overflows) and allow to run
+			r2 = (args[2]+0.01*args[1])*(args[2]+0.01*args[1]);
+		}
 	}
 	// If (r-delta)^2 < rcut^2 compute
 	if (r2 < (*rcut)*(*rcut)) {
 		float r = sqrt(r2);
         	float x = r - args[2];
+		if (ov->policy == OVERLAP_SOFTCORE && x < ov->softCore*args[1]) {
+			// inside the soft core the force keeps the magnitude it has at x = xs
+			const float xs = ov->softCore*args[1];
+			const float b = 1.0/xs, a = args[1]*b, a2 = a*a, a6 = a2*a2*a2;
+			const float fs = 24.0*args[0]*a6*(2.0*a6-1.0)*b;
+			const float factor = (r > 0.0) ? fs/r : 0.0;
+			pairForce->x = -factor*dr.x;
+			pairForce->y = -factor*dr.y;
+			pairForce->z = -factor*dr.z;
+			return 4.0*args[0]*(a6*a6-a6)+args[3] + fs*(xs-x);
+		}
 		float b = 1.0/x, a = args[1]*b, a2 = a*a, a6 = a2*a2*a2, factor;
 		factor = 24.0*args[0]*a6*(2.0*a6-1.0)*b/r;
 		pairForce->x = -factor*dr.x;
@@ -7,17 +7,31 @@
 #ifndef __POTENTIAL_H__
 #define __POTENTIAL_H__
 
+//! How a pair potential treats two atoms closer than its hard core (r <= delta for slj)
+enum overlapPolicy {
+	OVERLAP_ABORT,      //!< Zero the pair's force and energy, and throw once the force calculation is complete
+	OVERLAP_CLAMP,      //!< Evaluate the pair at r = delta + 0.01 sigma, just outside the core (the GPU used to clamp every overlap, to r^2 = 1.0001 delta^2)
+	OVERLAP_SOFTCORE    //!< Continue the potential linearly inside a soft core radius so the force is capped
+};
+
+//! Overlap policy and counter each thread hands to a pair potential, so overlaps are reported without throwing from a parallel region
+struct overlapState {
+	int policy;         //!< An overlapPolicy
+	float softCore;     //!< Soft core radius (for OVERLAP_SOFTCORE) in units of sigma, measured from the hard core
+	int count;          //!< Number of overlapping pairs found by this thread
+};
+
 #ifdef NVCC
 // These functions actually exist in integrator.cu because of how they must be compiled
-__device__ float dev_pairUF (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut);
-__device__ float dev_slj (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut);
+__device__ float dev_pairUF (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut, overlapState *ov);
+__device__ float dev_slj (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut, overlapState *ov);
 #else
 #include "dataTypes.h"
-float pairUF (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut);
-float slj (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut);
+float pairUF (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut, overlapState *ov);
+float slj (const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut, overlapState *ov);
 #endif
 
 //!< Function pointer that all force calculation (pair potentials) must follow
-typedef float(*pointFunction_t)(const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut);
+typedef float(*pointFunction_t)(const float3 *p1, const float3 *p2, float3 *pairForce, const float3 *box, const float *args, const float *rcut, overlapState *ov);
 
 #endif
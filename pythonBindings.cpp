@@ -0,0 +1,609 @@
+/*!
+ * Python extension module (cbemd) exposing systemDefinition and the integrators
+ * \date 10/19/26
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stddef.h>
+#include <exception>
+#include <string>
+#include <vector>
+#include "system.h"
+#include "potential.h"
+#include "integrator.h"
+#include "nve.h"
+#include "nvt.h"
+#include "npt.h"
+
+/*!
+ * Usage from Python (build with make PYTHON, which produces cbemd.so):
+ *
+ *   import cbemd, numpy as np
+ *   s = cbemd.System()
+ *   s.setBox(12, 12, 12); s.setTemp(1.0); s.setMass(1.0); s.setRcut(2.5); s.setRskin(0.3)
+ *   s.initThermal(1000, 1.0, 3145, 1.2)
+ *   s.setLJ(1.0, 1.0)
+ *   nvt = cbemd.NVT(1.0)
+ *   x = np.asarray(s.positions())     # (N, 3) float32 view of every atom's position, no copy
+ *   nvt.step(s, 100)                  # x now holds the positions after 100 steps
+ *
+ * positions(), velocities() and accelerations() return memoryviews which alias the atoms themselves (strided, since the three vectors are
+ * interleaved in each atom).  They are writable, so coordinates may also be changed in place.  While any view is alive the number of atoms
+ * cannot change, since that could move the atoms; initThermal() and initRandom() raise BufferError instead.
+ *
+ * step() runs without the interpreter lock.  For its duration it holds a reference to the system and the integrator and flags both as
+ * busy: any method that changes either (and a second step() of either) raises RuntimeError until it returns, and neither can be freed
+ * before then.  Views may still be read while the system is stepped, but see the positions of whichever step is in progress.
+ */
+
+//! Python object owning a systemDefinition
+struct systemObject {
+	PyObject_HEAD
+	systemDefinition *sys;  //!< Wrapped system
+	Py_ssize_t exports;     //!< Number of buffers currently exported over the atoms
+	bool busy;              //!< Flag for whether an integrator is stepping the system without the interpreter lock
+};
+
+//! Python object exporting one of the vectors of every atom through the buffer protocol
+struct atomViewObject {
+	PyObject_HEAD
+	systemObject *owner;    //!< System whose atoms are exported (a reference is held)
+	Py_ssize_t offset;      //!< Byte offset of the vector within an atom
+	Py_ssize_t shape[2];    //!< Number of atoms and 3
+	Py_ssize_t strides[2];  //!< Bytes between atoms and between components
+};
+
+//! Python object owning an integrator (the NVE, NVT and NPT types derive from it)
+struct integratorObject {
+	PyObject_HEAD
+	integrator *ig;         //!< Wrapped integrator
+	bool busy;              //!< Flag for whether the integrator is stepping a system without the interpreter lock
+};
+
+/*!
+ * Translate the exception currently being handled into a Python RuntimeError.
+ */
+static PyObject* raiseFromException (const std::exception &e) {
+	PyErr_SetString(PyExc_RuntimeError, e.what());
+	return NULL;
+}
+
+/*!
+ * Check a system is not being stepped, which would race with any change to it.
+ */
+static bool checkIdle (systemObject *self) {
+	if (self->busy) {
+		PyErr_SetString(PyExc_RuntimeError, "the system is being stepped by another thread");
+		return false;
+	}
+	return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// atom views
+
+static void atomView_dealloc (atomViewObject *self) {
+	Py_XDECREF(self->owner);
+	Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+/*!
+ * Export the vector as a (N, 3) float32 array aliasing the atoms.  Consumers must accept strides, as NumPy and memoryview do.
+ */
+static int atomView_getbuffer (atomViewObject *self, Py_buffer *view, int flags) {
+	if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+		PyErr_SetString(PyExc_BufferError, "atom vectors are interleaved, the consumer must accept strides");
+		view->obj = NULL;
+		return -1;
+	}
+	if ((flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS || (flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS || (flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS) {
+		PyErr_SetString(PyExc_BufferError, "atom vectors are interleaved and not contiguous");
+		view->obj = NULL;
+		return -1;
+	}
+	systemDefinition *sys = self->owner->sys;
+	if (sys->numAtoms() != self->shape[0]) {
+		PyErr_SetString(PyExc_BufferError, "the number of atoms changed since this view was created");
+		view->obj = NULL;
+		return -1;
+	}
+	char *base = sys->numAtoms() > 0 ? (char*) &sys->atoms[0] : NULL;
+	view->buf = base + self->offset;
+	view->obj = (PyObject*) self;
+	Py_INCREF(self);
+	view->len = self->shape[0]*3*sizeof(float);
+	view->readonly = 0;
+	view->itemsize = sizeof(float);
+	view->format = (flags & PyBUF_FORMAT) ? (char*) "f" : NULL;
+	view->ndim = 2;
+	view->shape = self->shape;
+	view->strides = self->strides;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	self->owner->exports++;
+	return 0;
+}
+
+static void atomView_releasebuffer (atomViewObject *self, Py_buffer *view) {
+	self->owner->exports--;
+}
+
+static PyBufferProcs atomView_as_buffer = {
+	(getbufferproc) atomView_getbuffer,
+	(releasebufferproc) atomView_releasebuffer
+};
+
+static PyTypeObject atomViewType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"cbemd.AtomView",                       // tp_name
+	sizeof(atomViewObject),                 // tp_basicsize
+};
+
+/*!
+ * Make a memoryview over one vector of every atom of a system.
+ *
+ * \param [in] owner System
+ * \param [in] offset Byte offset of the vector within an atom
+ */
+static PyObject* newAtomView (systemObject *owner, const size_t offset) {
+	atomViewObject *v = PyObject_New(atomViewObject, &atomViewType);
+	if (v == NULL) {
+		return NULL;
+	}
+	Py_INCREF(owner);
+	v->owner = owner;
+	v->offset = offset;
+	v->shape[0] = owner->sys->numAtoms();
+	v->shape[1] = 3;
+	v->strides[0] = sizeof(atom);
+	v->strides[1] = sizeof(float);
+	PyObject *mv = PyMemoryView_FromObject((PyObject*) v);
+	Py_DECREF(v);
+	return mv;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// systems
+
+static PyObject* system_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
+	systemObject *self = (systemObject*) type->tp_alloc(type, 0);
+	if (self == NULL) {
+		return NULL;
+	}
+	self->sys = new systemDefinition;
+	self->sys->potential = NULL;
+	self->exports = 0;
+	self->busy = false;
+	return (PyObject*) self;
+}
+
+/*!
+ * Never runs while the system is stepped, since step() holds a reference to it.
+ */
+static void system_dealloc (systemObject *self) {
+	delete self->sys;
+	Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+static PyObject* system_setBox (systemObject *self, PyObject *args) {
+	float x, y, z;
+	if (!PyArg_ParseTuple(args, "fff", &x, &y, &z)) return NULL;
+	if (!checkIdle(self)) return NULL;
+	self->sys->setBox(x, y, z);
+	Py_RETURN_NONE;
+}
+
+static PyObject* system_box (systemObject *self, PyObject *noargs) {
+	const float3 box = self->sys->box();
+	return Py_BuildValue("(fff)", box.x, box.y, box.z);
+}
+
+static PyObject* system_setTemp (systemObject *self, PyObject *args) {
+	float T;
+	if (!PyArg_ParseTuple(args, "f", &T)) return NULL;
+	if (!checkIdle(self)) return NULL;
+	self->sys->setTemp(T);
+	Py_RETURN_NONE;
+}
+
+static PyObject* system_setPressure (systemObject *self, PyObject *args) {
+	float P;
+	if (!PyArg_ParseTuple(args, "f", &P)) return NULL;
+	if (!checkIdle(self)) return NULL;
+	self->sys->setPressure(P);
+	Py_RETURN_NONE;
+}
+
+static PyObject* system_setMass (systemObject *self, PyObject *args) {
+	float m;
+	if (!PyArg_ParseTuple(args, "f", &m)) return NULL;
+	if (!checkIdle(self)) return NULL;
+	self->sys->setMass(m);
+	Py_RETURN_NONE;
+}
+
+static PyObject* system_setRcut (systemObject *self, PyObject *args) {
+	float rc;
+	if (!PyArg_ParseTuple(args, "f", &rc)) return NULL;
+	if (!checkIdle(self)) return NULL;
+	self->sys->setRcut(rc);
+	Py_RETURN_NONE;
+}
+
+static PyObject* system_setRskin (systemObject *self, PyObject *args) {
+	float rs;
+	if (!PyArg_ParseTuple(args, "f", &rs)) return NULL;
+	if (!checkIdle(self)) return NULL;
+	self->sys->setRskin(rs);
+	Py_RETURN_NONE;
+}
+
+static PyObject* system_initThermal (systemObject *self, PyObject *args) {
+	int N, seed;
+	float T, dx;
+	if (!PyArg_ParseTuple(args, "ifif", &N, &T, &seed, &dx)) return NULL;
+	if (!checkIdle(self)) return NULL;
+	if (self->exports > 0) {
+		PyErr_SetString(PyExc_BufferError, "cannot reinitialize the atoms while views of them exist");
+		return NULL;
+	}
+	try {
+		self->sys->initThermal(N, T, seed, dx);
+	} catch (std::exception &e) {
+		return raiseFromException(e);
+	}
+	Py_RETURN_NONE;
+}
+
+static PyObject* system_initRandom (systemObject *self, PyObject *args) {
+	int N, seed;
+	if (!PyArg_ParseTuple(args, "ii", &N, &seed)) return NULL;
+	if (!checkIdle(self)) return NULL;
+	if (self->exports > 0) {
+		PyErr_SetString(PyExc_BufferError, "cannot reinitialize the atoms while views of them exist");
+		return NULL;
+	}
+	try {
+		self->sys->initRandom(N, seed);
+	} catch (std::exception &e) {
+		return raiseFromException(e);
+	}
+	Py_RETURN_NONE;
+}
+
+static PyObject* system_setLJ (systemObject *self, PyObject *args) {
+	float eps, sigma, delta = 0.0, ushift = 0.0;
+	if (!PyArg_ParseTuple(args, "ff|ff", &eps, &sigma, &delta, &ushift)) return NULL;
+	if (!checkIdle(self)) return NULL;
+	std::vector <float> potArgs (5, 0.0);
+	potArgs[0] = eps;
+	potArgs[1] = sigma;
+	potArgs[2] = delta;
+	potArgs[3] = ushift;
+	self->sys->setPotential(slj);
+	self->sys->setPotentialArgs(potArgs);
+	Py_RETURN_NONE;
+}
+
+static PyObject* system_setOverlapPolicy (systemObject *self, PyObject *args) {
+	int policy;
+	float softCore = 0.8;
+	if (!PyArg_ParseTuple(args, "i|f", &policy, &softCore)) return NULL;
+	if (!checkIdle(self)) return NULL;
+	if (policy < OVERLAP_ABORT || policy > OVERLAP_SOFTCORE) {
+		PyErr_SetString(PyExc_ValueError, "unknown overlap policy");
+		return NULL;
+	}
+	try {
+		self->sys->setOverlapPolicy((overlapPolicy) policy, softCore);
+	} catch (std::exception &e) {
+		return raiseFromException(e);
+	}
+	Py_RETURN_NONE;
+}
+
+static PyObject* system_numAtoms (systemObject *self, PyObject *noargs) {return PyLong_FromLong(self->sys->numAtoms());}
+static PyObject* system_KinE (systemObject *self, PyObject *noargs) {return PyFloat_FromDouble(self->sys->KinE());}
+static PyObject* system_PotE (systemObject *self, PyObject *noargs) {return PyFloat_FromDouble(self->sys->PotE());}
+static PyObject* system_instantT (systemObject *self, PyObject *noargs) {return PyFloat_FromDouble(self->sys->instantT());}
+static PyObject* system_pressure (systemObject *self, PyObject *noargs) {return PyFloat_FromDouble(self->sys->pressure());}
+static PyObject* system_positions (systemObject *self, PyObject *noargs) {return newAtomView(self, offsetof(atom, pos));}
+static PyObject* system_velocities (systemObject *self, PyObject *noargs) {return newAtomView(self, offsetof(atom, vel));}
+static PyObject* system_accelerations (systemObject *self, PyObject *noargs) {return newAtomView(self, offsetof(atom, acc));}
+
+static PyObject* system_stepping (systemObject *self, PyObject *noargs) {return PyBool_FromLong(self->busy);}
+
+static PyObject* system_writeSnapshot (systemObject *self, PyObject *noargs) {
+	if (!checkIdle(self)) return NULL;
+	self->sys->writeSnapshot();
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef system_methods[] = {
+	{"setBox", (PyCFunction) system_setBox, METH_VARARGS, "setBox(x, y, z): assign the simulation box size"},
+	{"box", (PyCFunction) system_box, METH_NOARGS, "box(): report the box dimensions"},
+	{"setTemp", (PyCFunction) system_setTemp, METH_VARARGS, "setTemp(T): assign the target temperature"},
+	{"setPressure", (PyCFunction) system_setPressure, METH_VARARGS, "setPressure(P): assign the target pressure"},
+	{"setMass", (PyCFunction) system_setMass, METH_VARARGS, "setMass(m): assign the mass of each particle"},
+	{"setRcut", (PyCFunction) system_setRcut, METH_VARARGS, "setRcut(rc): assign the cutoff radius of the pair potential"},
+	{"setRskin", (PyCFunction) system_setRskin, METH_VARARGS, "setRskin(rs): assign the skin radius of the cell lists"},
+	{"initThermal", (PyCFunction) system_initThermal, METH_VARARGS, "initThermal(N, T, seed, dx): place N atoms on a lattice of spacing dx with velocities at temperature T"},
+	{"initRandom", (PyCFunction) system_initRandom, METH_VARARGS, "initRandom(N, seed): place N atoms on a lattice with random velocities"},
+	{"setLJ", (PyCFunction) system_setLJ, METH_VARARGS, "setLJ(epsilon, sigma, delta=0, ushift=0): use the shifted Lennard-Jones pair potential"},
+	{"setOverlapPolicy", (PyCFunction) system_setOverlapPolicy, METH_VARARGS, "setOverlapPolicy(policy, softCore=0.8): choose how overlapping atoms are treated (OVERLAP_ABORT, OVERLAP_CLAMP or OVERLAP_SOFTCORE)"},
+	{"numAtoms", (PyCFunction) system_numAtoms, METH_NOARGS, "numAtoms(): report the number of atoms"},
+	{"KinE", (PyCFunction) system_KinE, METH_NOARGS, "KinE(): report the kinetic energy"},
+	{"PotE", (PyCFunction) system_PotE, METH_NOARGS, "PotE(): report the potential energy"},
+	{"instantT", (PyCFunction) system_instantT, METH_NOARGS, "instantT(): report the instantaneous temperature"},
+	{"pressure", (PyCFunction) system_pressure, METH_NOARGS, "pressure(): report the instantaneous pressure (only computed by NPT)"},
+	{"positions", (PyCFunction) system_positions, METH_NOARGS, "positions(): (N, 3) float32 memoryview aliasing every atom's position"},
+	{"velocities", (PyCFunction) system_velocities, METH_NOARGS, "velocities(): (N, 3) float32 memoryview aliasing every atom's velocity"},
+	{"accelerations", (PyCFunction) system_accelerations, METH_NOARGS, "accelerations(): (N, 3) float32 memoryview aliasing every atom's acceleration (the force divided by the mass)"},
+	{"stepping", (PyCFunction) system_stepping, METH_NOARGS, "stepping(): report if an integrator is stepping the system, during which it cannot be changed"},
+	{"writeSnapshot", (PyCFunction) system_writeSnapshot, METH_NOARGS, "writeSnapshot(): append the positions to trajectory.xyz"},
+	{NULL}
+};
+
+static PyTypeObject systemType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"cbemd.System",                         // tp_name
+	sizeof(systemObject),                   // tp_basicsize
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// integrators
+
+/*!
+ * Never runs while the integrator is stepping, since step() holds a reference to it.
+ */
+static void integrator_dealloc (integratorObject *self) {
+	delete self->ig;
+	Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+static PyObject* integrator_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
+	integratorObject *self = (integratorObject*) type->tp_alloc(type, 0);
+	if (self != NULL) {
+		self->ig = NULL;
+		self->busy = false;
+	}
+	return (PyObject*) self;
+}
+
+/*!
+ * Check an integrator is not stepping a system, so it may be changed or replaced.
+ */
+static bool checkIntegratorIdle (integratorObject *self) {
+	if (self->busy) {
+		PyErr_SetString(PyExc_RuntimeError, "the integrator is stepping a system in another thread");
+		return false;
+	}
+	return true;
+}
+
+static int nve_init (integratorObject *self, PyObject *args, PyObject *kwds) {
+	if (!PyArg_ParseTuple(args, "")) return -1;
+	if (!checkIntegratorIdle(self)) return -1;
+	delete self->ig;
+	self->ig = new nve;
+	return 0;
+}
+
+static int nvt_init (integratorObject *self, PyObject *args, PyObject *kwds) {
+	float Q;
+	if (!PyArg_ParseTuple(args, "f", &Q)) return -1;
+	if (!checkIntegratorIdle(self)) return -1;
+	delete self->ig;
+	self->ig = new nvt_NH (Q);
+	return 0;
+}
+
+static int npt_init (integratorObject *self, PyObject *args, PyObject *kwds) {
+	float tauT, tauP;
+	if (!PyArg_ParseTuple(args, "ff", &tauT, &tauP)) return -1;
+	if (!checkIntegratorIdle(self)) return -1;
+	try {
+		integrator *ig = new npt_MTK (tauT, tauP);
+		delete self->ig;
+		self->ig = ig;
+	} catch (std::exception &e) {
+		raiseFromException(e);
+		return -1;
+	}
+	return 0;
+}
+
+/*!
+ * Check an integrator was constructed by one of the derived types.
+ */
+static bool checkIntegrator (integratorObject *self) {
+	if (self->ig == NULL) {
+		PyErr_SetString(PyExc_TypeError, "use one of the NVE, NVT or NPT integrators");
+		return false;
+	}
+	return true;
+}
+
+/*!
+ * Advance a system nsteps.  The interpreter lock is released while the integrator runs, so other Python threads may continue; the
+ * system and the integrator are kept alive and flagged as busy until it is taken back, so those threads cannot change or free them.
+ */
+static PyObject* integrator_step (integratorObject *self, PyObject *args) {
+	systemObject *s;
+	int nsteps = 1;
+	if (!PyArg_ParseTuple(args, "O!|i", &systemType, &s, &nsteps)) return NULL;
+	if (!checkIntegrator(self)) return NULL;
+	if (s->sys->potential == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "the system has no pair potential, see System.setLJ()");
+		return NULL;
+	}
+	if (!checkIdle(s) || !checkIntegratorIdle(self)) return NULL;
+	Py_INCREF(s);
+	Py_INCREF(self);
+	s->busy = true;
+	self->busy = true;
+	bool failed = false;
+	std::string msg;
+	Py_BEGIN_ALLOW_THREADS
+	try {
+		for (int i = 0; i < nsteps; ++i) {
+			self->ig->step(*s->sys);
+		}
+	} catch (std::exception &e) {
+		failed = true;
+		msg = e.what();
+	}
+	Py_END_ALLOW_THREADS
+	s->busy = false;
+	self->busy = false;
+	Py_DECREF(self);
+	Py_DECREF(s);
+	if (failed) {
+		PyErr_SetString(PyExc_RuntimeError, msg.c_str());
+		return NULL;
+	}
+	Py_RETURN_NONE;
+}
+
+static PyObject* integrator_setTimestep (integratorObject *self, PyObject *args) {
+	float dt;
+	if (!PyArg_ParseTuple(args, "f", &dt)) return NULL;
+	if (!checkIntegrator(self) || !checkIntegratorIdle(self)) return NULL;
+	self->ig->setTimestep(dt);
+	Py_RETURN_NONE;
+}
+
+static PyObject* integrator_timestep (integratorObject *self, PyObject *noargs) {
+	if (!checkIntegrator(self)) return NULL;
+	return PyFloat_FromDouble(self->ig->timestep());
+}
+
+static PyObject* integrator_setAdaptiveTimestep (integratorObject *self, PyObject *args) {
+	float dtMin, dtMax, maxDisp = 0.03, energyTol = 1.0e-4;
+	if (!PyArg_ParseTuple(args, "ff|ff", &dtMin, &dtMax, &maxDisp, &energyTol)) return NULL;
+	if (!checkIntegrator(self) || !checkIntegratorIdle(self)) return NULL;
+	try {
+		self->ig->setAdaptiveTimestep(dtMin, dtMax, maxDisp, energyTol);
+	} catch (std::exception &e) {
+		return raiseFromException(e);
+	}
+	Py_RETURN_NONE;
+}
+
+static PyObject* integrator_conservedEnergy (integratorObject *self, PyObject *args) {
+	systemObject *s;
+	if (!PyArg_ParseTuple(args, "O!", &systemType, &s)) return NULL;
+	if (!checkIntegrator(self) || !checkIdle(s) || !checkIntegratorIdle(self)) return NULL;
+	return PyFloat_FromDouble(self->ig->conservedEnergy(*s->sys));
+}
+
+static PyObject* integrator_overlaps (integratorObject *self, PyObject *noargs) {
+	if (!checkIntegrator(self)) return NULL;
+	return PyLong_FromLong(self->ig->overlaps());
+}
+
+static PyMethodDef integrator_methods[] = {
+	{"step", (PyCFunction) integrator_step, METH_VARARGS, "step(system, nsteps=1): advance the system nsteps"},
+	{"setTimestep", (PyCFunction) integrator_setTimestep, METH_VARARGS, "setTimestep(dt): set the timestep"},
+	{"timestep", (PyCFunction) integrator_timestep, METH_NOARGS, "timestep(): report the timestep"},
+	{"setAdaptiveTimestep", (PyCFunction) integrator_setAdaptiveTimestep, METH_VARARGS, "setAdaptiveTimestep(dtMin, dtMax, maxDisp=0.03, energyTol=1e-4): let the timestep vary"},
+	{"conservedEnergy", (PyCFunction) integrator_conservedEnergy, METH_VARARGS, "conservedEnergy(system): report the quantity the integrator conserves"},
+	{"overlaps", (PyCFunction) integrator_overlaps, METH_NOARGS, "overlaps(): report how many overlapping pairs the last force calculation found"},
+	{NULL}
+};
+
+static PyTypeObject integratorType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"cbemd.Integrator",                     // tp_name
+	sizeof(integratorObject),               // tp_basicsize
+};
+
+static PyTypeObject nveType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"cbemd.NVE",                            // tp_name
+	sizeof(integratorObject),               // tp_basicsize
+};
+
+static PyTypeObject nvtType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"cbemd.NVT",                            // tp_name
+	sizeof(integratorObject),               // tp_basicsize
+};
+
+static PyTypeObject nptType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"cbemd.NPT",                            // tp_name
+	sizeof(integratorObject),               // tp_basicsize
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// module
+
+static PyModuleDef cbemdModule = {
+	PyModuleDef_HEAD_INIT,
+	"cbemd",
+	"Molecular dynamics with systems, integrators and zero-copy views of the atoms",
+	-1,
+	NULL
+};
+
+/*!
+ * Fill in the type objects (done here rather than with designated initializers, which C++03 lacks) and add them to the module.
+ */
+PyMODINIT_FUNC PyInit_cbemd (void) {
+	atomViewType.tp_dealloc = (destructor) atomView_dealloc;
+	atomViewType.tp_as_buffer = &atomView_as_buffer;
+	atomViewType.tp_flags = Py_TPFLAGS_DEFAULT;
+	atomViewType.tp_doc = "Buffer over one vector of every atom of a System";
+
+	systemType.tp_new = system_new;
+	systemType.tp_dealloc = (destructor) system_dealloc;
+	systemType.tp_flags = Py_TPFLAGS_DEFAULT;
+	systemType.tp_methods = system_methods;
+	systemType.tp_doc = "System definition: box, atoms, pair potential and thermodynamic targets";
+
+	integratorType.tp_new = integrator_new;
+	integratorType.tp_dealloc = (destructor) integrator_dealloc;
+	integratorType.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+	integratorType.tp_methods = integrator_methods;
+	integratorType.tp_doc = "Base of the integrators";
+
+	nveType.tp_base = &integratorType;
+	nveType.tp_init = (initproc) nve_init;
+	nveType.tp_flags = Py_TPFLAGS_DEFAULT;
+	nveType.tp_doc = "NVE(): velocity Verlet at constant energy";
+	nvtType.tp_base = &integratorType;
+	nvtType.tp_init = (initproc) nvt_init;
+	nvtType.tp_flags = Py_TPFLAGS_DEFAULT;
+	nvtType.tp_doc = "NVT(Q): Nose-Hoover thermostat with damping constant Q";
+	nptType.tp_base = &integratorType;
+	nptType.tp_init = (initproc) npt_init;
+	nptType.tp_flags = Py_TPFLAGS_DEFAULT;
+	nptType.tp_doc = "NPT(tauT, tauP): Martyna-Tobias-Klein barostat and thermostat with these relaxation times";
+
+	PyTypeObject *types[6] = {&atomViewType, &systemType, &integratorType, &nveType, &nvtType, &nptType};
+	for (int i = 0; i < 6; ++i) {
+		if (PyType_Ready(types[i]) < 0) {
+			return NULL;
+		}
+	}
+
+	PyObject *m = PyModule_Create(&cbemdModule);
+	if (m == NULL) {
+		return NULL;
+	}
+	const char *names[5] = {"System", "Integrator", "NVE", "NVT", "NPT"};
+	for (int i = 0; i < 5; ++i) {
+		Py_INCREF(types[i+1]);
+		if (PyModule_AddObject(m, names[i], (PyObject*) types[i+1]) < 0) {
+			Py_DECREF(types[i+1]);
+			Py_DECREF(m);
+			return NULL;
+		}
+	}
+	PyModule_AddIntConstant(m, "OVERLAP_ABORT", OVERLAP_ABORT);
+	PyModule_AddIntConstant(m, "OVERLAP_CLAMP", OVERLAP_CLAMP);
+	PyModule_AddIntConstant(m, "OVERLAP_SOFTCORE", OVERLAP_SOFTCORE);
+	return m;
+}
@@ -0,0 +1,73 @@
+#include "system.h"
+#include "potential.h"
+#include "integrator.h"
+#include "nvt.h"
+#include "replicaExchange.h"
+#include <iostream>
+#include <sstream>
+#include "utils.h"
+#include <omp.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*!
+ * Invoke the program as
+ * $ ./remd numThreads natoms nsteps every Tmin Tmax nreplicas [seed] > log
+ * Runs parallel tempering of shifted Lennard-Jones atoms at the density of the timing runs over nreplicas temperatures spaced
+ * geometrically from Tmin to Tmax, attempting swaps every so many steps.  Replica i writes its thermodynamics to replica_i.dat; the
+ * acceptance of every pair of temperatures and the round trips of every replica are written to stdout.
+ */
+int main (int argc, char* argv[]) {
+	if (argc < 8 || argc > 9) {
+		// catch incorrect number of arguments
+		printf("USAGE: %s <nthreads> <natoms> <nsteps> <every> <Tmin> <Tmax> <nreplicas> [seed] \n",argv[0]);
+		exit(1);
+	}
+	const int nthreads = atoi(argv[1]);
+	const int nAtoms = atoi(argv[2]);
+	const int nSteps = atoi(argv[3]);
+	const int every = atoi(argv[4]);
+	const float Tmin = atof(argv[5]);
+	const float Tmax = atof(argv[6]);
+	const int M = atoi(argv[7]);
+	const int rngSeed = (argc == 9) ? atoi(argv[8]) : 3145;
+	const float timestep = 0.005;
+	const double L = pow(2.0*nAtoms, 1.0/3.0);
+	const float dx = 0.999*L/ceil(pow(nAtoms, 1.0/3.0));
+
+	std::vector <float> T (M);
+	for (int k = 0; k < M; ++k) {
+		T[k] = (M > 1) ? Tmin*pow(Tmax/Tmin, k/(M-1.0)) : Tmin;
+	}
+	std::vector <systemDefinition> systems (M);
+	std::vector <nvt_NH> integrators (M, nvt_NH (1.0));
+	try {
+		replicaExchange remd (T, every, rngSeed);
+		for (int k = 0; k < M; ++k) {
+			systemDefinition &a = systems[k];
+			a.setBox(L, L, L);
+			a.setTemp(T[k]);
+			a.setMass(1.0);
+			a.setRskin(0.3);
+			a.setRcut(2.5);
+			a.initThermal(nAtoms, T[k], rngSeed+k, dx);
+			a.setPotential(slj);
+			std::vector <float> args(5);
+			args[0] = 1.0; // epsilon
+			args[1] = 1.0; // sigma
+			args[2] = 0.0; // delta
+			args[3] = 0.0; // ushift
+			a.setPotentialArgs(args);
+			integrators[k].setTimestep(timestep);
+			std::ostringstream name;
+			name << "replica_" << k << ".dat";
+			remd.addReplica(&a, &integrators[k], name.str());
+		}
+		remd.run(nSteps, nthreads);
+		remd.report(std::cout);
+	} catch (customException &ce) {
+		std::cerr << ce.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*!
+ * Replica exchange (parallel tempering) molecular dynamics
+ * \date 10/19/26
+ */
+
+#include "replicaExchange.h"
+#include "common.h"
+#include <stdlib.h>
+#include <math.h>
+
+/*!
+ * \param [in] temperatures Temperature ladder, in increasing order
+ * \param [in] every Number of steps between swap attempts
+ * \param [in] rngSeed Seed of the random numbers of the Metropolis test
+ * \param [in] atomsPerThread Atoms per thread of each replica's team (see ensembleRunner)
+ */
+replicaExchange::replicaExchange (const std::vector <float> &temperatures, const int every, const int rngSeed, const int atomsPerThread) : runner_ (atomsPerThread) {
+	if (temperatures.empty() || every < 1) {
+		throw customException ("Replica exchange needs at least one temperature and swaps at least every 1 step");
+		return;
+	}
+	for (unsigned int k = 0; k < temperatures.size(); ++k) {
+		if (temperatures[k] <= 0.0 || (k > 0 && temperatures[k] <= temperatures[k-1])) {
+			throw customException ("Replica exchange temperatures must be positive and increasing");
+			return;
+		}
+	}
+	T_ = temperatures;
+	every_ = every;
+	seed_ = rngSeed;
+	parity_ = 0;
+	attempts_.assign(T_.size()-1, 0);
+	accepted_.assign(T_.size()-1, 0);
+}
+
+/*!
+ * Add a replica, which starts at the next temperature of the ladder; its target temperature is set to it.  Its velocities should
+ * already be drawn at that temperature.
+ *
+ * \param [in] sys System
+ * \param [in] integrate Integrator
+ * \param [in] output File to write the replica's thermodynamics to (see ensembleRunner), or empty for none
+ * \return Index of the replica
+ */
+int replicaExchange::addReplica (systemDefinition *sys, nvt_NH *integrate, const std::string &output) {
+	const int r = sys_.size();
+	if (r >= (int) T_.size()) {
+		throw customException ("Replica exchange already has a replica at every temperature");
+		return -1;
+	}
+	if (sys == NULL || integrate == NULL) {
+		throw customException ("A replica needs a system and an integrator");
+		return -1;
+	}
+	sys->setTemp(T_[r]);
+	runner_.addReplica(sys, integrate, 0, output, every_);
+	sys_.push_back(sys);
+	integrators_.push_back(integrate);
+	replicaAt_.push_back(r);
+	tempOf_.push_back(r);
+	heading_.push_back(0);
+	trips_.push_back(0);
+	return r;
+}
+
+/*!
+ * Run every replica nSteps further, concurrently, attempting swaps whenever the step count reaches a multiple of the swap interval.
+ *
+ * \param [in] nSteps Number of steps
+ * \param [in] nThreads Number of threads to share between the replicas, or 0 for omp_get_max_threads()
+ */
+void replicaExchange::run (const int nSteps, const int nThreads) {
+	if (sys_.size() != T_.size()) {
+		throw customException ("Replica exchange needs a replica at every temperature");
+		return;
+	}
+	for (unsigned int r = 0; r < sys_.size(); ++r) {
+		runner_.addSteps(r, nSteps);
+	}
+	const int end = runner_.stepsDone(0) + nSteps;
+	visit_();
+	while (runner_.stepsDone(0) < end) {
+		runner_.run(nThreads, every_ - runner_.stepsDone(0)%every_);
+		if (runner_.stepsDone(0)%every_ == 0) {
+			exchange_();
+		}
+	}
+}
+
+/*!
+ * \return Uniform random number in (0, 1)
+ */
+double replicaExchange::uniform_ () {
+	return (rand_r(&seed_) + 0.5)/(RAND_MAX + 1.0);
+}
+
+/*!
+ * Attempt to swap the replicas at temperatures k and k+1 for every k of the current parity, then switch parity.
+ */
+void replicaExchange::exchange_ () {
+	const int M = T_.size();
+	for (int k = parity_; k+1 < M; k += 2) {
+		const int a = replicaAt_[k], b = replicaAt_[k+1];
+		const double delta = (1.0/T_[k] - 1.0/T_[k+1])*((double) sys_[a]->PotE() - sys_[b]->PotE());
+		attempts_[k]++;
+		if (delta >= 0.0 || uniform_() < exp(delta)) {
+			accepted_[k]++;
+			replicaAt_[k] = b;
+			replicaAt_[k+1] = a;
+			tempOf_[a] = k+1;
+			tempOf_[b] = k;
+			integrators_[a]->rescaleTemperature(*sys_[a], T_[k+1]);
+			integrators_[b]->rescaleTemperature(*sys_[b], T_[k]);
+		}
+	}
+	parity_ = 1 - parity_;
+	visit_();
+}
+
+/*!
+ * Note which replicas are at the ends of the ladder, completing a round trip for each one back at the lowest temperature after the highest.
+ */
+void replicaExchange::visit_ () {
+	const int M = T_.size();
+	for (unsigned int r = 0; r < sys_.size(); ++r) {
+		if (tempOf_[r] == 0) {
+			if (heading_[r] < 0) {
+				trips_[r]++;
+			}
+			heading_[r] = 1;
+		} else if (tempOf_[r] == M-1 && heading_[r] > 0) {
+			heading_[r] = -1;
+		}
+	}
+}
+
+/*!
+ * \return Sum of the round trips of every replica
+ */
+int replicaExchange::totalRoundTrips () const {
+	int total = 0;
+	for (unsigned int r = 0; r < trips_.size(); ++r) {
+		total += trips_[r];
+	}
+	return total;
+}
+
+/*!
+ * Write the swaps attempted and accepted between every pair of neighboring temperatures, and the temperature and round trips of every replica.
+ *
+ * \param [in, out] os Stream to write to
+ */
+void replicaExchange::report (std::ostream &os) const {
+	os << "# T_k\tT_k+1\tattempts\taccepted\tacceptance" << std::endl;
+	for (unsigned int k = 0; k < attempts_.size(); ++k) {
+		os << T_[k] << "\t" << T_[k+1] << "\t" << attempts_[k] << "\t" << accepted_[k] << "\t" << acceptance(k) << std::endl;
+	}
+	os << "# replica\tT\tround trips" << std::endl;
+	for (unsigned int r = 0; r < sys_.size(); ++r) {
+		os << r << "\t" << T_[tempOf_[r]] << "\t" << trips_[r] << std::endl;
+	}
+}
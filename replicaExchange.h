@@ -0,0 +1,63 @@
+/*!
+ * Replica exchange (parallel tempering) molecular dynamics
+ * \date 10/19/26
+ */
+
+#ifndef __REPLICA_EXCHANGE_H__
+#define __REPLICA_EXCHANGE_H__
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include "system.h"
+#include "nvt.h"
+#include "ensembleRunner.h"
+
+/*!
+ * Parallel tempering over a ladder of temperatures, one Nose-Hoover replica per temperature.  The replicas are advanced concurrently by
+ * an ensembleRunner for a segment of steps, then swaps between neighboring temperatures are attempted with the Metropolis criterion
+ * min(1, exp((1/T_k - 1/T_k+1)(U_k - U_k+1))), alternating between the even and the odd pairs.  A swap exchanges the temperatures of
+ * two replicas, not their atoms: each keeps its configuration and has its velocities and thermostat rescaled to its new temperature
+ * (see nvt_NH::rescaleTemperature()).  Acceptance is counted for every pair, and a round trip for a replica each time it returns to
+ * the lowest temperature after reaching the highest.
+ * Each run() carries on from the last: swaps stay every so many steps of the whole simulation, and each replica's thermodynamics
+ * (a line at every swap attempt) are appended to its file.
+ */
+class replicaExchange {
+	public:
+		replicaExchange (const std::vector <float> &temperatures, const int every, const int rngSeed=3145, const int atomsPerThread=2000);
+		~replicaExchange () {}
+		int addReplica (systemDefinition *sys, nvt_NH *integrate, const std::string &output="");    //!< Add the replica (not owned) starting at the next temperature of the ladder, returns its index
+		void run (const int nSteps, const int nThreads=0);      //!< Run every replica nSteps further, attempting swaps every so many steps
+		int stepsDone () const {return sys_.empty() ? 0 : runner_.stepsDone(0);}   //!< Report the number of steps every replica has run
+		int numReplicas () const {return sys_.size();}          //!< Report the number of replicas
+		float temperature (const int k) const {return T_[k];}   //!< Report the k-th temperature of the ladder
+		int replicaAt (const int k) const {return replicaAt_[k];}       //!< Report the replica at the k-th temperature
+		int temperatureOf (const int r) const {return tempOf_[r];}      //!< Report the index of the temperature replica r is at
+		int attempts (const int k) const {return attempts_[k];}         //!< Report the number of swaps attempted between temperatures k and k+1
+		int accepted (const int k) const {return accepted_[k];}         //!< Report the number of swaps accepted between temperatures k and k+1
+		double acceptance (const int k) const {return attempts_[k] > 0 ? accepted_[k]/(double) attempts_[k] : 0.0;}   //!< Report the acceptance rate between temperatures k and k+1
+		int roundTrips (const int r) const {return trips_[r];}          //!< Report the number of round trips replica r has made
+		int totalRoundTrips () const;                                   //!< Report the number of round trips of all replicas
+		void report (std::ostream &os) const;                           //!< Write the acceptance of every pair and the round trips of every replica
+
+	private:
+		std::vector <float> T_;         //!< Temperatures, in increasing order
+		int every_;                     //!< Steps between attempts
+		unsigned int seed_;             //!< State of the random number generator
+		int parity_;                    //!< First temperature of the pairs attempted next, 0 or 1
+		std::vector <systemDefinition*> sys_;   //!< System of each replica
+		std::vector <nvt_NH*> integrators_;     //!< Integrator of each replica
+		ensembleRunner runner_;         //!< Runs the replicas, keeping their step counts across calls to run()
+		std::vector <int> replicaAt_;   //!< Replica at each temperature
+		std::vector <int> tempOf_;      //!< Temperature of each replica
+		std::vector <int> attempts_;    //!< Swaps attempted between each pair of neighboring temperatures
+		std::vector <int> accepted_;    //!< Swaps accepted between each pair of neighboring temperatures
+		std::vector <int> heading_;     //!< For each replica, +1 if it last visited the lowest temperature, -1 the highest, 0 neither
+		std::vector <int> trips_;       //!< Round trips of each replica
+		double uniform_ ();             //!< Uniform random number in (0, 1)
+		void exchange_ ();              //!< Attempt swaps between the pairs of this parity
+		void visit_ ();                 //!< Update the round trips after swaps
+};
+
+#endif
@@ -0,0 +1,218 @@
+/*!
+ * Static structure factor accumulated during a simulation
+ * \date 10/19/26
+ */
+
+#include "structureFactor.h"
+#include "common.h"
+#include <fstream>
+#include <algorithm>
+#include <math.h>
+#include <omp.h>
+
+/*!
+ * Instantiate an empty accumulator.
+ *
+ * \param [in] kmax Largest wavevector
+ * \param [in] every Number of steps between samples
+ * \param [in] dk Width of the shells; if not positive, the smallest wavevector of the first box sampled
+ */
+structureFactor::structureFactor (const float kmax, const int every, const float dk) {
+	if (kmax <= 0.0 || every < 1) {
+		throw customException ("The structure factor needs a positive kmax and to be sampled at least every 1 step");
+		return;
+	}
+	kmax_ = kmax;
+	every_ = every;
+	dk_ = dk;
+	samples_ = 0;
+	box_.x = -1.0;
+	box_.y = -1.0;
+	box_.z = -1.0;
+	for (int d = 0; d < 3; ++d) {
+		nmax_[d] = 0;
+	}
+	if (dk_ > 0.0) {
+		sk_.assign((int) (kmax_/dk_)+1, 0.0);
+		count_.assign(sk_.size(), 0.0);
+	}
+}
+
+/*!
+ * Generate the wavevectors with nx > 0, or nx = 0 and ny > 0, or nx = ny = 0 and nz > 0, and |k| <= kmax, in rows of consecutive nz
+ * sharing (nx, ny).
+ *
+ * \param [in] box Box dimensions
+ */
+void structureFactor::setup_ (const float3 &box) {
+	box_ = box;
+	if (dk_ <= 0.0) {
+		dk_ = 2.0*M_PI/std::max(box.x, std::max(box.y, box.z));
+		sk_.assign((int) (kmax_/dk_)+1, 0.0);
+		count_.assign(sk_.size(), 0.0);
+	}
+	const double L[3] = {box.x, box.y, box.z};
+	for (int d = 0; d < 3; ++d) {
+		nmax_[d] = (int) (kmax_*L[d]/(2.0*M_PI));
+	}
+
+	row_.clear();
+	rowStart_.assign(1, 0);
+	shell_.clear();
+	for (int nx = 0; nx <= nmax_[0]; ++nx) {
+		for (int ny = (nx == 0 ? 0 : -nmax_[1]); ny <= nmax_[1]; ++ny) {
+			const double kx = 2.0*M_PI*nx/L[0], ky = 2.0*M_PI*ny/L[1];
+			int3 r;
+			r.x = nx; r.y = ny; r.z = nmax_[2]+1;
+			for (int nz = (nx == 0 && ny == 0 ? 1 : -nmax_[2]); nz <= nmax_[2]; ++nz) {
+				const double kz = 2.0*M_PI*nz/L[2];
+				const double k = sqrt(kx*kx + ky*ky + kz*kz);
+				if (k <= kmax_) {
+					r.z = std::min(r.z, nz);
+					shell_.push_back((int) (k/dk_));
+				}
+			}
+			if ((int) shell_.size() > rowStart_.back()) {
+				row_.push_back(r);
+				rowStart_.push_back(shell_.size());
+			}
+		}
+	}
+	if (shell_.empty()) {
+		throw customException ("The box has no wavevectors shorter than the structure factor's kmax");
+		return;
+	}
+}
+
+/*!
+ * Sample S(k) if this step is a multiple of the sampling interval.
+ *
+ * \param [in] sys System
+ * \param [in] step Current step
+ */
+void structureFactor::update (const systemDefinition &sys, const int step) {
+	if (step%every_ == 0) {
+		sample(sys);
+	}
+}
+
+/*!
+ * Add S(k) of the current positions.  Each thread sums exp(i k.r_j) over its share of the atoms into its own density, building each
+ * atom's phases along every axis by recurrence from one cos and sin, and the threads' densities are then added.
+ *
+ * \param [in] sys System
+ */
+void structureFactor::sample (const systemDefinition &sys) {
+	const float3 box = sys.box();
+	if (box.x != box_.x || box.y != box_.y || box.z != box_.z) {
+		setup_(box);
+	}
+	const int natoms = sys.numAtoms(), nk = shell_.size(), nRows = row_.size();
+	if (natoms == 0) {
+		return;
+	}
+	const int nthreads = omp_get_max_threads();
+	rho_.resize(nthreads);
+	phase_.resize(nthreads);
+	for (int t = 0; t < nthreads; ++t) {
+		rho_[t].assign(2*nk, 0.0);
+	}
+	const int width[3] = {2*nmax_[0]+1, 2*nmax_[1]+1, 2*nmax_[2]+1};
+	const double L[3] = {box.x, box.y, box.z};
+
+	#pragma omp parallel
+	{
+		const int tid = omp_get_thread_num();
+		std::vector <double> &phase = phase_[tid];
+		phase.resize(2*(width[0]+width[1]+width[2]));
+		double *re[3], *im[3];
+		int offset = 0;
+		for (int d = 0; d < 3; ++d) {
+			re[d] = &phase[offset+nmax_[d]];
+			im[d] = &phase[offset+width[d]+nmax_[d]];
+			offset += 2*width[d];
+		}
+		double *rhoRe = &rho_[tid][0], *rhoIm = &rho_[tid][nk];
+
+		#pragma omp for schedule(static)
+		for (int i = 0; i < natoms; ++i) {
+			// exp(i 2 pi n x/L) for n = -nmax..nmax
+			const double x[3] = {sys.atoms[i].pos.x, sys.atoms[i].pos.y, sys.atoms[i].pos.z};
+			for (int d = 0; d < 3; ++d) {
+				const double a = 2.0*M_PI*x[d]/L[d], c = cos(a), s = sin(a);
+				re[d][0] = 1.0;
+				im[d][0] = 0.0;
+				for (int m = 1; m <= nmax_[d]; ++m) {
+					re[d][m] = re[d][m-1]*c - im[d][m-1]*s;
+					im[d][m] = re[d][m-1]*s + im[d][m-1]*c;
+					re[d][-m] = re[d][m];
+					im[d][-m] = -im[d][m];
+				}
+			}
+			for (int r = 0; r < nRows; ++r) {
+				const int nx = row_[r].x, ny = row_[r].y;
+				const double ar = re[0][nx]*re[1][ny] - im[0][nx]*im[1][ny];
+				const double ai = re[0][nx]*im[1][ny] + im[0][nx]*re[1][ny];
+				const double *zr = &re[2][row_[r].z], *zi = &im[2][row_[r].z];
+				double *rr = rhoRe + rowStart_[r], *ri = rhoIm + rowStart_[r];
+				const int len = rowStart_[r+1]-rowStart_[r];
+				for (int k = 0; k < len; ++k) {
+					rr[k] += ar*zr[k] - ai*zi[k];
+					ri[k] += ar*zi[k] + ai*zr[k];
+				}
+			}
+		}
+
+		// add the threads' densities into the first thread's, which then holds |rho_k|^2/N
+		#pragma omp for schedule(static)
+		for (int k = 0; k < nk; ++k) {
+			double sr = 0.0, si = 0.0;
+			for (int t = 0; t < nthreads; ++t) {
+				sr += rho_[t][k];
+				si += rho_[t][nk+k];
+			}
+			rho_[0][k] = (sr*sr + si*si)/natoms;
+		}
+	}
+
+	for (int k = 0; k < nk; ++k) {
+		if (shell_[k] < (int) sk_.size()) {
+			sk_[shell_[k]] += rho_[0][k];
+			count_[shell_[k]] += 1.0;
+		}
+	}
+	samples_++;
+}
+
+/*!
+ * \param [out] k Middle of each shell holding wavevectors
+ * \param [out] S Mean S(k) over the samples and the wavevectors of each shell
+ */
+void structureFactor::result (std::vector <double> &k, std::vector <double> &S) const {
+	k.clear();
+	S.clear();
+	for (unsigned int b = 0; b < sk_.size(); ++b) {
+		if (count_[b] > 0) {
+			k.push_back((b+0.5)*dk_);
+			S.push_back(sk_[b]/count_[b]);
+		}
+	}
+}
+
+/*!
+ * Write the middle of each shell holding wavevectors and its mean S(k), in the format of the analyze tool's sk.dat.
+ *
+ * \param [in] filename File to write
+ */
+void structureFactor::write (const std::string &filename) const {
+	std::ofstream out (filename.c_str());
+	if (!out.is_open()) {
+		throw customException ("Unable to open "+filename);
+		return;
+	}
+	std::vector <double> k, S;
+	result(k, S);
+	for (unsigned int b = 0; b < k.size(); ++b) {
+		out << k[b] << "\t" << S[b] << std::endl;
+	}
+}
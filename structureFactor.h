@@ -0,0 +1,53 @@
+/*!
+ * Static structure factor accumulated during a simulation
+ * \date 10/19/26
+ */
+
+#ifndef __STRUCTURE_FACTOR_H__
+#define __STRUCTURE_FACTOR_H__
+
+#include <vector>
+#include <string>
+#include "dataTypes.h"
+#include "system.h"
+
+/*!
+ * S(k) = |sum_j exp(i k.r_j)|^2/N over the wavevectors k = 2 pi (nx/Lx, ny/Ly, nz/Lz) of the periodic box with 0 < |k| <= kmax, taken in
+ * half of reciprocal space (S(-k) = S(k)) and averaged over shells of width dk.  Call update() after every step; every so many steps
+ * the Fourier sums of the positions are evaluated in parallel, each thread summing its share of the atoms into its own copy of the
+ * density.  The wavevectors are stored as rows of consecutive nz sharing (nx, ny) and the phases exp(i 2 pi n z/Lz) of an atom as
+ * separate real and imaginary arrays, so the innermost loop runs with unit stride along a row and vectorizes.
+ * Wavevectors are regenerated if the box changes (NPT); the shells are fixed, so samples from different boxes average correctly.
+ */
+class structureFactor {
+	public:
+		structureFactor (const float kmax, const int every=1, const float dk=-1.0);
+		~structureFactor () {}
+		void update (const systemDefinition &sys, const int step);  //!< Sample S(k) if this step is a multiple of the interval
+		void sample (const systemDefinition &sys);                  //!< Add S(k) of the current positions
+		void result (std::vector <double> &k, std::vector <double> &S) const;  //!< Report the middle and the mean S(k) of every shell with wavevectors
+		void write (const std::string &filename) const;             //!< Write the shell averaged S(k)
+		int samples () const {return samples_;}     //!< Report the number of samples taken
+		int every () const {return every_;}         //!< Report the number of steps between samples
+		float kmax () const {return kmax_;}         //!< Report the largest wavevector
+		float dk () const {return dk_;}             //!< Report the width of the shells, valid after the first sample if it was not given
+		int numWavevectors () const {return shell_.size();}     //!< Report the number of wavevectors in the current box
+
+	private:
+		float kmax_;        //!< Largest wavevector
+		int every_;         //!< Steps between samples
+		float dk_;          //!< Width of the shells
+		int samples_;       //!< Number of samples taken
+		float3 box_;        //!< Box the wavevectors were generated for
+		int nmax_[3];       //!< Largest wavevector index along each axis
+		std::vector <int3> row_;        //!< nx, ny and the first nz of each row of wavevectors
+		std::vector <int> rowStart_;    //!< Index of the first wavevector of each row, and the total at the end
+		std::vector <int> shell_;       //!< Shell of each wavevector
+		std::vector <double> sk_;       //!< Sum of S(k) over samples and the wavevectors of each shell
+		std::vector <double> count_;    //!< Number of terms summed in each shell
+		std::vector < std::vector <double> > rho_;     //!< Per-thread real then imaginary parts of the density at each wavevector
+		std::vector < std::vector <double> > phase_;   //!< Per-thread real then imaginary parts of exp(i 2 pi n x/L) of one atom along each axis
+		void setup_ (const float3 &box);                //!< Generate the wavevectors of a box
+};
+
+#endif
@@ -27,6 +27,23 @@ void systemDefinition::setPotential (pointFunction_t pp) {
 //#endif
 }
 
+/*!
+ * Choose what the pair potential does when two atoms are closer than its hard core.  Overlaps are always counted (see
+ * integrator::overlaps()); OVERLAP_ABORT makes the integrator throw after the force calculation, OVERLAP_CLAMP evaluates the pair just
+ * outside the core, and OVERLAP_SOFTCORE caps the force at its value a distance softCore*sigma from the core.
+ *
+ * \param [in] policy Overlap policy
+ * \param [in] softCore Soft core radius in units of sigma, measured from the hard core (only used by OVERLAP_SOFTCORE)
+ */
+void systemDefinition::setOverlapPolicy (const overlapPolicy policy, const float softCore) {
+	if (softCore <= 0.0) {
+		throw customException ("Soft core radius must be > 0");
+		return;
+	}
+	overlapPolicy_ = policy;
+	softCore_ = softCore;
+}
+
 /*!
  * Initialize a system of N atoms with random velocities and positions on a lattice.
  * Net momeentum is automatically initialized to zero.
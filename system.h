@@ -16,7 +16,7 @@
 //! Contains all information pertaining to a system being simulated.
 class systemDefinition {
 	public:
-		systemDefinition () {mass_ = -1; instantT_ = 0; targetT_ = 0; snapFile_ = NULL; Uk_ = 0.0; Up_ = 0.0; rc_ = 0; rs_ = 0;}
+		systemDefinition () {mass_ = -1; instantT_ = 0; targetT_ = 0; snapFile_ = NULL; Uk_ = 0.0; Up_ = 0.0; rc_ = 0; rs_ = 0; targetP_ = 0; W_ = 0.0; Woff_.x = 0.0; Woff_.y = 0.0; Woff_.z = 0.0; overlapPolicy_ = OVERLAP_ABORT; softCore_ = 0.8;}
 		~systemDefinition () {if (snapFile_ != NULL) fclose(snapFile_);}
 		void initRandom (const int N, const int rngSeed);
 		void initThermal (const int N, const float Tset, const int rngSeed, const float dx);
@@ -30,6 +30,13 @@ class systemDefinition {
 		float3 box() const {return box_;}   //!< Report the box dimensions
 		float instantT() const {return instantT_;}  //!< Report the instantaneous temperature
 		float targetT() const {return targetT_;}    //!< Report the target temperature for NVT simulations
+		void setPressure (const float P) {targetP_ = P;}    //!< Assign the target pressure for NPT simulations
+		float targetP() const {return targetP_;}    //!< Report the target pressure for NPT simulations
+		void setVirial(const float W) {W_ = W;}     //!< Assign the virial, sum over pairs of r_ij.F_ij
+		float virial() const {return W_;}           //!< Report the virial (only computed by integrators which need the pressure)
+		void setVirialOffDiagonal(const float3 &W) {Woff_ = W;}    //!< Assign the off-diagonal virial, sums over pairs of x_ij F_ij,y, x_ij F_ij,z and y_ij F_ij,z
+		float3 virialOffDiagonal() const {return Woff_;}           //!< Report the off-diagonal virial (only computed if the integrator was asked for the stress)
+		float pressure() const {return (2.0*Uk_ + W_)/(3.0*box_.x*box_.y*box_.z);}   //!< Report the instantaneous pressure from the kinetic energy and virial
 		float mass() const {return mass_;}          //!< Report the particle's mass
 		float PotE() const {return Up_;}            //!< Report the instantaneous potential energy of the system
 		void setPotE(const float Up) {Up_ = Up;}    //!< Assign the potential energy
@@ -40,7 +47,12 @@ class systemDefinition {
 		void writeSnapshot ();                      //!< Print a snapshot of the system
 		int numAtoms() const {return atoms.size();} //!< Report the pair potential function cutoff radius
 		void setPotentialArgs (const std::vector <float> args) {potentialArgs_ = args;} //!< Assign additional arguments to the pair potential function
-		std::vector <float> potentialArgs () {return potentialArgs_;}   //!< Report additional arguments to the pair potential function
+		const std::vector <float>& potentialArgs () const {return potentialArgs_;}  //!< Report additional arguments to the pair potential function
+		void setCharges (const std::vector <float> &q) {charges_ = q;}     //!< Assign a charge to each atom (in units where the Coulomb energy is q_i q_j/r); empty for an uncharged system
+		const std::vector <float>& charges () const {return charges_;}     //!< Report the charge of each atom
+		void setOverlapPolicy (const overlapPolicy policy, const float softCore=0.8); //!< Choose how the pair potential treats overlapping atoms (see overlapPolicy)
+		overlapPolicy overlapMode () const {return overlapPolicy_;}       //!< Report how the pair potential treats overlapping atoms
+		float softCore () const {return softCore_;}                        //!< Report the soft core radius in units of sigma, used by OVERLAP_SOFTCORE
 		
 		#ifdef NVCC
 		int cudaBlocks, cudaThreads;            //!< Block and thread size if using GPUs
@@ -48,7 +60,7 @@ class systemDefinition {
 
 		pointFunction_t potential;              //!< Pointer to pair potential function
 		void setPotential (pointFunction_t pp); //!< Assign pair potential function
-		std::vector <atom> atoms;               //!< Vector of atoms in the system
+		atomVector atoms;                       //!< Vector of atoms in the system
     
 	private:
         float rc_;              //!< Cutoff radius of the pair potential function
@@ -56,11 +68,17 @@ class systemDefinition {
 		FILE *snapFile_;        //!< File to record system's trajectory to
 		float3 box_;            //!< Box dimensions
         float targetT_;         //!< Target temperature for NVT simulations
+        float targetP_;         //!< Target pressure for NPT simulations
+        float W_;               //!< Virial
+        float3 Woff_;           //!< Off-diagonal virial (xy, xz, yz)
         float instantT_;        //!< Instantaneous (kinetic) temperature of the system
 		float mass_;            //!< Particle mass
         float Uk_;              //!< Potential energy
         float Up_;              //!< Kinetic energy
 		std::vector <float> potentialArgs_; //!< Additional arguments to the pair potential function
+		std::vector <float> charges_;       //!< Charge of each atom
+		overlapPolicy overlapPolicy_;       //!< How the pair potential treats overlapping atoms
+		float softCore_;                    //!< Soft core radius in units of sigma
 };
 
 #endif
@@ -0,0 +1,92 @@
+"""
+Tests of the cbemd Python module: build it with make PYTHON and run python3 test_python.py in the same directory.
+\date 10/19/26
+"""
+
+import sys
+import threading
+import unittest
+
+import cbemd
+
+
+def makeSystem(N=500):
+	s = cbemd.System()
+	s.setBox(12, 12, 12)
+	s.setTemp(1.0)
+	s.setMass(1.0)
+	s.setRcut(2.5)
+	s.setRskin(0.3)
+	s.initThermal(N, 1.0, 3145, 1.2)
+	s.setLJ(1.0, 1.0)
+	return s
+
+
+class ViewTest(unittest.TestCase):
+	def test_StateRoundTrips(self):
+		s = makeSystem()
+		ig = cbemd.NVE()
+		ig.setTimestep(0.002)
+		ig.step(s)
+		pos = s.positions()
+		pos[7, 1] = 3.25
+		self.assertEqual(3.25, s.positions()[7, 1])
+
+		before = pos.tolist()
+		ig.step(s, 10)
+		self.assertEqual(s.positions().tolist(), pos.tolist())
+		self.assertNotEqual(before, pos.tolist())
+
+		vel = s.velocities()
+		Uk = 0.5*sum(vel[i, k]**2 for i in range(s.numAtoms()) for k in range(3))
+		self.assertAlmostEqual(1.0, Uk/s.KinE(), places=4)
+
+		del pos, vel
+		s.initThermal(100, 1.0, 3145, 1.2)
+		self.assertEqual((100, 3), s.positions().shape)
+
+
+class StepTest(unittest.TestCase):
+	def stepInBackground(self, ig, s, nsteps):
+		"""Start stepping on another thread and wait until the step has started, or return None if it finished first."""
+		t = threading.Thread(target=ig.step, args=(s, nsteps))
+		t.start()
+		while t.is_alive() and not s.stepping():
+			pass
+		if not s.stepping():
+			t.join()
+			return None
+		return t
+
+	def test_BusyWhileStepping(self):
+		s = makeSystem()
+		ig = cbemd.NVT(1.0)
+		ig.step(s)
+		refs = (sys.getrefcount(s), sys.getrefcount(ig))
+		other = makeSystem()
+		nsteps = 200
+		t = None
+		while t is None:
+			nsteps *= 2
+			t = self.stepInBackground(ig, s, nsteps)
+		try:
+			self.assertRaises(RuntimeError, s.initThermal, 100, 1.0, 3145, 1.2)
+			self.assertRaises(RuntimeError, s.initRandom, 100, 3145)
+			self.assertRaises(RuntimeError, s.setBox, 10, 10, 10)
+			self.assertRaises(RuntimeError, s.setLJ, 1.0, 1.0)
+			self.assertRaises(RuntimeError, cbemd.NVE().step, s)
+			self.assertRaises(RuntimeError, ig.step, other)
+			self.assertRaises(RuntimeError, ig.setTimestep, 0.001)
+			self.assertRaises(RuntimeError, ig.__init__, 2.0)
+			self.assertRaises(RuntimeError, ig.conservedEnergy, s)
+			self.assertEqual(500, s.numAtoms())
+		finally:
+			t.join()
+		self.assertFalse(s.stepping())
+		self.assertEqual(refs, (sys.getrefcount(s), sys.getrefcount(ig)))
+		s.setBox(12, 12, 12)
+		ig.step(s)
+
+
+if __name__ == "__main__":
+	unittest.main()
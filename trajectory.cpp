@@ -0,0 +1,620 @@
+/*!
+ * Lossy compressed trajectory output (XTC-style)
+ * \date 10/19/26
+ */
+
+#include "trajectory.h"
+#include "common.h"
+#include <math.h>
+#include <algorithm>
+#include <omp.h>
+#include <string.h>
+
+#define TRAJ_BLOCK 16384       //!< Atoms per independently compressed block
+#define TRAJ_GROUP 8           //!< Atoms sharing one bit width
+#define TRAJ_HEADER 40         //!< Bytes in a frame before the block sizes (3 int, 4 float, 3 int)
+
+//! Appends bit fields (least significant first) to a byte buffer
+struct bitWriter {
+	std::vector <unsigned char> *out;   //!< Buffer bytes are appended to
+	unsigned long long acc;             //!< Bits not yet appended
+	int n;                              //!< Number of bits in acc
+
+	bitWriter (std::vector <unsigned char> *buf) {out = buf; acc = 0; n = 0;}
+	void put (const unsigned int v, const int bits) {
+		if (bits == 0) return;
+		acc |= ((unsigned long long) v) << n;
+		n += bits;
+		while (n >= 8) {
+			out->push_back((unsigned char) (acc & 0xff));
+			acc >>= 8;
+			n -= 8;
+		}
+	}
+	void flush () {
+		if (n > 0) {
+			out->push_back((unsigned char) (acc & 0xff));
+		}
+		acc = 0;
+		n = 0;
+	}
+};
+
+//! Reads bit fields written by bitWriter
+struct bitReader {
+	const unsigned char *p;     //!< Next byte to read
+	const unsigned char *end;   //!< End of the buffer
+	unsigned long long acc;     //!< Bits read but not yet consumed
+	int n;                      //!< Number of bits in acc
+
+	bitReader (const unsigned char *begin, const unsigned char *stop) {p = begin; end = stop; acc = 0; n = 0;}
+	unsigned int get (const int bits) {
+		if (bits == 0) return 0;
+		while (n < bits) {
+			acc |= ((unsigned long long) (p < end ? *p++ : 0)) << n;
+			n += 8;
+		}
+		const unsigned int v = (unsigned int) (acc & ((1ULL << bits)-1));
+		acc >>= bits;
+		n -= bits;
+		return v;
+	}
+};
+
+//! Map a signed difference to an unsigned integer which is small if the difference is small in magnitude
+static inline unsigned int zigzag (const int r) {
+	return (((unsigned int) r) << 1) ^ (unsigned int) (r >> 31);
+}
+
+//! Inverse of zigzag
+static inline int unzigzag (const unsigned int u) {
+	return (int) (u >> 1) ^ -((int) (u & 1));
+}
+
+//! Number of bits needed to hold v
+static inline int bitWidth (unsigned long long v) {
+	int b = 0;
+	while (v) {
+		b++;
+		v >>= 1;
+	}
+	return b;
+}
+
+//! Number of quantization steps spanning a box length, the period key frames wrap coordinates with
+static inline long long quantizedLength (const float length, const float precision) {
+	const long long n = (long long) floor(length/precision+0.5);
+	return (n > 0) ? n : 1;
+}
+
+//! Floor of q/n, for n > 0
+static inline long long floorDiv (const long long q, const long long n) {
+	return (q >= 0) ? q/n : -((-q-1)/n)-1;
+}
+
+//! Append v as a Rice code: v >> k in unary, then the k low bits of v
+static inline void putRice (bitWriter &bw, const unsigned long long v, const int k) {
+	for (unsigned long long q = v >> k; q > 0; --q) {
+		bw.put(1, 1);
+	}
+	bw.put(0, 1);
+	if (k > 32) {
+		bw.put((unsigned int) (v & 0xffffffffULL), 32);
+		bw.put((unsigned int) ((v >> 32) & ((1ULL << (k-32))-1)), k-32);
+	} else {
+		bw.put((unsigned int) (v & ((1ULL << k)-1)), k);
+	}
+}
+
+//! Read a Rice code written by putRice
+static inline unsigned long long getRice (bitReader &br, const int k) {
+	unsigned long long q = 0;
+	while (br.get(1)) {
+		q++;
+	}
+	unsigned long long v;
+	if (k > 32) {
+		v = br.get(32);
+		v |= ((unsigned long long) br.get(k-32)) << 32;
+	} else {
+		v = br.get(k);
+	}
+	return (q << k) | v;
+}
+
+//! Append v as an Elias gamma code of v+1, so 0 takes a single bit
+static inline void putGamma (bitWriter &bw, const unsigned int v) {
+	const int w = bitWidth(v+1ULL);
+	putRice(bw, w-1, 0);
+	if (w > 1) {
+		bw.put((unsigned int) ((v+1ULL) & ((1ULL << (w-1))-1)), w-1);
+	}
+}
+
+//! Read an Elias gamma code written by putGamma
+static inline unsigned int getGamma (bitReader &br) {
+	const int w = (int) getRice(br, 0) + 1;
+	const unsigned long long low = (w > 1) ? br.get(w-1) : 0;
+	return (unsigned int) (((1ULL << (w-1)) | low) - 1);
+}
+
+//! Append v < m in a truncated binary code, floor(log2 m) or one more bits
+static inline void putTruncated (bitWriter &bw, const unsigned int v, const unsigned int m) {
+	const int k = bitWidth(m)-1;
+	const unsigned int u = (2U << k) - m;
+	if (v < u) {
+		bw.put(v, k);
+	} else {
+		bw.put((v+u) >> 1, k);
+		bw.put((v+u) & 1, 1);
+	}
+}
+
+//! Read a truncated binary code written by putTruncated
+static inline unsigned int getTruncated (bitReader &br, const unsigned int m) {
+	const int k = bitWidth(m)-1;
+	const unsigned int u = (2U << k) - m;
+	const unsigned int t = br.get(k);
+	if (t < u) {
+		return t;
+	}
+	return ((t << 1) | br.get(1)) - u;
+}
+
+//! Set of the indices 0..n-1 which supports removing an index and ranking or selecting among those left, in O(log n)
+struct rankTree {
+	std::vector <int> tree;     //!< Fenwick tree of the number of indices left
+	int top;                    //!< Largest power of 2 <= n
+
+	rankTree (const int n) : tree(n+1) {
+		for (int i = 1; i <= n; ++i) {
+			tree[i] = i & -i;
+		}
+		top = 1;
+		while (2*top <= n) {
+			top *= 2;
+		}
+	}
+	void remove (const int i) {
+		for (int j = i+1; j < (int) tree.size(); j += j & -j) {
+			tree[j]--;
+		}
+	}
+	int rank (const int i) const {     //!< Number of indices left below i
+		int r = 0;
+		for (int j = i; j > 0; j -= j & -j) {
+			r += tree[j];
+		}
+		return r;
+	}
+	int select (int r) const {         //!< Index left with r indices left below it
+		int i = 0;
+		for (int step = top; step > 0; step >>= 1) {
+			if (i+step < (int) tree.size() && tree[i+step] <= r) {
+				i += step;
+				r -= tree[i];
+			}
+		}
+		return i;
+	}
+};
+
+/*!
+ * Bit-pack signed values in groups of TRAJ_GROUP atoms (3 values each), each group with the smallest width that holds it.
+ *
+ * \param [in] r Residuals, 3 per atom
+ * \param [in] n Number of atoms
+ * \param [in, out] bw Bit writer
+ */
+static void packResiduals (const int *r, const int n, bitWriter &bw) {
+	for (int g = 0; g < n; g += TRAJ_GROUP) {
+		const int gEnd = std::min(g+TRAJ_GROUP, n);
+		unsigned int all = 0;
+		for (int v = 3*g; v < 3*gEnd; ++v) {
+			all |= zigzag(r[v]);
+		}
+		const int bits = bitWidth(all);
+		bw.put(bits, 6);
+		for (int v = 3*g; v < 3*gEnd; ++v) {
+			bw.put(zigzag(r[v]), bits);
+		}
+	}
+}
+
+//! Inverse of packResiduals
+static void unpackResiduals (bitReader &br, const int n, int *r) {
+	for (int g = 0; g < n; g += TRAJ_GROUP) {
+		const int gEnd = std::min(g+TRAJ_GROUP, n);
+		const int bits = br.get(6);
+		for (int v = 3*g; v < 3*gEnd; ++v) {
+			r[v] = unzigzag(br.get(bits));
+		}
+	}
+}
+
+/*!
+ * Compress one block of atoms.  Frames between key frames predict each atom from its own position in the previous frame.  Key frames
+ * wrap the coordinates into the box, split into the wrapped offset and the number of box lengths (image) removed, and sort the atoms
+ * by their wrapped cell in the quantization grid (z, then y, then x).  Consecutive atoms in this order are spatial neighbors, so only
+ * the gaps between their grid cells are stored, Rice coded, each followed by the atom's rank among the indices in the block not yet
+ * stored (so the permutation takes about log2(n!) bits instead of n log2(n)); the images follow in index
+ * order, as a flag per atom followed, for the few atoms which have left the box, by a gamma code of each image.
+ *
+ * \param [in] cur Quantized coordinates of every atom
+ * \param [in] ref Quantized coordinates of every atom in the previous frame (unused for key frames)
+ * \param [in] period Number of quantization steps spanning the box in each dimension (used by key frames)
+ * \param [in] begin First atom of the block
+ * \param [in] end One past the last atom of the block
+ * \param [in] key If true encode a key frame, otherwise predict from the previous frame
+ * \param [out] out Compressed block
+ */
+static void encodeBlock (const std::vector <int> &cur, const std::vector <int> &ref, const long long *period, const int begin, const int end, const bool key, std::vector <unsigned char> &out) {
+	out.clear();
+	bitWriter bw (&out);
+	const int n = end-begin;
+	std::vector <int> r (3*n);
+	if (!key) {
+		for (int v = 0; v < 3*n; ++v) {
+			r[v] = cur[3*begin+v] - ref[3*begin+v];
+		}
+		packResiduals(&r[0], n, bw);
+		bw.flush();
+		return;
+	}
+
+	std::vector < std::pair <unsigned long long, int> > order (n);
+	for (int i = 0; i < n; ++i) {
+		unsigned long long cell = 0;
+		for (int d = 2; d >= 0; --d) {
+			const long long q = cur[3*(begin+i)+d];
+			const long long image = floorDiv(q, period[d]);
+			r[3*i+d] = (int) image;
+			cell = cell*period[d] + (q - image*period[d]);
+		}
+		order[i] = std::make_pair(cell, i);
+	}
+	std::sort(order.begin(), order.end());
+
+	// pick the Rice parameter which minimizes the size of the gaps
+	int k = 0;
+	if (n > 0) {
+		const int k0 = std::max(0, bitWidth(order[n-1].first/n)-2);
+		unsigned long long best = 0;
+		for (int trial = k0; trial < k0+4; ++trial) {
+			unsigned long long size = 0, prev = 0;
+			for (int i = 0; i < n; ++i) {
+				size += ((order[i].first-prev) >> trial) + 1 + trial;
+				prev = order[i].first;
+			}
+			if (trial == k0 || size < best) {
+				best = size;
+				k = trial;
+			}
+		}
+	}
+	bw.put(k, 6);
+	rankTree left (n);
+	unsigned long long prev = 0;
+	for (int i = 0; i < n; ++i) {
+		putRice(bw, order[i].first-prev, k);
+		putTruncated(bw, left.rank(order[i].second), n-i);
+		left.remove(order[i].second);
+		prev = order[i].first;
+	}
+	for (int i = 0; i < n; ++i) {
+		const bool moved = (r[3*i] != 0 || r[3*i+1] != 0 || r[3*i+2] != 0);
+		bw.put(moved ? 1 : 0, 1);
+		for (int d = 0; d < 3 && moved; ++d) {
+			putGamma(bw, zigzag(r[3*i+d]));
+		}
+	}
+	bw.flush();
+}
+
+/*!
+ * Decompress one block of atoms, the inverse of encodeBlock.
+ *
+ * \param [in] in Start of the compressed block
+ * \param [in] inEnd End of the compressed block
+ * \param [in] ref Quantized coordinates of every atom in the previous frame (unused for key frames)
+ * \param [in] period Number of quantization steps spanning the box in each dimension (used by key frames)
+ * \param [in] begin First atom of the block
+ * \param [in] end One past the last atom of the block
+ * \param [in] key If true decode a key frame, otherwise predict from the previous frame
+ * \param [out] cur Quantized coordinates of every atom
+ * \return False if the block is corrupt
+ */
+static bool decodeBlock (const unsigned char *in, const unsigned char *inEnd, const std::vector <int> &ref, const long long *period, const int begin, const int end, const bool key, std::vector <int> &cur) {
+	bitReader br (in, inEnd);
+	const int n = end-begin;
+	std::vector <int> r (3*n);
+	if (!key) {
+		unpackResiduals(br, n, &r[0]);
+		for (int v = 0; v < 3*n; ++v) {
+			cur[3*begin+v] = ref[3*begin+v] + r[v];
+		}
+		return true;
+	}
+
+	const int k = br.get(6);
+	rankTree left (n);
+	unsigned long long cell = 0;
+	for (int j = 0; j < n; ++j) {
+		cell += getRice(br, k);
+		const unsigned int r = getTruncated(br, n-j);
+		if (r >= (unsigned int) (n-j)) {
+			return false;
+		}
+		const int i = left.select(r);
+		left.remove(i);
+		unsigned long long c = cell;
+		for (int d = 0; d < 3; ++d) {
+			cur[3*(begin+i)+d] = (int) (c % period[d]);
+			c /= period[d];
+		}
+	}
+	for (int i = begin; i < end; ++i) {
+		if (br.get(1)) {
+			for (int d = 0; d < 3; ++d) {
+				cur[3*i+d] += (int) (unzigzag(getGamma(br))*period[d]);
+			}
+		}
+	}
+	return true;
+}
+
+/*!
+ * Open a compressed trajectory for writing, overwriting any existing file.
+ *
+ * \param [in] filename Name of the file
+ * \param [in] precision Quantization step of the coordinates; every position is recovered to within half of this
+ * \param [in] keyInterval Number of frames between key frames
+ */
+compressedTrajectoryWriter::compressedTrajectoryWriter (const char *filename, const float precision, const int keyInterval) {
+	if (precision <= 0.0) {
+		throw customException ("Trajectory precision must be > 0");
+		return;
+	}
+	precision_ = precision;
+	nFrames_ = 0;
+	nBytes_ = 0;
+	keyInterval_ = 1;
+	setKeyInterval(keyInterval);
+	file_ = fopen(filename, "wb");
+	if (file_ == NULL) {
+		throw customException ("Unable to open compressed trajectory for writing");
+		return;
+	}
+}
+
+compressedTrajectoryWriter::~compressedTrajectoryWriter () {
+	if (file_ != NULL) {
+		fclose(file_);
+	}
+}
+
+/*!
+ * \param [in] n Number of frames between key frames, 1 makes every frame a key frame
+ */
+void compressedTrajectoryWriter::setKeyInterval (const int n) {
+	if (n < 1) {
+		throw customException ("Key frame interval must be > 0");
+		return;
+	}
+	keyInterval_ = n;
+}
+
+/*!
+ * Quantize the positions of every atom and compress them, with the blocks of atoms shared among threads, then append the frame to the file.
+ *
+ * \param [in] sys System definition
+ * \param [in] step Time step the frame is labelled with
+ */
+void compressedTrajectoryWriter::write (const systemDefinition &sys, const int step) {
+	const int N = sys.numAtoms();
+	const bool key = (nFrames_%keyInterval_ == 0 || (int) ref_.size() != 3*N);
+	const float inv = 1.0/precision_;
+	cur_.resize(3*N);
+
+	int overflow = 0;
+	#pragma omp parallel for schedule(static) reduction(+:overflow)
+	for (int i = 0; i < N; ++i) {
+		const float3 p = sys.atoms[i].pos;
+		const float q[3] = {p.x*inv, p.y*inv, p.z*inv};
+		for (int d = 0; d < 3; ++d) {
+			if (fabs(q[d]) > 1.0e9) {
+				overflow++;
+			} else {
+				cur_[3*i+d] = (int) floor(q[d]+0.5);
+			}
+		}
+	}
+	if (overflow > 0) {
+		throw customException ("Coordinates too large to quantize at this trajectory precision");
+		return;
+	}
+
+	const float3 box = sys.box();
+	const long long period[3] = {quantizedLength(box.x, precision_), quantizedLength(box.y, precision_), quantizedLength(box.z, precision_)};
+	if (key && (double) period[0]*period[1]*period[2] >= 9.0e18) {
+		throw customException ("Box too large to write key frames at this trajectory precision");
+		return;
+	}
+
+	const int nBlocks = (N+TRAJ_BLOCK-1)/TRAJ_BLOCK;
+	if ((int) block_.size() < nBlocks) {
+		block_.resize(nBlocks);
+	}
+	blockBytes_.resize(nBlocks);
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int b = 0; b < nBlocks; ++b) {
+		encodeBlock(cur_, ref_, period, b*TRAJ_BLOCK, std::min(N, (b+1)*TRAJ_BLOCK), key, block_[b]);
+		blockBytes_[b] = block_[b].size();
+	}
+
+	const int header[3] = {TRAJ_MAGIC, N, step};
+	const float dims[4] = {box.x, box.y, box.z, precision_};
+	const int layout[3] = {key ? 1 : 0, TRAJ_BLOCK, nBlocks};
+	bool ok = (fwrite(header, sizeof(int), 3, file_) == 3);
+	ok = ok && (fwrite(dims, sizeof(float), 4, file_) == 4);
+	ok = ok && (fwrite(layout, sizeof(int), 3, file_) == 3);
+	ok = ok && (nBlocks == 0 || fwrite(&blockBytes_[0], sizeof(unsigned int), nBlocks, file_) == (size_t) nBlocks);
+	nBytes_ += 3*sizeof(int) + 4*sizeof(float) + 3*sizeof(int) + nBlocks*sizeof(unsigned int);
+	for (int b = 0; b < nBlocks && ok; ++b) {
+		ok = (blockBytes_[b] == 0 || fwrite(&block_[b][0], 1, blockBytes_[b], file_) == blockBytes_[b]);
+		nBytes_ += blockBytes_[b];
+	}
+	if (!ok) {
+		throw customException ("Unable to write compressed trajectory frame");
+		return;
+	}
+
+	ref_.swap(cur_);
+	nFrames_++;
+}
+
+/*!
+ * Open a compressed trajectory for reading.
+ *
+ * \param [in] filename Name of the file
+ */
+compressedTrajectoryReader::compressedTrajectoryReader (const char *filename) {
+	precision_ = 0.0;
+	file_ = fopen(filename, "rb");
+	if (file_ == NULL) {
+		throw customException ("Unable to open compressed trajectory for reading");
+		return;
+	}
+}
+
+compressedTrajectoryReader::~compressedTrajectoryReader () {
+	if (file_ != NULL) {
+		fclose(file_);
+	}
+}
+
+/*!
+ * Read and decompress the next frame from the file.
+ *
+ * \param [out] pos Position of each atom, to within half the precision it was written with
+ * \param [out] box Box dimensions
+ * \param [out] step Time step the frame was labelled with
+ * \return False if there are no more frames
+ */
+bool compressedTrajectoryReader::read (std::vector <float3> &pos, float3 &box, int &step) {
+	if (file_ == NULL) {
+		throw customException ("Compressed trajectory reader has no file, use decode()");
+		return false;
+	}
+	buffer_.resize(TRAJ_HEADER);
+	const size_t got = fread(&buffer_[0], 1, TRAJ_HEADER, file_);
+	if (got == 0) {
+		return false;
+	}
+	if (got != TRAJ_HEADER) {
+		throw customException ("Truncated compressed trajectory frame");
+		return false;
+	}
+	int nBlocks;
+	memcpy(&nBlocks, &buffer_[TRAJ_HEADER-sizeof(int)], sizeof(int));
+	buffer_.resize(TRAJ_HEADER + nBlocks*sizeof(unsigned int));
+	if (nBlocks > 0 && fread(&buffer_[TRAJ_HEADER], sizeof(unsigned int), nBlocks, file_) != (size_t) nBlocks) {
+		throw customException ("Truncated compressed trajectory frame");
+		return false;
+	}
+	size_t payload = 0;
+	for (int b = 0; b < nBlocks; ++b) {
+		unsigned int n;
+		memcpy(&n, &buffer_[TRAJ_HEADER + b*sizeof(unsigned int)], sizeof(unsigned int));
+		payload += n;
+	}
+	const size_t start = buffer_.size();
+	buffer_.resize(start+payload);
+	if (payload > 0 && fread(&buffer_[start], 1, payload, file_) != payload) {
+		throw customException ("Truncated compressed trajectory frame");
+		return false;
+	}
+	decode(&buffer_[0], buffer_.size(), pos, box, step);
+	return true;
+}
+
+/*!
+ * Decompress a frame from memory (e.g. a memory mapped file), with the blocks of atoms shared among threads.
+ * Frames must be decoded in the order they were written, since all but key frames are predicted from their predecessor.
+ *
+ * \param [in] frame Start of the frame
+ * \param [in] bytes Number of bytes available from the start of the frame
+ * \param [out] pos Position of each atom, to within half the precision it was written with
+ * \param [out] box Box dimensions
+ * \param [out] step Time step the frame was labelled with
+ * \return Size of the frame in bytes, 0 if no frame starts here
+ */
+size_t compressedTrajectoryReader::decode (const unsigned char *frame, const size_t bytes, std::vector <float3> &pos, float3 &box, int &step) {
+	if (bytes == 0) {
+		return 0;
+	}
+	if (bytes < TRAJ_HEADER) {
+		throw customException ("Truncated compressed trajectory frame");
+		return 0;
+	}
+	int header[3], layout[3];
+	float dims[4];
+	memcpy(header, frame, sizeof(header));
+	memcpy(dims, frame+sizeof(header), sizeof(dims));
+	memcpy(layout, frame+sizeof(header)+sizeof(dims), sizeof(layout));
+	if (header[0] != TRAJ_MAGIC) {
+		throw customException ("Not a compressed trajectory frame");
+		return 0;
+	}
+	const int N = header[1];
+	const bool key = (layout[0] != 0);
+	const int blockAtoms = layout[1], nBlocks = layout[2];
+	if (!key && (int) ref_.size() != 3*N) {
+		throw customException ("Compressed trajectory frame refers to a missing key frame");
+		return 0;
+	}
+	if (bytes < TRAJ_HEADER + nBlocks*sizeof(unsigned int)) {
+		throw customException ("Truncated compressed trajectory frame");
+		return 0;
+	}
+	offset_.resize(nBlocks+1);
+	offset_[0] = TRAJ_HEADER + nBlocks*sizeof(unsigned int);
+	for (int b = 0; b < nBlocks; ++b) {
+		unsigned int n;
+		memcpy(&n, frame + TRAJ_HEADER + b*sizeof(unsigned int), sizeof(unsigned int));
+		offset_[b+1] = offset_[b] + n;
+	}
+	if (bytes < offset_[nBlocks]) {
+		throw customException ("Truncated compressed trajectory frame");
+		return 0;
+	}
+
+	const long long period[3] = {quantizedLength(dims[0], dims[3]), quantizedLength(dims[1], dims[3]), quantizedLength(dims[2], dims[3])};
+	cur_.resize(3*N);
+	int corrupt = 0;
+	#pragma omp parallel for schedule(dynamic, 1) reduction(+:corrupt)
+	for (int b = 0; b < nBlocks; ++b) {
+		if (!decodeBlock(frame+offset_[b], frame+offset_[b+1], ref_, period, b*blockAtoms, std::min(N, (b+1)*blockAtoms), key, cur_)) {
+			corrupt++;
+		}
+	}
+	if (corrupt > 0) {
+		throw customException ("Corrupt compressed trajectory frame");
+		return 0;
+	}
+
+	step = header[2];
+	box.x = dims[0];
+	box.y = dims[1];
+	box.z = dims[2];
+	precision_ = dims[3];
+	pos.resize(N);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < N; ++i) {
+		pos[i].x = cur_[3*i]*precision_;
+		pos[i].y = cur_[3*i+1]*precision_;
+		pos[i].z = cur_[3*i+2]*precision_;
+	}
+	ref_.swap(cur_);
+	return offset_[nBlocks];
+}
@@ -0,0 +1,69 @@
+/*!
+ * Lossy compressed trajectory output (XTC-style)
+ * \date 10/19/26
+ */
+
+#ifndef __TRAJECTORY_H__
+#define __TRAJECTORY_H__
+
+#include <stdio.h>
+#include <vector>
+#include "dataTypes.h"
+#include "system.h"
+
+#define TRAJ_MAGIC 0x5a544243  //!< "CBTZ", marks the start of every compressed trajectory frame
+
+/*!
+ * Writes positions quantized to a fixed precision, at about 3-4 bytes per atom instead of the 12 of binary floats (or ~30 of XYZ text).
+ * Frames between key frames replace each quantized coordinate by its difference from the same atom in the previous frame; the
+ * differences are zigzag mapped to unsigned integers and bit-packed in groups of 8 atoms with the smallest width that holds the group.
+ * Key frames wrap the coordinates into the box and encode the atoms in spatial order (by their cell in the quantization grid), storing
+ * the gap to the previous atom in that order, the permutation back to the atoms' indices and the number of box lengths each atom was
+ * moved by, so the unwrapped positions are recovered exactly and the size does not depend on how the atoms are numbered.  A key frame
+ * needs about log2(V/precision^3) bits per atom for V the box volume, about 5.5 bytes for a liquid of density 0.6 at the default
+ * precision, so the key interval sets how close a file comes to the 3-4 bytes of the frames in between.  Atoms are split into blocks
+ * which are compressed in parallel and can be decoded independently.  Read the file back with compressedTrajectoryReader.
+ *
+ * Every frame is: int magic, natoms, step; float box[3], precision; int keyframe, blockAtoms, nBlocks; unsigned int payload bytes of
+ * each block; then the payloads.  Integers and floats are in native byte order.
+ */
+class compressedTrajectoryWriter {
+	public:
+		compressedTrajectoryWriter (const char *filename, const float precision=0.001, const int keyInterval=10);
+		~compressedTrajectoryWriter ();
+		void write (const systemDefinition &sys, const int step);  //!< Compress and append the system's current positions
+		void setKeyInterval (const int n);              //!< Write a key frame (decodable without its predecessor) every n frames
+		float precision () const {return precision_;}   //!< Report the quantization step of the coordinates
+		int framesWritten () const {return nFrames_;}   //!< Report the number of frames written
+		long bytesWritten () const {return nBytes_;}    //!< Report the size of the file so far
+	private:
+		FILE *file_;                //!< Trajectory file
+		float precision_;           //!< Quantization step of the coordinates
+		int keyInterval_;           //!< Number of frames between key frames
+		int nFrames_;               //!< Number of frames written
+		long nBytes_;               //!< Number of bytes written
+		std::vector <int> ref_;     //!< Quantized coordinates of the previous frame, 3 per atom
+		std::vector <int> cur_;     //!< Quantized coordinates of the frame being written
+		std::vector <unsigned int> blockBytes_;                 //!< Compressed size of each block
+		std::vector < std::vector <unsigned char> > block_;     //!< Compressed payload of each block
+};
+
+//! Reads frames written by compressedTrajectoryWriter
+class compressedTrajectoryReader {
+	public:
+		compressedTrajectoryReader () {file_ = NULL; precision_ = 0.0;}   //!< Reader without a file, for frames handed to decode()
+		compressedTrajectoryReader (const char *filename);
+		~compressedTrajectoryReader ();
+		bool read (std::vector <float3> &pos, float3 &box, int &step);     //!< Decompress the next frame, returns false at the end of the file
+		size_t decode (const unsigned char *frame, const size_t bytes, std::vector <float3> &pos, float3 &box, int &step);    //!< Decompress a frame already in memory, returns its size
+		float precision () const {return precision_;}   //!< Report the quantization step of the last frame read
+	private:
+		FILE *file_;                //!< Trajectory file
+		float precision_;           //!< Quantization step of the last frame read
+		std::vector <int> ref_;     //!< Quantized coordinates of the previous frame, 3 per atom
+		std::vector <int> cur_;     //!< Quantized coordinates of the frame being read
+		std::vector <size_t> offset_;               //!< Offset of each block's payload from the start of the frame
+		std::vector <unsigned char> buffer_;        //!< Frame read from the file
+};
+
+#endif
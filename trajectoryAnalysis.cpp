@@ -0,0 +1,280 @@
+/*!
+ * Offline trajectory analysis: reading mapped trajectories, radial distribution function, density profiles and mean squared displacement
+ * \date 10/19/26
+ */
+
+#include "trajectoryAnalysis.h"
+
+#ifndef NVCC
+
+#include "cellList.h"
+#include "common.h"
+#include "utils.h"
+#include <algorithm>
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*!
+ * \param [in] filename Trajectory file
+ * \param [in] box Box dimensions, used only for XYZ files
+ */
+mappedTrajectory::mappedTrajectory (const char *filename, const float3 &box) {
+	box_ = box;
+	offset_ = 0;
+	released_ = 0;
+	fd_ = open(filename, O_RDONLY);
+	if (fd_ < 0) {
+		throw customException ("Unable to open trajectory");
+		return;
+	}
+	struct stat st;
+	if (fstat(fd_, &st) != 0) {
+		throw customException ("Unable to stat trajectory");
+		return;
+	}
+	size_ = st.st_size;
+	data_ = NULL;
+	compressed_ = false;
+	if (size_ > 0) {
+		void *p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+		if (p == MAP_FAILED) {
+			throw customException ("Unable to map trajectory into memory");
+			return;
+		}
+		data_ = (const char*) p;
+		madvise(p, size_, MADV_SEQUENTIAL);
+		int magic = 0;
+		if (size_ >= sizeof(int)) {
+			memcpy(&magic, data_, sizeof(int));
+		}
+		compressed_ = (magic == TRAJ_MAGIC);
+	}
+}
+
+mappedTrajectory::~mappedTrajectory () {
+	if (data_ != NULL) {
+		munmap((void*) data_, size_);
+	}
+	if (fd_ >= 0) {
+		close(fd_);
+	}
+}
+
+/*!
+ * Parse the next frame.  The lines of an XYZ frame are located serially and then converted in parallel; compressed frames are
+ * decoded in parallel by compressedTrajectoryReader.
+ *
+ * \param [out] pos Position of each atom
+ * \param [out] box Box dimensions
+ * \return False if there are no more frames
+ */
+bool mappedTrajectory::next (std::vector <float3> &pos, float3 &box) {
+	if (offset_ >= size_) {
+		return false;
+	}
+	if (compressed_) {
+		int step;
+		offset_ += ctz_.decode((const unsigned char*) data_+offset_, size_-offset_, pos, box, step);
+		return true;
+	}
+
+	// header: number of atoms, then a comment line
+	const char *p = data_+offset_, *end = data_+size_;
+	while (p < end && isspace(*p)) p++;
+	if (p == end) {
+		offset_ = size_;
+		return false;
+	}
+	const int N = atoi(p);
+	for (int skip = 0; skip < 2; ++skip) {
+		p = (const char*) memchr(p, '\n', end-p);
+		if (p == NULL) {
+			throw customException ("Truncated XYZ frame");
+			return false;
+		}
+		p++;
+	}
+	line_.resize(N);
+	for (int i = 0; i < N; ++i) {
+		line_[i] = p;
+		p = (const char*) memchr(p, '\n', end-p);
+		if (p == NULL) {
+			if (i < N-1) {
+				throw customException ("Truncated XYZ frame");
+				return false;
+			}
+			p = end;
+		} else {
+			p++;
+		}
+	}
+	offset_ = p-data_;
+
+	pos.resize(N);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < N; ++i) {
+		// skip the atom's name, then read three coordinates
+		const char *q = line_[i];
+		while (!isspace(*q)) q++;
+		char *r;
+		pos[i].x = strtod(q, &r);
+		pos[i].y = strtod(r, &r);
+		pos[i].z = strtod(r, &r);
+	}
+	box = box_;
+	return true;
+}
+
+void mappedTrajectory::release () {
+	const size_t page = sysconf(_SC_PAGESIZE);
+	const size_t upTo = (offset_/page)*page;
+	if (data_ != NULL && upTo > released_) {
+		madvise((void*) (data_+released_), upTo-released_, MADV_DONTNEED);
+		released_ = upTo;
+	}
+}
+
+void frameStatistics::clear () {
+	frames = 0;
+	grFrames = 0;
+	gr.assign(GR_BINS, 0.0);
+	profile.assign(3*PROFILE_BINS, 0.0);
+}
+
+/*!
+ * Histogram the pair distances of a frame, found with a cell list of cells wider than rmax, and add the resulting g(r).
+ *
+ * \param [in] pos Position of each atom
+ * \param [in] box Box dimensions
+ * \param [in] rmax Largest distance
+ * \param [in, out] acc Accumulators of the executing thread
+ */
+void addRdf (const std::vector <float3> &pos, const float3 &box, const float rmax, frameStatistics &acc) {
+	const int N = pos.size();
+	if (std::min(box.x, std::min(box.y, box.z)) < 3.03*rmax) {
+		// the cell list needs at least 3 cells in every direction
+		return;
+	}
+	acc.sys.setBox(box.x, box.y, box.z);
+	acc.sys.atoms.resize(N);
+	for (int i = 0; i < N; ++i) {
+		acc.sys.atoms[i].pos = pos[i];
+	}
+	cellList_cpu cl (box, rmax, 0.0);
+	cl.checkUpdate(acc.sys);
+
+	const float rmax2 = rmax*rmax, dr = rmax/GR_BINS;
+	acc.hist.assign(GR_BINS, 0.0);
+	for (int pair = 0; pair < cl.numCellPairs(); ++pair) {
+		const int c1 = cl.pairCell1(pair), c2 = cl.pairCell2(pair);
+		for (int s1 = cl.cellBegin(c1); s1 < cl.cellEnd(c1); ++s1) {
+			const float3 &p1 = pos[cl.atom(s1)];
+			const int start2 = (c1 == c2) ? s1+1 : cl.cellBegin(c2);
+			for (int s2 = start2; s2 < cl.cellEnd(c2); ++s2) {
+				float3 d;
+				const float r2 = pbcDist2(p1, pos[cl.atom(s2)], d, box);
+				if (r2 < rmax2) {
+					acc.hist[std::min((int) (sqrt(r2)/dr), GR_BINS-1)] += 2.0;
+				}
+			}
+		}
+	}
+
+	const double V = box.x*box.y*box.z;
+	for (int b = 0; b < GR_BINS; ++b) {
+		const double shell = 4.0/3.0*M_PI*(pow((b+1)*dr, 3.0) - pow(b*dr, 3.0));
+		acc.gr[b] += acc.hist[b]*V/(N*(double) N*shell);
+	}
+	acc.grFrames++;
+}
+
+/*!
+ * Add the number density profile along each axis of a frame.
+ *
+ * \param [in] pos Position of each atom
+ * \param [in] box Box dimensions
+ * \param [in, out] acc Accumulators of the executing thread
+ */
+void addProfile (const std::vector <float3> &pos, const float3 &box, frameStatistics &acc) {
+	const double binVolume = box.x*box.y*box.z/PROFILE_BINS;
+	const double L[3] = {box.x, box.y, box.z};
+	for (unsigned int i = 0; i < pos.size(); ++i) {
+		const double x[3] = {pos[i].x, pos[i].y, pos[i].z};
+		for (int d = 0; d < 3; ++d) {
+			double s = x[d]/L[d];
+			s -= floor(s);
+			const int b = std::min((int) (s*PROFILE_BINS), PROFILE_BINS-1);
+			acc.profile[d*PROFILE_BINS+b] += 1.0/binVolume;
+		}
+	}
+}
+
+/*!
+ * \param [in] pos Position of each atom
+ * \param [in] box Box dimensions
+ */
+void msdWindow::add (const std::vector <float3> &pos, const float3 &box) {
+	const int N = pos.size();
+	if ((int) window_.size() < maxLag_+1) {
+		window_.resize(maxLag_+1);
+	}
+	const int cur = nFrames_%(maxLag_+1), prev = (nFrames_+maxLag_)%(maxLag_+1);
+	window_[cur].resize(N);
+	if (nFrames_ == 0) {
+		for (int i = 0; i < N; ++i) {
+			window_[cur][i] = pos[i];
+		}
+	} else {
+		#pragma omp parallel for schedule(static)
+		for (int i = 0; i < N; ++i) {
+			float3 d;
+			pbcDist2(last_[i], pos[i], d, box);
+			window_[cur][i].x = window_[prev][i].x + d.x;
+			window_[cur][i].y = window_[prev][i].y + d.y;
+			window_[cur][i].z = window_[prev][i].z + d.z;
+		}
+	}
+	last_ = pos;
+
+	const int lags = std::min(nFrames_, maxLag_);
+	const int nThreads = omp_get_max_threads();
+	partial_.assign(nThreads*(maxLag_+1), 0.0);
+	#pragma omp parallel
+	{
+		double *mine = &partial_[omp_get_thread_num()*(maxLag_+1)];
+		#pragma omp for schedule(static)
+		for (int i = 0; i < N; ++i) {
+			const float3 u = window_[cur][i];
+			for (int lag = 1; lag <= lags; ++lag) {
+				const float3 &v = window_[(nFrames_-lag)%(maxLag_+1)][i];
+				mine[lag] += (u.x-v.x)*(u.x-v.x) + (u.y-v.y)*(u.y-v.y) + (u.z-v.z)*(u.z-v.z);
+			}
+		}
+	}
+	for (int lag = 1; lag <= lags; ++lag) {
+		double sum = 0.0;
+		for (int t = 0; t < nThreads; ++t) {
+			sum += partial_[t*(maxLag_+1)+lag];
+		}
+		msd_[lag] += sum/N;
+		count_[lag] += 1.0;
+	}
+	nFrames_++;
+}
+
+void msdWindow::write (std::ostream &os) const {
+	for (int lag = 0; lag <= maxLag_; ++lag) {
+		if (lag == 0 || count_[lag] > 0) {
+			os << lag << "\t" << (lag == 0 ? 0.0 : msd_[lag]/count_[lag]) << std::endl;
+		}
+	}
+}
+
+#endif
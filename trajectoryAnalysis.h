@@ -0,0 +1,76 @@
+/*!
+ * Offline trajectory analysis: reading mapped trajectories, radial distribution function, density profiles and mean squared displacement
+ * (the structure factor is accumulated by structureFactor)
+ * \date 10/19/26
+ */
+
+#ifndef __TRAJECTORY_ANALYSIS_H__
+#define __TRAJECTORY_ANALYSIS_H__
+
+#include <vector>
+#include <iostream>
+#include "dataTypes.h"
+#include "system.h"
+#include "trajectory.h"
+
+#define GR_BINS 200         //!< Number of bins of the radial distribution function
+#define PROFILE_BINS 100    //!< Number of bins of the density profile along each axis
+
+/*!
+ * A trajectory file (trajectory.xyz text or a compressed trajectory) mapped into memory and read one frame at a time.
+ * Pages behind the last frame read are released, so only the frames being analyzed are resident however long the file is.
+ */
+class mappedTrajectory {
+	public:
+		mappedTrajectory (const char *filename, const float3 &box);
+		~mappedTrajectory ();
+		bool next (std::vector <float3> &pos, float3 &box);    //!< Read the next frame, returns false at the end of the file
+		void release ();                                        //!< Release the pages of every frame already read
+		bool compressed () const {return compressed_;}          //!< Report if the file is a compressed trajectory
+	private:
+		int fd_;                        //!< File descriptor
+		const char *data_;              //!< Start of the mapping
+		size_t size_;                   //!< Size of the file
+		size_t offset_;                 //!< Start of the next frame
+		size_t released_;               //!< Bytes at the start of the mapping already released
+		bool compressed_;               //!< Flag for whether this is a compressed trajectory rather than XYZ text
+		float3 box_;                    //!< Box of XYZ frames, which do not record it
+		std::vector <const char*> line_;    //!< Start of each atom's line in the current XYZ frame
+		compressedTrajectoryReader ctz_;    //!< Decoder of compressed frames
+};
+
+//! Per-thread accumulators of the static properties
+struct frameStatistics {
+	int frames;                 //!< Number of frames accumulated
+	int grFrames;               //!< Number of frames whose box was large enough for g(r)
+	std::vector <double> gr;    //!< Sum over frames of g(r) in each bin
+	std::vector <double> profile;       //!< Sum over frames of the density in each bin along x, y and z (axis major)
+	std::vector <double> hist;  //!< Pair histogram of one frame
+	systemDefinition sys;       //!< Frame handed to the cell list
+	void clear ();              //!< Zero every accumulator
+};
+
+void addRdf (const std::vector <float3> &pos, const float3 &box, const float rmax, frameStatistics &acc);    //!< Add g(r) of a frame, if its box holds 3 cells of width rmax
+void addProfile (const std::vector <float3> &pos, const float3 &box, frameStatistics &acc);   //!< Add the density profiles of a frame
+
+/*!
+ * Mean squared displacement against each of the last maxLag frames.  Positions are unwrapped with the minimum image displacement
+ * between consecutive frames, so atoms must move less than half the box between frames.  Only maxLag frames are kept.
+ */
+class msdWindow {
+	public:
+		msdWindow (const int maxLag) {maxLag_ = maxLag; nFrames_ = 0; msd_.assign(maxLag+1, 0.0); count_.assign(maxLag+1, 0.0);}
+		void add (const std::vector <float3> &pos, const float3 &box);    //!< Unwrap a frame and add its displacement from every frame in the window
+		void write (std::ostream &os) const;                              //!< Write the lag (in frames) and the MSD
+		double msd (const int lag) const {return (lag > 0 && lag <= maxLag_ && count_[lag] > 0) ? msd_[lag]/count_[lag] : 0.0;}   //!< Report the MSD at a lag (in frames)
+	private:
+		int maxLag_;        //!< Largest lag
+		int nFrames_;       //!< Number of frames added
+		std::vector < std::vector <float3> > window_;   //!< Unwrapped positions of the last maxLag+1 frames (ring buffer)
+		std::vector <float3> last_;     //!< Wrapped positions of the last frame
+		std::vector <double> msd_;      //!< Sum of the MSD at each lag
+		std::vector <double> count_;    //!< Number of frame pairs summed at each lag
+		std::vector <double> partial_;  //!< Per-thread sums at each lag
+};
+
+#endif
@@ -2,10 +2,28 @@
 #include "potential.h"
 #include "integrator.h"
 #include "nvt.h"
+#include "npt.h"
 #include <iostream>
 #include "utils.h"
+#include "allocCounter.h"
+#include "ewald.h"
+#include "eam.h"
+#include "trajectory.h"
+#include "trajectoryAnalysis.h"
+#include "inSitu.h"
+#include "laneSystems.h"
+#include "correlator.h"
+#include "ensembleRunner.h"
+#include "replicaExchange.h"
+#include "structureFactor.h"
+#include "autotune.h"
 #include <omp.h>
 #include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <map>
 #include "gtest/gtest.h"
 
 class SystemTest : public ::testing::Test {
@@ -54,6 +72,41 @@ protected:
 	float sigma;
 	nvt_NH integrate;
 };	
+
+/*!
+ * Set up a Lennard-Jones system (epsilon = sigma = 1, rc = 2.5) of N atoms on a lattice of spacing dx in a cubic box, thermalized at T.
+ * If shifted, the potential is shifted so the energy is continuous at the cutoff.
+ */
+static void ljSystem (systemDefinition &b, const int N, const float L, const float T, const float rs, const bool shifted, const int seed=3145, const float dx=1.2) {
+	b.setBox(L, L, L);
+	b.setMass(1.0);
+	b.setTemp(T);
+	b.setRskin(rs);
+	b.setRcut(2.5);
+	b.initThermal(N, T, seed, dx);
+	b.setPotential(slj);
+	std::vector <float> args(5, 0.0);
+	args[0] = 1.0; // epsilon
+	args[1] = 1.0; // sigma
+	if (shifted) {
+		args[3] = -4.0*(pow(2.5, -12.0)-pow(2.5, -6.0)); // ushift
+	}
+	b.setPotentialArgs(args);
+}
+
+//! Check the energy and accelerations of a system are those of a plain cell list built at its current positions (wrap in ASSERT_NO_FATAL_FAILURE)
+static void expectForcesMatchFreshList (const systemDefinition &sys) {
+	systemDefinition ref = sys;
+	nvt_NH check (1.0);
+	check.resetCellList(ref);
+	check.calcForce(ref);
+	ASSERT_NEAR(ref.PotE(), sys.PotE(), 1.0e-4*fabs(ref.PotE()));
+	for (int i = 0; i < sys.numAtoms(); ++i) {
+		ASSERT_NEAR(ref.atoms[i].acc.x, sys.atoms[i].acc.x, 1.0e-3);
+		ASSERT_NEAR(ref.atoms[i].acc.y, sys.atoms[i].acc.y, 1.0e-3);
+		ASSERT_NEAR(ref.atoms[i].acc.z, sys.atoms[i].acc.z, 1.0e-3);
+	}
+}
 	
 TEST_F(SystemTest, NumAtoms) {
 	ASSERT_EQ(natoms, a.numAtoms());
@@ -128,6 +181,1272 @@ TEST_F(SystemTest, PBC) {
 	
 }
 
+TEST(CellListTest, IncrementalMatchesFullBuild) {
+	systemDefinition b;
+	const float L = 12.0;
+	b.setBox(L, L, L);
+	b.setMass(1.0);
+	b.initThermal(500, 1.0, 3145, 1.2);
+
+	cellList_cpu full (b.box(), 2.5, 0.5), inc (b.box(), 2.5, 0.5);
+	inc.setIncremental(true);
+	full.checkUpdate(b);
+	inc.checkUpdate(b);
+
+	// displace every atom by more than the skin so both lists rebuild
+	srand(3145);
+	for (int i = 0; i < b.numAtoms(); ++i) {
+		b.atoms[i].pos.x += 0.8*((1.0*rand())/RAND_MAX - 0.5);
+		b.atoms[i].pos.y += 0.8*((1.0*rand())/RAND_MAX - 0.5) + 0.6;
+		b.atoms[i].pos.z += 0.8*((1.0*rand())/RAND_MAX - 0.5);
+	}
+	cellList_cpu fresh (b.box(), 2.5, 0.5);
+	fresh.checkUpdate(b);
+	inc.checkUpdate(b);
+	ASSERT_EQ(2, inc.numBuilds());
+	ASSERT_LT(inc.movedLastBuild(), b.numAtoms());
+	// the drift piles atoms into some cells beyond their slack, which must be handled in place rather than by a full build
+	ASSERT_EQ(1, inc.numRelayouts());
+
+	for (int c = 0; c < fresh.nCells.x*fresh.nCells.y*fresh.nCells.z; ++c) {
+		std::vector <int> expected, found;
+		for (int s = fresh.cellBegin(c); s < fresh.cellEnd(c); ++s) expected.push_back(fresh.atom(s));
+		for (int s = inc.cellBegin(c); s < inc.cellEnd(c); ++s) found.push_back(inc.atom(s));
+		std::sort(expected.begin(), expected.end());
+		std::sort(found.begin(), found.end());
+		ASSERT_EQ(expected, found);
+	}
+}
+
+TEST(CellListTest, PackedCells) {
+	systemDefinition b;
+	const float L = 12.0;
+	b.setBox(L, L, L);
+	b.setMass(1.0);
+	b.initThermal(500, 1.0, 3145, 1.2);
+
+	cellList_cpu cl (b.box(), 2.5, 0.5);
+	cl.setPackedPositions(true);
+	cl.checkUpdate(b);
+
+	// every atom appears exactly once, in the cell containing it, with its position packed alongside
+	std::vector <int> seen (b.numAtoms(), 0);
+	for (int c = 0; c < cl.nCells.x*cl.nCells.y*cl.nCells.z; ++c) {
+		for (int s = cl.cellBegin(c); s < cl.cellEnd(c); ++s) {
+			const int i = cl.atom(s);
+			seen[i]++;
+			ASSERT_EQ(c, cl.cell(b.atoms[i].pos));
+			ASSERT_FLOAT_EQ(b.atoms[i].pos.x, cl.packedPos(s).x);
+			ASSERT_FLOAT_EQ(b.atoms[i].pos.y, cl.packedPos(s).y);
+			ASSERT_FLOAT_EQ(b.atoms[i].pos.z, cl.packedPos(s).z);
+		}
+	}
+	for (int i = 0; i < b.numAtoms(); ++i) {
+		ASSERT_EQ(1, seen[i]);
+	}
+}
+
+TEST(CellListTest, PairSchedulerCoversEveryPairOnce) {
+	systemDefinition b;
+	const float L = 12.0;
+	b.setBox(L, L, L);
+	b.setMass(1.0);
+	b.initRandom(500, 3145);
+
+	cellList_cpu cl (b.box(), 2.5, 0.5);
+	cl.checkUpdate(b);
+	cellPairScheduler tasks;
+	const int nThreads = 3;
+	tasks.build(cl, nThreads);
+
+	// thread 0 drains every queue by itself, so all other queues must be stolen from
+	std::vector <int> seen (tasks.numPairs(), 0);
+	int steals = 0, task;
+	while ((task = tasks.next(0, steals)) >= 0) {
+		for (int p = tasks.taskBegin(task); p < tasks.taskEnd(task); ++p) {
+			seen[p]++;
+		}
+	}
+	for (int p = 0; p < tasks.numPairs(); ++p) {
+		ASSERT_EQ(1, seen[p]);
+	}
+	ASSERT_GT(steals, 0);
+
+	int nonEmpty = 0;
+	for (int p = 0; p < cl.numCellPairs(); ++p) {
+		const int n1 = cl.occupancy(cl.pairCell1(p)), n2 = cl.occupancy(cl.pairCell2(p));
+		if ((cl.pairCell1(p) == cl.pairCell2(p)) ? n1 > 1 : n1*n2 > 0) nonEmpty++;
+	}
+	ASSERT_EQ(nonEmpty, tasks.numPairs());
+	for (int r = 1; r < tasks.numTasks(); ++r) {
+		ASSERT_GE(tasks.cost(tasks.sortedTask(r-1)), tasks.cost(tasks.sortedTask(r)));
+	}
+}
+
+TEST(CellListTest, SubcellsMatchForces) {
+	std::vector <atomVector> result;
+	std::vector <float> energy;
+	for (int k = 1; k <= 3; ++k) {
+		systemDefinition b;
+		ljSystem(b, 800, 12.0, 1.0, 0.3, false, 3145, 1.1);
+
+		nvt_NH integrate (1.0);
+		integrate.setCellSubdivisions(k);
+		integrate.resetCellList(b);
+		integrate.calcForce(b);
+		ASSERT_EQ(k, integrate.cellList().subdivisions());
+		result.push_back(b.atoms);
+		energy.push_back(b.PotE());
+	}
+
+	// finer cells only prune pairs which cannot interact, so forces are unchanged
+	for (int k = 1; k < 3; ++k) {
+		ASSERT_NEAR(energy[0], energy[k], 1.0e-4*fabs(energy[0]));
+		for (unsigned int i = 0; i < result[0].size(); ++i) {
+			ASSERT_NEAR(result[0][i].acc.x, result[k][i].acc.x, 1.0e-3);
+			ASSERT_NEAR(result[0][i].acc.y, result[k][i].acc.y, 1.0e-3);
+			ASSERT_NEAR(result[0][i].acc.z, result[k][i].acc.z, 1.0e-3);
+		}
+	}
+}
+
+TEST(CellListTest, ClusterPairsMatchForces) {
+	std::vector <atomVector> result;
+	std::vector <float> energy;
+	for (int c = 0; c < 2; ++c) {
+		systemDefinition b;
+		ljSystem(b, 800, 12.0, 1.0, 0.3, true, 3145, 1.1);
+
+		nvt_NH integrate (1.0);
+		integrate.setClusterPairs(c == 1);
+		integrate.resetCellList(b);
+		integrate.calcForce(b);
+		result.push_back(b.atoms);
+		energy.push_back(b.PotE());
+		if (c == 1) {
+			const clusterPairList &cp = integrate.clusters();
+			int atoms = 0;
+			for (int s = 0; s < cp.numClusters()*CLUSTER_SIZE; ++s) {
+				atoms += (cp.atom(s) >= 0) ? 1 : 0;
+			}
+			ASSERT_EQ(b.numAtoms(), atoms);
+			ASSERT_GT(cp.fill(), 0.5);
+		}
+	}
+	ASSERT_NEAR(energy[0], energy[1], 1.0e-4*fabs(energy[0]));
+	for (unsigned int i = 0; i < result[0].size(); ++i) {
+		ASSERT_NEAR(result[0][i].acc.x, result[1][i].acc.x, 1.0e-3);
+		ASSERT_NEAR(result[0][i].acc.y, result[1][i].acc.y, 1.0e-3);
+		ASSERT_NEAR(result[0][i].acc.z, result[1][i].acc.z, 1.0e-3);
+	}
+
+	// the list follows rebuilds and box rescaling of the cell list, and the virial drives the barostat
+	systemDefinition b;
+	ljSystem(b, 500, 9.0, 1.5, 0.3, true, 3145, 1.1);
+	b.setPressure(1.0);
+	npt_MTK integrate (0.5, 2.0);
+	integrate.setClusterPairs(true);
+	integrate.setTimestep(0.002);
+	integrate.step(b);
+	const float H0 = integrate.conservedEnergy(b);
+	for (int step = 0; step < 300; ++step) {
+		integrate.step(b);
+	}
+	ASSERT_NEAR(integrate.conservedEnergy(b), H0, 1.0e-3*b.numAtoms());
+	ASSERT_GT(integrate.cellList().numBuilds(), 1);
+}
+
+TEST(CellListTest, DualPairListMatchesForces) {
+	systemDefinition b;
+	ljSystem(b, 800, 12.0, 1.0, 1.0, true, 3145, 1.1);
+
+	nvt_NH integrate (1.0);
+	integrate.setTimestep(0.005);
+	integrate.setClusterPairs(true);
+	integrate.setDualPairList(0.1);
+	integrate.step(b);
+	for (int step = 1; step <= 200; ++step) {
+		integrate.step(b);
+		if (step%25 == 0) {
+			// the forces from the inner list are those of a plain cell list at the same positions
+			ASSERT_NO_FATAL_FAILURE(expectForcesMatchFreshList(b));
+		}
+	}
+
+	// the wide skin keeps rebuilds rare, the inner list is pruned in between and is much shorter than the outer one
+	const clusterPairList &cp = integrate.clusters();
+	ASSERT_GT(cp.numPrunes(), integrate.cellList().numBuilds());
+	ASSERT_LT(2*cp.numInnerPairs(), cp.numPairs());
+}
+
+TEST(CellListTest, ClusterPairsFollowCompression) {
+	// a cold dilute gas compressed hard by the barostat brings pairs beyond rc+rs at a build within rc while barely moving
+	for (int dual = 0; dual < 2; ++dual) {
+		systemDefinition b;
+		const float L = 14.0;
+		ljSystem(b, 500, L, 0.1, 0.3, true);
+		b.setPressure(10.0);
+
+		npt_MTK integrate (0.5, 0.2);
+		integrate.setTimestep(0.002);
+		integrate.setClusterPairs(true);
+		integrate.setDualPairList(dual ? 0.2 : 0.0);
+		integrate.step(b);
+		for (int step = 1; step <= 200; ++step) {
+			integrate.step(b);
+			if (step%10 == 0) {
+				ASSERT_NO_FATAL_FAILURE(expectForcesMatchFreshList(b));
+			}
+		}
+		ASSERT_LT(b.box().x, 0.9*L);
+	}
+
+	// an inner buffer as wide as the skin prunes nothing
+	systemDefinition b;
+	ljSystem(b, 500, 12.0, 1.0, 0.3, true);
+	nvt_NH integrate (1.0);
+	integrate.setClusterPairs(true);
+	integrate.setDualPairList(0.3);
+	integrate.resetCellList(b);
+	ASSERT_THROW(integrate.calcForce(b), customException);
+}
+
+TEST(CellListTest, AsyncRebuildMatchesForces) {
+	systemDefinition b;
+	ljSystem(b, 800, 12.0, 1.0, 0.6, true, 3145, 1.1);
+
+	nvt_NH integrate (1.0);
+	integrate.setTimestep(0.005);
+	integrate.setAsyncRebuild(true, 0.5);
+	integrate.step(b);
+	for (int step = 1; step <= 300; ++step) {
+		integrate.step(b);
+		if (step%20 == 0) {
+			// whichever list is in use, the forces are those of a list built at the current positions
+			ASSERT_NO_FATAL_FAILURE(expectForcesMatchFreshList(b));
+			ASSERT_LE(integrate.cellList().maxDisplacement(), b.rskin());
+		}
+	}
+
+	// rebuilds after the first come from the helper thread
+	const asyncCellList &async = integrate.asyncRebuilds();
+	ASSERT_GT(async.numTaken(), 0);
+	ASSERT_LE(async.numTaken(), async.numStarted());
+	ASSERT_GE(integrate.cellList().numBuilds(), 1+async.numTaken());
+
+	// a copy starts idle and carries on
+	nvt_NH copy = integrate;
+	ASSERT_FALSE(copy.asyncRebuilds().busy());
+	copy.step(b);
+
+	// the box must stay fixed
+	npt_MTK barostat (0.5, 2.0);
+	barostat.setAsyncRebuild(true);
+	b.setPressure(1.0);
+	ASSERT_THROW(barostat.step(b), customException);
+}
+
+TEST(CellListTest, FusedDisplacementCheck) {
+	systemDefinition b;
+	ljSystem(b, 500, 12.0, 1.0, 0.5, false);
+
+	nvt_NH integrate (1.0);
+	for (int step = 0; step < 20; ++step) {
+		integrate.step(b);
+		const cellList_cpu &cl = integrate.cellList();
+		if (cl.stepsSinceBuild() == 0) continue;
+
+		// displacements found during the position sweep must match a serial pass
+		float m1 = 0.0, m2 = 0.0;
+		for (int i = 0; i < b.numAtoms(); ++i) {
+			float3 dr;
+			keepTop2 (pbcDist2(b.atoms[i].pos, cl.refPos(i), dr, b.box()), m1, m2);
+		}
+		ASSERT_NEAR(sqrt(m1)+sqrt(m2), cl.maxDisplacement(), 1.0e-5);
+	}
+}
+
+TEST(AutotuneTest, SettlesOnAValidConfiguration) {
+	systemDefinition b;
+	ljSystem(b, 800, 12.0, 1.0, 0.5, true, 3145, 1.1);
+
+	const int maxThreads = omp_get_max_threads();
+	nvt_NH integrate (1.0);
+	autoTuner tuner;
+	tuner.setTrialSteps(4);
+	const float rs[] = {0.3, 0.6};
+	const float scale[] = {1.01, 1.25};
+	const int subdiv[] = {1, 2};
+	const omp_sched_t fk[] = {omp_sched_dynamic, omp_sched_static};
+	const int fc[] = {4, 0};
+	const omp_sched_t sk[] = {omp_sched_guided, omp_sched_static};
+	const int sc[] = {OMP_CHUNK, 0};
+	tuner.setSkinCandidates(std::vector <float> (rs, rs+2));
+	tuner.setCellScaleCandidates(std::vector <float> (scale, scale+2));
+	tuner.setCellSubdivCandidates(std::vector <int> (subdiv, subdiv+2));
+	tuner.setForceScheduleCandidates(std::vector <omp_sched_t> (fk, fk+2), std::vector <int> (fc, fc+2));
+	tuner.setSweepScheduleCandidates(std::vector <omp_sched_t> (sk, sk+2), std::vector <int> (sc, sc+2));
+	tuner.setRetune(0, 0.1);
+	int steps = 0;
+	while (tuner.tuning() && steps < 1000) {
+		tuner.step(b, integrate);
+		steps++;
+	}
+	ASSERT_FALSE(tuner.tuning());
+	ASSERT_EQ(1, tuner.numTunings());
+
+	// every parameter is one of its candidates
+	const tuneConfig best = tuner.best();
+	ASSERT_GE(best.threads, 1);
+	ASSERT_LE(best.threads, maxThreads);
+	ASSERT_TRUE(best.rs == rs[0] || best.rs == rs[1]);
+	ASSERT_TRUE(best.cellScale == scale[0] || best.cellScale == scale[1]);
+	ASSERT_TRUE(best.cellSubdiv == subdiv[0] || best.cellSubdiv == subdiv[1]);
+	if (!best.forceSteal) {
+		ASSERT_TRUE((best.forceKind == fk[0] && best.forceChunk == fc[0]) || (best.forceKind == fk[1] && best.forceChunk == fc[1]));
+	}
+	ASSERT_TRUE((best.sweepKind == sk[0] && best.sweepChunk == sc[0]) || (best.sweepKind == sk[1] && best.sweepChunk == sc[1]));
+
+	// and is the one the integrator and its cell list now run with
+	ASSERT_EQ(best.threads, omp_get_max_threads());
+	ASSERT_FLOAT_EQ(best.rs, b.rskin());
+	ASSERT_FLOAT_EQ(best.rs, integrate.cellList().skin());
+	ASSERT_FLOAT_EQ(best.cellScale, integrate.cellScale());
+	ASSERT_EQ(best.cellSubdiv, integrate.cellSubdivisions());
+	ASSERT_EQ(best.forceSteal, integrate.workStealing());
+	omp_sched_t kind;
+	int chunk;
+	integrate.sweepSchedule(kind, chunk);
+	ASSERT_EQ(best.sweepKind, kind);
+	ASSERT_EQ(best.sweepChunk, chunk);
+	if (!best.forceSteal) {
+		integrate.forceSchedule(kind, chunk);
+		ASSERT_EQ(best.forceKind, kind);
+		ASSERT_EQ(best.forceChunk, chunk);
+	}
+	tuner.step(b, integrate);
+	omp_set_num_threads(maxThreads);
+}
+
+TEST(NumaTest, FirstTouchPlacement) {
+	setNumaMode(true);
+	atomVector atoms (50000);
+	float3Vector pos (50000);
+	std::vector <atomVector> copies (2, atoms);
+	setNumaMode(false);
+
+	// every page was touched during allocation, so all are resident somewhere
+	std::stringstream report;
+	reportPlacement(report, "atoms", &atoms[0], atoms.size()*sizeof(atom));
+	reportPlacement(report, "pos", &pos[0], pos.size()*sizeof(float3));
+	ASSERT_EQ(std::string::npos, report.str().find("not resident"));
+	ASSERT_EQ(0, ((size_t) &atoms[0])%4096);
+	ASSERT_EQ(copies[1].size(), atoms.size());
+	ASSERT_FLOAT_EQ(0.0, atoms[49999].pos.x);
+	ASSERT_GE(pageNode(&atoms[0]), 0);
+
+	// on a machine with several nodes, each thread's share of the atoms must be on the node of the thread that owns it
+	if (numaNodes() < 2) {
+		GTEST_SKIP() << "only one NUMA node, placement across nodes cannot be checked";
+	}
+	std::stringstream pinning;
+	pinThreads(pinning);
+	setNumaMode(true);
+	float3Vector placed (4000000);
+	setNumaMode(false);
+	const int n = placed.size();
+	std::vector <int> owner (omp_get_max_threads(), -2), found (omp_get_max_threads(), -2);
+	bool wide = true;
+	#pragma omp parallel
+	{
+		// the middle of each thread's static share lies on a (huge) page only that thread touched first, if the share spans a few of them
+		const int tid = omp_get_thread_num(), nt = omp_get_num_threads();
+		const int begin = (long) n*tid/nt, end = (long) n*(tid+1)/nt;
+		if (tid == 0) {
+			wide = ((end-begin)*sizeof(float3) >= 3*2097152);
+		}
+		owner[tid] = threadNode();
+		found[tid] = pageNode(&placed[(begin+end)/2]);
+	}
+	if (!wide) {
+		GTEST_SKIP() << "too many threads for each share to span several huge pages";
+	}
+	for (unsigned int t = 0; t < owner.size(); ++t) {
+		if (owner[t] >= 0) {
+			ASSERT_EQ(owner[t], found[t]);
+		}
+	}
+}
+
+TEST(WorkspaceTest, SteadyStateDoesNotAllocate) {
+	systemDefinition b;
+	ljSystem(b, 800, 12.0, 1.0, 0.3, false, 3145, 1.1);
+
+	nvt_NH integrate (1.0);
+	for (int step = 0; step < 20; ++step) {
+		integrate.step(b);
+	}
+
+	// buffers have been sized, further steps (including cell list rebuilds) reuse them
+	const int builds = integrate.cellList().numBuilds();
+	const long before = allocCount();
+	ASSERT_GT(before, 0);   // the counting operator new is linked in
+	for (int step = 0; step < 50; ++step) {
+		integrate.step(b);
+	}
+	ASSERT_EQ(before, allocCount());
+	ASSERT_GT(integrate.cellList().numBuilds(), builds);
+
+	// per-atom arrays (the cell list's among them) are counted too, so rebuilding a list must not reallocate any of them
+	float3Vector placed (b.numAtoms());
+	ASSERT_EQ(before+1, allocCount());
+	cellList_cpu cl = integrate.cellList();
+	cl.rebuild(b);
+	const long copied = allocCount();
+	for (int step = 0; step < 20; ++step) {
+		integrate.step(b);
+		cl.rebuild(b);
+	}
+	ASSERT_EQ(copied, allocCount());
+}
+
+TEST(EwaldTest, RockSaltMadelungConstant) {
+	// rock salt lattice with nearest neighbor distance 1, the energy per ion pair is the Madelung constant
+	const int n = 10;
+	systemDefinition s;
+	s.setBox(n, n, n);
+	s.setMass(1.0);
+	s.setTemp(1.0);
+	s.setRskin(0.3);
+	s.setRcut(3.0);
+	s.initThermal(n*n*n, 1.0, 3145, 1.0);
+	std::vector <float> q (n*n*n);
+	for (int i = 0; i < n*n*n; ++i) {
+		const int parity = (int) floor(s.atoms[i].pos.x+0.5) + (int) floor(s.atoms[i].pos.y+0.5) + (int) floor(s.atoms[i].pos.z+0.5);
+		q[i] = (parity%2) ? -1.0 : 1.0;
+	}
+	s.setCharges(q);
+	s.setPotential(slj);
+	std::vector <float> args(5, 0.0);	// no Lennard-Jones interactions
+	args[1] = 1.0;
+	s.setPotentialArgs(args);
+
+	std::vector <float3> acc[2];
+	for (int m = 0; m < 2; ++m) {
+		ewaldSolver es ((m == 0) ? CLASSIC_EWALD : SMOOTH_PME, 1.0e-5);
+		es.setOrder(6);
+		nvt_NH integrate (1.0);
+		integrate.setElectrostatics(&es);
+		integrate.resetCellList(s);
+		integrate.calcForce(s);
+		EXPECT_NEAR(-1.747565, s.PotE()/(n*n*n/2), 1.0e-4);
+		for (int i = 0; i < n*n*n; ++i) {
+			EXPECT_NEAR(0.0, s.atoms[i].acc.x, 1.0e-3);
+		}
+
+		// away from the lattice both methods must agree
+		s.atoms[0].pos.x += 0.2;
+		s.atoms[1].pos.y += 0.1;
+		integrate.calcForce(s);
+		for (int i = 0; i < n*n*n; ++i) {
+			acc[m].push_back(s.atoms[i].acc);
+		}
+		s.atoms[0].pos.x -= 0.2;
+		s.atoms[1].pos.y -= 0.1;
+	}
+	ASSERT_NEAR(acc[0][0].x, acc[1][0].x, 1.0e-3*fabs(acc[0][0].x));
+	ASSERT_NEAR(acc[0][1].y, acc[1][1].y, 1.0e-3*fabs(acc[0][1].y));
+}
+
+TEST(NptTest, BarostatRescalesCellListInPlace) {
+	systemDefinition b;
+	const float L = 9.0;
+	ljSystem(b, 500, L, 1.5, 0.3, true, 3145, 1.1);
+	b.setPressure(1.0);
+
+	npt_MTK integrate (0.5, 2.0);
+	integrate.setTimestep(0.002);
+	integrate.step(b);
+	const float H0 = integrate.conservedEnergy(b);
+	for (int step = 0; step < 500; ++step) {
+		integrate.step(b);
+	}
+	ASSERT_NEAR(integrate.conservedEnergy(b), H0, 1.0e-3*b.numAtoms());	// float round off only
+	ASSERT_GT(fabs(b.box().x-L), 0.05);
+	ASSERT_NEAR(b.box().x, b.box().z, 1.0e-4);
+
+	// the box moved every step, the grid rarely had to be recreated
+	ASSERT_LT(integrate.cellGridResets(), 5);
+}
+
+TEST(TrajectoryTest, CompressedRoundTrip) {
+	systemDefinition b;
+	const float L = 12.0;
+	ljSystem(b, 1000, L, 1.0, 0.3, false, 3145, 1.0);
+
+	// melt the lattice, so key frames cannot rely on the atoms' initial ordering and many atoms have left the box
+	nvt_NH integrate (1.0);
+	for (int step = 0; step < 1000; ++step) {
+		integrate.step(b);
+	}
+
+	// at the default precision key frames take about 5.5 bytes per atom, the frames between them about 3.5
+	const int nFrames = 12;
+	std::vector < std::vector <float3> > frames;
+	float precision;
+	long bytes, keyBytes = 0;
+	{
+		compressedTrajectoryWriter out ("test_trajectory.ctz");
+		precision = out.precision();
+		for (int f = 0; f < nFrames; ++f) {
+			for (int step = 0; step < 20; ++step) {
+				integrate.step(b);
+			}
+			out.write(b, f);
+			if (f == 0) {
+				keyBytes = out.bytesWritten();
+			}
+			std::vector <float3> pos (b.numAtoms());
+			for (int i = 0; i < b.numAtoms(); ++i) {
+				pos[i] = b.atoms[i].pos;
+			}
+			frames.push_back(pos);
+		}
+		bytes = out.bytesWritten();
+	}
+	ASSERT_FLOAT_EQ(0.001, precision);
+	ASSERT_LT(keyBytes, 5.75*b.numAtoms());
+	ASSERT_LT(bytes, 4*nFrames*b.numAtoms());
+
+	// every coordinate is recovered to within half the precision, including frames predicted from earlier ones
+	compressedTrajectoryReader in ("test_trajectory.ctz");
+	std::vector <float3> pos;
+	float3 box;
+	int f = 0, step;
+	while (in.read(pos, box, step)) {
+		ASSERT_EQ(f, step);
+		ASSERT_EQ(b.numAtoms(), (int) pos.size());
+		ASSERT_FLOAT_EQ(L, box.x);
+		for (int i = 0; i < b.numAtoms(); ++i) {
+			ASSERT_NEAR(frames[f][i].x, pos[i].x, 0.5*precision+1.0e-5);
+			ASSERT_NEAR(frames[f][i].y, pos[i].y, 0.5*precision+1.0e-5);
+			ASSERT_NEAR(frames[f][i].z, pos[i].z, 0.5*precision+1.0e-5);
+		}
+		f++;
+	}
+	ASSERT_EQ(nFrames, f);
+	remove("test_trajectory.ctz");
+}
+
+TEST(AnalyzeTest, LatticeRdfAndDriftMsd) {
+	// a simple cubic lattice of spacing 1 translated by 0.3 along x every frame, wrapped into the box
+	const int n = 6, N = n*n*n, nFrames = 5;
+	const float L = n, v = 0.3;
+	{
+		FILE *f = fopen("test_analysis.xyz", "w");
+		for (int frame = 0; frame < nFrames; ++frame) {
+			fprintf(f, "%d\nframe %d\n", N, frame);
+			for (int i = 0; i < N; ++i) {
+				const float x = fmod(i%n + v*frame, L);
+				fprintf(f, "A %f %f %f\n", x, (float) ((i/n)%n), (float) (i/(n*n)));
+			}
+		}
+		fclose(f);
+	}
+
+	float3 box;
+	box.x = L; box.y = L; box.z = L;
+	mappedTrajectory traj ("test_analysis.xyz", box);
+	ASSERT_FALSE(traj.compressed());
+	const float rmax = 1.9;
+	frameStatistics acc;
+	acc.clear();
+	msdWindow msd (nFrames-1);
+	std::vector <float3> pos;
+	float3 frameBox;
+	int frames = 0;
+	while (traj.next(pos, frameBox)) {
+		ASSERT_EQ(N, (int) pos.size());
+		ASSERT_FLOAT_EQ(L, frameBox.x);
+		addRdf(pos, frameBox, rmax, acc);
+		msd.add(pos, frameBox);
+		frames++;
+	}
+	remove("test_analysis.xyz");
+	ASSERT_EQ(nFrames, frames);
+	ASSERT_EQ(nFrames, acc.grFrames);
+
+	// integrating g(r) counts 6 nearest neighbors at r = 1, then 12 more at sqrt(2) and 8 at sqrt(3), and nothing closer
+	const double rho = N/(L*L*L), dr = rmax/GR_BINS;
+	double neighbors = 0.0;
+	for (int b = 0; b < GR_BINS; ++b) {
+		const double r = (b+1)*dr;
+		neighbors += rho*acc.gr[b]/nFrames*4.0/3.0*M_PI*(pow(r, 3.0) - pow(b*dr, 3.0));
+		if (r < 0.9) {
+			ASSERT_DOUBLE_EQ(0.0, acc.gr[b]);
+		} else if (r > 1.1 && r < 1.3) {
+			ASSERT_NEAR(6.0, neighbors, 1.0e-3);
+		} else if (r > 1.5 && r < 1.7) {
+			ASSERT_NEAR(18.0, neighbors, 1.0e-3);
+		} else if (r > 1.8) {
+			ASSERT_NEAR(26.0, neighbors, 1.0e-3);
+		}
+	}
+
+	// every atom drifts ballistically, across the periodic boundary too
+	for (int lag = 1; lag < nFrames; ++lag) {
+		ASSERT_NEAR(v*v*lag*lag, msd.msd(lag), 1.0e-4);
+	}
+}
+
+TEST(TimestepTest, AdaptiveTimestepSurvivesHotStart) {
+	systemDefinition b;
+	const float T = 5.0;
+	ljSystem(b, 1000, 12.0, T, 0.3, true);
+
+	// a fixed step of 0.005 blows up from this start
+	nvt_NH integrate (1.0);
+	integrate.setTimestep(0.005);
+	integrate.setAdaptiveTimestep(0.0005, 0.02);
+	integrate.step(b);
+	const float H0 = integrate.conservedEnergy(b);
+	for (int step = 0; step < 600; ++step) {
+		integrate.step(b);
+	}
+	ASSERT_GT(integrate.timestepChanges(), 0);
+	ASSERT_LT(integrate.timestep(), 0.005);
+	ASSERT_GE(integrate.timestep(), 0.0005);
+	ASSERT_NEAR(integrate.conservedEnergy(b), H0, 0.01*b.numAtoms());
+	ASSERT_NEAR(b.instantT(), T, 0.5);
+}
+
+TEST(OverlapTest, PoliciesCountOverlapsWithoutThrowingInTheForceLoop) {
+	const overlapPolicy policies[3] = {OVERLAP_ABORT, OVERLAP_CLAMP, OVERLAP_SOFTCORE};
+	for (int p = 0; p < 3; ++p) {
+		systemDefinition b;
+		const float L = 12.0;
+		b.setBox(L, L, L);
+		b.setMass(1.0);
+		b.setTemp(1.0);
+		b.setRskin(0.3);
+		b.setRcut(3.0);
+		b.initThermal(1000, 1.0, 3145, 1.2);
+		b.setPotential(slj);
+		std::vector <float> args(5, 0.0);
+		args[0] = 1.0; // epsilon
+		args[1] = 1.0; // sigma
+		args[2] = 1.3; // delta, so every nearest neighbor on the lattice overlaps
+		b.setPotentialArgs(args);
+		b.setOverlapPolicy(policies[p]);
+
+		nvt_NH integrate (1.0);
+		integrate.resetCellList(b);
+		if (policies[p] == OVERLAP_ABORT) {
+			ASSERT_THROW(integrate.calcForce(b), customException);
+		} else {
+			integrate.calcForce(b);
+			ASSERT_TRUE(fabs(b.PotE()) < 1.0e30);
+			for (int i = 0; i < b.numAtoms(); ++i) {
+				ASSERT_TRUE(fabs(b.atoms[i].acc.x) + fabs(b.atoms[i].acc.y) + fabs(b.atoms[i].acc.z) < 1.0e30);
+			}
+		}
+		ASSERT_EQ(3*b.numAtoms(), integrate.overlaps());
+	}
+
+	// the soft core continues the potential linearly, matching it where it starts
+	overlapState ov;
+	ov.policy = OVERLAP_SOFTCORE;
+	ov.softCore = 0.8;
+	ov.count = 0;
+	std::vector <float> args(5, 0.0);
+	args[0] = 1.0;
+	args[1] = 1.0;
+	args[2] = 0.5;
+	const float3 box = {10.0, 10.0, 10.0}, p1 = {1.0, 1.0, 1.0};
+	const float rc = 3.0, xs = 0.8, fs = 24.0*(2.0*pow(xs, -13.0)-pow(xs, -7.0));
+	float3 p2 = {1.0f+args[2]+xs, 1.0, 1.0}, pf;
+	const float Us = slj(&p1, &p2, &pf, &box, &args[0], &rc, &ov);
+	ASSERT_NEAR(4.0*(pow(xs, -12.0)-pow(xs, -6.0)), Us, 1.0e-3*Us);
+	p2.x = 1.2;
+	ASSERT_NEAR(Us + fs*(xs+args[2]-0.2), slj(&p1, &p2, &pf, &box, &args[0], &rc, &ov), 1.0e-3*Us);
+	ASSERT_NEAR(fs, fabs(pf.x), 1.0e-3*fs);
+	ASSERT_EQ(1, ov.count);
+}
+
+TEST(EamTest, TwoPassForcesMatchEnergy) {
+	// a smooth single element setfl file: f(r) = (rc-r)^4, F(rho) = rho^2/2 - 2 rho, phi(r) a Morse potential tapered to zero at rc
+	const int nrho = 1000, nr = 1000;
+	const double drho = 0.01, dr = 0.002, rc = 2.0;
+	FILE *f = fopen("test.eam.alloy", "w");
+	fprintf(f, "test\nfunctions\n\n1 X\n%d %g %d %g %g\n1 1.0 1.2 sc\n", nrho, drho, nr, dr, rc);
+	for (int i = 0; i < nrho; ++i) {
+		const double rho = i*drho;
+		fprintf(f, "%.10g\n", 0.5*rho*rho - 2.0*rho);
+	}
+	for (int i = 0; i < nr; ++i) {
+		const double r = i*dr;
+		fprintf(f, "%.10g\n", pow(rc-r, 4.0));
+	}
+	for (int i = 0; i < nr; ++i) {
+		const double r = i*dr;
+		fprintf(f, "%.10g\n", r*(exp(-6.0*(r-1.0)) - 2.0*exp(-3.0*(r-1.0)))*(rc-r)*(rc-r));
+	}
+	fclose(f);
+	eamPotential eam ("test.eam.alloy");
+	remove("test.eam.alloy");
+	ASSERT_FLOAT_EQ(2.0, eam.cutoff());
+
+	systemDefinition b;
+	const float L = 7.3;
+	b.setBox(L, L, L);
+	b.setMass(eam.mass());
+	b.setTemp(1.0);
+	b.setRskin(0.3);
+	b.setRcut(eam.cutoff());
+	b.initThermal(216, 1.0, 3145, 1.2);
+	for (int i = 0; i < b.numAtoms(); ++i) {
+		b.atoms[i].pos.x += 0.1*sin(1.7*i);
+		b.atoms[i].pos.y += 0.1*sin(2.3*i);
+		b.atoms[i].pos.z += 0.1*sin(3.1*i);
+	}
+	nvt_NH integrate (1.0);
+	integrate.setEmbeddedAtom(&eam);
+	integrate.resetCellList(b);
+	integrate.calcForce(b);
+
+	// energy agrees with a direct sum over all pairs
+	std::vector <double> rho (b.numAtoms(), 0.0);
+	double U = 0.0;
+	for (int i = 0; i < b.numAtoms(); ++i) {
+		for (int j = i+1; j < b.numAtoms(); ++j) {
+			float3 dr;
+			const float r = sqrt(pbcDist2(b.atoms[i].pos, b.atoms[j].pos, dr, b.box()));
+			if (r < rc) {
+				float d;
+				rho[i] += eam.density(r, d);
+				rho[j] += eam.density(r, d);
+				U += eam.pair(r, d);
+			}
+		}
+	}
+	for (int i = 0; i < b.numAtoms(); ++i) {
+		float d;
+		U += eam.embed(rho[i], d);
+	}
+	ASSERT_NEAR(U, b.PotE(), 1.0e-4*fabs(U));
+
+	// forces are the derivative of the energy
+	const float h = 0.005;
+	const int probe[3] = {0, 17, 100};
+	for (int k = 0; k < 3; ++k) {
+		const int i = probe[k];
+		const float F = b.atoms[i].acc.x*b.mass();
+		const float x = b.atoms[i].pos.x;
+		b.atoms[i].pos.x = x + h;
+		integrate.calcForce(b);
+		const float Up = b.PotE();
+		b.atoms[i].pos.x = x - h;
+		integrate.calcForce(b);
+		const float Um = b.PotE();
+		b.atoms[i].pos.x = x;
+		integrate.calcForce(b);
+		ASSERT_NEAR(F, -(Up-Um)/(2.0*h), 0.02*fabs(F) + 0.05);
+	}
+}
+
+//! One-shot latch: wait() blocks until release() has been called
+class testLatch {
+	public:
+		testLatch () {released_ = false; pthread_mutex_init(&lock_, NULL); pthread_cond_init(&cond_, NULL);}
+		~testLatch () {pthread_cond_destroy(&cond_); pthread_mutex_destroy(&lock_);}
+		void release () {
+			pthread_mutex_lock(&lock_);
+			released_ = true;
+			pthread_cond_broadcast(&cond_);
+			pthread_mutex_unlock(&lock_);
+		}
+		void wait () {
+			pthread_mutex_lock(&lock_);
+			while (!released_) {
+				pthread_cond_wait(&cond_, &lock_);
+			}
+			pthread_mutex_unlock(&lock_);
+		}
+		bool released () {
+			pthread_mutex_lock(&lock_);
+			const bool r = released_;
+			pthread_mutex_unlock(&lock_);
+			return r;
+		}
+	private:
+		bool released_;
+		pthread_mutex_t lock_;
+		pthread_cond_t cond_;
+};
+
+//! Records the step and first position of every snapshot it sees, each once the gate (if any) is open
+class gatedHook : public analysisHook {
+	public:
+		gatedHook (testLatch *gate) {gate_ = gate;}
+		void analyze (const snapshot &snap) {
+			if (gate_ != NULL) {
+				gate_->wait();
+			}
+			steps.push_back(snap.step);
+			x.push_back(snap.pos[0].x);
+		}
+		std::vector <int> steps;
+		std::vector <float> x;
+	private:
+		testLatch *gate_;
+};
+
+//! Opens the gate (second) once the integrator has reached the step that must wait for it (first)
+static void* openGateWhenReached (void *latches) {
+	std::pair <testLatch*, testLatch*> *l = static_cast <std::pair <testLatch*, testLatch*>*> (latches);
+	l->first->wait();
+	l->second->release();
+	return NULL;
+}
+
+TEST(InSituTest, HooksSeeSnapshotsWhileTheIntegratorContinues) {
+	systemDefinition b;
+	const float L = 12.0;
+	b.setBox(L, L, L);
+	b.setMass(1.0);
+	b.setTemp(1.0);
+	b.setRskin(0.3);
+	b.setRcut(2.5);
+	b.initThermal(1000, 1.0, 3145, 1.2);
+	b.setPotential(slj);
+	std::vector <float> args(5, 0.0);
+	args[0] = 1.0; // epsilon
+	args[1] = 1.0; // sigma
+	b.setPotentialArgs(args);
+	nvt_NH integrate (1.0);
+
+	// the gated hook cannot finish its snapshot of step 0 until the gate opens, so from step 4 on both buffers are in use: skipping
+	// drops every analysis due until then, and blocking holds up step 4 until the gate opens
+	const int nSteps = 20, firstFull = 4;
+	const laggingPolicy policies[2] = {ANALYSIS_BLOCK, ANALYSIS_SKIP};
+	for (int p = 0; p < 2; ++p) {
+		testLatch gate, reached;
+		std::pair <testLatch*, testLatch*> latches (&reached, &gate);
+		pthread_t opener;
+		if (policies[p] == ANALYSIS_BLOCK) {
+			ASSERT_EQ(0, pthread_create(&opener, NULL, openGateWhenReached, &latches));
+		}
+		gatedHook slow (&gate), fast (NULL);
+		std::map <int, float> x;
+		bool openedFirst = false;
+		{
+			inSituAnalysis analysis (2, policies[p]);
+			analysis.addHook(&slow, 2, "slow");
+			analysis.addHook(&fast, 5, "fast");
+			for (int step = 0; step < nSteps; ++step) {
+				integrate.step(b);
+				x[step] = b.atoms[0].pos.x;
+				if (step == firstFull) {
+					reached.release();
+				}
+				analysis.update(b, step);
+				if (step == firstFull) {
+					openedFirst = gate.released();
+				}
+			}
+			gate.release();
+			analysis.finish();
+			const hookStats s = analysis.stats(0), f = analysis.stats(1);
+			ASSERT_EQ(nSteps/2, s.calls + s.skipped);
+			ASSERT_EQ((int) slow.steps.size(), s.calls);
+			ASSERT_EQ((int) fast.steps.size(), f.calls);
+			if (policies[p] == ANALYSIS_BLOCK) {
+				ASSERT_EQ(0, pthread_join(opener, NULL));
+				ASSERT_TRUE(openedFirst);
+				ASSERT_EQ(0, s.skipped);
+				ASSERT_EQ(0, f.skipped);
+				ASSERT_EQ(nSteps/5, f.calls);
+			} else {
+				ASSERT_FALSE(openedFirst);
+				ASSERT_EQ(2, s.calls);
+				ASSERT_EQ(1, f.calls);
+				ASSERT_EQ(nSteps/5-1, f.skipped);
+			}
+		}
+
+		// every snapshot is the state at its own step, in order, even though the system moved on while it was analyzed
+		for (unsigned int i = 0; i < slow.steps.size(); ++i) {
+			ASSERT_EQ(0, slow.steps[i]%2);
+			if (i > 0) {
+				ASSERT_GT(slow.steps[i], slow.steps[i-1]);
+			}
+			ASSERT_FLOAT_EQ(x[slow.steps[i]], slow.x[i]);
+		}
+		for (unsigned int i = 0; i < fast.steps.size(); ++i) {
+			ASSERT_FLOAT_EQ(x[fast.steps[i]], fast.x[i]);
+		}
+	}
+}
+
+TEST(CorrelatorTest, MultiTauAndGreenKubo) {
+	// two channels cos(wt) and sin(wt) average to C(t) = cos(wt)/2, exactly at level 0 and nearly so at the block averaged lags
+	multiTauCorrelator c (2, 16, 2, 12);
+	const double w = 0.05;
+	for (int t = 0; t < 4000; ++t) {
+		float x[2] = {(float) cos(w*t), (float) sin(w*t)};
+		c.add(x);
+	}
+	std::vector <double> lag, C;
+	c.result(lag, C);
+	ASSERT_EQ(16 + 7*8 + 7, (int) lag.size());	// level k holds 4000/2^k values: levels 1-7 have all 8 lags, level 8 (15 values) has 7, and later levels none
+	for (unsigned int i = 0; i < lag.size(); ++i) {
+		if (i > 0) {
+			ASSERT_GT(lag[i], lag[i-1]);
+		}
+		if (lag[i] < 16) {
+			ASSERT_NEAR(0.5*cos(w*lag[i]), C[i], 1.0e-5);
+		} else if (lag[i] <= 120) {
+			ASSERT_NEAR(0.5*cos(w*lag[i]), C[i], 0.025);
+		}
+	}
+
+	// a level's values are allocated when the first value reaches it, after 2^k samples
+	multiTauCorrelator d (3, 16, 2, 24);
+	ASSERT_EQ(1, d.levelsAllocated());
+	for (int t = 0; t < 100; ++t) {
+		float x[3] = {(float) t, 1.0f, -1.0f};
+		d.add(x);
+	}
+	ASSERT_EQ(7, d.levelsAllocated());
+
+	// the off-diagonal virial from the force loop matches a direct sum over pairs
+	systemDefinition b;
+	const float L = 12.0;
+	b.setBox(L, L, L);
+	b.setMass(1.0);
+	b.setTemp(1.5);
+	b.setRskin(0.3);
+	b.setRcut(2.5);
+	b.initThermal(1000, 1.5, 3145, 1.2);
+	b.setPotential(slj);
+	std::vector <float> args(5, 0.0);
+	args[0] = 1.0; // epsilon
+	args[1] = 1.0; // sigma
+	b.setPotentialArgs(args);
+	nvt_NH integrate (1.0);
+	integrate.setComputeStress(true);
+	for (int step = 0; step < 50; ++step) {
+		integrate.step(b);
+	}
+	double Wxy = 0.0, Wxz = 0.0, Wyz = 0.0;
+	const float rc = b.rcut();
+	const float3 box = b.box();
+	for (int i = 0; i < b.numAtoms(); ++i) {
+		for (int j = i+1; j < b.numAtoms(); ++j) {
+			float3 dr, pf;
+			overlapState ov = {OVERLAP_ABORT, 0.8, 0};
+			slj(&b.atoms[i].pos, &b.atoms[j].pos, &pf, &box, &args[0], &rc, &ov);
+			pbcDist2(b.atoms[i].pos, b.atoms[j].pos, dr, box);
+			Wxy -= dr.x*pf.y;
+			Wxz -= dr.x*pf.z;
+			Wyz -= dr.y*pf.z;
+		}
+	}
+	const float3 Woff = b.virialOffDiagonal();
+	ASSERT_NEAR(Wxy, Woff.x, 1.0e-3*b.numAtoms());
+	ASSERT_NEAR(Wxz, Woff.y, 1.0e-3*b.numAtoms());
+	ASSERT_NEAR(Wyz, Woff.z, 1.0e-3*b.numAtoms());
+
+	// the VACF starts at kT/m per component, and both coefficients come out positive
+	greenKubo gk (integrate.timestep());
+	double T = 0.0;
+	const int nSamples = 400;
+	for (int step = 0; step < nSamples; ++step) {
+		integrate.step(b);
+		gk.update(b);
+		T += b.instantT();
+	}
+	gk.vacf().result(lag, C);
+	ASSERT_NEAR(T/nSamples, C[0]*b.mass(), 0.02*T/nSamples);
+	ASSERT_GT(gk.diffusion(), 0.0);
+	ASSERT_GT(gk.viscosity(), 0.0);
+}
+
+TEST(StructureFactorTest, ShellsMatchDirectSum) {
+	systemDefinition b;
+	const float Lx = 9.0, Ly = 10.0, Lz = 11.0, kmax = 5.0, dk = 0.25;
+	b.setBox(Lx, Ly, Lz);
+	b.setMass(1.0);
+	b.initRandom(800, 3145);
+
+	// only multiples of the interval are sampled
+	structureFactor sf (kmax, 5, dk);
+	for (int step = 1; step <= 10; ++step) {
+		sf.update(b, step);
+	}
+	ASSERT_EQ(2, sf.samples());
+
+	// the same configuration summed directly over every wavevector in half of reciprocal space
+	const int nshell = (int) (kmax/dk)+1, N = b.numAtoms();
+	std::vector <double> direct (nshell, 0.0), count (nshell, 0.0);
+	const int n[3] = {(int) (kmax*Lx/(2*M_PI)), (int) (kmax*Ly/(2*M_PI)), (int) (kmax*Lz/(2*M_PI))};
+	int nk = 0;
+	for (int nx = -n[0]; nx <= n[0]; ++nx) {
+		for (int ny = -n[1]; ny <= n[1]; ++ny) {
+			for (int nz = -n[2]; nz <= n[2]; ++nz) {
+				const double kx = 2*M_PI*nx/Lx, ky = 2*M_PI*ny/Ly, kz = 2*M_PI*nz/Lz, k = sqrt(kx*kx + ky*ky + kz*kz);
+				if (k == 0.0 || k > kmax || nx < 0 || (nx == 0 && (ny < 0 || (ny == 0 && nz < 0)))) {
+					continue;
+				}
+				double c = 0.0, s = 0.0;
+				for (int i = 0; i < N; ++i) {
+					const double kr = kx*b.atoms[i].pos.x + ky*b.atoms[i].pos.y + kz*b.atoms[i].pos.z;
+					c += cos(kr);
+					s += sin(kr);
+				}
+				direct[(int) (k/dk)] += (c*c + s*s)/N;
+				count[(int) (k/dk)] += 1.0;
+				nk++;
+			}
+		}
+	}
+	ASSERT_EQ(nk, sf.numWavevectors());
+
+	std::vector <double> k, S;
+	sf.result(k, S);
+	int shells = 0;
+	double mean = 0.0;
+	for (int sh = 0; sh < nshell; ++sh) {
+		if (count[sh] == 0) continue;
+		ASSERT_NEAR((sh+0.5)*dk, k[shells], 1.0e-6);
+		ASSERT_NEAR(direct[sh]/count[sh], S[shells], 1.0e-6*std::max(1.0, S[shells]));
+		mean += S[shells]*count[sh];
+		shells++;
+	}
+	ASSERT_EQ(shells, (int) k.size());
+
+	// uncorrelated positions have S(k) = 1 on average
+	ASSERT_NEAR(1.0, mean/nk, 0.1);
+}
+
+//! Thermostat which records the size of the team its parallel regions run on
+class teamNvt : public nvt_NH {
+	public:
+		teamNvt (const float Q) : nvt_NH (Q) {team = 0;}
+		void step (systemDefinition &sys) {
+			nvt_NH::step(sys);
+			#pragma omp parallel
+			{
+				#pragma omp single
+				team = omp_get_num_threads();
+			}
+		}
+		int team;
+};
+
+TEST(EnsembleTest, ReplicasMatchIndependentRuns) {
+	const int nrep = 4, nSteps = 20;
+	const int N[nrep] = {200, 500, 200, 500};
+	const float L[nrep] = {9.0, 11.0, 9.0, 11.0}, T[nrep] = {0.8, 1.0, 1.2, 1.4};
+	systemDefinition sys[nrep], ref[nrep];
+	std::vector <teamNvt*> integrators;
+	std::vector <nvt_NH*> refIntegrators;
+	ensembleRunner runner (100);
+	for (int i = 0; i < nrep; ++i) {
+		ljSystem(sys[i], N[i], L[i], T[i], 0.3, false, 3145+i);
+		ljSystem(ref[i], N[i], L[i], T[i], 0.3, false, 3145+i);
+		integrators.push_back(new teamNvt (1.0));
+		refIntegrators.push_back(new nvt_NH (1.0));
+		ASSERT_EQ(i, runner.addReplica(&sys[i], integrators[i], nSteps));
+	}
+
+	// on 4 threads the small replicas get 2 each and run side by side, the large ones every thread
+	ASSERT_EQ(2, runner.teamSize(200, 4));
+	ASSERT_EQ(4, runner.teamSize(500, 4));
+	ASSERT_EQ(3, runner.teamSize(500, 3));
+	ASSERT_EQ(1, runner.teamSize(50, 4));
+	runner.run(4);
+	for (int i = 0; i < nrep; ++i) {
+		ASSERT_EQ(N[i] == 200 ? 2 : 4, runner.threads(i));
+		ASSERT_EQ(runner.threads(i), integrators[i]->team);  // the teams really ran nested, with the threads they were given
+		ASSERT_GT(runner.time(i), 0.0);
+	}
+	ASSERT_GT(runner.wallTime(), 0.0);
+
+	// each replica evolves as it would on its own, up to the order of the force sums
+	for (int i = 0; i < nrep; ++i) {
+		for (int step = 0; step < nSteps; ++step) {
+			refIntegrators[i]->step(ref[i]);
+		}
+		ASSERT_NEAR(ref[i].PotE(), sys[i].PotE(), 1.0e-3*fabs(ref[i].PotE()));
+		ASSERT_NEAR(ref[i].KinE(), sys[i].KinE(), 1.0e-3*ref[i].KinE());
+		delete integrators[i];
+		delete refIntegrators[i];
+	}
+}
+
+TEST(ReplicaExchangeTest, SwapsMoveTemperaturesBetweenReplicas) {
+	// a swap rescales velocities and the thermostat velocity by sqrt(T/T0)
+	systemDefinition one;
+	ljSystem(one, 200, 9.0, 1.0, 0.3, false, 3145);
+	nvt_NH single (1.0);
+	for (int step = 0; step < 10; ++step) {
+		single.step(one);
+	}
+	const float v0 = one.atoms[7].vel.y, T0 = one.instantT(), g0 = single.thermostatVelocity();
+	single.rescaleTemperature(one, 1.21);
+	ASSERT_FLOAT_EQ(1.21, one.targetT());
+	ASSERT_NEAR(1.1*v0, one.atoms[7].vel.y, 1.0e-5*fabs(v0));
+	ASSERT_NEAR(1.21*T0, one.instantT(), 1.0e-5*T0);
+	ASSERT_NEAR(1.1*g0, single.thermostatVelocity(), 1.0e-5*fabs(g0));
+
+	const int M = 4, every = 5, nSteps = 100;
+	std::vector <float> T (M);
+	for (int k = 0; k < M; ++k) {
+		T[k] = 1.0 + 0.02*k;
+	}
+	systemDefinition sys[M];
+	std::vector <nvt_NH> integrators (M, nvt_NH (1.0));
+	replicaExchange remd (T, every, 3145, 100);
+	for (int k = 0; k < M; ++k) {
+		ljSystem(sys[k], 200, 9.0, T[k], 0.3, false, 3145+k);
+		ASSERT_EQ(k, remd.addReplica(&sys[k], &integrators[k]));
+	}
+	remd.run(nSteps, 2);
+
+	// even and odd pairs alternate, and neighboring temperatures this close swap often
+	int accepted = 0;
+	for (int k = 0; k+1 < M; ++k) {
+		ASSERT_EQ(nSteps/every/2, remd.attempts(k));
+		accepted += remd.accepted(k);
+	}
+	ASSERT_GT(accepted, 0);
+
+	// each temperature is held by exactly one replica, whose thermostat targets it
+	std::vector <int> seen (M, 0);
+	for (int k = 0; k < M; ++k) {
+		const int r = remd.replicaAt(k);
+		ASSERT_EQ(k, remd.temperatureOf(r));
+		ASSERT_FLOAT_EQ(T[k], sys[r].targetT());
+		seen[r]++;
+	}
+	for (int r = 0; r < M; ++r) {
+		ASSERT_EQ(1, seen[r]);
+	}
+}
+
+TEST(ReplicaExchangeTest, RoundTripsAcrossRuns) {
+	// without interactions every potential energy is zero, so every swap is accepted and the replicas move deterministically
+	const int M = 3, every = 2;
+	std::vector <float> T (M);
+	for (int k = 0; k < M; ++k) {
+		T[k] = 1.0 + 0.1*k;
+	}
+	systemDefinition sys[M];
+	std::vector <nvt_NH> integrators (M, nvt_NH (1.0));
+	replicaExchange remd (T, every, 3145, 100);
+	std::vector <float> args(5, 0.0);
+	args[1] = 1.0; // sigma, with epsilon 0
+	for (int k = 0; k < M; ++k) {
+		ljSystem(sys[k], 200, 9.0, T[k], 0.3, false, 3145+k);
+		sys[k].setPotentialArgs(args);
+		ASSERT_EQ(k, remd.addReplica(&sys[k], &integrators[k], (k == 0) ? "test_remd.dat" : ""));
+	}
+
+	// the second run carries on from step 5, so swaps are attempted at steps 2, 4, 6, 8, 10 and 12
+	remd.run(5, 2);
+	ASSERT_EQ(5, remd.stepsDone());
+	ASSERT_EQ(2, remd.attempts(0) + remd.attempts(1));
+	remd.run(7, 2);
+	ASSERT_EQ(12, remd.stepsDone());
+	for (int k = 0; k+1 < M; ++k) {
+		ASSERT_EQ(3, remd.attempts(k));
+		ASSERT_EQ(3, remd.accepted(k));
+	}
+
+	// alternating swaps carry replica 0 up the ladder and back by the fifth attempt, the others only reach the far end
+	ASSERT_EQ(1, remd.roundTrips(0));
+	ASSERT_EQ(0, remd.roundTrips(1));
+	ASSERT_EQ(0, remd.roundTrips(2));
+	ASSERT_EQ(1, remd.totalRoundTrips());
+	for (int k = 0; k < M; ++k) {
+		ASSERT_EQ(k, remd.replicaAt(k));
+	}
+	std::ostringstream report;
+	remd.report(report);
+	ASSERT_EQ("# T_k\tT_k+1\tattempts\taccepted\tacceptance\n1\t1.1\t3\t3\t1\n1.1\t1.2\t3\t3\t1\n# replica\tT\tround trips\n0\t1\t1\n1\t1.1\t0\n2\t1.2\t0\n", report.str());
+
+	// the thermodynamics of both runs are in the file, a line at every swap interval
+	std::ifstream in ("test_remd.dat");
+	std::vector <int> steps;
+	std::string line;
+	while (std::getline(in, line)) {
+		steps.push_back(atoi(line.c_str()));
+	}
+	ASSERT_EQ(6, (int) steps.size());
+	for (int i = 0; i < 6; ++i) {
+		ASSERT_EQ(every*i, steps[i]);
+	}
+	remove("test_remd.dat");
+}
+
+TEST(LaneSystemsTest, LanesMatchSeparateRuns) {
+	// three systems at different temperatures share the first block of lanes with five padding lanes
+	const int W = 3, nSteps = 50;
+	systemDefinition sys[W], ref[W];
+	std::vector <systemDefinition*> packed;
+	for (int w = 0; w < W; ++w) {
+		ljSystem(sys[w], 200, 9.0, 0.8+0.3*w, 0.3, false, 3145+w);
+		ljSystem(ref[w], 200, 9.0, 0.8+0.3*w, 0.3, false, 3145+w);
+		packed.push_back(&sys[w]);
+	}
+	laneSystems lanes (packed, 1.0);
+	ASSERT_EQ(W, lanes.numSystems());
+	for (int step = 0; step < nSteps; ++step) {
+		lanes.step();
+	}
+	for (int w = 0; w < W; ++w) {
+		nvt_NH integrate (1.0);
+		for (int step = 0; step < nSteps; ++step) {
+			integrate.step(ref[w]);
+		}
+		ASSERT_NEAR(ref[w].PotE(), lanes.PotE(w), 1.0e-3*fabs(ref[w].PotE()));
+		ASSERT_NEAR(ref[w].KinE(), lanes.KinE(w), 1.0e-3*ref[w].KinE());
+		lanes.unpack(w, sys[w]);
+		for (int i = 0; i < 200; i += 37) {
+			ASSERT_NEAR(ref[w].atoms[i].pos.x, sys[w].atoms[i].pos.x, 1.0e-3);
+			ASSERT_NEAR(ref[w].atoms[i].vel.z, sys[w].atoms[i].vel.z, 1.0e-3);
+		}
+	}
+
+	// without a thermostat each lane conserves its energy, once the potential is shifted to zero at the cutoff
+	std::vector <float> args = sys[0].potentialArgs();
+	args[3] = -4.0*(pow(2.5, -12.0) - pow(2.5, -6.0));
+	for (int w = 0; w < W; ++w) {
+		sys[w].setPotentialArgs(args);
+	}
+	laneSystems nve (packed, 0.0);
+	nve.step();
+	const float E0 = nve.KinE(1) + nve.PotE(1);
+	for (int step = 0; step < nSteps; ++step) {
+		nve.step();
+	}
+	ASSERT_NEAR(E0, nve.KinE(1) + nve.PotE(1), 1.0e-3*fabs(E0));
+
+	// steps reuse their buffers
+	const long before = allocCount();
+	for (int step = 0; step < 5; ++step) {
+		lanes.step();
+	}
+	ASSERT_EQ(before, allocCount());
+
+	// the minimum image only finds every neighbor if the box is at least twice the cutoff
+	systemDefinition small;
+	ljSystem(small, 27, 4.8, 1.0, 0.3, false, 3145);
+	std::vector <systemDefinition*> tooSmall (1, &small);
+	ASSERT_THROW(laneSystems (tooSmall, 1.0), customException);
+}
+
 int main (int argc, char** argv) {
 	::testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
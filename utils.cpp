@@ -5,7 +5,9 @@
  */
 
 #include "dataTypes.h"
+#include "utils.h"
 #include <math.h>
+#include <omp.h>
 /*
 #ifdef NVCC
 __device__ float dev_pbcDist2 (const float3 *p1, const float3 *p2, float3 *dr, const float3 *box) {
@@ -113,3 +115,33 @@ float pbcDist2 (const float3 &p1, const float3 &p2, float3 &dr, const float3 &bo
 
 	return d;
 }
+
+/*!
+ * Find the two largest squared (minimum image) displacements of a set of atoms from reference positions, as a parallel top-2 reduction.
+ *
+ * \param [in] atoms Atoms
+ * \param [in] ref Reference position of each atom
+ * \param [in] box Box dimensions
+ * \param [out] dr1sq Largest squared displacement
+ * \param [out] dr2sq Second largest squared displacement
+ */
+void maxDisplacement2 (const atomVector &atoms, const float3Vector &ref, const float3 &box, float &dr1sq, float &dr2sq) {
+	float m1 = 0.0, m2 = 0.0;
+	const int natoms = atoms.size();
+	#pragma omp parallel shared(m1, m2)
+	{
+		float my1 = 0.0, my2 = 0.0;
+		float3 dummy;
+		#pragma omp for schedule(static)
+		for (int i = 0; i < natoms; ++i) {
+			keepTop2 (pbcDist2 (atoms[i].pos, ref[i], dummy, box), my1, my2);
+		}
+		#pragma omp critical
+		{
+			keepTop2 (my1, m1, m2);
+			keepTop2 (my2, m1, m2);
+		}
+	}
+	dr1sq = m1;
+	dr2sq = m2;
+}
@@ -7,6 +7,7 @@
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
+#include <vector>
 #include "dataTypes.h"
 
 #ifdef NVCC
@@ -14,5 +15,22 @@ __device__ float dev_pbcDist2 (const float3 *p1, const float3 *p2, float3 *dr, c
 #endif
 float pbcDist2 (const float3 &p1, const float3 &p2, float3 &dr, const float3 &box);
 float3 pbc (const float3 &p1, const float3 &box);
+void maxDisplacement2 (const atomVector &atoms, const float3Vector &ref, const float3 &box, float &dr1sq, float &dr2sq);
+
+/*!
+ * Keep the two largest values seen so far.
+ *
+ * \param [in] d New value
+ * \param [in, out] m1 Largest value
+ * \param [in, out] m2 Second largest value
+ */
+inline void keepTop2 (const float d, float &m1, float &m2) {
+	if (d > m1) {
+		m2 = m1;
+		m1 = d;
+	} else if (d > m2) {
+		m2 = d;
+	}
+}
 
 #endif
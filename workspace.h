@@ -0,0 +1,112 @@
+/*!
+ * Persistent scratch buffers
+ * \date 10/19/26
+ */
+
+#ifndef __WORKSPACE_H__
+#define __WORKSPACE_H__
+
+#include <vector>
+#include <omp.h>
+#include "dataTypes.h"
+
+/*!
+ * Owns the scratch buffers an integrator needs every step.  Buffers are sized the first time they are needed and afterwards only grow
+ * (when the number of atoms or threads grows), so once a simulation reaches steady state a step performs no heap allocations.
+ * Buffers must be sized with reserve() outside of any parallel region; the accessors never allocate.
+ */
+class workspace {
+	public:
+		workspace () {natoms_ = 0; nGrows_ = 0; densityAtoms_ = 0;}
+		~workspace () {}
+		void reserve (const int nThreads, const int natoms);                //!< Make sure every buffer holds at least natoms entries for nThreads threads
+		float3* threadAcc (const int tid) {return &threadAcc_[tid][0];}     //!< Return a thread's acceleration accumulator
+		float3* hostForce () {return &hostForce_[0];}                        //!< Return the buffer forces are copied back into from a device
+		void reserveDensity (const int nThreads, const int natoms);         //!< Make sure the many-body density buffers hold at least natoms entries for nThreads threads
+		float* threadDensity (const int tid) {return &threadDensity_[tid][0];}   //!< Return a thread's host density accumulator
+		float* density () {return &density_[0];}                            //!< Return the host density of each atom
+		float* embeddingForce () {return &embeddingForce_[0];}              //!< Return the derivative of each atom's embedding energy with respect to its density
+		int numGrows () const {return nGrows_;}                             //!< Report how many times the buffers had to grow
+		size_t bytes () const;                                              //!< Report the memory held by the buffers
+	private:
+		int natoms_;    //!< Number of atoms every buffer can hold
+		int nGrows_;    //!< Number of times the buffers grew
+		std::vector < std::vector <float3> > threadAcc_;    //!< Per-thread acceleration accumulators
+		std::vector <float3> hostForce_;                    //!< Host copy of forces computed on a device
+		int densityAtoms_;  //!< Number of atoms the density buffers can hold
+		std::vector < std::vector <float> > threadDensity_; //!< Per-thread host density accumulators
+		std::vector <float> density_;                       //!< Host density of each atom
+		std::vector <float> embeddingForce_;                //!< F'(rho) of each atom
+};
+
+/*!
+ * Grow the buffers if the number of atoms or threads has increased.  Existing contents are not preserved in any meaningful way.
+ *
+ * \param [in] nThreads Number of threads which will accumulate
+ * \param [in] natoms Number of atoms
+ */
+inline void workspace::reserve (const int nThreads, const int natoms) {
+	if (natoms <= natoms_ && nThreads <= (int) threadAcc_.size()) {
+		return;
+	}
+	if (natoms > natoms_) {
+		natoms_ = natoms;
+	}
+	if (nThreads > (int) threadAcc_.size()) {
+		threadAcc_.resize(nThreads);
+	}
+	// each thread allocates and zeroes its own accumulator so its pages are first touched on that thread's NUMA node
+	#pragma omp parallel
+	{
+		for (unsigned int t = omp_get_thread_num(); t < threadAcc_.size(); t += omp_get_num_threads()) {
+			threadAcc_[t].resize(natoms_);
+		}
+	}
+	hostForce_.resize(natoms_);
+	nGrows_++;
+}
+
+/*!
+ * Grow the buffers a many-body potential needs if the number of atoms or threads has increased.  These are kept apart from reserve() so
+ * pair potentials do not pay for them.
+ *
+ * \param [in] nThreads Number of threads which will accumulate
+ * \param [in] natoms Number of atoms
+ */
+inline void workspace::reserveDensity (const int nThreads, const int natoms) {
+	if (natoms <= densityAtoms_ && nThreads <= (int) threadDensity_.size()) {
+		return;
+	}
+	if (natoms > densityAtoms_) {
+		densityAtoms_ = natoms;
+	}
+	if (nThreads > (int) threadDensity_.size()) {
+		threadDensity_.resize(nThreads);
+	}
+	#pragma omp parallel
+	{
+		for (unsigned int t = omp_get_thread_num(); t < threadDensity_.size(); t += omp_get_num_threads()) {
+			threadDensity_[t].resize(densityAtoms_);
+		}
+	}
+	density_.resize(densityAtoms_);
+	embeddingForce_.resize(densityAtoms_);
+	nGrows_++;
+}
+
+/*!
+ * Memory held by the buffers.
+ */
+inline size_t workspace::bytes () const {
+	size_t b = hostForce_.capacity()*sizeof(float3);
+	for (unsigned int t = 0; t < threadAcc_.size(); ++t) {
+		b += threadAcc_[t].capacity()*sizeof(float3);
+	}
+	for (unsigned int t = 0; t < threadDensity_.size(); ++t) {
+		b += threadDensity_[t].capacity()*sizeof(float);
+	}
+	b += (density_.capacity() + embeddingForce_.capacity())*sizeof(float);
+	return b;
+}
+
+#endif